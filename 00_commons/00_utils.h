@@ -9,6 +9,7 @@
 #include <vector>
 #include <cassert>
 #include <fstream>
+#include <algorithm>
 
 namespace vkdemos {
 namespace utils {
@@ -133,13 +134,147 @@ int findMemoryTypeWithProperties(const VkPhysicalDeviceMemoryProperties theMemor
 
 
 
+/**
+ * How the CPU and the GPU are going to access a resource; used to rank memory types.
+ */
+enum MemoryUsage
+{
+	MEMORY_USAGE_UNKNOWN,    // no preference, only the required/preferred flags are considered.
+	MEMORY_USAGE_GPU_ONLY,   // written and read only by the device (render targets, textures, static geometry).
+	MEMORY_USAGE_UPLOAD,     // written once by the host, read once by the device (staging buffers).
+	MEMORY_USAGE_READBACK,   // written by the device, read by the host.
+	MEMORY_USAGE_DYNAMIC,    // written often by the host, read often by the device (per-frame data, dynamic geometry).
+};
+
+
+
+/**
+ * Scores a memory type for the specified usage. Higher is better.
+ * The weights are chosen so that a property that matters for the usage always
+ * dominates the "nice to have" preferred flags.
+ */
+int scoreMemoryType(const VkMemoryPropertyFlags propertyFlags,
+                    const VkMemoryPropertyFlags preferredMemoryProperties,
+                    const MemoryUsage usage)
+{
+	const bool deviceLocal  = (propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+	const bool hostVisible  = (propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	const bool hostCoherent = (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	const bool hostCached   = (propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+
+	int score = 0;
+
+	switch(usage)
+	{
+		case MEMORY_USAGE_GPU_ONLY:
+			// Device-local is what we want; host-visible device-local memory (ReBAR, small BAR heaps)
+			// is a scarce resource better left to the resources the host writes to.
+			score += deviceLocal ? 1000 : 0;
+			score -= hostVisible ? 100 : 0;
+			break;
+
+		case MEMORY_USAGE_UPLOAD:
+			// Plain system memory is best for staging: it doesn't waste device-local memory,
+			// and uncached (write-combined) memory is the fastest to write sequentially.
+			score -= deviceLocal ? 100 : 0;
+			score += hostCoherent ? 50 : 0;
+			score -= hostCached ? 20 : 0;
+			break;
+
+		case MEMORY_USAGE_READBACK:
+			// Reading uncached memory from the CPU is extremely slow.
+			score += hostCached ? 1000 : 0;
+			score += hostCoherent ? 50 : 0;
+			break;
+
+		case MEMORY_USAGE_DYNAMIC:
+			// On UMA and ReBAR systems, memory both host-visible and device-local
+			// lets the device read the data at full speed.
+			score += deviceLocal ? 1000 : 0;
+			score += hostCoherent ? 50 : 0;
+			break;
+
+		case MEMORY_USAGE_UNKNOWN:
+			break;
+	}
+
+	// Every preferred flag the type has is worth a bit.
+	for(uint32_t bit = 1; bit != 0 && bit <= preferredMemoryProperties; bit <<= 1)
+		if((preferredMemoryProperties & bit) && (propertyFlags & bit))
+			score += 10;
+
+	return score;
+}
+
+
+
+/**
+ * Searches the best memory type for an allocation, scoring every candidate.
+ * @param theMemoryProperties memory properties of the Physical Device from where we would like to allocate our object.
+ * @param memoryTypeBits memoryTypeBits field from the VkMemoryRequirements of the object we want to allocate.
+ * @param requiredMemoryProperties properties the memory type must have.
+ * @param preferredMemoryProperties properties that make a memory type more desirable, but that are not mandatory.
+ * @param usage how the host and the device will access the memory; host-accessing usages imply HOST_VISIBLE.
+ * @param allocationSize size of the allocation, checked against heapBudgetsLeft.
+ * @param heapBudgetsLeft if not nullptr, array of VK_MAX_MEMORY_HEAPS elements with the bytes still available
+ *        in every heap; types whose heap doesn't have allocationSize bytes left are skipped.
+ * @return A value >= 0 as the index in VkPhysicalDeviceMemoryProperties::memoryTypes, or -1 if a matching memory type couldn't be found.
+ */
+int findBestMemoryType(const VkPhysicalDeviceMemoryProperties & theMemoryProperties,
+                       const uint32_t memoryTypeBits,
+                       const VkMemoryPropertyFlags requiredMemoryProperties,
+                       const VkMemoryPropertyFlags preferredMemoryProperties,
+                       const MemoryUsage usage,
+                       const VkDeviceSize allocationSize = 0,
+                       const VkDeviceSize * heapBudgetsLeft = nullptr)
+{
+	VkMemoryPropertyFlags required = requiredMemoryProperties;
+	if(usage == MEMORY_USAGE_UPLOAD || usage == MEMORY_USAGE_READBACK || usage == MEMORY_USAGE_DYNAMIC)
+		required |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+	int bestIndex = -1;
+	int bestScore = 0;
+
+	uint32_t len = std::min(theMemoryProperties.memoryTypeCount, 32u);
+	for(uint32_t i = 0; i < len; i++)
+	{
+		if((memoryTypeBits & (1u << i)) == 0)
+			continue;
+
+		const VkMemoryType & memoryType = theMemoryProperties.memoryTypes[i];
+
+		if((memoryType.propertyFlags & required) != required)
+			continue;
+
+		if(heapBudgetsLeft != nullptr && heapBudgetsLeft[memoryType.heapIndex] < allocationSize)
+			continue;
+
+		int score = scoreMemoryType(memoryType.propertyFlags, preferredMemoryProperties, usage);
+
+		// Lazily-allocated memory can only back transient attachments: never pick it unless asked for.
+		if((memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !((required | preferredMemoryProperties) & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+			score -= 10000;
+
+		// On equal scores, keep the first type (the order of memory types is meaningful, see the specification).
+		if(bestIndex < 0 || score > bestScore) {
+			bestIndex = (int)i;
+			bestScore = score;
+		}
+	}
+
+	return bestIndex;
+}
+
+
+
 /**
  * Utility function to create a VkFence on a specified VkDevice.
  * @param theDevice the device used to create the fence.
  * @param outFence the created fence.
+ * @param pAllocator host allocation callbacks, nullptr to use the driver's allocator.
  * @return VkResult returned by vkCreateFence.
  */
-VkResult createFence(const VkDevice theDevice, VkFence & outFence)
+VkResult createFence(const VkDevice theDevice, VkFence & outFence, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 
 	VkFenceCreateInfo fenceCreateInfo = {
@@ -148,7 +283,7 @@ VkResult createFence(const VkDevice theDevice, VkFence & outFence)
 	    .flags = 0
 	};
 
-	return vkCreateFence(theDevice, &fenceCreateInfo, nullptr, &outFence);
+	return vkCreateFence(theDevice, &fenceCreateInfo, pAllocator, &outFence);
 }
 
 
@@ -157,9 +292,10 @@ VkResult createFence(const VkDevice theDevice, VkFence & outFence)
  * Utility function to create a VkSemaphore on a specified VkDevice.
  * @param theDevice the device used to create the semaphore.
  * @param outSemaphore the created semaphore.
+ * @param pAllocator host allocation callbacks, nullptr to use the driver's allocator.
  * @return VkResult returned by vkCreateSemaphore.
  */
-VkResult createSemaphore(const VkDevice theDevice, VkSemaphore & outSemaphore)
+VkResult createSemaphore(const VkDevice theDevice, VkSemaphore & outSemaphore, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {
@@ -168,7 +304,7 @@ VkResult createSemaphore(const VkDevice theDevice, VkSemaphore & outSemaphore)
 		.flags = 0,
 	};
 
-	return vkCreateSemaphore(theDevice, &semaphoreCreateInfo, nullptr, &outSemaphore);
+	return vkCreateSemaphore(theDevice, &semaphoreCreateInfo, pAllocator, &outSemaphore);
 }
 
 
@@ -181,6 +317,7 @@ VkResult createSemaphore(const VkDevice theDevice, VkSemaphore & outSemaphore)
  * @param width width of the framebuffer.
  * @param height height of the framebuffer.
  * @param outFramebuffer the resulting VkFramebuffer object.
+ * @param pAllocator host allocation callbacks, nullptr to use the driver's allocator.
  * @return VkResult returned by vkCreateFramebuffer.
  */
 bool createFramebuffer(const VkDevice theDevice,
@@ -188,7 +325,8 @@ bool createFramebuffer(const VkDevice theDevice,
                        const std::vector<VkImageView> & theViewAttachmentsVector,
                        const int width,
                        const int height,
-                       VkFramebuffer & outFramebuffer
+                       VkFramebuffer & outFramebuffer,
+                       const VkAllocationCallbacks * pAllocator = nullptr
                        )
 {
 	VkResult result;
@@ -206,7 +344,7 @@ bool createFramebuffer(const VkDevice theDevice,
 	};
 
 	VkFramebuffer myFramebuffer;
-	result = vkCreateFramebuffer(theDevice, &framebufferCreateInfo, nullptr, &myFramebuffer);
+	result = vkCreateFramebuffer(theDevice, &framebufferCreateInfo, pAllocator, &myFramebuffer);
 	assert(result == VK_SUCCESS);
 
 	outFramebuffer = myFramebuffer;
@@ -220,9 +358,10 @@ bool createFramebuffer(const VkDevice theDevice,
  * @param theDevice the device used to create the modules.
  * @param filename path and file name of the file containing the shader in SPIR-V format.
  * @param outShaderModule the created VkShaderModule object.
+ * @param pAllocator host allocation callbacks, nullptr to use the driver's allocator.
  * @return VkResult returned by vkCreateShaderModule.
  */
-bool loadAndCreateShaderModule(const VkDevice theDevice, const std::string & filename, VkShaderModule & outShaderModule)
+bool loadAndCreateShaderModule(const VkDevice theDevice, const std::string & filename, VkShaderModule & outShaderModule, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	VkResult result;
 
@@ -261,7 +400,7 @@ bool loadAndCreateShaderModule(const VkDevice theDevice, const std::string & fil
 	};
 
 	VkShaderModule myModule;
-	result = vkCreateShaderModule(theDevice, &shaderModuleCreateInfo, nullptr, &myModule);
+	result = vkCreateShaderModule(theDevice, &shaderModuleCreateInfo, pAllocator, &myModule);
 	assert(result == VK_SUCCESS);
 
 	outShaderModule = myModule;
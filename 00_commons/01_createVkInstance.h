@@ -16,12 +16,15 @@ namespace vkdemos {
 /**
  * Creates a VKInstance that has all the layer names in layerNamesToEnable
  * and all the extension names in extensionNamesToEnable enabled.
+ * If pAllocator is not nullptr, the instance uses it for all its host allocations,
+ * and it must be passed to vkDestroyInstance too.
  */
 bool createVkInstance(const std::vector<const char *> & layerNamesToEnable,
                       const std::vector<const char *> & extensionNamesToEnable,
                       const char * applicationName,
                       const char * engineName,
-                      VkInstance & outInstance)
+                      VkInstance & outInstance,
+                      const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	VkResult result;
 
@@ -201,7 +204,7 @@ bool createVkInstance(const std::vector<const char *> & layerNamesToEnable,
 	 * the structs we filled before.
 	 */
 	VkInstance myInstance;
-	result = vkCreateInstance(&instanceCreateInfo, nullptr, &myInstance);
+	result = vkCreateInstance(&instanceCreateInfo, pAllocator, &myInstance);
 
 	if(result != VK_SUCCESS) {
 		std::cout << "!!! ERROR: Cannot create Vulkan instance, " << vkdemos::utils::VkResultToString(result) << std::endl;
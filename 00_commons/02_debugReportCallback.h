@@ -51,7 +51,8 @@ debugCallback(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t src
 bool createDebugReportCallback(const VkInstance theInstance,
                                const VkDebugReportFlagsEXT theFlags,
                                const PFN_vkDebugReportCallbackEXT theCallback,
-                               VkDebugReportCallbackEXT & outDebugReportCallback)
+                               VkDebugReportCallbackEXT & outDebugReportCallback,
+                               const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	// Since this is an extension, we need to get the pointer to vkCreateDebugReportCallbackEXT at runtime
 	auto pfn_vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(theInstance, "vkCreateDebugReportCallbackEXT");
@@ -67,7 +68,7 @@ bool createDebugReportCallback(const VkInstance theInstance,
 
 	// Call the function pointer we got before to create the VkDebugReportCallback:
 	VkDebugReportCallbackEXT myDebugReportCallback;
-	VkResult result = pfn_vkCreateDebugReportCallbackEXT(theInstance, &debugReportCallbackCreateInfo, nullptr, &myDebugReportCallback);
+	VkResult result = pfn_vkCreateDebugReportCallbackEXT(theInstance, &debugReportCallbackCreateInfo, pAllocator, &myDebugReportCallback);
 	assert(result == VK_SUCCESS);
 
 	outDebugReportCallback = myDebugReportCallback;
@@ -79,11 +80,11 @@ bool createDebugReportCallback(const VkInstance theInstance,
 /*
  * Utility to destroy a VkDebugReportCallbackEXT
  */
-void destroyDebugReportCallback(const VkInstance theInstance, const VkDebugReportCallbackEXT theDebugReportCallback)
+void destroyDebugReportCallback(const VkInstance theInstance, const VkDebugReportCallbackEXT theDebugReportCallback, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	// Get the function pointer and call the function.
 	auto pfn_vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(theInstance, "vkDestroyDebugReportCallbackEXT");
-	pfn_vkDestroyDebugReportCallbackEXT(theInstance, theDebugReportCallback, nullptr);
+	pfn_vkDestroyDebugReportCallbackEXT(theInstance, theDebugReportCallback, pAllocator);
 }
 
 }
@@ -13,7 +13,7 @@ namespace vkdemos {
 /*
  * Create a VkSurfaceKHR from an XCB connection and window.
  */
-bool createVkSurfaceXCB(const VkInstance theInstance, xcb_connection_t * const xcbConnection, const xcb_window_t & xcbWindow, VkSurfaceKHR & outInstance)
+bool createVkSurfaceXCB(const VkInstance theInstance, xcb_connection_t * const xcbConnection, const xcb_window_t & xcbWindow, VkSurfaceKHR & outInstance, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	VkResult result;
 	VkSurfaceKHR mySurface;
@@ -32,7 +32,7 @@ bool createVkSurfaceXCB(const VkInstance theInstance, xcb_connection_t * const x
 		.window = xcbWindow
 	};
 
-	result = vkCreateXcbSurfaceKHR(theInstance, &xlibSurfaceCreateInfo, nullptr, &mySurface);
+	result = vkCreateXcbSurfaceKHR(theInstance, &xlibSurfaceCreateInfo, pAllocator, &mySurface);
 	assert(result == VK_SUCCESS);
 
 	outInstance = mySurface;
@@ -43,11 +43,11 @@ bool createVkSurfaceXCB(const VkInstance theInstance, xcb_connection_t * const x
 /*
  * Create a VkSurfaceKHR from the specified instance and SDL2 SysWmInfo.
  */
-bool createVkSurface(const VkInstance theInstance, const SDL_SysWMinfo & theSysWmInfo, VkSurfaceKHR & outInstance)
+bool createVkSurface(const VkInstance theInstance, const SDL_SysWMinfo & theSysWmInfo, VkSurfaceKHR & outInstance, const VkAllocationCallbacks * pAllocator = nullptr)
 {
 	// TODO add support for other windowing systems.
 	if(theSysWmInfo.subsystem == SDL_SYSWM_X11)
-		return createVkSurfaceXCB(theInstance, XGetXCBConnection(theSysWmInfo.info.x11.display), static_cast<xcb_window_t>(theSysWmInfo.info.x11.window), outInstance);
+		return createVkSurfaceXCB(theInstance, XGetXCBConnection(theSysWmInfo.info.x11.display), static_cast<xcb_window_t>(theSysWmInfo.info.x11.window), outInstance, pAllocator);
 	else
 		return false;
 }
@@ -12,8 +12,19 @@ namespace vkdemos {
 
 /**
  * Creates a VkDevice and its associated VkQueue.
+ * If outTransferQueuePtr and outTransferQueueFamilyIndexPtr are not null, a second queue is created
+ * from a transfer-only queue family (if the device has one) to be used for asynchronous uploads;
+ * otherwise the graphics queue and its family are returned there.
  */
-bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const VkSurfaceKHR theSurface, const std::vector<const char *> & layersNamesToEnable, VkDevice & outDevice, VkQueue & outQueue, uint32_t & outQueueFamilyIndex)
+bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice,
+                              const VkSurfaceKHR theSurface,
+                              const std::vector<const char *> & layersNamesToEnable,
+                              VkDevice & outDevice,
+                              VkQueue & outQueue,
+                              uint32_t & outQueueFamilyIndex,
+                              const VkAllocationCallbacks * pAllocator = nullptr,
+                              VkQueue * outTransferQueuePtr = nullptr,
+                              uint32_t * outTransferQueueFamilyIndexPtr = nullptr)
 {
 	VkResult result;
 
@@ -75,6 +86,7 @@ bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const Vk
 
 	int queueFamilyIndex = 0;
 	int indexOfGraphicsQueueFamily = -1;
+	int indexOfTransferQueueFamily = -1;
 	for(const auto & queueFamProp : queueFamilyPropertiesVector)
 	{
 		// Check if the queue family supports presentation
@@ -110,6 +122,18 @@ bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const Vk
 				indexOfGraphicsQueueFamily = queueFamilyIndex;
 		}
 
+		/*
+		 * A family that supports transfers but neither graphics nor compute is usually
+		 * a DMA engine, that can copy data while the other queues are busy.
+		 * Its minImageTransferGranularity may be bigger than (1,1,1), but that
+		 * doesn't matter for copies of whole images.
+		 */
+		const VkQueueFlags graphicsOrCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+		if(bool(queueFamProp.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamProp.queueFlags & graphicsOrCompute)) {
+			if(indexOfTransferQueueFamily < 0)
+				indexOfTransferQueueFamily = queueFamilyIndex;
+		}
+
 		queueFamilyIndex++;
 	}
 
@@ -142,6 +166,13 @@ bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const Vk
 	                                                                   //  that will be submitted to each created queue. Refer to the spec for more info.
 	deviceQueueCreateInfoVector.push_back(qciToFill);
 
+	// If requested and available, we also create a queue in the transfer-only family.
+	const bool createTransferQueue = (outTransferQueuePtr != nullptr && outTransferQueueFamilyIndexPtr != nullptr && indexOfTransferQueueFamily >= 0);
+	if(createTransferQueue) {
+		qciToFill.queueFamilyIndex = (uint32_t)indexOfTransferQueueFamily;
+		deviceQueueCreateInfoVector.push_back(qciToFill);
+	}
+
 
 	/*
 	 * Physical device features:
@@ -177,7 +208,7 @@ bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const Vk
 	    .pEnabledFeatures        = &physicalDeviceFeatures
 	};
 
-	result = vkCreateDevice(thePhysicalDevice, &deviceCreateInfo, nullptr, &myDevice);
+	result = vkCreateDevice(thePhysicalDevice, &deviceCreateInfo, pAllocator, &myDevice);
 	assert(result == VK_SUCCESS);
 
 
@@ -196,6 +227,20 @@ bool createVkDeviceAndVkQueue(const VkPhysicalDevice thePhysicalDevice, const Vk
 	                 &myQueue                               // The queue goes here.
 	);
 
+	if(outTransferQueuePtr != nullptr && outTransferQueueFamilyIndexPtr != nullptr)
+	{
+		if(createTransferQueue) {
+			vkGetDeviceQueue(myDevice, (uint32_t)indexOfTransferQueueFamily, 0, outTransferQueuePtr);
+			*outTransferQueueFamilyIndexPtr = (uint32_t)indexOfTransferQueueFamily;
+			std::cout << "--- Using queue family " << indexOfTransferQueueFamily << " for transfers." << std::endl;
+		}
+		else {
+			*outTransferQueuePtr = myQueue;
+			*outTransferQueueFamilyIndexPtr = (uint32_t)indexOfGraphicsQueueFamily;
+			std::cout << "--- No transfer-only queue family, transfers will use the graphics queue." << std::endl;
+		}
+	}
+
 	// We're done here!
 	std::cout << "\n+++ VkDevice and VkQueue created succesfully!\n" << std::endl;
 
@@ -22,7 +22,8 @@ bool createVkSwapchain(const VkPhysicalDevice thePhysicalDevice,
                        VkSwapchainKHR theOldSwapChain,
                        VkSwapchainKHR & outSwapchain,
                        VkFormat & outSurfaceFormat,
-                       const VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                       const VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                       const VkAllocationCallbacks * pAllocator = nullptr
                        )
 {
 	VkResult result;
@@ -161,7 +162,7 @@ bool createVkSwapchain(const VkPhysicalDevice thePhysicalDevice,
 	};
 
 	VkSwapchainKHR mySwapchain;
-	result = vkCreateSwapchainKHR(theDevice, &swapchainCreateInfo, nullptr, &mySwapchain);
+	result = vkCreateSwapchainKHR(theDevice, &swapchainCreateInfo, pAllocator, &mySwapchain);
 	assert(result == VK_SUCCESS);
 
 	std::cout << "+++ VkSwapchainKHR created succesfully!\n";
@@ -170,7 +171,7 @@ bool createVkSwapchain(const VkPhysicalDevice thePhysicalDevice,
 
 	// Destroy the old swapchain, if there was one.
 	if(theOldSwapChain != VK_NULL_HANDLE) {
-		vkDestroySwapchainKHR(theDevice, theOldSwapChain, nullptr);
+		vkDestroySwapchainKHR(theDevice, theOldSwapChain, pAllocator);
 		std::cout << "+++     ... and old VkSwapchainKHR destroyed succesfully!\n";
 	}
 	std::cout << std::endl;
@@ -189,7 +190,8 @@ bool getSwapchainImagesAndViews(const VkDevice theDevice,
                                 const VkSwapchainKHR theSwapchain,
                                 const VkFormat & theSurfaceFormat,
                                 std::vector<VkImage> & outSwapchainImagesVector,
-                                std::vector<VkImageView> & outSwapchainImageViewsVector
+                                std::vector<VkImageView> & outSwapchainImageViewsVector,
+                                const VkAllocationCallbacks * pAllocator = nullptr
                                 )
 {
 	VkResult result;
@@ -235,7 +237,7 @@ bool getSwapchainImagesAndViews(const VkDevice theDevice,
 			.image = swapchainImagesVector[i],
 		};
 
-		result = vkCreateImageView(theDevice, &imageViewCreateInfo, nullptr, &swapchainImageViewsVector[i]);
+		result = vkCreateImageView(theDevice, &imageViewCreateInfo, pAllocator, &swapchainImageViewsVector[i]);
 		assert(result == VK_SUCCESS);
 	}
 
@@ -12,7 +12,8 @@ namespace vkdemos {
 bool createCommandPool(const VkDevice theDevice,
                        const uint32_t theQueueFamilyIndex,
                        const VkCommandPoolCreateFlagBits createFlagBits,
-                       VkCommandPool & outCommandPool
+                       VkCommandPool & outCommandPool,
+                       const VkAllocationCallbacks * pAllocator = nullptr
                        )
 {
 	VkResult result;
@@ -25,7 +26,7 @@ bool createCommandPool(const VkDevice theDevice,
 	};
 
 	VkCommandPool myCommandPool;
-	result = vkCreateCommandPool(theDevice, &commandPoolCreateInfo, nullptr, &myCommandPool);
+	result = vkCreateCommandPool(theDevice, &commandPoolCreateInfo, pAllocator, &myCommandPool);
 	assert(result == VK_SUCCESS);
 
 	outCommandPool = myCommandPool;
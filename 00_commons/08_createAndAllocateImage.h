@@ -1,6 +1,9 @@
 #ifndef VKDEMOS_CREATEANDALLOCATEIMAGE_H
 #define VKDEMOS_CREATEANDALLOCATEIMAGE_H
 
+#include "12_memoryAllocator.h"
+#include "15_memoryTracker.h"
+
 namespace vkdemos {
 
 #include "00_utils.h"
@@ -14,6 +17,16 @@ namespace vkdemos {
  * and must be transitioned to the appropriate layout.
  *
  * If outImageViewPtr is not nullptr, a VkImageView for the new image is created.
+ *
+ * The memory is recorded by the memory tracker with the specified allocationSite
+ * (see 15_memoryTracker.h); free it with trackedFreeMemory, with the same pAllocator.
+ * Pass VKDEMOS_ALLOCATION_SITE("tag") from the caller, so that the tracker reports the caller's file and line.
+ *
+ * If imageUsage contains VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, the image is
+ * placed in LAZILY_ALLOCATED memory when the device has it.
+ *
+ * mipLevels is the number of mip levels of the image (see computeMipLevelCount in
+ * 19_mipmaps.h for a full chain); the view, if created, covers all of them.
  */
 bool createAndAllocateImage(const VkDevice theDevice,
 							const VkPhysicalDeviceMemoryProperties theMemoryProperties,
@@ -24,8 +37,11 @@ bool createAndAllocateImage(const VkDevice theDevice,
 							const int height,
 							VkImage & outImage,
 							VkDeviceMemory & outImageMemory,
-							VkImageView * outImageViewPtr = nullptr,
-							VkImageAspectFlags viewSubresourceAspectMask = 0
+							VkImageView * outImageViewPtr,
+							VkImageAspectFlags viewSubresourceAspectMask,
+							const AllocationSite & allocationSite,
+							const VkAllocationCallbacks * pAllocator = nullptr,
+							const uint32_t mipLevels = 1
 							)
 {
 	VkResult result;
@@ -47,7 +63,7 @@ bool createAndAllocateImage(const VkDevice theDevice,
 		.imageType = VK_IMAGE_TYPE_2D,
 		.format = theImageFormat,
 		.extent = {(uint32_t)width, (uint32_t)height, 1},
-		.mipLevels = 1,
+		.mipLevels = mipLevels,
 		.arrayLayers = 1,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -58,7 +74,7 @@ bool createAndAllocateImage(const VkDevice theDevice,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 	};
 
-	result = vkCreateImage(theDevice, &imageCreateInfo, nullptr, &myImage);
+	result = vkCreateImage(theDevice, &imageCreateInfo, pAllocator, &myImage);
 	assert(result == VK_SUCCESS);
 
 
@@ -77,8 +93,25 @@ bool createAndAllocateImage(const VkDevice theDevice,
 	VkMemoryRequirements memoryRequirements;
 	vkGetImageMemoryRequirements(theDevice, myImage, &memoryRequirements);
 
-	// Find an appropriate memory type with all the requirements for our image.
-	int memoryTypeIndex = vkdemos::utils::findMemoryTypeWithProperties(theMemoryProperties, memoryRequirements.memoryTypeBits, requiredMemoryProperties);
+	/*
+	 * Find an appropriate memory type with all the requirements for our image.
+	 *
+	 * Transient attachments (depth buffers, multisampled color buffers...) are
+	 * written and read only inside a render pass, and their contents are thrown away
+	 * at its end (storeOp DONT_CARE). On tiled GPUs they can then live entirely in
+	 * on-chip tile memory, and if we place them in a LAZILY_ALLOCATED memory type
+	 * the driver will never commit real memory for them.
+	 * Desktop GPUs usually don't have such a memory type: in that case we fall back
+	 * to a normal memory type with the required properties.
+	 */
+	int memoryTypeIndex = -1;
+
+	if(imageUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		memoryTypeIndex = vkdemos::utils::findMemoryTypeWithProperties(theMemoryProperties, memoryRequirements.memoryTypeBits, requiredMemoryProperties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+	if(memoryTypeIndex < 0)
+		memoryTypeIndex = vkdemos::utils::findMemoryTypeWithProperties(theMemoryProperties, memoryRequirements.memoryTypeBits, requiredMemoryProperties);
+
 	if(memoryTypeIndex < 0) {
 		std::cout << "!!! ERROR: Can't find a memory type to hold the image." << std::endl;
 		return false;
@@ -92,7 +125,7 @@ bool createAndAllocateImage(const VkDevice theDevice,
 		.memoryTypeIndex = (uint32_t)memoryTypeIndex,
 	};
 
-	result = vkAllocateMemory(theDevice, &memoryAllocateInfo, nullptr, &myImageMemory);
+	result = trackedAllocateMemory(theDevice, theMemoryProperties, memoryAllocateInfo, allocationSite, myImageMemory, pAllocator);
 	assert(result == VK_SUCCESS);
 
 
@@ -110,7 +143,8 @@ bool createAndAllocateImage(const VkDevice theDevice,
 	 * This is done mainly to ammortize the cost of memory allocation (there is a potentially large
 	 * space and time overhead in each memory allocation), or it can be used for advanced techniques
 	 * such as memory aliasing.
-	 * In these demoes we just allocate a new VkDeviceMemory for each single VkImage, for simplicity.
+	 * In this function we just allocate a new VkDeviceMemory for each single VkImage, for simplicity;
+	 * the overload below takes a MemoryAllocator and sub-allocates the image from a bigger block.
 	 */
 	result = vkBindImageMemory(theDevice, myImage, myImageMemory, 0);
 	assert(result == VK_SUCCESS);
@@ -132,7 +166,7 @@ bool createAndAllocateImage(const VkDevice theDevice,
 			.subresourceRange = {
 				.aspectMask = viewSubresourceAspectMask,
 				.baseMipLevel = 0,
-				.levelCount = 1,
+				.levelCount = mipLevels,
 				.baseArrayLayer = 0,
 				.layerCount = 1
 			},
@@ -145,7 +179,113 @@ bool createAndAllocateImage(const VkDevice theDevice,
 			.viewType = VK_IMAGE_VIEW_TYPE_2D,
 		};
 
-		result = vkCreateImageView(theDevice, &imageViewCreateInfo, nullptr, &myImageView);
+		result = vkCreateImageView(theDevice, &imageViewCreateInfo, pAllocator, &myImageView);
+		assert(result == VK_SUCCESS);
+
+		*outImageViewPtr = myImageView;
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Creates a VkImage and binds it to a range of memory sub-allocated from theAllocator.
+ *
+ * Same as the function above, but instead of calling vkAllocateMemory for every image,
+ * the memory is taken from one of the big blocks owned by the allocator.
+ * memoryUsage is used to pick the best memory type among the ones having requiredMemoryProperties.
+ * The memory tracker records the sub-allocation with allocationSite until it is freed.
+ * Free outImageAllocation with freeMemoryToAllocator after destroying the image.
+ */
+bool createAndAllocateImage(const VkDevice theDevice,
+							MemoryAllocator & theAllocator,
+							const VkImageUsageFlags imageUsage,
+							const VkMemoryPropertyFlags requiredMemoryProperties,
+							const VkFormat theImageFormat,
+							const int width,
+							const int height,
+							VkImage & outImage,
+							MemoryAllocation & outImageAllocation,
+							VkImageView * outImageViewPtr,
+							VkImageAspectFlags viewSubresourceAspectMask,
+							const AllocationSite & allocationSite,
+							const vkdemos::utils::MemoryUsage memoryUsage = vkdemos::utils::MEMORY_USAGE_GPU_ONLY,
+							const VkAllocationCallbacks * pAllocator = nullptr,
+							const uint32_t mipLevels = 1
+							)
+{
+	VkResult result;
+	VkImage myImage;
+	VkImageView myImageView;
+	MemoryAllocation myImageAllocation;
+
+	const VkImageCreateInfo imageCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = theImageFormat,
+		.extent = {(uint32_t)width, (uint32_t)height, 1},
+		.mipLevels = mipLevels,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = imageUsage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+
+	result = vkCreateImage(theDevice, &imageCreateInfo, pAllocator, &myImage);
+	assert(result == VK_SUCCESS);
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(theDevice, myImage, &memoryRequirements);
+
+	// Transient attachments prefer lazily-allocated memory, as in the function above.
+	const VkMemoryPropertyFlags preferredMemoryProperties = (imageUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+
+	// Optimally-tiled images are non-linear resources.
+	if(!allocateMemoryFromAllocator(theAllocator, memoryRequirements, requiredMemoryProperties, false, allocationSite, myImageAllocation, memoryUsage, preferredMemoryProperties)) {
+		std::cout << "!!! ERROR: Can't allocate memory for the image." << std::endl;
+		vkDestroyImage(theDevice, myImage, pAllocator);
+		return false;
+	}
+
+	result = vkBindImageMemory(theDevice, myImage, myImageAllocation.memory, myImageAllocation.offset);
+	assert(result == VK_SUCCESS);
+
+	outImage = myImage;
+	outImageAllocation = myImageAllocation;
+
+	if(outImageViewPtr != nullptr)
+	{
+		const VkImageViewCreateInfo imageViewCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.image = myImage,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = theImageFormat,
+			.components = {
+				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.a = VK_COMPONENT_SWIZZLE_IDENTITY
+			},
+			.subresourceRange = {
+				.aspectMask = viewSubresourceAspectMask,
+				.baseMipLevel = 0,
+				.levelCount = mipLevels,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+		};
+
+		result = vkCreateImageView(theDevice, &imageViewCreateInfo, pAllocator, &myImageView);
 		assert(result == VK_SUCCESS);
 
 		*outImageViewPtr = myImageView;
@@ -1,6 +1,9 @@
 #ifndef VKDEMOS_CREATEANDALLOCATEBUFFER_H
 #define VKDEMOS_CREATEANDALLOCATEBUFFER_H
 
+#include "12_memoryAllocator.h"
+#include "15_memoryTracker.h"
+
 namespace vkdemos {
 
 #include "00_utils.h"
@@ -14,6 +17,8 @@ namespace vkdemos {
  * This function is basically identical to createAndAllocateImage;
  * for an extended explanation of Vulkan's memory binding, refer
  * to createAndAllocateImage's implementation.
+ * allocationSite is recorded by the memory tracker, as for createAndAllocateImage.
+ * Free outBufferMemory with trackedFreeMemory, with the same pAllocator.
  */
 bool createAndAllocateBuffer(const VkDevice theDevice,
 							 const VkPhysicalDeviceMemoryProperties theMemoryProperties,
@@ -21,7 +26,9 @@ bool createAndAllocateBuffer(const VkDevice theDevice,
 							 const VkMemoryPropertyFlags requiredMemoryProperties,
 							 const VkDeviceSize bufferSize,
 							 VkBuffer & outBuffer,
-							 VkDeviceMemory & outBufferMemory
+							 VkDeviceMemory & outBufferMemory,
+							 const AllocationSite & allocationSite,
+							 const VkAllocationCallbacks * pAllocator = nullptr
 							 )
 {
 	VkResult result;
@@ -42,7 +49,7 @@ bool createAndAllocateBuffer(const VkDevice theDevice,
 		.pQueueFamilyIndices = nullptr,            // unused in sharing mode exclusive
 	};
 
-	result = vkCreateBuffer(theDevice, &bufferCreateInfo, nullptr, &myBuffer);
+	result = vkCreateBuffer(theDevice, &bufferCreateInfo, pAllocator, &myBuffer);
 	assert(result == VK_SUCCESS);
 
 	// Get memory requirements for the buffer.
@@ -66,7 +73,7 @@ bool createAndAllocateBuffer(const VkDevice theDevice,
 		.memoryTypeIndex = (uint32_t)memoryTypeIndex,
 	};
 
-	result = vkAllocateMemory(theDevice, &memoryAllocateInfo, nullptr, &myBufferMemory);
+	result = trackedAllocateMemory(theDevice, theMemoryProperties, memoryAllocateInfo, allocationSite, myBufferMemory, pAllocator);
 	assert(result == VK_SUCCESS);
 
 	/*
@@ -80,5 +87,61 @@ bool createAndAllocateBuffer(const VkDevice theDevice,
 	return true;
 }
 
+
+
+/**
+ * Creates a VkBuffer and binds it to a range of memory sub-allocated from theAllocator.
+ * memoryUsage is used to pick the best memory type among the ones having requiredMemoryProperties.
+ * The memory tracker records the sub-allocation with allocationSite until it is freed.
+ * Free outBufferAllocation with freeMemoryToAllocator after destroying the buffer.
+ */
+bool createAndAllocateBuffer(const VkDevice theDevice,
+							 MemoryAllocator & theAllocator,
+							 const VkBufferUsageFlags bufferUsage,
+							 const VkMemoryPropertyFlags requiredMemoryProperties,
+							 const VkDeviceSize bufferSize,
+							 VkBuffer & outBuffer,
+							 MemoryAllocation & outBufferAllocation,
+							 const AllocationSite & allocationSite,
+							 const vkdemos::utils::MemoryUsage memoryUsage = vkdemos::utils::MEMORY_USAGE_UNKNOWN,
+							 const VkAllocationCallbacks * pAllocator = nullptr
+							 )
+{
+	VkResult result;
+	VkBuffer myBuffer;
+	MemoryAllocation myBufferAllocation;
+
+	const VkBufferCreateInfo bufferCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.size = bufferSize,
+		.usage = bufferUsage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+	};
+
+	result = vkCreateBuffer(theDevice, &bufferCreateInfo, pAllocator, &myBuffer);
+	assert(result == VK_SUCCESS);
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(theDevice, myBuffer, &memoryRequirements);
+
+	// Buffers are always linear resources.
+	if(!allocateMemoryFromAllocator(theAllocator, memoryRequirements, requiredMemoryProperties, true, allocationSite, myBufferAllocation, memoryUsage)) {
+		std::cout << "!!! ERROR: Can't allocate memory for the buffer." << std::endl;
+		vkDestroyBuffer(theDevice, myBuffer, pAllocator);
+		return false;
+	}
+
+	result = vkBindBufferMemory(theDevice, myBuffer, myBufferAllocation.memory, myBufferAllocation.offset);
+	assert(result == VK_SUCCESS);
+
+	outBuffer = myBuffer;
+	outBufferAllocation = myBufferAllocation;
+	return true;
+}
+
 }	// vkdemos
 #endif
@@ -1,16 +1,21 @@
 #ifndef VKDEMOS_SUBMITIMAGEBARRIER_H
 #define VKDEMOS_SUBMITIMAGEBARRIER_H
 
-namespace vkdemos {
+#include <vulkan/vulkan.h>
 
-#include "vulkan/vulkan.h"
+namespace vkdemos {
 
 /**
  * Appends a CmdPipelineBarrier to the specified command buffer,
  * containing an Image Barrier operation with the specified parameters.
+ * srcStageMask must contain the stages of the previous accesses to the image, and dstStageMask
+ * the stages of the next ones; TOP_OF_PIPE on both sides doesn't wait for anything.
+ * To barrier many images at once see ResourceStateTracker in 33_resourceStateTracker.h.
  */
 void submitImageBarrier(const VkCommandBuffer theCommandBuffer,
                         const VkImage theImage,
+                        const VkPipelineStageFlags srcStageMask,
+                        const VkPipelineStageFlags dstStageMask,
                         const VkAccessFlags srcAccessMask,
                         const VkAccessFlags dstAccessMask,
                         const VkImageLayout oldLayout,
@@ -32,8 +37,8 @@ void submitImageBarrier(const VkCommandBuffer theCommandBuffer,
 	};
 
 	vkCmdPipelineBarrier(theCommandBuffer,
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // dstStageMask
+		srcStageMask,                      // srcStageMask
+		dstStageMask,                      // dstStageMask
 		0,                                 // dependencyFlags
 		0,                                 // memoryBarrierCount
 		nullptr,                           // pMemoryBarriers
@@ -44,6 +49,6 @@ void submitImageBarrier(const VkCommandBuffer theCommandBuffer,
 	);
 }
 
-}
+}	// vkdemos
 
 #endif
@@ -2,8 +2,15 @@
 #define VKDEMOS_LOADIMAGEFROMFILE_H
 
 #include <SDL2/SDL_image.h>
+#include <vulkan/vulkan.h>
+#include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+	#include <immintrin.h>
+#endif
 
 /**
  * Load an image from a file.
@@ -30,10 +37,220 @@ SDL_Surface* loadImageFromFile(const std::string & path)
 	if(loadedimage != nullptr)
 	{
 		// Puts the file in a SDL acceptable format
-		return SDL_ConvertSurface(loadedimage, &pixformat, 0);
+		SDL_Surface* convertedImage = SDL_ConvertSurface(loadedimage, &pixformat, 0);
+		SDL_FreeSurface(loadedimage);
+		return convertedImage;
 	}
 
 	return nullptr;
 }
 
+
+
+namespace vkdemos {
+
+/*
+ * Decoding images directly into caller-provided memory.
+ *
+ * loadImageFromFile copies the pixels twice after decoding them: SDL_ConvertSurface
+ * creates a second surface, and the caller then copies it to a staging buffer.
+ * Instead, openImageFile only decodes the file (SDL_image gives us the pixels in the
+ * decoder's native format: 24-bit RGB for JPEGs and opaque PNGs, 32-bit RGBA, palettes...)
+ * and readImagePixels converts them, in a single pass, to the destination's format and
+ * row pitch: the destination can be a mapped staging allocation, so the pixels are
+ * written just once, where the GPU copy will read them.
+ *
+ * The common conversions (3 or 4 bytes per pixel in any byte order, to RGBA or BGRA)
+ * are a byte shuffle: with SSSE3, 4 pixels are converted by a single PSHUFB.
+ * Other formats (palettes, 16-bit) go through SDL_GetRGBA, one pixel at a time.
+ */
+struct ImageFile
+{
+	SDL_Surface* surface = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+
+
+/**
+ * Decodes an image file, without converting it.
+ * Its size is then available to allocate the destination of readImagePixels.
+ */
+bool openImageFile(const std::string & path, ImageFile & outImageFile)
+{
+	SDL_Surface* surface = IMG_Load(path.c_str());
+
+	if(surface == nullptr) {
+		std::cout << "!!! ERROR: couldn't load image \"" << path << "\": " << SDL_GetError() << std::endl;
+		return false;
+	}
+
+	outImageFile.surface = surface;
+	outImageFile.width = (uint32_t)surface->w;
+	outImageFile.height = (uint32_t)surface->h;
+	return true;
+}
+
+
+
+/**
+ * Frees a decoded image (readImagePixels does it automatically).
+ */
+void closeImageFile(ImageFile & theImageFile)
+{
+	if(theImageFile.surface != nullptr)
+		SDL_FreeSurface(theImageFile.surface);
+
+	theImageFile = ImageFile{};
+}
+
+
+
+/*
+ * Converts a row of pixels whose channels are single bytes, at the offsets in srcOffsets
+ * (-1 for a missing alpha channel), to 4-byte pixels with the channels at dstOffsets.
+ */
+void convertImageRowScalar(const uint8_t * src, uint8_t * dst, const uint32_t width, const uint32_t srcBytesPerPixel, const int srcOffsets[4], const int dstOffsets[4])
+{
+	for(uint32_t x = 0; x < width; x++, src += srcBytesPerPixel, dst += 4) {
+		for(int c = 0; c < 4; c++)
+			dst[dstOffsets[c]] = (srcOffsets[c] >= 0) ? src[srcOffsets[c]] : 255;
+	}
+}
+
+#if defined(__x86_64__) && defined(__SSE2__)
+
+__attribute__((target("ssse3")))
+void convertImageRowSSSE3(const uint8_t * src, uint8_t * dst, const uint32_t width, const uint32_t srcBytesPerPixel, const int srcOffsets[4], const int dstOffsets[4])
+{
+	// Shuffle mask for 4 pixels: each destination byte takes a source byte, or 0x80 (zero) for the missing alpha, which is then ORed in.
+	alignas(16) uint8_t shuffle[16];
+	alignas(16) uint8_t fill[16];
+
+	for(int p = 0; p < 4; p++) {
+		for(int c = 0; c < 4; c++) {
+			shuffle[p*4 + dstOffsets[c]] = (srcOffsets[c] >= 0) ? (uint8_t)(p * srcBytesPerPixel + srcOffsets[c]) : 0x80;
+			fill[p*4 + dstOffsets[c]] = (srcOffsets[c] >= 0) ? 0 : 255;
+		}
+	}
+
+	const __m128i shuffleMask = _mm_load_si128((const __m128i*)shuffle);
+	const __m128i fillMask = _mm_load_si128((const __m128i*)fill);
+
+	// 4 pixels per iteration, as long as the 16-byte load stays inside the row.
+	uint32_t x = 0;
+	for(; x * srcBytesPerPixel + 16 <= width * srcBytesPerPixel; x += 4) {
+		const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * srcBytesPerPixel));
+		_mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffleMask), fillMask));
+	}
+
+	convertImageRowScalar(src + x * srcBytesPerPixel, dst + x * 4, width - x, srcBytesPerPixel, srcOffsets, dstOffsets);
+}
+
+#endif
+
+
+
+/**
+ * Converts the pixels of a decoded image to theFormat, writing them to theDestination
+ * with rows dstRowPitch bytes apart, and frees the decoded image (even if the conversion fails).
+ * @param theFormat VK_FORMAT_R8G8B8A8_* or VK_FORMAT_B8G8R8A8_* (UNORM or SRGB).
+ */
+bool readImagePixels(ImageFile & theImageFile, void * theDestination, const size_t dstRowPitch, const VkFormat theFormat)
+{
+	SDL_Surface* surface = theImageFile.surface;
+	const SDL_PixelFormat* format = surface->format;
+
+	int dstOffsets[4];   // R, G, B, A
+	switch(theFormat)
+	{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			dstOffsets[0] = 0; dstOffsets[1] = 1; dstOffsets[2] = 2; dstOffsets[3] = 3;
+			break;
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			dstOffsets[0] = 2; dstOffsets[1] = 1; dstOffsets[2] = 0; dstOffsets[3] = 3;
+			break;
+		default:
+			std::cout << "!!! ERROR: readImagePixels can't convert images to VkFormat " << theFormat << "." << std::endl;
+			closeImageFile(theImageFile);
+			return false;
+	}
+
+	/*
+	 * Byte offset of each channel in a source pixel, if all the channels are whole bytes
+	 * (the masks describe the pixel as a little-endian integer).
+	 */
+	const uint32_t masks[4] = {format->Rmask, format->Gmask, format->Bmask, format->Amask};
+	int srcOffsets[4];
+	bool byteChannels = (format->palette == nullptr) && (format->BytesPerPixel == 3 || format->BytesPerPixel == 4);
+
+	for(int c = 0; c < 4 && byteChannels; c++)
+	{
+		srcOffsets[c] = -1;
+
+		if(masks[c] == 0) {
+			byteChannels = (c == 3);    // Only alpha can be missing.
+			continue;
+		}
+
+		for(int b = 0; b < format->BytesPerPixel; b++)
+			if(masks[c] == (0xFFu << (8 * b)))
+				srcOffsets[c] = b;
+
+		byteChannels = (srcOffsets[c] >= 0);
+	}
+
+	if(SDL_MUSTLOCK(surface))
+		SDL_LockSurface(surface);
+
+	const uint8_t* src = (const uint8_t*)surface->pixels;
+	uint8_t* dst = (uint8_t*)theDestination;
+	const uint32_t width = theImageFile.width;
+
+#if defined(__x86_64__) && defined(__SSE2__)
+	const bool useSSSE3 = __builtin_cpu_supports("ssse3");
+#endif
+
+	for(uint32_t y = 0; y < theImageFile.height; y++)
+	{
+		const uint8_t* srcRow = src + (size_t)y * surface->pitch;
+		uint8_t* dstRow = dst + (size_t)y * dstRowPitch;
+
+		if(byteChannels) {
+#if defined(__x86_64__) && defined(__SSE2__)
+			if(useSSSE3) {
+				convertImageRowSSSE3(srcRow, dstRow, width, format->BytesPerPixel, srcOffsets, dstOffsets);
+				continue;
+			}
+#endif
+			convertImageRowScalar(srcRow, dstRow, width, format->BytesPerPixel, srcOffsets, dstOffsets);
+		}
+		else {
+			// Generic path: let SDL unpack each pixel.
+			for(uint32_t x = 0; x < width; x++)
+			{
+				uint32_t pixel = 0;
+				memcpy(&pixel, srcRow + x * format->BytesPerPixel, format->BytesPerPixel);
+
+				uint8_t rgba[4];
+				SDL_GetRGBA(pixel, format, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+
+				for(int c = 0; c < 4; c++)
+					dstRow[x * 4 + dstOffsets[c]] = rgba[c];
+			}
+		}
+	}
+
+	if(SDL_MUSTLOCK(surface))
+		SDL_UnlockSurface(surface);
+
+	closeImageFile(theImageFile);
+	return true;
+}
+
+}	// vkdemos
+
 #endif
@@ -0,0 +1,673 @@
+#ifndef VKDEMOS_MEMORYALLOCATOR_H
+#define VKDEMOS_MEMORYALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "15_memoryTracker.h"
+
+namespace vkdemos {
+
+/*
+ * A simple pooled device memory allocator.
+ *
+ * vkAllocateMemory is an expensive call, and implementations are only required
+ * to support a small number of live allocations (VkPhysicalDeviceLimits::maxMemoryAllocationCount
+ * can be as low as 4096). Instead of allocating a VkDeviceMemory for every resource,
+ * we allocate big blocks of memory for each memory type, and carve aligned ranges
+ * out of them; every block keeps a list of its free ranges (sorted by offset,
+ * so that adjacent free ranges can be merged back together when memory is released).
+ *
+ * Linear resources (buffers) and non-linear resources (optimally-tiled images)
+ * are placed in different blocks, so that we never have to care about
+ * bufferImageGranularity between neighbouring allocations.
+ *
+ * Requests bigger than half a block get a dedicated VkDeviceMemory, that is
+ * released as soon as the resource is freed. So do requests for LAZILY_ALLOCATED
+ * memory (transient attachments): the driver commits such memory only if it's
+ * really needed, so there's nothing to gain in pooling it.
+ *
+ * Blocks of host-visible memory are mapped once when they are allocated, and stay
+ * mapped until they are freed: every allocation from them gets a ready-to-use
+ * mappedPointer. Since a VkDeviceMemory can't be mapped twice, never call vkMapMemory
+ * on memory coming from the allocator.
+ */
+
+static constexpr VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+// By default the allocator never takes more than this percentage of a heap,
+// leaving some room to the driver, the swapchain and other applications.
+static constexpr VkDeviceSize DEFAULT_HEAP_BUDGET_PERCENT = 80;
+
+
+/**
+ * A big VkDeviceMemory allocation from which the allocator sub-allocates resources.
+ */
+struct MemoryBlock
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;    // VK_NULL_HANDLE if this slot is unused.
+	VkDeviceSize size = 0;
+	uint32_t memoryTypeIndex = 0;
+	bool linear = true;                        // true if the block contains buffers, false if it contains optimal images.
+	bool dedicated = false;                    // true if the whole block is used by a single resource.
+	uint8_t * mappedPointer = nullptr;         // persistent mapping of the whole block, nullptr if not host-visible.
+
+	VkDeviceSize usedBytes = 0;
+	uint32_t allocationCount = 0;
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges;   // offset -> size of every free range, ordered by offset.
+};
+
+
+/**
+ * A range of device memory returned by the allocator.
+ * Bind your resource to (memory, offset).
+ */
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memoryTypeIndex = 0;
+	uint32_t blockIndex = 0;
+	void * mappedPointer = nullptr;            // pointer to the allocation's memory, if host-visible.
+};
+
+
+/**
+ * The allocator state. Create it with createMemoryAllocator and destroy it with destroyMemoryAllocator.
+ */
+struct MemoryAllocator
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize preferredBlockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+	VkDeviceSize nonCoherentAtomSize = 1;
+	uint32_t maxMemoryAllocationCount = 0;
+	const VkAllocationCallbacks * pAllocator = nullptr;     // for the VkDeviceMemory blocks.
+
+	// Bytes the allocator may take from each heap, and bytes currently taken by its blocks.
+	VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS] = {};
+
+	std::vector<MemoryBlock> blocks;
+};
+
+
+/**
+ * Aggregated statistics about the state of a MemoryAllocator.
+ */
+struct MemoryAllocatorStatistics
+{
+	uint32_t blockCount = 0;
+	uint32_t dedicatedBlockCount = 0;
+	uint32_t allocationCount = 0;
+	uint32_t freeRangeCount = 0;
+	VkDeviceSize reservedBytes = 0;     // sum of the sizes of all the blocks.
+	VkDeviceSize usedBytes = 0;         // bytes given to resources.
+	VkDeviceSize freeBytes = 0;         // reservedBytes - usedBytes.
+	VkDeviceSize largestFreeRange = 0;
+	float fragmentation = 0.0f;         // 0 = all free memory is contiguous, close to 1 = free memory is scattered in tiny ranges.
+};
+
+
+
+/**
+ * Round "value" up to a multiple of "alignment" (that must be a power of two, as all Vulkan alignments are).
+ */
+VkDeviceSize alignDeviceSize(const VkDeviceSize value, const VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+
+/**
+ * Initializes a MemoryAllocator for the specified device.
+ * No memory is allocated until the first call to allocateMemoryFromAllocator.
+ * @param preferredBlockSize size of the VkDeviceMemory blocks the allocator requests to the device;
+ *        it is reduced for small heaps, so that a single block never takes more than 1/8 of a heap.
+ * @param pAllocator host allocation callbacks for the allocation and the freeing of the blocks.
+ */
+bool createMemoryAllocator(const VkPhysicalDevice thePhysicalDevice,
+                           const VkDevice theDevice,
+                           MemoryAllocator & outAllocator,
+                           const VkDeviceSize preferredBlockSize = DEFAULT_MEMORY_BLOCK_SIZE,
+                           const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(thePhysicalDevice, &physicalDeviceProperties);
+
+	MemoryAllocator myAllocator;
+	myAllocator.device = theDevice;
+	vkGetPhysicalDeviceMemoryProperties(thePhysicalDevice, &myAllocator.memoryProperties);
+	myAllocator.preferredBlockSize = preferredBlockSize;
+	myAllocator.pAllocator = pAllocator;
+	myAllocator.nonCoherentAtomSize = std::max<VkDeviceSize>(physicalDeviceProperties.limits.nonCoherentAtomSize, 1);
+	myAllocator.maxMemoryAllocationCount = physicalDeviceProperties.limits.maxMemoryAllocationCount;
+
+	for(uint32_t i = 0; i < myAllocator.memoryProperties.memoryHeapCount; i++)
+		myAllocator.heapBudget[i] = myAllocator.memoryProperties.memoryHeaps[i].size / 100 * DEFAULT_HEAP_BUDGET_PERCENT;
+
+	outAllocator = myAllocator;
+	return true;
+}
+
+
+
+/**
+ * Sets how many bytes the allocator may take from the specified heap.
+ * When a heap's budget is exhausted, allocations fall back to the next best memory type.
+ */
+void setMemoryHeapBudget(MemoryAllocator & theAllocator, const uint32_t heapIndex, const VkDeviceSize budget)
+{
+	assert(heapIndex < theAllocator.memoryProperties.memoryHeapCount);
+	theAllocator.heapBudget[heapIndex] = budget;
+}
+
+
+
+/**
+ * Frees all the blocks owned by the allocator.
+ * All the resources bound to memory coming from this allocator must be destroyed before calling this function;
+ * the allocations that were never freed stay in the memory tracker, and are listed by printMemoryLeakReport.
+ */
+void destroyMemoryAllocator(MemoryAllocator & theAllocator)
+{
+	for(auto & block : theAllocator.blocks)
+	{
+		if(block.memory == VK_NULL_HANDLE)
+			continue;
+
+		if(block.allocationCount != 0)
+			std::cout << "~~~ WARNING: Destroying a memory block with " << block.allocationCount << " live allocations." << std::endl;
+
+		if(block.mappedPointer != nullptr)
+			vkUnmapMemory(theAllocator.device, block.memory);
+
+		trackedFreeMemory(theAllocator.device, block.memory, theAllocator.pAllocator);
+	}
+
+	theAllocator.blocks.clear();
+
+	for(auto & usage : theAllocator.heapUsage)
+		usage = 0;
+}
+
+
+
+/**
+ * Allocates a new block of memory in the allocator, reusing an empty slot in the block list if possible.
+ * Returns the index of the new block, or -1 if the allocation failed.
+ */
+int allocateMemoryBlock(MemoryAllocator & theAllocator,
+                        const uint32_t memoryTypeIndex,
+                        const VkDeviceSize blockSize,
+                        const bool linear,
+                        const bool dedicated)
+{
+	VkResult result;
+	VkDeviceMemory myMemory;
+
+	const uint32_t heapIndex = theAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+	if(theAllocator.heapUsage[heapIndex] + blockSize > theAllocator.heapBudget[heapIndex]) {
+		std::cout << "~~~ Heap " << heapIndex << " budget exhausted, can't allocate a block of " << blockSize << " bytes." << std::endl;
+		return -1;
+	}
+
+	const VkMemoryAllocateInfo memoryAllocateInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = blockSize,
+		.memoryTypeIndex = memoryTypeIndex,
+	};
+
+	result = trackedAllocateMemory(theAllocator.device, theAllocator.memoryProperties, memoryAllocateInfo, dedicated ? VKDEMOS_ALLOCATION_SITE("allocator dedicated block") : VKDEMOS_ALLOCATION_SITE("allocator block"), myMemory, theAllocator.pAllocator);
+	if(result != VK_SUCCESS) {
+		std::cout << "~~~ vkAllocateMemory failed for a block of " << blockSize << " bytes: " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return -1;
+	}
+
+	MemoryBlock myBlock;
+
+	// Host-visible blocks are mapped for their whole lifetime.
+	if(theAllocator.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		void * mappedPointer;
+		result = vkMapMemory(theAllocator.device, myMemory, 0, VK_WHOLE_SIZE, 0, &mappedPointer);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: vkMapMemory failed for a block of " << blockSize << " bytes: " << vkdemos::utils::VkResultToString(result) << std::endl;
+			trackedFreeMemory(theAllocator.device, myMemory, theAllocator.pAllocator);
+			return -1;
+		}
+
+		myBlock.mappedPointer = reinterpret_cast<uint8_t *>(mappedPointer);
+	}
+
+	myBlock.memory = myMemory;
+	myBlock.size = blockSize;
+	myBlock.memoryTypeIndex = memoryTypeIndex;
+	myBlock.linear = linear;
+	myBlock.dedicated = dedicated;
+	myBlock.freeRanges[0] = blockSize;
+
+	theAllocator.heapUsage[heapIndex] += blockSize;
+
+	// Reuse a slot left empty by a previously released block, so that block indices stay stable.
+	for(size_t i = 0; i < theAllocator.blocks.size(); i++)
+	{
+		if(theAllocator.blocks[i].memory == VK_NULL_HANDLE) {
+			theAllocator.blocks[i] = myBlock;
+			return (int)i;
+		}
+	}
+
+	theAllocator.blocks.push_back(myBlock);
+
+	uint32_t liveBlocks = 0;
+	for(const auto & block : theAllocator.blocks)
+		if(block.memory != VK_NULL_HANDLE)
+			liveBlocks++;
+
+	if(liveBlocks * 10 >= theAllocator.maxMemoryAllocationCount * 9)
+		std::cout << "~~~ WARNING: " << liveBlocks << " device memory blocks allocated, close to maxMemoryAllocationCount (" << theAllocator.maxMemoryAllocationCount << ")." << std::endl;
+
+	return (int)(theAllocator.blocks.size() - 1);
+}
+
+
+
+/**
+ * Frees the VkDeviceMemory of a block without allocations, leaving its slot empty for a future block.
+ */
+void releaseMemoryBlock(MemoryAllocator & theAllocator, MemoryBlock & theBlock)
+{
+	assert(theBlock.allocationCount == 0);
+
+	if(theBlock.mappedPointer != nullptr)
+		vkUnmapMemory(theAllocator.device, theBlock.memory);
+
+	theAllocator.heapUsage[theAllocator.memoryProperties.memoryTypes[theBlock.memoryTypeIndex].heapIndex] -= theBlock.size;
+
+	trackedFreeMemory(theAllocator.device, theBlock.memory, theAllocator.pAllocator);
+	theBlock = MemoryBlock{};
+}
+
+
+
+/**
+ * Searches the best-fitting free range in a block for an allocation of the specified size and alignment.
+ * Returns true if a range was found; outRangeOffset is the start of the free range, outAlignedOffset
+ * the aligned offset the allocation would start at.
+ */
+bool findFreeRangeInBlock(const MemoryBlock & theBlock,
+                          const VkDeviceSize size,
+                          const VkDeviceSize alignment,
+                          VkDeviceSize & outRangeOffset,
+                          VkDeviceSize & outAlignedOffset,
+                          VkDeviceSize & outRangeSize)
+{
+	bool found = false;
+
+	for(const auto & range : theBlock.freeRanges)
+	{
+		const VkDeviceSize alignedOffset = alignDeviceSize(range.first, alignment);
+		const VkDeviceSize padding = alignedOffset - range.first;
+
+		if(padding + size > range.second)
+			continue;
+
+		// Best fit: keep the smallest range that can hold the allocation.
+		if(!found || range.second < outRangeSize)
+		{
+			found = true;
+			outRangeOffset = range.first;
+			outAlignedOffset = alignedOffset;
+			outRangeSize = range.second;
+		}
+	}
+
+	return found;
+}
+
+
+
+/**
+ * Allocates a range of device memory from the blocks of the specified memory type,
+ * allocating a new block if needed. Returns false if the memory type is out of space.
+ */
+bool allocateMemoryOfType(MemoryAllocator & theAllocator,
+                          const VkMemoryRequirements & memoryRequirements,
+                          const int memoryTypeIndex,
+                          const bool linearResource,
+                          MemoryAllocation & outAllocation)
+{
+	const VkMemoryType & memoryType = theAllocator.memoryProperties.memoryTypes[memoryTypeIndex];
+	const VkDeviceSize heapSize = theAllocator.memoryProperties.memoryHeaps[memoryType.heapIndex].size;
+
+	/*
+	 * Non-coherent host-visible memory must be flushed in multiples of nonCoherentAtomSize:
+	 * align and pad these allocations so that flushing one of them never touches its neighbours.
+	 */
+	VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+	VkDeviceSize size = memoryRequirements.size;
+
+	if((memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		alignment = std::max(alignment, theAllocator.nonCoherentAtomSize);
+		size = alignDeviceSize(size, theAllocator.nonCoherentAtomSize);
+	}
+
+	const VkDeviceSize blockSize = std::min(theAllocator.preferredBlockSize, std::max<VkDeviceSize>(heapSize / 8, 1024*1024));
+
+	int blockIndex = -1;
+	VkDeviceSize rangeOffset = 0, alignedOffset = 0, rangeSize = 0;
+
+	if(size > blockSize / 2 || (memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+	{
+		// Big resources and lazily-allocated ones get their own VkDeviceMemory.
+		blockIndex = allocateMemoryBlock(theAllocator, (uint32_t)memoryTypeIndex, size, linearResource, true);
+		if(blockIndex < 0)
+			return false;
+
+		rangeOffset = alignedOffset = 0;
+		rangeSize = size;
+	}
+	else
+	{
+		// Search the best-fitting free range among the existing blocks of this memory type.
+		VkDeviceSize bestRangeSize = 0;
+
+		for(size_t i = 0; i < theAllocator.blocks.size(); i++)
+		{
+			const MemoryBlock & block = theAllocator.blocks[i];
+
+			// An empty block can take resources of either kind.
+			if(block.memory == VK_NULL_HANDLE || block.dedicated || block.memoryTypeIndex != (uint32_t)memoryTypeIndex || (block.linear != linearResource && block.allocationCount != 0))
+				continue;
+
+			VkDeviceSize blockRangeOffset, blockAlignedOffset, blockRangeSize;
+			if(findFreeRangeInBlock(block, size, alignment, blockRangeOffset, blockAlignedOffset, blockRangeSize))
+			{
+				if(blockIndex < 0 || blockRangeSize < bestRangeSize)
+				{
+					blockIndex = (int)i;
+					rangeOffset = blockRangeOffset;
+					alignedOffset = blockAlignedOffset;
+					rangeSize = blockRangeSize;
+					bestRangeSize = blockRangeSize;
+				}
+			}
+		}
+
+		// No space left: allocate a new block.
+		if(blockIndex < 0)
+		{
+			blockIndex = allocateMemoryBlock(theAllocator, (uint32_t)memoryTypeIndex, blockSize, linearResource, false);
+			if(blockIndex < 0)
+				return false;
+
+			rangeOffset = alignedOffset = 0;
+			rangeSize = blockSize;
+		}
+	}
+
+	/*
+	 * Carve the allocation out of the free range: the padding before the aligned
+	 * offset and the space after the allocation go back in the free list.
+	 */
+	MemoryBlock & block = theAllocator.blocks[blockIndex];
+
+	if(block.allocationCount == 0)
+		block.linear = linearResource;
+
+	block.freeRanges.erase(rangeOffset);
+
+	if(alignedOffset > rangeOffset)
+		block.freeRanges[rangeOffset] = alignedOffset - rangeOffset;
+
+	const VkDeviceSize allocationEnd = alignedOffset + size;
+	const VkDeviceSize rangeEnd = rangeOffset + rangeSize;
+	if(rangeEnd > allocationEnd)
+		block.freeRanges[allocationEnd] = rangeEnd - allocationEnd;
+
+	block.usedBytes += size;
+	block.allocationCount++;
+
+	MemoryAllocation myAllocation;
+	myAllocation.memory = block.memory;
+	myAllocation.offset = alignedOffset;
+	myAllocation.size = size;
+	myAllocation.memoryTypeIndex = (uint32_t)memoryTypeIndex;
+	myAllocation.blockIndex = (uint32_t)blockIndex;
+	myAllocation.mappedPointer = (block.mappedPointer != nullptr) ? block.mappedPointer + alignedOffset : nullptr;
+
+	outAllocation = myAllocation;
+	return true;
+}
+
+
+
+/**
+ * Allocates a range of device memory satisfying the specified requirements.
+ *
+ * The memory type is chosen by scoring all the compatible types for the specified usage
+ * (see vkdemos::utils::findBestMemoryType), skipping heaps whose budget is exhausted;
+ * if the allocation fails in the best type, the next best one is tried.
+ *
+ * @param memoryRequirements requirements of the resource, as returned by vkGet{Buffer,Image}MemoryRequirements.
+ * @param requiredMemoryProperties properties the memory type must have.
+ * @param linearResource true for buffers and linearly-tiled images, false for optimally-tiled images.
+ * @param allocationSite tag, file and line of the resource, recorded by the memory tracker until the
+ *        allocation is freed; use VKDEMOS_ALLOCATION_SITE("tag").
+ * @param outAllocation the resulting allocation; bind the resource to outAllocation.memory at outAllocation.offset.
+ * @param usage how the host and the device will access the memory.
+ * @param preferredMemoryProperties properties that are desirable but not mandatory.
+ */
+bool allocateMemoryFromAllocator(MemoryAllocator & theAllocator,
+                                 const VkMemoryRequirements & memoryRequirements,
+                                 const VkMemoryPropertyFlags requiredMemoryProperties,
+                                 const bool linearResource,
+                                 const AllocationSite & allocationSite,
+                                 MemoryAllocation & outAllocation,
+                                 const vkdemos::utils::MemoryUsage usage = vkdemos::utils::MEMORY_USAGE_UNKNOWN,
+                                 const VkMemoryPropertyFlags preferredMemoryProperties = 0)
+{
+	uint32_t candidateTypeBits = memoryRequirements.memoryTypeBits;
+
+	VkDeviceSize heapBudgetsLeft[VK_MAX_MEMORY_HEAPS] = {};
+	for(uint32_t i = 0; i < theAllocator.memoryProperties.memoryHeapCount; i++)
+		if(theAllocator.heapBudget[i] > theAllocator.heapUsage[i])
+			heapBudgetsLeft[i] = theAllocator.heapBudget[i] - theAllocator.heapUsage[i];
+
+	while(candidateTypeBits != 0)
+	{
+		/*
+		 * Heaps without room for the resource are skipped. A heap with room for the resource
+		 * but not for a whole new block is still tried: the resource may fit in an existing block.
+		 */
+		int memoryTypeIndex = vkdemos::utils::findBestMemoryType(theAllocator.memoryProperties, candidateTypeBits, requiredMemoryProperties, preferredMemoryProperties, usage, memoryRequirements.size, heapBudgetsLeft);
+		if(memoryTypeIndex < 0)
+			break;
+
+		if(allocateMemoryOfType(theAllocator, memoryRequirements, memoryTypeIndex, linearResource, outAllocation))
+		{
+			trackSubAllocation(outAllocation.memory, outAllocation.offset, outAllocation.size, outAllocation.memoryTypeIndex,
+			                   theAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, allocationSite);
+			return true;
+		}
+
+		// This memory type is full: try the next best one.
+		candidateTypeBits &= ~(1u << memoryTypeIndex);
+	}
+
+	std::cout << "!!! ERROR: Can't find a memory type with the required properties and enough space." << std::endl;
+	return false;
+}
+
+
+
+/**
+ * Returns a range of memory to the allocator.
+ * The resource bound to the allocation must have already been destroyed
+ * (or at least it must not be used anymore by the device).
+ */
+void freeMemoryToAllocator(MemoryAllocator & theAllocator, MemoryAllocation & theAllocation)
+{
+	if(theAllocation.memory == VK_NULL_HANDLE)
+		return;
+
+	assert(theAllocation.blockIndex < theAllocator.blocks.size());
+	MemoryBlock & block = theAllocator.blocks[theAllocation.blockIndex];
+	assert(block.memory == theAllocation.memory);
+
+	untrackSubAllocation(theAllocation.memory, theAllocation.offset);
+
+	block.usedBytes -= theAllocation.size;
+	block.allocationCount--;
+
+	if(block.dedicated && block.allocationCount == 0)
+	{
+		// Dedicated blocks are released right away.
+		releaseMemoryBlock(theAllocator, block);
+	}
+	else
+	{
+		// Insert the range in the free list, merging it with the previous and next free ranges if they are adjacent.
+		VkDeviceSize offset = theAllocation.offset;
+		VkDeviceSize size = theAllocation.size;
+
+		auto next = block.freeRanges.lower_bound(offset);
+
+		if(next != block.freeRanges.begin())
+		{
+			auto prev = std::prev(next);
+			if(prev->first + prev->second == offset) {
+				offset = prev->first;
+				size += prev->second;
+				block.freeRanges.erase(prev);
+			}
+		}
+
+		if(next != block.freeRanges.end() && offset + size == next->first) {
+			size += next->second;
+			block.freeRanges.erase(next);
+		}
+
+		block.freeRanges[offset] = size;
+
+		/*
+		 * A block left empty is kept as a spare, so that a resource freed and created again every
+		 * frame doesn't allocate and free a whole block each time; but only one per memory type:
+		 * the others would hold heap memory nothing uses.
+		 */
+		if(block.allocationCount == 0)
+		{
+			const bool hasSpare = std::any_of(theAllocator.blocks.begin(), theAllocator.blocks.end(), [&](const MemoryBlock & other) {
+				return &other != &block && other.memory != VK_NULL_HANDLE && !other.dedicated
+				       && other.memoryTypeIndex == block.memoryTypeIndex && other.allocationCount == 0;
+			});
+
+			if(hasSpare)
+				releaseMemoryBlock(theAllocator, block);
+		}
+	}
+
+	theAllocation = MemoryAllocation{};
+}
+
+
+
+/**
+ * Computes usage and fragmentation statistics of the allocator.
+ * If memoryTypeIndex is >= 0, only the blocks of that memory type are considered.
+ */
+void getMemoryAllocatorStatistics(const MemoryAllocator & theAllocator,
+                                  MemoryAllocatorStatistics & outStatistics,
+                                  const int memoryTypeIndex = -1)
+{
+	MemoryAllocatorStatistics myStatistics;
+
+	for(const auto & block : theAllocator.blocks)
+	{
+		if(block.memory == VK_NULL_HANDLE)
+			continue;
+		if(memoryTypeIndex >= 0 && block.memoryTypeIndex != (uint32_t)memoryTypeIndex)
+			continue;
+
+		myStatistics.blockCount++;
+		if(block.dedicated)
+			myStatistics.dedicatedBlockCount++;
+
+		myStatistics.allocationCount += block.allocationCount;
+		myStatistics.reservedBytes += block.size;
+		myStatistics.usedBytes += block.usedBytes;
+
+		for(const auto & range : block.freeRanges) {
+			myStatistics.freeRangeCount++;
+			myStatistics.largestFreeRange = std::max(myStatistics.largestFreeRange, range.second);
+		}
+	}
+
+	myStatistics.freeBytes = myStatistics.reservedBytes - myStatistics.usedBytes;
+
+	// Fragmentation: how much of the free memory is NOT in the single largest free range.
+	if(myStatistics.freeBytes > 0)
+		myStatistics.fragmentation = 1.0f - float(myStatistics.largestFreeRange) / float(myStatistics.freeBytes);
+
+	outStatistics = myStatistics;
+}
+
+
+
+/**
+ * Prints the allocator statistics, globally and for each memory type in use.
+ */
+void printMemoryAllocatorStatistics(const MemoryAllocator & theAllocator)
+{
+	auto printStatistics = [](const MemoryAllocatorStatistics & stats)
+	{
+		std::cout << stats.blockCount << " blocks (" << stats.dedicatedBlockCount << " dedicated), "
+		          << stats.allocationCount << " allocations, "
+		          << std::fixed << std::setprecision(2)
+		          << stats.usedBytes / (1024.0*1024.0) << "/" << stats.reservedBytes / (1024.0*1024.0) << " MiB used, "
+		          << stats.freeRangeCount << " free ranges (largest " << stats.largestFreeRange / (1024.0*1024.0) << " MiB), "
+		          << "fragmentation " << stats.fragmentation * 100.0f << "%"
+		          << std::endl;
+	};
+
+	MemoryAllocatorStatistics stats;
+
+	getMemoryAllocatorStatistics(theAllocator, stats);
+	std::cout << "--- Memory allocator: ";
+	printStatistics(stats);
+
+	for(uint32_t i = 0; i < theAllocator.memoryProperties.memoryTypeCount; i++)
+	{
+		getMemoryAllocatorStatistics(theAllocator, stats, (int)i);
+		if(stats.blockCount == 0)
+			continue;
+
+		std::cout << "---     memory type " << i << " (heap " << theAllocator.memoryProperties.memoryTypes[i].heapIndex << "): ";
+		printStatistics(stats);
+	}
+	for(uint32_t i = 0; i < theAllocator.memoryProperties.memoryHeapCount; i++)
+	{
+		std::cout << "---     heap " << i << ": "
+		          << std::fixed << std::setprecision(2)
+		          << theAllocator.heapUsage[i] / (1024.0*1024.0) << "/" << theAllocator.heapBudget[i] / (1024.0*1024.0) << " MiB of budget used"
+		          << std::endl;
+	}
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef VKDEMOS_FRAMERINGBUFFER_H
+#define VKDEMOS_FRAMERINGBUFFER_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "09_createAndAllocateBuffer.h"
+#include "12_memoryAllocator.h"
+
+namespace vkdemos {
+
+/*
+ * A per-frame linear ring allocator for transient data (uniforms, dynamic vertices...).
+ *
+ * A single host-visible buffer is mapped once at creation; every frame, data is
+ * written by simply bumping the "head" pointer forward, and bound with the
+ * returned offset (for example as the dynamic offset of a
+ * VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor, or as the offset in vkCmdBindVertexBuffers).
+ *
+ * Since up to FRAME_LAG frames can be in flight at the same time, the data written
+ * in a frame can't be overwritten until the GPU has finished with that frame:
+ * the ring remembers where each frame's data ends, and the space is reclaimed only
+ * in beginRingBufferFrame, after the present fence of the frame that used it has signaled.
+ */
+
+struct FrameRingBuffer
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	uint8_t * mappedPointer = nullptr;
+	VkDeviceSize size = 0;
+	const VkAllocationCallbacks * pAllocator = nullptr;
+
+	VkDeviceSize head = 0;        // where the next allocation starts.
+	VkDeviceSize tail = 0;        // start of the oldest data still used by the GPU.
+	VkDeviceSize usedBytes = 0;   // bytes between tail and head, including alignment padding.
+
+	// Alignment required to use allocations as dynamic uniform buffers.
+	VkDeviceSize uniformBufferAlignment = 1;
+
+	// For each frame slot, the bytes it consumed and where its data ends.
+	uint32_t currentFrameSlot = 0;
+	std::vector<VkDeviceSize> frameUsedBytes;
+	std::vector<VkDeviceSize> frameEnd;
+};
+
+
+
+/**
+ * Creates a FrameRingBuffer of ringSize bytes, for frameLag frames in flight.
+ * @param bufferUsage usage of the underlying VkBuffer (for example VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT).
+ */
+bool createFrameRingBuffer(const VkPhysicalDevice thePhysicalDevice,
+                           const VkDevice theDevice,
+                           const VkBufferUsageFlags bufferUsage,
+                           const VkDeviceSize ringSize,
+                           const int frameLag,
+                           FrameRingBuffer & outRingBuffer,
+                           const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+	bool boolResult;
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(thePhysicalDevice, &physicalDeviceProperties);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(thePhysicalDevice, &memoryProperties);
+
+	FrameRingBuffer myRingBuffer;
+	myRingBuffer.device = theDevice;
+	myRingBuffer.size = ringSize;
+	myRingBuffer.pAllocator = pAllocator;
+	myRingBuffer.uniformBufferAlignment = std::max<VkDeviceSize>(physicalDeviceProperties.limits.minUniformBufferOffsetAlignment, 1);
+	myRingBuffer.frameUsedBytes.resize(frameLag, 0);
+	myRingBuffer.frameEnd.resize(frameLag, 0);
+
+	/*
+	 * The Vulkan specification guarantees that there is always a memory type
+	 * that is both HOST_VISIBLE and HOST_COHERENT, so we use that and don't need
+	 * to flush anything after writing.
+	 * The buffer gets its own VkDeviceMemory, since it stays mapped for its
+	 * whole lifetime, and a VkDeviceMemory can't be mapped twice at the same time.
+	 */
+	boolResult = createAndAllocateBuffer(theDevice,
+	                                     memoryProperties,
+	                                     bufferUsage,
+	                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                                     ringSize,
+	                                     myRingBuffer.buffer,
+	                                     myRingBuffer.memory,
+	                                     VKDEMOS_ALLOCATION_SITE("frame ring buffer"),
+	                                     pAllocator);
+	if(!boolResult) {
+		std::cout << "!!! ERROR: Can't create the ring buffer." << std::endl;
+		return false;
+	}
+
+	void * mappedPointer;
+	result = vkMapMemory(theDevice, myRingBuffer.memory, 0, VK_WHOLE_SIZE, 0, &mappedPointer);
+	assert(result == VK_SUCCESS);
+
+	myRingBuffer.mappedPointer = reinterpret_cast<uint8_t *>(mappedPointer);
+
+	outRingBuffer = myRingBuffer;
+	return true;
+}
+
+
+
+/**
+ * Destroys the ring buffer. The device must not be using it anymore.
+ */
+void destroyFrameRingBuffer(FrameRingBuffer & theRingBuffer)
+{
+	vkUnmapMemory(theRingBuffer.device, theRingBuffer.memory);
+	vkDestroyBuffer(theRingBuffer.device, theRingBuffer.buffer, theRingBuffer.pAllocator);
+	trackedFreeMemory(theRingBuffer.device, theRingBuffer.memory, theRingBuffer.pAllocator);
+
+	theRingBuffer = FrameRingBuffer{};
+}
+
+
+
+/**
+ * Starts a new frame on the ring buffer.
+ * If the frame slot was already used, waits on thePresentFence (the fence that was signaled
+ * by the submission of the frame that previously used this slot), and reclaims all the space
+ * that frame was using.
+ * The fence is not reset, as that's done by the render function before submitting again.
+ */
+void beginRingBufferFrame(FrameRingBuffer & theRingBuffer,
+                          const uint32_t frameSlot,
+                          const VkFence thePresentFence,
+                          const bool fenceInitialized)
+{
+	assert(frameSlot < theRingBuffer.frameUsedBytes.size());
+
+	if(fenceInitialized)
+		vkWaitForFences(theRingBuffer.device, 1, &thePresentFence, VK_TRUE, UINT64_MAX);
+
+	/*
+	 * Frames complete in submission order, so once this slot's frame is done,
+	 * everything up to the end of its data is free again.
+	 */
+	if(theRingBuffer.frameUsedBytes[frameSlot] > 0)
+	{
+		theRingBuffer.usedBytes -= theRingBuffer.frameUsedBytes[frameSlot];
+		theRingBuffer.tail = theRingBuffer.frameEnd[frameSlot];
+		theRingBuffer.frameUsedBytes[frameSlot] = 0;
+	}
+
+	// Ring empty: restart from the beginning, so that we have the most contiguous space available.
+	if(theRingBuffer.usedBytes == 0)
+		theRingBuffer.head = theRingBuffer.tail = 0;
+
+	theRingBuffer.currentFrameSlot = frameSlot;
+}
+
+
+
+/**
+ * Allocates "size" bytes aligned to "alignment" from the ring, for the current frame.
+ * @param outOffset offset of the allocation inside theRingBuffer.buffer.
+ * @param outPointer pointer to the mapped memory of the allocation, where the data should be written.
+ * @return false if the ring is full (it's too small for the amount of data written in FRAME_LAG frames).
+ */
+bool allocateFromRingBuffer(FrameRingBuffer & theRingBuffer,
+                            const VkDeviceSize size,
+                            const VkDeviceSize alignment,
+                            VkDeviceSize & outOffset,
+                            void * & outPointer)
+{
+	const VkDeviceSize head = theRingBuffer.head;
+	const VkDeviceSize tail = theRingBuffer.tail;
+
+	VkDeviceSize alignedOffset = alignDeviceSize(head, std::max<VkDeviceSize>(alignment, 1));
+	VkDeviceSize padding = alignedOffset - head;
+
+	bool fits;
+
+	if(head == tail && theRingBuffer.usedBytes > 0)
+	{
+		// Ring completely full.
+		fits = false;
+	}
+	else if(head >= tail)
+	{
+		// Free space is [head, size) and [0, tail).
+		if(alignedOffset + size <= theRingBuffer.size) {
+			fits = true;
+		}
+		else if(size <= tail) {
+			// Wrap around: the end of the buffer is wasted until this frame is reclaimed.
+			alignedOffset = 0;
+			padding = theRingBuffer.size - head;
+			fits = true;
+		}
+		else
+			fits = false;
+	}
+	else
+	{
+		// Free space is [head, tail).
+		fits = (alignedOffset + size <= tail);
+	}
+
+	if(!fits) {
+		std::cout << "!!! ERROR: Ring buffer full, can't allocate " << size << " bytes." << std::endl;
+		return false;
+	}
+
+	const uint32_t slot = theRingBuffer.currentFrameSlot;
+
+	theRingBuffer.head = alignedOffset + size;
+	theRingBuffer.usedBytes += padding + size;
+	theRingBuffer.frameUsedBytes[slot] += padding + size;
+	theRingBuffer.frameEnd[slot] = theRingBuffer.head;
+
+	outOffset = alignedOffset;
+	outPointer = theRingBuffer.mappedPointer + alignedOffset;
+	return true;
+}
+
+}	// vkdemos
+
+#endif
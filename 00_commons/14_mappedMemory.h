@@ -0,0 +1,149 @@
+#ifndef VKDEMOS_MAPPEDMEMORY_H
+#define VKDEMOS_MAPPEDMEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "12_memoryAllocator.h"
+
+namespace vkdemos {
+
+/*
+ * Batched flushing of persistently-mapped memory.
+ *
+ * Allocations from host-visible memory of a MemoryAllocator are always mapped
+ * (see MemoryAllocation::mappedPointer), so data can be written at any time
+ * without calling vkMapMemory/vkUnmapMemory.
+ * If the memory is not HOST_COHERENT, the written ranges must then be flushed
+ * before the device reads them. Instead of flushing every allocation with VK_WHOLE_SIZE
+ * right after writing it, we record the written ("dirty") ranges, expanded to
+ * multiples of nonCoherentAtomSize as the specification requires, and flush all of them
+ * with a single vkFlushMappedMemoryRanges call, once per frame (or before a submit).
+ * Writes to coherent memory are not recorded at all, since they need no flush.
+ */
+
+struct MappedMemoryFlushBatch
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkDeviceSize nonCoherentAtomSize = 1;
+	std::vector<VkMappedMemoryRange> dirtyRanges;
+
+	// Statistics
+	uint64_t flushCallCount = 0;
+	uint64_t flushedRangeCount = 0;
+	uint64_t flushedBytes = 0;
+};
+
+
+
+/**
+ * Initializes an empty flush batch for memory coming from theAllocator.
+ */
+void createMappedMemoryFlushBatch(const MemoryAllocator & theAllocator, MappedMemoryFlushBatch & outFlushBatch)
+{
+	MappedMemoryFlushBatch myFlushBatch;
+	myFlushBatch.device = theAllocator.device;
+	myFlushBatch.nonCoherentAtomSize = theAllocator.nonCoherentAtomSize;
+
+	outFlushBatch = myFlushBatch;
+}
+
+
+
+/**
+ * Records that the range [offset, offset+size) of theAllocation has been written by the host.
+ * Offset and size are relative to the start of the allocation; VK_WHOLE_SIZE means "up to the end of the allocation".
+ * Does nothing if the allocation lives in HOST_COHERENT memory.
+ */
+void markAllocationDirty(MappedMemoryFlushBatch & theFlushBatch,
+                         const MemoryAllocator & theAllocator,
+                         const MemoryAllocation & theAllocation,
+                         const VkDeviceSize offset = 0,
+                         const VkDeviceSize size = VK_WHOLE_SIZE)
+{
+	assert(theAllocation.mappedPointer != nullptr);
+
+	const VkMemoryPropertyFlags propertyFlags = theAllocator.memoryProperties.memoryTypes[theAllocation.memoryTypeIndex].propertyFlags;
+	if(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		return;
+
+	const VkDeviceSize atom = theFlushBatch.nonCoherentAtomSize;
+	const VkDeviceSize blockSize = theAllocator.blocks[theAllocation.blockIndex].size;
+
+	const VkDeviceSize rangeSize = (size == VK_WHOLE_SIZE) ? theAllocation.size - offset : size;
+	assert(offset + rangeSize <= theAllocation.size);
+
+	/*
+	 * Expand the range to atom boundaries: the start is rounded down, the end up.
+	 * The allocator aligns non-coherent allocations to nonCoherentAtomSize, so the
+	 * expanded range never leaves the allocation, except for the end of the block,
+	 * where the specification lets the range end at the size of the memory object.
+	 */
+	const VkDeviceSize begin = ((theAllocation.offset + offset) / atom) * atom;
+	const VkDeviceSize end = std::min(alignDeviceSize(theAllocation.offset + offset + rangeSize, atom), blockSize);
+
+	const VkMappedMemoryRange mappedMemoryRange = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = theAllocation.memory,
+		.offset = begin,
+		.size = end - begin,
+	};
+
+	theFlushBatch.dirtyRanges.push_back(mappedMemoryRange);
+}
+
+
+
+/**
+ * Flushes all the dirty ranges recorded since the last call, with a single vkFlushMappedMemoryRanges.
+ * Overlapping and adjacent ranges of the same VkDeviceMemory are merged together first.
+ */
+VkResult flushMappedMemoryBatch(MappedMemoryFlushBatch & theFlushBatch)
+{
+	if(theFlushBatch.dirtyRanges.empty())
+		return VK_SUCCESS;
+
+	std::vector<VkMappedMemoryRange> & ranges = theFlushBatch.dirtyRanges;
+
+	std::sort(ranges.begin(), ranges.end(), [](const VkMappedMemoryRange & a, const VkMappedMemoryRange & b) {
+		return (a.memory != b.memory) ? (a.memory < b.memory) : (a.offset < b.offset);
+	});
+
+	// Merge in place.
+	size_t mergedCount = 0;
+	for(size_t i = 0; i < ranges.size(); i++)
+	{
+		if(mergedCount > 0)
+		{
+			VkMappedMemoryRange & last = ranges[mergedCount - 1];
+			if(last.memory == ranges[i].memory && ranges[i].offset <= last.offset + last.size)
+			{
+				last.size = std::max(last.offset + last.size, ranges[i].offset + ranges[i].size) - last.offset;
+				continue;
+			}
+		}
+
+		ranges[mergedCount++] = ranges[i];
+	}
+	ranges.resize(mergedCount);
+
+	VkResult result = vkFlushMappedMemoryRanges(theFlushBatch.device, (uint32_t)ranges.size(), ranges.data());
+
+	theFlushBatch.flushCallCount++;
+	theFlushBatch.flushedRangeCount += ranges.size();
+	for(const auto & range : ranges)
+		theFlushBatch.flushedBytes += range.size;
+
+	ranges.clear();
+	return result;
+}
+
+}	// vkdemos
+
+#endif
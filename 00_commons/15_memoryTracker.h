@@ -0,0 +1,295 @@
+#ifndef VKDEMOS_MEMORYTRACKER_H
+#define VKDEMOS_MEMORYTRACKER_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+
+namespace vkdemos {
+
+/*
+ * Device memory instrumentation.
+ *
+ * Every VkDeviceMemory allocated through trackedAllocateMemory is recorded,
+ * together with its size, memory type, heap, a descriptive tag and the
+ * source file and line that requested it; trackedFreeMemory removes the record.
+ *
+ * The tracker keeps live totals for every heap and their high-water marks,
+ * which are the numbers to look at when sizing memory budgets; the live
+ * totals are also useful to spot memory that slowly grows during a long session.
+ * At shutdown, printMemoryLeakReport lists every allocation that was never freed.
+ *
+ * Allocators that carve many resources out of a single VkDeviceMemory (see 12_memoryAllocator.h)
+ * also record every range they hand out with trackSubAllocation, so that a leaked texture or
+ * buffer is reported with its own tag and call site, even after the allocator freed its blocks.
+ *
+ * There is a single tracker for the whole program, protected by a mutex so that
+ * it can be used from any thread.
+ */
+
+/**
+ * Where an allocation comes from. Use the VKDEMOS_ALLOCATION_SITE macro to fill it
+ * with the current file and line.
+ */
+struct AllocationSite
+{
+	const char * tag = "";
+	const char * file = "";
+	int line = 0;
+};
+
+#define VKDEMOS_ALLOCATION_SITE(tag) vkdemos::AllocationSite{(tag), __FILE__, __LINE__}
+
+
+struct TrackedAllocation
+{
+	VkDeviceSize size = 0;
+	uint32_t memoryTypeIndex = 0;
+	uint32_t heapIndex = 0;
+	AllocationSite site;
+	uint64_t serialNumber = 0;   // order of allocation, to tell apart old and new leaks.
+};
+
+
+struct MemoryTracker
+{
+	std::mutex mutex;
+	std::map<VkDeviceMemory, TrackedAllocation> liveAllocations;
+	std::map<std::pair<VkDeviceMemory, VkDeviceSize>, TrackedAllocation> liveSubAllocations;   // (memory, offset) -> range.
+
+	uint64_t nextSerialNumber = 0;
+	uint64_t totalAllocationCount = 0;
+	uint64_t totalFreeCount = 0;
+
+	VkDeviceSize heapLiveBytes[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize heapHighWaterMark[VK_MAX_MEMORY_HEAPS] = {};
+	uint32_t heapLiveAllocationCount[VK_MAX_MEMORY_HEAPS] = {};
+
+	VkDeviceSize liveBytes = 0;
+	VkDeviceSize highWaterMark = 0;
+};
+
+
+
+/**
+ * Returns the tracker shared by the whole program.
+ */
+MemoryTracker & getMemoryTracker()
+{
+	static MemoryTracker theTracker;
+	return theTracker;
+}
+
+
+
+/**
+ * Allocates device memory with vkAllocateMemory and records the allocation in the tracker.
+ * @param theMemoryProperties memory properties of the physical device, used to find the heap of the memory type.
+ * @param theAllocateInfo same as for vkAllocateMemory.
+ * @param theSite tag, file and line of the allocation; use VKDEMOS_ALLOCATION_SITE("tag").
+ * @param outMemory the allocated memory, if the function returns VK_SUCCESS.
+ * @param pAllocator same as for vkAllocateMemory; free the memory with the same callbacks.
+ */
+VkResult trackedAllocateMemory(const VkDevice theDevice,
+                               const VkPhysicalDeviceMemoryProperties & theMemoryProperties,
+                               const VkMemoryAllocateInfo & theAllocateInfo,
+                               const AllocationSite & theSite,
+                               VkDeviceMemory & outMemory,
+                               const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+	VkDeviceMemory myMemory;
+
+	result = vkAllocateMemory(theDevice, &theAllocateInfo, pAllocator, &myMemory);
+	if(result != VK_SUCCESS)
+		return result;
+
+	assert(theAllocateInfo.memoryTypeIndex < theMemoryProperties.memoryTypeCount);
+
+	TrackedAllocation myRecord;
+	myRecord.size = theAllocateInfo.allocationSize;
+	myRecord.memoryTypeIndex = theAllocateInfo.memoryTypeIndex;
+	myRecord.heapIndex = theMemoryProperties.memoryTypes[theAllocateInfo.memoryTypeIndex].heapIndex;
+	myRecord.site = theSite;
+
+	MemoryTracker & tracker = getMemoryTracker();
+	{
+		std::lock_guard<std::mutex> lock(tracker.mutex);
+
+		myRecord.serialNumber = tracker.nextSerialNumber++;
+		tracker.totalAllocationCount++;
+		tracker.liveAllocations[myMemory] = myRecord;
+
+		tracker.heapLiveBytes[myRecord.heapIndex] += myRecord.size;
+		tracker.heapLiveAllocationCount[myRecord.heapIndex]++;
+		tracker.heapHighWaterMark[myRecord.heapIndex] = std::max(tracker.heapHighWaterMark[myRecord.heapIndex], tracker.heapLiveBytes[myRecord.heapIndex]);
+
+		tracker.liveBytes += myRecord.size;
+		tracker.highWaterMark = std::max(tracker.highWaterMark, tracker.liveBytes);
+	}
+
+	outMemory = myMemory;
+	return VK_SUCCESS;
+}
+
+
+
+/**
+ * Frees device memory allocated with trackedAllocateMemory, and removes its record from the tracker.
+ * Freeing VK_NULL_HANDLE is allowed and does nothing, as for vkFreeMemory.
+ */
+void trackedFreeMemory(const VkDevice theDevice, const VkDeviceMemory theMemory, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	if(theMemory == VK_NULL_HANDLE)
+		return;
+
+	MemoryTracker & tracker = getMemoryTracker();
+	{
+		std::lock_guard<std::mutex> lock(tracker.mutex);
+
+		auto it = tracker.liveAllocations.find(theMemory);
+		if(it == tracker.liveAllocations.end()) {
+			std::cout << "~~~ WARNING: freeing a VkDeviceMemory unknown to the memory tracker." << std::endl;
+		}
+		else {
+			const TrackedAllocation & record = it->second;
+
+			tracker.heapLiveBytes[record.heapIndex] -= record.size;
+			tracker.heapLiveAllocationCount[record.heapIndex]--;
+			tracker.liveBytes -= record.size;
+			tracker.totalFreeCount++;
+
+			tracker.liveAllocations.erase(it);
+		}
+	}
+
+	vkFreeMemory(theDevice, theMemory, pAllocator);
+}
+
+
+
+/**
+ * Records a range of a VkDeviceMemory given to a single resource by a sub-allocator.
+ * The bytes are not added to the live totals: they are already counted with the VkDeviceMemory itself.
+ * @param theSite tag, file and line of the resource; use VKDEMOS_ALLOCATION_SITE("tag").
+ */
+void trackSubAllocation(const VkDeviceMemory theMemory,
+                        const VkDeviceSize offset,
+                        const VkDeviceSize size,
+                        const uint32_t memoryTypeIndex,
+                        const uint32_t heapIndex,
+                        const AllocationSite & theSite)
+{
+	TrackedAllocation myRecord;
+	myRecord.size = size;
+	myRecord.memoryTypeIndex = memoryTypeIndex;
+	myRecord.heapIndex = heapIndex;
+	myRecord.site = theSite;
+
+	MemoryTracker & tracker = getMemoryTracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+
+	myRecord.serialNumber = tracker.nextSerialNumber++;
+	tracker.liveSubAllocations[std::make_pair(theMemory, offset)] = myRecord;
+}
+
+
+
+/**
+ * Removes the record of a range recorded with trackSubAllocation.
+ */
+void untrackSubAllocation(const VkDeviceMemory theMemory, const VkDeviceSize offset)
+{
+	MemoryTracker & tracker = getMemoryTracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+
+	if(tracker.liveSubAllocations.erase(std::make_pair(theMemory, offset)) == 0)
+		std::cout << "~~~ WARNING: freeing a sub-allocation unknown to the memory tracker." << std::endl;
+}
+
+
+
+/**
+ * Prints the live totals and the high-water mark of every heap that has been used.
+ */
+void printMemoryTrackerStatistics()
+{
+	MemoryTracker & tracker = getMemoryTracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+
+	std::cout << "--- Memory tracker: "
+	          << tracker.liveAllocations.size() << " live allocations, "
+	          << std::fixed << std::setprecision(2)
+	          << tracker.liveBytes / (1024.0*1024.0) << " MiB live, "
+	          << tracker.highWaterMark / (1024.0*1024.0) << " MiB high-water mark, "
+	          << tracker.totalAllocationCount << " allocations and " << tracker.totalFreeCount << " frees so far"
+	          << std::endl;
+
+	for(uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+	{
+		if(tracker.heapHighWaterMark[i] == 0)
+			continue;
+
+		std::cout << "---     heap " << i << ": "
+		          << tracker.heapLiveAllocationCount[i] << " allocations, "
+		          << tracker.heapLiveBytes[i] / (1024.0*1024.0) << " MiB live, "
+		          << tracker.heapHighWaterMark[i] / (1024.0*1024.0) << " MiB high-water mark"
+		          << std::endl;
+	}
+}
+
+
+
+/**
+ * Prints every allocation and sub-allocation that is still alive, with its size, memory type, heap, tag and call site.
+ * Call it at shutdown, after all the memory should have been freed (and before destroying the device).
+ * @return the number of leaked allocations and sub-allocations.
+ */
+size_t printMemoryLeakReport()
+{
+	MemoryTracker & tracker = getMemoryTracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+
+	if(tracker.liveAllocations.empty() && tracker.liveSubAllocations.empty()) {
+		std::cout << "+++ No device memory leaks." << std::endl;
+		return 0;
+	}
+
+	auto printRecord = [](const TrackedAllocation & record) {
+		std::cout << "~~~     #" << record.serialNumber << " \"" << record.site.tag << "\": "
+		          << record.size << " bytes, memory type " << record.memoryTypeIndex << ", heap " << record.heapIndex
+		          << ", allocated at " << record.site.file << ":" << record.site.line
+		          << std::endl;
+	};
+
+	if(!tracker.liveAllocations.empty())
+	{
+		std::cout << "~~~ WARNING: " << tracker.liveAllocations.size() << " device memory allocations were not freed ("
+		          << tracker.liveBytes << " bytes):" << std::endl;
+
+		for(const auto & entry : tracker.liveAllocations)
+			printRecord(entry.second);
+	}
+
+	if(!tracker.liveSubAllocations.empty())
+	{
+		std::cout << "~~~ WARNING: " << tracker.liveSubAllocations.size() << " sub-allocations were not returned to their allocator:" << std::endl;
+
+		for(const auto & entry : tracker.liveSubAllocations)
+			printRecord(entry.second);
+	}
+
+	return tracker.liveAllocations.size() + tracker.liveSubAllocations.size();
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,512 @@
+#ifndef VKDEMOS_HOSTALLOCATOR_H
+#define VKDEMOS_HOSTALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <cstdint>
+
+namespace vkdemos {
+
+/*
+ * Host memory allocation callbacks.
+ *
+ * Every vkCreate*, vkAllocate* and vkDestroy* function takes a pAllocator parameter:
+ * when it's nullptr, the driver allocates its host memory with its own allocator
+ * (usually plain malloc). Passing a VkAllocationCallbacks structure instead lets us
+ * see, and control, every host allocation the driver does on our behalf.
+ *
+ * The driver tells us the "scope" of each allocation, i.e. how long it will live:
+ * - VK_SYSTEM_ALLOCATION_SCOPE_COMMAND allocations only live for the duration of the
+ *   Vulkan command that made them; these go to a linear arena, that is rewound as soon
+ *   as all of its allocations have been freed, and at the beginning of every frame.
+ * - Small allocations of the other scopes (objects, caches, the device, the instance)
+ *   go to pools of fixed-size slots, one pool per size class.
+ * - Everything else (big or over-aligned allocations) goes to malloc.
+ *
+ * Every allocation is preceded by a small header recording its size and backend,
+ * so that free and realloc know where the memory comes from.
+ *
+ * The counters are atomic, since the driver can call the callbacks from any thread
+ * that calls a Vulkan function; the arena and each pool are protected by a mutex.
+ *
+ * Remember that objects created with a VkAllocationCallbacks must be destroyed
+ * passing the same callbacks.
+ */
+
+static constexpr size_t DEFAULT_HOST_ARENA_SIZE = 1024 * 1024;
+
+// Sizes of the pool slots, header included.
+static constexpr size_t HOST_POOL_SLOT_SIZES[] = {64, 128, 256, 512, 1024};
+static constexpr size_t HOST_POOL_CLASS_COUNT = sizeof(HOST_POOL_SLOT_SIZES) / sizeof(HOST_POOL_SLOT_SIZES[0]);
+static constexpr size_t HOST_POOL_CHUNK_SIZE = 64 * 1024;
+
+static constexpr uint32_t HOST_SCOPE_COUNT = 5;   // VK_SYSTEM_ALLOCATION_SCOPE_COMMAND ... VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+
+
+enum HostAllocationBackend : uint32_t
+{
+	HOST_BACKEND_HEAP,
+	HOST_BACKEND_POOL,
+	HOST_BACKEND_ARENA,
+};
+
+
+/*
+ * Header placed right before every pointer returned to the driver.
+ * It's 32 bytes long, so that pointers following it in a 16-byte aligned slot are 16-byte aligned too.
+ */
+struct alignas(16) HostAllocationHeader
+{
+	size_t size;               // size requested by the driver.
+	uint32_t backend;          // a HostAllocationBackend.
+	uint32_t scope;            // a VkSystemAllocationScope.
+	uint32_t sizeClass;        // index in HOST_POOL_SLOT_SIZES, for pool allocations.
+	uint32_t offset;           // distance between the start of the raw memory and the returned pointer.
+};
+
+static constexpr size_t HOST_ALLOCATION_HEADER_SIZE = 32;
+static_assert(sizeof(HostAllocationHeader) <= HOST_ALLOCATION_HEADER_SIZE, "HostAllocationHeader too big");
+
+
+struct HostMemoryPool
+{
+	std::mutex mutex;
+	std::vector<void *> chunks;
+	void * freeList = nullptr;    // free slots, linked through their first bytes.
+};
+
+
+struct HostAllocator
+{
+	VkAllocationCallbacks callbacks;
+
+	// Arena for command-scope allocations.
+	std::mutex arenaMutex;
+	uint8_t * arena = nullptr;
+	size_t arenaSize = 0;
+	size_t arenaHead = 0;
+	size_t arenaLiveCount = 0;
+
+	HostMemoryPool pools[HOST_POOL_CLASS_COUNT];
+
+	// Counters.
+	std::atomic<uint64_t> allocationCount[HOST_SCOPE_COUNT];
+	std::atomic<uint64_t> liveBytes[HOST_SCOPE_COUNT];
+	std::atomic<uint64_t> freeCount;
+	std::atomic<uint64_t> reallocationCount;
+	std::atomic<uint64_t> arenaAllocationCount;
+	std::atomic<uint64_t> arenaOverflowCount;
+	std::atomic<uint64_t> poolAllocationCount;
+	std::atomic<uint64_t> heapAllocationCount;
+	std::atomic<uint64_t> internalAllocationCount;
+	std::atomic<uint64_t> internalLiveBytes;
+	std::atomic<uint64_t> totalLiveBytes;
+	std::atomic<uint64_t> peakLiveBytes;
+
+	// Host allocations done since the last beginHostAllocatorFrame, and in the frame before.
+	std::atomic<uint64_t> frameAllocationCount;
+	uint64_t lastFrameAllocationCount = 0;
+};
+
+
+struct HostAllocatorStatistics
+{
+	uint64_t allocationCount[HOST_SCOPE_COUNT] = {};
+	uint64_t liveBytes[HOST_SCOPE_COUNT] = {};
+	uint64_t freeCount = 0;
+	uint64_t reallocationCount = 0;
+	uint64_t arenaAllocationCount = 0;
+	uint64_t arenaOverflowCount = 0;
+	uint64_t poolAllocationCount = 0;
+	uint64_t heapAllocationCount = 0;
+	uint64_t internalAllocationCount = 0;
+	uint64_t internalLiveBytes = 0;
+	uint64_t totalLiveBytes = 0;
+	uint64_t peakLiveBytes = 0;
+	uint64_t lastFrameAllocationCount = 0;
+};
+
+
+
+/*
+ * Backends.
+ */
+void * hostArenaAllocate(HostAllocator & theAllocator, const size_t rawSize)
+{
+	std::lock_guard<std::mutex> lock(theAllocator.arenaMutex);
+
+	// Keep every raw allocation 16-byte aligned.
+	const size_t alignedSize = (rawSize + 15) & ~size_t(15);
+	if(theAllocator.arenaHead + alignedSize > theAllocator.arenaSize)
+		return nullptr;
+
+	void * ptr = theAllocator.arena + theAllocator.arenaHead;
+	theAllocator.arenaHead += alignedSize;
+	theAllocator.arenaLiveCount++;
+	return ptr;
+}
+
+
+void hostArenaFree(HostAllocator & theAllocator)
+{
+	std::lock_guard<std::mutex> lock(theAllocator.arenaMutex);
+
+	assert(theAllocator.arenaLiveCount > 0);
+
+	// Arena memory is never reused piecewise: the whole arena is rewound once it's empty.
+	if(--theAllocator.arenaLiveCount == 0)
+		theAllocator.arenaHead = 0;
+}
+
+
+void * hostPoolAllocate(HostMemoryPool & thePool, const size_t slotSize)
+{
+	std::lock_guard<std::mutex> lock(thePool.mutex);
+
+	if(thePool.freeList == nullptr)
+	{
+		// Carve a new chunk into slots. malloc returns memory aligned for any type, so the slots are 16-byte aligned.
+		uint8_t * chunk = reinterpret_cast<uint8_t *>(std::malloc(HOST_POOL_CHUNK_SIZE));
+		if(chunk == nullptr)
+			return nullptr;
+
+		thePool.chunks.push_back(chunk);
+
+		for(size_t offset = 0; offset + slotSize <= HOST_POOL_CHUNK_SIZE; offset += slotSize) {
+			void * slot = chunk + offset;
+			*reinterpret_cast<void **>(slot) = thePool.freeList;
+			thePool.freeList = slot;
+		}
+	}
+
+	void * slot = thePool.freeList;
+	thePool.freeList = *reinterpret_cast<void **>(slot);
+	return slot;
+}
+
+
+void hostPoolFree(HostMemoryPool & thePool, void * theSlot)
+{
+	std::lock_guard<std::mutex> lock(thePool.mutex);
+
+	*reinterpret_cast<void **>(theSlot) = thePool.freeList;
+	thePool.freeList = theSlot;
+}
+
+
+
+/*
+ * The callbacks.
+ */
+VKAPI_ATTR void * VKAPI_CALL hostAllocationCallback(void * pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+	HostAllocator & allocator = *reinterpret_cast<HostAllocator *>(pUserData);
+
+	if(size == 0)
+		return nullptr;
+
+	const uint32_t scope = std::min<uint32_t>((uint32_t)allocationScope, HOST_SCOPE_COUNT - 1);
+	const size_t effectiveAlignment = std::max<size_t>(alignment, 16);
+
+	HostAllocationHeader header;
+	header.size = size;
+	header.scope = scope;
+	header.sizeClass = 0;
+	header.offset = HOST_ALLOCATION_HEADER_SIZE;
+
+	uint8_t * raw = nullptr;
+
+	// Short-lived allocations go to the arena.
+	if(allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && effectiveAlignment == 16)
+	{
+		raw = reinterpret_cast<uint8_t *>(hostArenaAllocate(allocator, HOST_ALLOCATION_HEADER_SIZE + size));
+		if(raw != nullptr) {
+			header.backend = HOST_BACKEND_ARENA;
+			allocator.arenaAllocationCount++;
+		}
+		else
+			allocator.arenaOverflowCount++;
+	}
+
+	// Small allocations go to the pools.
+	if(raw == nullptr && effectiveAlignment == 16)
+	{
+		for(uint32_t i = 0; i < HOST_POOL_CLASS_COUNT; i++)
+		{
+			if(HOST_ALLOCATION_HEADER_SIZE + size <= HOST_POOL_SLOT_SIZES[i])
+			{
+				raw = reinterpret_cast<uint8_t *>(hostPoolAllocate(allocator.pools[i], HOST_POOL_SLOT_SIZES[i]));
+				if(raw != nullptr) {
+					header.backend = HOST_BACKEND_POOL;
+					header.sizeClass = i;
+					allocator.poolAllocationCount++;
+				}
+				break;
+			}
+		}
+	}
+
+	// Everything else goes to malloc, with enough room to align the returned pointer.
+	if(raw == nullptr)
+	{
+		raw = reinterpret_cast<uint8_t *>(std::malloc(HOST_ALLOCATION_HEADER_SIZE + size + effectiveAlignment));
+		if(raw == nullptr)
+			return nullptr;
+
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + HOST_ALLOCATION_HEADER_SIZE + effectiveAlignment - 1) & ~uintptr_t(effectiveAlignment - 1);
+
+		header.backend = HOST_BACKEND_HEAP;
+		header.offset = (uint32_t)(aligned - reinterpret_cast<uintptr_t>(raw));
+		allocator.heapAllocationCount++;
+	}
+
+	uint8_t * ptr = raw + header.offset;
+	std::memcpy(ptr - HOST_ALLOCATION_HEADER_SIZE, &header, sizeof(header));
+
+	allocator.allocationCount[scope]++;
+	allocator.liveBytes[scope] += size;
+	allocator.frameAllocationCount++;
+
+	const uint64_t live = (allocator.totalLiveBytes += size);
+	uint64_t peak = allocator.peakLiveBytes.load();
+	while(live > peak && !allocator.peakLiveBytes.compare_exchange_weak(peak, live))
+		;
+
+	return ptr;
+}
+
+
+VKAPI_ATTR void VKAPI_CALL hostFreeCallback(void * pUserData, void * pMemory)
+{
+	HostAllocator & allocator = *reinterpret_cast<HostAllocator *>(pUserData);
+
+	if(pMemory == nullptr)
+		return;
+
+	uint8_t * ptr = reinterpret_cast<uint8_t *>(pMemory);
+
+	HostAllocationHeader header;
+	std::memcpy(&header, ptr - HOST_ALLOCATION_HEADER_SIZE, sizeof(header));
+
+	allocator.freeCount++;
+	allocator.liveBytes[header.scope] -= header.size;
+	allocator.totalLiveBytes -= header.size;
+
+	uint8_t * raw = ptr - header.offset;
+
+	switch(header.backend)
+	{
+		case HOST_BACKEND_ARENA:
+			hostArenaFree(allocator);
+			break;
+
+		case HOST_BACKEND_POOL:
+			hostPoolFree(allocator.pools[header.sizeClass], raw);
+			break;
+
+		default:
+			std::free(raw);
+			break;
+	}
+}
+
+
+VKAPI_ATTR void * VKAPI_CALL hostReallocationCallback(void * pUserData, void * pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+	HostAllocator & allocator = *reinterpret_cast<HostAllocator *>(pUserData);
+
+	if(pOriginal == nullptr)
+		return hostAllocationCallback(pUserData, size, alignment, allocationScope);
+
+	if(size == 0) {
+		hostFreeCallback(pUserData, pOriginal);
+		return nullptr;
+	}
+
+	allocator.reallocationCount++;
+
+	HostAllocationHeader header;
+	std::memcpy(&header, reinterpret_cast<uint8_t *>(pOriginal) - HOST_ALLOCATION_HEADER_SIZE, sizeof(header));
+
+	// On failure the original allocation must be left untouched.
+	void * ptr = hostAllocationCallback(pUserData, size, alignment, allocationScope);
+	if(ptr == nullptr)
+		return nullptr;
+
+	std::memcpy(ptr, pOriginal, std::min(header.size, size));
+	hostFreeCallback(pUserData, pOriginal);
+	return ptr;
+}
+
+
+VKAPI_ATTR void VKAPI_CALL hostInternalAllocationCallback(void * pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	HostAllocator & allocator = *reinterpret_cast<HostAllocator *>(pUserData);
+	allocator.internalAllocationCount++;
+	allocator.internalLiveBytes += size;
+}
+
+
+VKAPI_ATTR void VKAPI_CALL hostInternalFreeCallback(void * pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	HostAllocator & allocator = *reinterpret_cast<HostAllocator *>(pUserData);
+	allocator.internalLiveBytes -= size;
+}
+
+
+
+/**
+ * Initializes theAllocator in place (it contains mutexes and atomics, so it can't be copied).
+ * @param arenaSize size of the arena used for command-scope allocations.
+ */
+void initHostAllocator(HostAllocator & theAllocator, const size_t arenaSize = DEFAULT_HOST_ARENA_SIZE)
+{
+	theAllocator.callbacks = {
+		.pUserData = &theAllocator,
+		.pfnAllocation = hostAllocationCallback,
+		.pfnReallocation = hostReallocationCallback,
+		.pfnFree = hostFreeCallback,
+		.pfnInternalAllocation = hostInternalAllocationCallback,
+		.pfnInternalFree = hostInternalFreeCallback,
+	};
+
+	theAllocator.arena = reinterpret_cast<uint8_t *>(std::malloc(arenaSize));
+	theAllocator.arenaSize = (theAllocator.arena != nullptr) ? arenaSize : 0;
+	theAllocator.arenaHead = 0;
+	theAllocator.arenaLiveCount = 0;
+
+	for(uint32_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+		theAllocator.allocationCount[i] = 0;
+		theAllocator.liveBytes[i] = 0;
+	}
+
+	theAllocator.freeCount = 0;
+	theAllocator.reallocationCount = 0;
+	theAllocator.arenaAllocationCount = 0;
+	theAllocator.arenaOverflowCount = 0;
+	theAllocator.poolAllocationCount = 0;
+	theAllocator.heapAllocationCount = 0;
+	theAllocator.internalAllocationCount = 0;
+	theAllocator.internalLiveBytes = 0;
+	theAllocator.totalLiveBytes = 0;
+	theAllocator.peakLiveBytes = 0;
+	theAllocator.frameAllocationCount = 0;
+	theAllocator.lastFrameAllocationCount = 0;
+}
+
+
+
+/**
+ * Releases the arena and the pools. All the objects created with the allocator's callbacks
+ * (including the instance) must have been destroyed.
+ */
+void destroyHostAllocator(HostAllocator & theAllocator)
+{
+	if(theAllocator.totalLiveBytes != 0)
+		std::cout << "~~~ WARNING: destroying a host allocator with " << theAllocator.totalLiveBytes << " bytes still allocated." << std::endl;
+
+	std::free(theAllocator.arena);
+	theAllocator.arena = nullptr;
+	theAllocator.arenaSize = 0;
+
+	for(auto & pool : theAllocator.pools)
+	{
+		for(void * chunk : pool.chunks)
+			std::free(chunk);
+
+		pool.chunks.clear();
+		pool.freeList = nullptr;
+	}
+}
+
+
+
+/**
+ * Returns the callbacks to pass as pAllocator to the Vulkan functions (and to the vkdemos helpers).
+ */
+const VkAllocationCallbacks * getHostAllocationCallbacks(HostAllocator & theAllocator)
+{
+	return &theAllocator.callbacks;
+}
+
+
+
+/**
+ * Starts a new frame: saves the number of host allocations done in the previous frame,
+ * and rewinds the arena if it's empty.
+ */
+void beginHostAllocatorFrame(HostAllocator & theAllocator)
+{
+	theAllocator.lastFrameAllocationCount = theAllocator.frameAllocationCount.exchange(0);
+
+	std::lock_guard<std::mutex> lock(theAllocator.arenaMutex);
+	if(theAllocator.arenaLiveCount == 0)
+		theAllocator.arenaHead = 0;
+}
+
+
+
+/**
+ * Takes a snapshot of the allocator counters.
+ */
+void getHostAllocatorStatistics(const HostAllocator & theAllocator, HostAllocatorStatistics & outStatistics)
+{
+	HostAllocatorStatistics myStatistics;
+
+	for(uint32_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+		myStatistics.allocationCount[i] = theAllocator.allocationCount[i];
+		myStatistics.liveBytes[i] = theAllocator.liveBytes[i];
+	}
+
+	myStatistics.freeCount = theAllocator.freeCount;
+	myStatistics.reallocationCount = theAllocator.reallocationCount;
+	myStatistics.arenaAllocationCount = theAllocator.arenaAllocationCount;
+	myStatistics.arenaOverflowCount = theAllocator.arenaOverflowCount;
+	myStatistics.poolAllocationCount = theAllocator.poolAllocationCount;
+	myStatistics.heapAllocationCount = theAllocator.heapAllocationCount;
+	myStatistics.internalAllocationCount = theAllocator.internalAllocationCount;
+	myStatistics.internalLiveBytes = theAllocator.internalLiveBytes;
+	myStatistics.totalLiveBytes = theAllocator.totalLiveBytes;
+	myStatistics.peakLiveBytes = theAllocator.peakLiveBytes;
+	myStatistics.lastFrameAllocationCount = theAllocator.lastFrameAllocationCount;
+
+	outStatistics = myStatistics;
+}
+
+
+
+/**
+ * Prints the allocator counters.
+ */
+void printHostAllocatorStatistics(const HostAllocator & theAllocator)
+{
+	static const char * const scopeNames[HOST_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+	HostAllocatorStatistics stats;
+	getHostAllocatorStatistics(theAllocator, stats);
+
+	std::cout << "--- Host allocator: " << stats.lastFrameAllocationCount << " allocations in the last frame, "
+	          << stats.totalLiveBytes << " bytes live (peak " << stats.peakLiveBytes << "), "
+	          << stats.freeCount << " frees, " << stats.reallocationCount << " reallocations" << std::endl;
+
+	std::cout << "---     backends: " << stats.arenaAllocationCount << " arena (" << stats.arenaOverflowCount << " overflowed), "
+	          << stats.poolAllocationCount << " pool, " << stats.heapAllocationCount << " heap; "
+	          << stats.internalAllocationCount << " internal allocations (" << stats.internalLiveBytes << " bytes live)" << std::endl;
+
+	std::cout << "---     per scope:";
+	for(uint32_t i = 0; i < HOST_SCOPE_COUNT; i++)
+		std::cout << " " << scopeNames[i] << " " << stats.allocationCount[i] << " (" << stats.liveBytes[i] << " bytes live)";
+	std::cout << std::endl;
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,684 @@
+#ifndef VKDEMOS_UPLOADENGINE_H
+#define VKDEMOS_UPLOADENGINE_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "07_commandPoolAndBuffer.h"
+
+namespace vkdemos {
+
+/*
+ * Asynchronous uploads on a dedicated transfer queue.
+ *
+ * Many GPUs have a queue family that only supports transfer operations, backed by
+ * DMA engines that can copy data while the graphics queue keeps rendering.
+ * The upload engine records copies in "upload batches": command buffers of its own
+ * pool on the transfer family, each submitted to the transfer queue with a single
+ * vkQueueSubmit. Every submitted batch gets an UploadHandle that can be polled
+ * (isUploadComplete) or waited on (waitForUpload).
+ * uploadBufferToImage and uploadBufferToBuffer are shortcuts for a batch with a single copy;
+ * to submit many copies at once, use beginUploadBatch, the record* functions and
+ * submitUploadBatch (or a StagingRing, see 18_stagingRing.h).
+ *
+ * The command buffers, fences and semaphores of completed batches are not destroyed,
+ * but kept in free lists and reused by the next batches.
+ *
+ * Resources created with VK_SHARING_MODE_EXCLUSIVE are owned by one queue family
+ * at a time, so when the transfer family is not the family that will use the
+ * resource (the "destination" family) the ownership must be transferred:
+ * - the upload command buffer ends with a "release" barrier, with
+ *   srcQueueFamilyIndex = transfer family and dstQueueFamilyIndex = destination family;
+ * - the upload submission signals a semaphore;
+ * - submitPendingUploadAcquires records the matching "acquire" barriers in a command
+ *   buffer of the destination family, and submits it to the destination queue waiting
+ *   on the semaphores. Commands submitted to the destination queue afterwards are
+ *   ordered after the acquire barriers, so they see the uploaded data.
+ * If the device has no dedicated transfer family, the transfer queue is the destination
+ * queue itself, and the upload command buffer transitions the resource directly.
+ * Resources created with VK_SHARING_MODE_CONCURRENT (listing the transfer family too) have
+ * no owner: their barriers use VK_QUEUE_FAMILY_IGNORED, and the destination queue only waits
+ * on the semaphore, followed by a memory barrier making the copies visible to its stages.
+ *
+ * Nothing here blocks the CPU: call submitPendingUploadAcquires once per frame,
+ * before submitting the work that uses the uploaded resources.
+ * The engine is not thread-safe, like the queues it submits to.
+ */
+
+struct UploadHandle
+{
+	uint64_t id = 0;
+};
+
+
+/*
+ * A command buffer of copies, recorded on the transfer queue family.
+ */
+struct UploadBatch
+{
+	uint64_t id = 0;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;   // VK_NULL_HANDLE if there's no ownership transfer.
+
+	// Barriers to record on the destination queue to acquire the resources.
+	std::vector<VkImageMemoryBarrier> acquireImageBarriers;
+	std::vector<VkBufferMemoryBarrier> acquireBufferBarriers;
+	VkPipelineStageFlags acquireDstStageMask = 0;
+	VkAccessFlags acquireDstAccessMask = 0;      // of the concurrent resources, made visible by a global barrier.
+	bool acquireSubmitted = false;
+};
+
+
+struct PendingAcquire
+{
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	std::vector<VkSemaphore> semaphores;
+	std::vector<uint64_t> uploadIds;
+};
+
+
+struct UploadEngine
+{
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks * pAllocator = nullptr;
+
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t transferQueueFamilyIndex = 0;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+	VkQueue destinationQueue = VK_NULL_HANDLE;
+	uint32_t destinationQueueFamilyIndex = 0;
+	VkCommandPool destinationCommandPool = VK_NULL_HANDLE;   // only if the families differ.
+
+	uint64_t nextUploadId = 1;
+	std::vector<UploadBatch> pendingUploads;
+	std::vector<PendingAcquire> pendingAcquires;
+
+	// Objects of completed batches, ready for reuse.
+	std::vector<VkCommandBuffer> freeTransferCommandBuffers;
+	std::vector<VkCommandBuffer> freeDestinationCommandBuffers;
+	std::vector<VkFence> freeFences;
+	std::vector<VkSemaphore> freeSemaphores;
+};
+
+
+
+/**
+ * Creates the upload engine.
+ * @param theTransferQueue queue where the copies are executed (see createVkDeviceAndVkQueue's outTransferQueuePtr).
+ * @param theDestinationQueue queue that will use the uploaded resources.
+ */
+bool createUploadEngine(const VkDevice theDevice,
+                        const VkQueue theTransferQueue,
+                        const uint32_t theTransferQueueFamilyIndex,
+                        const VkQueue theDestinationQueue,
+                        const uint32_t theDestinationQueueFamilyIndex,
+                        UploadEngine & outUploadEngine,
+                        const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	bool boolResult;
+
+	UploadEngine myEngine;
+	myEngine.device = theDevice;
+	myEngine.pAllocator = pAllocator;
+	myEngine.transferQueue = theTransferQueue;
+	myEngine.transferQueueFamilyIndex = theTransferQueueFamilyIndex;
+	myEngine.destinationQueue = theDestinationQueue;
+	myEngine.destinationQueueFamilyIndex = theDestinationQueueFamilyIndex;
+
+	// Command buffers are recorded once and freed after use: hint that to the driver.
+	const auto poolFlags = (VkCommandPoolCreateFlagBits)(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+	boolResult = createCommandPool(theDevice, theTransferQueueFamilyIndex, poolFlags, myEngine.transferCommandPool, pAllocator);
+	if(!boolResult)
+		return false;
+
+	if(theTransferQueueFamilyIndex != theDestinationQueueFamilyIndex) {
+		boolResult = createCommandPool(theDevice, theDestinationQueueFamilyIndex, poolFlags, myEngine.destinationCommandPool, pAllocator);
+		if(!boolResult)
+			return false;
+	}
+
+	std::cout << "+++ Upload engine created on queue family " << theTransferQueueFamilyIndex
+	          << ((theTransferQueueFamilyIndex != theDestinationQueueFamilyIndex) ? " (with queue family ownership transfers)." : " (same family as the destination queue).")
+	          << std::endl;
+
+	outUploadEngine = myEngine;
+	return true;
+}
+
+
+
+/*
+ * Takes a fence from the free list, or creates a new one. The fence is unsignaled.
+ */
+VkFence getUploadFence(UploadEngine & theEngine)
+{
+	VkFence myFence;
+
+	if(!theEngine.freeFences.empty()) {
+		myFence = theEngine.freeFences.back();
+		theEngine.freeFences.pop_back();
+		return myFence;
+	}
+
+	VkResult result = vkdemos::utils::createFence(theEngine.device, myFence, theEngine.pAllocator);
+	assert(result == VK_SUCCESS);
+	return myFence;
+}
+
+
+
+/*
+ * Takes a command buffer from a free list, or allocates a new one from thePool.
+ * The command pools are created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+ * so vkBeginCommandBuffer implicitly resets a reused command buffer.
+ */
+VkCommandBuffer getUploadCommandBuffer(UploadEngine & theEngine, const VkCommandPool thePool, std::vector<VkCommandBuffer> & theFreeList)
+{
+	VkCommandBuffer myCommandBuffer;
+
+	if(!theFreeList.empty()) {
+		myCommandBuffer = theFreeList.back();
+		theFreeList.pop_back();
+		return myCommandBuffer;
+	}
+
+	bool boolResult = allocateCommandBuffer(theEngine.device, thePool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCommandBuffer);
+	assert(boolResult);
+	return myCommandBuffer;
+}
+
+
+
+/**
+ * Recycles the command buffers, fences and semaphores of the uploads and acquires that have completed.
+ * Called automatically by the other functions of the engine.
+ */
+void collectCompletedUploads(UploadEngine & theEngine)
+{
+	const VkDevice device = theEngine.device;
+
+	// An upload is done once it's finished, and its semaphore is owned by an acquire batch (if it had one).
+	auto uploadDone = [&](UploadBatch & upload) {
+		if(upload.semaphore != VK_NULL_HANDLE && !upload.acquireSubmitted)
+			return false;
+		if(vkGetFenceStatus(device, upload.fence) != VK_SUCCESS)
+			return false;
+
+		vkResetFences(device, 1, &upload.fence);
+		theEngine.freeFences.push_back(upload.fence);
+		theEngine.freeTransferCommandBuffers.push_back(upload.commandBuffer);
+		return true;
+	};
+
+	// The semaphores waited on by a completed acquire are unsignaled again, and can be reused too.
+	auto acquireDone = [&](PendingAcquire & acquire) {
+		if(vkGetFenceStatus(device, acquire.fence) != VK_SUCCESS)
+			return false;
+
+		vkResetFences(device, 1, &acquire.fence);
+		theEngine.freeFences.push_back(acquire.fence);
+		theEngine.freeDestinationCommandBuffers.push_back(acquire.commandBuffer);
+		theEngine.freeSemaphores.insert(theEngine.freeSemaphores.end(), acquire.semaphores.begin(), acquire.semaphores.end());
+		return true;
+	};
+
+	auto & uploads = theEngine.pendingUploads;
+	uploads.erase(std::remove_if(uploads.begin(), uploads.end(), uploadDone), uploads.end());
+
+	auto & acquires = theEngine.pendingAcquires;
+	acquires.erase(std::remove_if(acquires.begin(), acquires.end(), acquireDone), acquires.end());
+}
+
+
+
+/**
+ * Starts a new upload batch: takes a command buffer and the synchronization objects
+ * from the free lists, and begins recording.
+ * Record the copies with recordBufferToImageUpload/recordBufferToBufferUpload,
+ * then submit them all with submitUploadBatch.
+ */
+void beginUploadBatch(UploadEngine & theEngine, UploadBatch & outBatch)
+{
+	VkResult result;
+
+	collectCompletedUploads(theEngine);
+
+	UploadBatch myUpload;
+	myUpload.id = theEngine.nextUploadId++;
+	myUpload.commandBuffer = getUploadCommandBuffer(theEngine, theEngine.transferCommandPool, theEngine.freeTransferCommandBuffers);
+	myUpload.fence = getUploadFence(theEngine);
+
+	if(theEngine.transferQueueFamilyIndex != theEngine.destinationQueueFamilyIndex)
+	{
+		if(!theEngine.freeSemaphores.empty()) {
+			myUpload.semaphore = theEngine.freeSemaphores.back();
+			theEngine.freeSemaphores.pop_back();
+		}
+		else {
+			result = vkdemos::utils::createSemaphore(theEngine.device, myUpload.semaphore, theEngine.pAllocator);
+			assert(result == VK_SUCCESS);
+		}
+	}
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	result = vkBeginCommandBuffer(myUpload.commandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	outBatch = myUpload;
+}
+
+
+
+/**
+ * Ends the batch's command buffer and submits it to the transfer queue.
+ * @return the handle to poll or wait for the completion of all the copies in the batch.
+ */
+UploadHandle submitUploadBatch(UploadEngine & theEngine, UploadBatch & theUpload)
+{
+	VkResult result;
+
+	result = vkEndCommandBuffer(theUpload.commandBuffer);
+	assert(result == VK_SUCCESS);
+
+	/*
+	 * No barrier is needed for the host writes to the staging memory:
+	 * vkQueueSubmit makes all the host writes done before it visible to the device.
+	 */
+	const VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = nullptr,
+		.pWaitDstStageMask = nullptr,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &theUpload.commandBuffer,
+		.signalSemaphoreCount = (theUpload.semaphore != VK_NULL_HANDLE) ? 1u : 0u,
+		.pSignalSemaphores = &theUpload.semaphore,
+	};
+
+	result = vkQueueSubmit(theEngine.transferQueue, 1, &submitInfo, theUpload.fence);
+	assert(result == VK_SUCCESS);
+
+	UploadHandle myHandle;
+	myHandle.id = theUpload.id;
+
+	theEngine.pendingUploads.push_back(theUpload);
+	return myHandle;
+}
+
+
+
+/**
+ * Records in theBatch the copy of one or more regions of a buffer (usually a staging buffer) to an image.
+ * The subresources in subresourceRange are transitioned from UNDEFINED (their previous content
+ * is discarded) to finalLayout, and made available to dstStageMask/dstAccessMask on the destination queue.
+ * sharingMode is the one theImage was created with: concurrent images aren't released to the destination family.
+ * theStagingBuffer must not be modified or destroyed until the batch is complete.
+ */
+void recordBufferToImageUpload(UploadEngine & theEngine,
+                               UploadBatch & theBatch,
+                               const VkBuffer theStagingBuffer,
+                               const VkImage theImage,
+                               const std::vector<VkBufferImageCopy> & regions,
+                               const VkImageSubresourceRange & subresourceRange,
+                               const VkImageLayout finalLayout,
+                               const VkPipelineStageFlags dstStageMask,
+                               const VkAccessFlags dstAccessMask,
+                               const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	const VkCommandBuffer cmdBuffer = theBatch.commandBuffer;
+	const bool otherQueue = (theBatch.semaphore != VK_NULL_HANDLE);
+	const bool ownershipTransfer = otherQueue && sharingMode == VK_SHARING_MODE_EXCLUSIVE;
+	const VkPipelineStageFlags releaseDstStageMask = otherQueue ? (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : dstStageMask;
+
+	// Transition to TRANSFER_DST.
+	VkImageMemoryBarrier imageMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = theImage,
+		.subresourceRange = subresourceRange,
+	};
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	// Copy.
+	vkCmdCopyBufferToImage(cmdBuffer, theStagingBuffer, theImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+	/*
+	 * Transition to the final layout.
+	 * With an ownership transfer, this is the release half: the destination access
+	 * and stage are ignored here, and are specified by the acquire barrier instead
+	 * (which must have the same layouts and queue family indices).
+	 * A concurrent image used on another queue is transitioned here, and made visible there.
+	 */
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = otherQueue ? 0 : dstAccessMask;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout = finalLayout;
+
+	if(ownershipTransfer) {
+		imageMemoryBarrier.srcQueueFamilyIndex = theEngine.transferQueueFamilyIndex;
+		imageMemoryBarrier.dstQueueFamilyIndex = theEngine.destinationQueueFamilyIndex;
+	}
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, releaseDstStageMask,
+	                     0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	if(ownershipTransfer) {
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = dstAccessMask;
+		theBatch.acquireImageBarriers.push_back(imageMemoryBarrier);
+	}
+	else if(otherQueue)
+		theBatch.acquireDstAccessMask |= dstAccessMask;
+
+	if(otherQueue)
+		theBatch.acquireDstStageMask |= dstStageMask;
+}
+
+
+
+/**
+ * Records in theBatch the copy of a range of a buffer (usually a staging buffer) to another buffer,
+ * making it available to dstStageMask/dstAccessMask on the destination queue.
+ * sharingMode is the one theDstBuffer was created with: concurrent buffers aren't released to the destination family.
+ * theSrcBuffer must not be modified or destroyed until the batch is complete.
+ */
+void recordBufferToBufferUpload(UploadEngine & theEngine,
+                                UploadBatch & theBatch,
+                                const VkBuffer theSrcBuffer,
+                                const VkBuffer theDstBuffer,
+                                const VkBufferCopy & region,
+                                const VkPipelineStageFlags dstStageMask,
+                                const VkAccessFlags dstAccessMask,
+                                const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	const VkCommandBuffer cmdBuffer = theBatch.commandBuffer;
+	const bool otherQueue = (theBatch.semaphore != VK_NULL_HANDLE);
+	const bool ownershipTransfer = otherQueue && sharingMode == VK_SHARING_MODE_EXCLUSIVE;
+	const VkPipelineStageFlags releaseDstStageMask = otherQueue ? (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : dstStageMask;
+
+	vkCmdCopyBuffer(cmdBuffer, theSrcBuffer, theDstBuffer, 1, &region);
+
+	VkBufferMemoryBarrier bufferMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = otherQueue ? 0 : dstAccessMask,
+		.srcQueueFamilyIndex = ownershipTransfer ? theEngine.transferQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = ownershipTransfer ? theEngine.destinationQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED,
+		.buffer = theDstBuffer,
+		.offset = region.dstOffset,
+		.size = region.size,
+	};
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, releaseDstStageMask,
+	                     0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	if(ownershipTransfer) {
+		bufferMemoryBarrier.srcAccessMask = 0;
+		bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+		theBatch.acquireBufferBarriers.push_back(bufferMemoryBarrier);
+	}
+	else if(otherQueue)
+		theBatch.acquireDstAccessMask |= dstAccessMask;
+
+	if(otherQueue)
+		theBatch.acquireDstStageMask |= dstStageMask;
+}
+
+
+
+/**
+ * Uploads the content of a buffer (usually a staging buffer) to mip level 0 of a 2D image,
+ * with a batch containing only this copy. See recordBufferToImageUpload.
+ */
+UploadHandle uploadBufferToImage(UploadEngine & theEngine,
+                                 const VkBuffer theStagingBuffer,
+                                 const VkDeviceSize stagingBufferOffset,
+                                 const VkImage theImage,
+                                 const uint32_t width,
+                                 const uint32_t height,
+                                 const VkImageAspectFlags aspectMask,
+                                 const VkImageLayout finalLayout,
+                                 const VkPipelineStageFlags dstStageMask,
+                                 const VkAccessFlags dstAccessMask,
+                                 const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	const VkBufferImageCopy bufferImageCopy = {
+		.bufferOffset = stagingBufferOffset,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {aspectMask, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {width, height, 1},
+	};
+
+	UploadBatch myBatch;
+	beginUploadBatch(theEngine, myBatch);
+	recordBufferToImageUpload(theEngine, myBatch, theStagingBuffer, theImage, {bufferImageCopy}, {aspectMask, 0, 1, 0, 1}, finalLayout, dstStageMask, dstAccessMask, sharingMode);
+	return submitUploadBatch(theEngine, myBatch);
+}
+
+
+
+/**
+ * Uploads "size" bytes from a buffer (usually a staging buffer) to another buffer,
+ * with a batch containing only this copy. See recordBufferToBufferUpload.
+ */
+UploadHandle uploadBufferToBuffer(UploadEngine & theEngine,
+                                  const VkBuffer theSrcBuffer,
+                                  const VkDeviceSize srcOffset,
+                                  const VkBuffer theDstBuffer,
+                                  const VkDeviceSize dstOffset,
+                                  const VkDeviceSize size,
+                                  const VkPipelineStageFlags dstStageMask,
+                                  const VkAccessFlags dstAccessMask,
+                                  const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	const VkBufferCopy bufferCopy = {
+		.srcOffset = srcOffset,
+		.dstOffset = dstOffset,
+		.size = size,
+	};
+
+	UploadBatch myBatch;
+	beginUploadBatch(theEngine, myBatch);
+	recordBufferToBufferUpload(theEngine, myBatch, theSrcBuffer, theDstBuffer, bufferCopy, dstStageMask, dstAccessMask, sharingMode);
+	return submitUploadBatch(theEngine, myBatch);
+}
+
+
+
+/**
+ * Records the acquire barriers of all the uploads submitted since the last call in a single
+ * command buffer, and submits it to the destination queue waiting on the uploads' semaphores.
+ * Doesn't block: the destination queue will wait for the transfers, not the CPU.
+ * Call it before submitting to the destination queue work that uses uploaded resources.
+ */
+void submitPendingUploadAcquires(UploadEngine & theEngine)
+{
+	VkResult result;
+
+	collectCompletedUploads(theEngine);
+
+	if(theEngine.destinationCommandPool == VK_NULL_HANDLE)
+		return;    // No ownership transfers: nothing to acquire.
+
+	PendingAcquire myAcquire;
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	std::vector<VkPipelineStageFlags> waitStages;
+	VkPipelineStageFlags dstStageMask = 0;
+	VkAccessFlags dstAccessMask = 0;
+
+	for(auto & upload : theEngine.pendingUploads)
+	{
+		if(upload.acquireSubmitted)
+			continue;
+
+		imageBarriers.insert(imageBarriers.end(), upload.acquireImageBarriers.begin(), upload.acquireImageBarriers.end());
+		bufferBarriers.insert(bufferBarriers.end(), upload.acquireBufferBarriers.begin(), upload.acquireBufferBarriers.end());
+		dstStageMask |= upload.acquireDstStageMask;
+		dstAccessMask |= upload.acquireDstAccessMask;
+
+		// The semaphore wait is chained to the acquire barriers through the TRANSFER stage.
+		myAcquire.semaphores.push_back(upload.semaphore);
+		myAcquire.uploadIds.push_back(upload.id);
+		waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		upload.acquireSubmitted = true;
+	}
+
+	if(myAcquire.semaphores.empty())
+		return;
+
+	myAcquire.commandBuffer = getUploadCommandBuffer(theEngine, theEngine.destinationCommandPool, theEngine.freeDestinationCommandBuffers);
+	myAcquire.fence = getUploadFence(theEngine);
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	result = vkBeginCommandBuffer(myAcquire.commandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	// The semaphores made the copies to concurrent resources available: make them visible.
+	const VkMemoryBarrier memoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = 0,
+		.dstAccessMask = dstAccessMask,
+	};
+
+	vkCmdPipelineBarrier(myAcquire.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,          // srcStageMask: the stage the semaphores are waited on.
+		dstStageMask,                            // dstStageMask
+		0,
+		(dstAccessMask != 0) ? 1u : 0u, &memoryBarrier,
+		(uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+		(uint32_t)imageBarriers.size(), imageBarriers.data()
+	);
+
+	result = vkEndCommandBuffer(myAcquire.commandBuffer);
+	assert(result == VK_SUCCESS);
+
+	const VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = (uint32_t)myAcquire.semaphores.size(),
+		.pWaitSemaphores = myAcquire.semaphores.data(),
+		.pWaitDstStageMask = waitStages.data(),
+		.commandBufferCount = 1,
+		.pCommandBuffers = &myAcquire.commandBuffer,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = nullptr,
+	};
+
+	result = vkQueueSubmit(theEngine.destinationQueue, 1, &submitInfo, myAcquire.fence);
+	assert(result == VK_SUCCESS);
+
+	theEngine.pendingAcquires.push_back(myAcquire);
+}
+
+
+
+/**
+ * Returns true when the upload has completed, and the resource has been acquired
+ * by the destination queue (if needed).
+ */
+bool isUploadComplete(UploadEngine & theEngine, const UploadHandle theHandle)
+{
+	collectCompletedUploads(theEngine);
+
+	for(const auto & upload : theEngine.pendingUploads)
+		if(upload.id == theHandle.id)
+			return false;
+
+	for(const auto & acquire : theEngine.pendingAcquires)
+		if(std::find(acquire.uploadIds.begin(), acquire.uploadIds.end(), theHandle.id) != acquire.uploadIds.end())
+			return false;
+
+	return true;
+}
+
+
+
+/**
+ * Blocks until the upload has completed on the transfer queue, and its acquire
+ * on the destination queue (submitting the pending acquires, if needed).
+ */
+void waitForUpload(UploadEngine & theEngine, const UploadHandle theHandle)
+{
+	submitPendingUploadAcquires(theEngine);
+
+	for(const auto & upload : theEngine.pendingUploads)
+		if(upload.id == theHandle.id)
+			vkWaitForFences(theEngine.device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+
+	for(const auto & acquire : theEngine.pendingAcquires)
+		if(std::find(acquire.uploadIds.begin(), acquire.uploadIds.end(), theHandle.id) != acquire.uploadIds.end())
+			vkWaitForFences(theEngine.device, 1, &acquire.fence, VK_TRUE, UINT64_MAX);
+
+	collectCompletedUploads(theEngine);
+}
+
+
+
+/**
+ * Waits for all the pending uploads and destroys the engine.
+ */
+void destroyUploadEngine(UploadEngine & theEngine)
+{
+	submitPendingUploadAcquires(theEngine);
+
+	for(const auto & upload : theEngine.pendingUploads)
+		vkWaitForFences(theEngine.device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+
+	for(const auto & acquire : theEngine.pendingAcquires)
+		vkWaitForFences(theEngine.device, 1, &acquire.fence, VK_TRUE, UINT64_MAX);
+
+	collectCompletedUploads(theEngine);
+	assert(theEngine.pendingUploads.empty() && theEngine.pendingAcquires.empty());
+
+	for(VkFence fence : theEngine.freeFences)
+		vkDestroyFence(theEngine.device, fence, theEngine.pAllocator);
+
+	for(VkSemaphore semaphore : theEngine.freeSemaphores)
+		vkDestroySemaphore(theEngine.device, semaphore, theEngine.pAllocator);
+
+	// The command buffers are freed together with their pools.
+	vkDestroyCommandPool(theEngine.device, theEngine.transferCommandPool, theEngine.pAllocator);
+	if(theEngine.destinationCommandPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(theEngine.device, theEngine.destinationCommandPool, theEngine.pAllocator);
+
+	theEngine = UploadEngine{};
+}
+
+}	// vkdemos
+
+#endif
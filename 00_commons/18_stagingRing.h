@@ -0,0 +1,447 @@
+#ifndef VKDEMOS_STAGINGRING_H
+#define VKDEMOS_STAGINGRING_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "00_utils.h"
+#include "09_createAndAllocateBuffer.h"
+#include "12_memoryAllocator.h"
+#include "15_memoryTracker.h"
+#include "17_uploadEngine.h"
+
+namespace vkdemos {
+
+/*
+ * A staging ring buffer, that coalesces many uploads into a few submits.
+ *
+ * Instead of creating a staging buffer, a command buffer and a vkQueueSubmit for every
+ * resource to upload, the data of all the uploads is written in a single persistently-mapped
+ * host-visible buffer, used as a ring, and all the copies are recorded in the same
+ * upload batch (see 17_uploadEngine.h); flushStagingRing submits the whole batch at once.
+ *
+ * Every submitted batch remembers where its data ends in the ring: when the batch's
+ * fence signals, that space is reclaimed. When the ring is full, the open batch is
+ * submitted and the oldest batches are waited on, so any amount of data can be uploaded
+ * with a fixed amount of staging memory, as long as a single upload fits in the ring.
+ *
+ * Usage:
+ * - stageBufferData/stageImageData copy the data from host memory;
+ * - or, to write the data directly in the staging memory (for example to decode an image
+ *   without an intermediate copy), call allocateStagingMemory, write the data in the
+ *   returned pointer, then record the copy with stageBufferCopy/stageImageCopy
+ *   before allocating again.
+ * - call flushStagingRing after a group of uploads (at the end of a loading phase,
+ *   or once per frame), then submitPendingUploadAcquires before using the resources.
+ */
+
+struct StagingAllocation
+{
+	VkDeviceSize offset = 0;      // offset in the ring's buffer.
+	VkDeviceSize size = 0;
+	void * pointer = nullptr;     // mapped pointer, where the host writes the data.
+};
+
+
+struct StagingRing
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	uint8_t * mappedPointer = nullptr;
+	VkDeviceSize size = 0;
+	const VkAllocationCallbacks * pAllocator = nullptr;
+
+	// Alignment of the data copied to images (optimalBufferCopyOffsetAlignment, and at least 16 for any texel size).
+	VkDeviceSize imageCopyAlignment = 16;
+
+	VkDeviceSize head = 0;        // where the next allocation starts.
+	VkDeviceSize tail = 0;        // start of the oldest data still used by the GPU.
+	VkDeviceSize usedBytes = 0;   // bytes between tail and head, including alignment padding.
+
+	// The batch being recorded.
+	UploadBatch currentBatch;
+	bool batchOpen = false;
+	uint32_t batchCopyCount = 0;
+	VkDeviceSize batchUsedBytes = 0;
+	VkDeviceSize batchEnd = 0;
+
+	// Batches submitted and not yet reclaimed, in submission order.
+	struct InFlightBatch {
+		UploadHandle handle;
+		VkDeviceSize usedBytes;
+		VkDeviceSize end;
+	};
+	std::deque<InFlightBatch> inFlightBatches;
+
+	// Statistics.
+	uint64_t submitCount = 0;
+	uint64_t copyCount = 0;
+	uint64_t stagedBytes = 0;
+	uint64_t stallCount = 0;      // times the ring was full and the CPU waited for a batch.
+};
+
+
+
+/**
+ * Creates a StagingRing of ringSize bytes.
+ */
+bool createStagingRing(const VkPhysicalDevice thePhysicalDevice,
+                       const VkDevice theDevice,
+                       const VkDeviceSize ringSize,
+                       StagingRing & outStagingRing,
+                       const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+	bool boolResult;
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(thePhysicalDevice, &physicalDeviceProperties);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(thePhysicalDevice, &memoryProperties);
+
+	StagingRing myRing;
+	myRing.device = theDevice;
+	myRing.size = ringSize;
+	myRing.pAllocator = pAllocator;
+	myRing.imageCopyAlignment = std::max<VkDeviceSize>(physicalDeviceProperties.limits.optimalBufferCopyOffsetAlignment, 16);
+
+	// As for the FrameRingBuffer, use HOST_COHERENT memory, so that nothing needs to be flushed.
+	boolResult = createAndAllocateBuffer(theDevice,
+	                                     memoryProperties,
+	                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                                     ringSize,
+	                                     myRing.buffer,
+	                                     myRing.memory,
+	                                     VKDEMOS_ALLOCATION_SITE("staging ring"),
+	                                     pAllocator);
+	if(!boolResult) {
+		std::cout << "!!! ERROR: Can't create the staging ring." << std::endl;
+		return false;
+	}
+
+	void * mappedPointer;
+	result = vkMapMemory(theDevice, myRing.memory, 0, VK_WHOLE_SIZE, 0, &mappedPointer);
+	assert(result == VK_SUCCESS);
+
+	myRing.mappedPointer = reinterpret_cast<uint8_t *>(mappedPointer);
+
+	outStagingRing = myRing;
+	return true;
+}
+
+
+
+/*
+ * Reclaims the space of the batches that have completed, oldest first.
+ * If waitForOldest is true and nothing could be reclaimed, waits for the oldest batch.
+ */
+void reclaimStagingRing(StagingRing & theRing, UploadEngine & theEngine, const bool waitForOldest)
+{
+	if(waitForOldest && !theRing.inFlightBatches.empty() && !isUploadComplete(theEngine, theRing.inFlightBatches.front().handle)) {
+		waitForUpload(theEngine, theRing.inFlightBatches.front().handle);
+		theRing.stallCount++;
+	}
+
+	// Batches complete in submission order on the transfer queue, so we can stop at the first incomplete one.
+	while(!theRing.inFlightBatches.empty() && isUploadComplete(theEngine, theRing.inFlightBatches.front().handle))
+	{
+		const auto & batch = theRing.inFlightBatches.front();
+		theRing.usedBytes -= batch.usedBytes;
+		theRing.tail = batch.end;
+		theRing.inFlightBatches.pop_front();
+	}
+
+	// Ring empty: restart from the beginning, so that we have the most contiguous space available.
+	if(theRing.usedBytes == 0)
+		theRing.head = theRing.tail = 0;
+}
+
+
+
+/**
+ * Submits the copies recorded since the last flush in a single vkQueueSubmit.
+ * @return the handle of the submitted batch (or of the last one, if there was nothing to submit).
+ */
+UploadHandle flushStagingRing(StagingRing & theRing, UploadEngine & theEngine)
+{
+	if(!theRing.batchOpen)
+		return theRing.inFlightBatches.empty() ? UploadHandle{} : theRing.inFlightBatches.back().handle;
+
+	StagingRing::InFlightBatch myBatch;
+	myBatch.handle = submitUploadBatch(theEngine, theRing.currentBatch);
+	myBatch.usedBytes = theRing.batchUsedBytes;
+	myBatch.end = theRing.batchEnd;
+	theRing.inFlightBatches.push_back(myBatch);
+
+	theRing.batchOpen = false;
+	theRing.batchCopyCount = 0;
+	theRing.batchUsedBytes = 0;
+	theRing.submitCount++;
+
+	reclaimStagingRing(theRing, theEngine, false);
+
+	return myBatch.handle;
+}
+
+
+
+/**
+ * Allocates "size" bytes aligned to "alignment" from the ring, where the host can write
+ * the data to upload. If the ring is full, submits the open batch and waits for the oldest ones.
+ * The copy of the allocation must be recorded (with stageBufferCopy/stageImageCopy)
+ * before allocating again.
+ * @return false if the allocation is bigger than the whole ring.
+ */
+bool allocateStagingMemory(StagingRing & theRing,
+                           UploadEngine & theEngine,
+                           const VkDeviceSize size,
+                           const VkDeviceSize alignment,
+                           StagingAllocation & outAllocation)
+{
+	if(size > theRing.size) {
+		std::cout << "!!! ERROR: Staging ring too small for an upload of " << size << " bytes." << std::endl;
+		return false;
+	}
+
+	reclaimStagingRing(theRing, theEngine, false);
+
+	while(true)
+	{
+		const VkDeviceSize head = theRing.head;
+		const VkDeviceSize tail = theRing.tail;
+
+		VkDeviceSize alignedOffset = alignDeviceSize(head, std::max<VkDeviceSize>(alignment, 1));
+		VkDeviceSize padding = alignedOffset - head;
+		bool fits;
+
+		if(head == tail && theRing.usedBytes > 0) {
+			fits = false;
+		}
+		else if(head >= tail) {
+			// Free space is [head, size) and [0, tail).
+			if(alignedOffset + size <= theRing.size) {
+				fits = true;
+			}
+			else if(size <= tail) {
+				alignedOffset = 0;
+				padding = theRing.size - head;
+				fits = true;
+			}
+			else
+				fits = false;
+		}
+		else {
+			// Free space is [head, tail).
+			fits = (alignedOffset + size <= tail);
+		}
+
+		if(fits)
+		{
+			theRing.head = alignedOffset + size;
+			theRing.usedBytes += padding + size;
+			theRing.batchUsedBytes += padding + size;
+			theRing.batchEnd = theRing.head;
+
+			outAllocation.offset = alignedOffset;
+			outAllocation.size = size;
+			outAllocation.pointer = theRing.mappedPointer + alignedOffset;
+			return true;
+		}
+
+		// Full: submit what we have, so that it can complete, and wait for the oldest batch.
+		if(theRing.batchOpen)
+			flushStagingRing(theRing, theEngine);
+
+		// Nothing in flight to wait for: the space is taken by allocations whose copy was never recorded.
+		if(theRing.inFlightBatches.empty()) {
+			std::cout << "!!! ERROR: Staging ring full, can't allocate " << size << " bytes." << std::endl;
+			return false;
+		}
+
+		reclaimStagingRing(theRing, theEngine, true);
+	}
+}
+
+
+
+/*
+ * Opens the batch, if it isn't already.
+ */
+void beginStagingRingBatch(StagingRing & theRing, UploadEngine & theEngine)
+{
+	if(theRing.batchOpen)
+		return;
+
+	beginUploadBatch(theEngine, theRing.currentBatch);
+	theRing.batchOpen = true;
+}
+
+
+
+/**
+ * Records the copy of a staging allocation to a buffer, at dstOffset.
+ */
+void stageBufferCopy(StagingRing & theRing,
+                     UploadEngine & theEngine,
+                     const StagingAllocation & theAllocation,
+                     const VkBuffer theDstBuffer,
+                     const VkDeviceSize dstOffset,
+                     const VkPipelineStageFlags dstStageMask,
+                     const VkAccessFlags dstAccessMask,
+                     const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	beginStagingRingBatch(theRing, theEngine);
+
+	const VkBufferCopy bufferCopy = {
+		.srcOffset = theAllocation.offset,
+		.dstOffset = dstOffset,
+		.size = theAllocation.size,
+	};
+
+	recordBufferToBufferUpload(theEngine, theRing.currentBatch, theRing.buffer, theDstBuffer, bufferCopy, dstStageMask, dstAccessMask, sharingMode);
+
+	theRing.batchCopyCount++;
+	theRing.copyCount++;
+	theRing.stagedBytes += theAllocation.size;
+}
+
+
+
+/**
+ * Records the copy of a staging allocation to some regions of an image.
+ * The bufferOffset of the regions is relative to the start of the allocation.
+ * See recordBufferToImageUpload for the meaning of the other parameters.
+ */
+void stageImageCopy(StagingRing & theRing,
+                    UploadEngine & theEngine,
+                    const StagingAllocation & theAllocation,
+                    const VkImage theImage,
+                    std::vector<VkBufferImageCopy> regions,
+                    const VkImageSubresourceRange & subresourceRange,
+                    const VkImageLayout finalLayout,
+                    const VkPipelineStageFlags dstStageMask,
+                    const VkAccessFlags dstAccessMask,
+                    const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	beginStagingRingBatch(theRing, theEngine);
+
+	for(auto & region : regions)
+		region.bufferOffset += theAllocation.offset;
+
+	recordBufferToImageUpload(theEngine, theRing.currentBatch, theRing.buffer, theImage, regions, subresourceRange, finalLayout, dstStageMask, dstAccessMask, sharingMode);
+
+	theRing.batchCopyCount++;
+	theRing.copyCount++;
+	theRing.stagedBytes += theAllocation.size;
+}
+
+
+
+/**
+ * Copies "size" bytes from host memory to the ring, and records their upload to a buffer.
+ */
+bool stageBufferData(StagingRing & theRing,
+                     UploadEngine & theEngine,
+                     const void * data,
+                     const VkDeviceSize size,
+                     const VkBuffer theDstBuffer,
+                     const VkDeviceSize dstOffset,
+                     const VkPipelineStageFlags dstStageMask,
+                     const VkAccessFlags dstAccessMask,
+                     const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	StagingAllocation myAllocation;
+	if(!allocateStagingMemory(theRing, theEngine, size, 4, myAllocation))
+		return false;
+
+	memcpy(myAllocation.pointer, data, size);
+	stageBufferCopy(theRing, theEngine, myAllocation, theDstBuffer, dstOffset, dstStageMask, dstAccessMask, sharingMode);
+	return true;
+}
+
+
+
+/**
+ * Copies the tightly-packed pixels of a 2D image from host memory to the ring,
+ * and records their upload to mip level 0 of theImage.
+ */
+bool stageImageData(StagingRing & theRing,
+                    UploadEngine & theEngine,
+                    const void * data,
+                    const VkDeviceSize size,
+                    const VkImage theImage,
+                    const uint32_t width,
+                    const uint32_t height,
+                    const VkImageAspectFlags aspectMask,
+                    const VkImageLayout finalLayout,
+                    const VkPipelineStageFlags dstStageMask,
+                    const VkAccessFlags dstAccessMask,
+                    const VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE)
+{
+	StagingAllocation myAllocation;
+	if(!allocateStagingMemory(theRing, theEngine, size, theRing.imageCopyAlignment, myAllocation))
+		return false;
+
+	memcpy(myAllocation.pointer, data, size);
+
+	const VkBufferImageCopy bufferImageCopy = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {aspectMask, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {width, height, 1},
+	};
+
+	stageImageCopy(theRing, theEngine, myAllocation, theImage, {bufferImageCopy}, {aspectMask, 0, 1, 0, 1}, finalLayout, dstStageMask, dstAccessMask, sharingMode);
+	return true;
+}
+
+
+
+/**
+ * Prints how many copies and bytes went through the ring, in how many submits.
+ */
+void printStagingRingStatistics(const StagingRing & theRing)
+{
+	std::cout << "--- Staging ring: "
+	          << theRing.copyCount << " copies, "
+	          << std::fixed << std::setprecision(2) << theRing.stagedBytes / (1024.0*1024.0) << " MiB staged in "
+	          << theRing.submitCount << " submits, "
+	          << theRing.stallCount << " stalls on a full ring ("
+	          << theRing.size / (1024.0*1024.0) << " MiB)"
+	          << std::endl;
+}
+
+
+
+/**
+ * Submits the pending copies, waits for all of them, and destroys the ring.
+ */
+void destroyStagingRing(StagingRing & theRing, UploadEngine & theEngine)
+{
+	flushStagingRing(theRing, theEngine);
+
+	while(!theRing.inFlightBatches.empty())
+		reclaimStagingRing(theRing, theEngine, true);
+
+	vkUnmapMemory(theRing.device, theRing.memory);
+	vkDestroyBuffer(theRing.device, theRing.buffer, theRing.pAllocator);
+	trackedFreeMemory(theRing.device, theRing.memory, theRing.pAllocator);
+
+	theRing = StagingRing{};
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,523 @@
+#ifndef VKDEMOS_MIPMAPS_H
+#define VKDEMOS_MIPMAPS_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+
+namespace vkdemos {
+
+/*
+ * Generation of mip chains on the GPU.
+ *
+ * When a texture is minified, many texels fall inside a single pixel: sampling only
+ * the full-resolution level reads texels far apart from each other (thrashing the
+ * texture cache) and aliases. With a mip chain, the sampler reads from the level whose
+ * texels are about the size of a pixel.
+ *
+ * Only level 0 is uploaded; the other levels are generated on the GPU:
+ * - with a cascade of vkCmdBlitImage, each level being a linearly-filtered blit of the
+ *   previous one. This needs a queue with graphics capabilities, and a format supporting
+ *   BLIT_SRC, BLIT_DST and SAMPLED_IMAGE_FILTER_LINEAR with optimal tiling;
+ * - otherwise, with a compute shader that averages 2x2 texels of the previous level
+ *   (the MipmapComputeGenerator below). The shader declares its images as rgba8, so this
+ *   is only for VK_FORMAT_R8G8B8A8_UNORM, if it supports STORAGE_IMAGE (sRGB formats
+ *   can't be storage images, and would be averaged in the wrong space anyway).
+ * Both paths expect all the levels in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, with
+ * level 0 written by a transfer operation, and leave all the levels in finalLayout.
+ */
+
+enum MipmapGenerationMethod
+{
+	MIPMAP_GENERATION_BLIT,
+	MIPMAP_GENERATION_COMPUTE,
+	MIPMAP_GENERATION_NONE,
+};
+
+
+
+/**
+ * Returns the number of levels of a full mip chain for an image of the specified size
+ * (down to 1x1).
+ */
+uint32_t computeMipLevelCount(const uint32_t width, const uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+
+	while(size > 1) {
+		size /= 2;
+		levels++;
+	}
+
+	return levels;
+}
+
+
+
+/**
+ * Chooses how to generate the mip chain of optimally-tiled images of theFormat:
+ * a blit if the format supports it, else the compute shader if it can write theFormat.
+ */
+MipmapGenerationMethod chooseMipmapGenerationMethod(const VkPhysicalDevice thePhysicalDevice, const VkFormat theFormat)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(thePhysicalDevice, theFormat, &formatProperties);
+
+	const VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	if((features & blitFeatures) == blitFeatures)
+		return MIPMAP_GENERATION_BLIT;
+
+	// The format of the shader's storage images (05_textures/mipmap.comp).
+	if(theFormat == VK_FORMAT_R8G8B8A8_UNORM && (features & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT))
+		return MIPMAP_GENERATION_COMPUTE;
+
+	return MIPMAP_GENERATION_NONE;
+}
+
+
+
+/**
+ * Image usage flags needed, besides the ones for sampling, to generate the mip chain with theMethod.
+ */
+VkImageUsageFlags getMipmapGenerationImageUsage(const MipmapGenerationMethod theMethod)
+{
+	switch(theMethod) {
+		case MIPMAP_GENERATION_BLIT:    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		case MIPMAP_GENERATION_COMPUTE: return VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		default:                        return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+}
+
+
+
+/**
+ * Records the blit cascade that generates levels 1..mipLevels-1 of a 2D image from level 0.
+ *
+ * For each level, a barrier waits for the previous level to be written (by the copy,
+ * or by the previous blit) and transitions it to TRANSFER_SRC_OPTIMAL; then the previous
+ * level is blitted, with a linear filter, to the level with half its size.
+ * At the end, a single barrier transitions all the levels to finalLayout, making them
+ * available to dstStageMask/dstAccessMask.
+ */
+void recordMipmapBlitCascade(const VkCommandBuffer theCommandBuffer,
+                             const VkImage theImage,
+                             const uint32_t width,
+                             const uint32_t height,
+                             const uint32_t mipLevels,
+                             const VkImageLayout finalLayout,
+                             const VkPipelineStageFlags dstStageMask,
+                             const VkAccessFlags dstAccessMask)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = theImage,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+
+	int32_t levelWidth = (int32_t)width;
+	int32_t levelHeight = (int32_t)height;
+
+	for(uint32_t level = 1; level < mipLevels; level++)
+	{
+		// Previous level: written -> blit source.
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		vkCmdPipelineBarrier(theCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		const int32_t nextWidth = std::max(levelWidth / 2, 1);
+		const int32_t nextHeight = std::max(levelHeight / 2, 1);
+
+		const VkImageBlit imageBlit = {
+			.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+			.srcOffsets = {{0, 0, 0}, {levelWidth, levelHeight, 1}},
+			.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+			.dstOffsets = {{0, 0, 0}, {nextWidth, nextHeight, 1}},
+		};
+
+		vkCmdBlitImage(theCommandBuffer,
+		               theImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		               theImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		               1, &imageBlit,
+		               VK_FILTER_LINEAR);
+
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+
+	/*
+	 * Levels 0..mipLevels-2 are now in TRANSFER_SRC_OPTIMAL and have been read,
+	 * the last level is in TRANSFER_DST_OPTIMAL and has been written.
+	 */
+	VkImageMemoryBarrier finalBarriers[2] = {barrier, barrier};
+	uint32_t finalBarrierCount = 0;
+
+	if(mipLevels > 1) {
+		finalBarriers[finalBarrierCount].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		finalBarriers[finalBarrierCount].dstAccessMask = dstAccessMask;
+		finalBarriers[finalBarrierCount].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		finalBarriers[finalBarrierCount].newLayout = finalLayout;
+		finalBarriers[finalBarrierCount].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels - 1, 0, 1};
+		finalBarrierCount++;
+	}
+
+	finalBarriers[finalBarrierCount].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	finalBarriers[finalBarrierCount].dstAccessMask = dstAccessMask;
+	finalBarriers[finalBarrierCount].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	finalBarriers[finalBarrierCount].newLayout = finalLayout;
+	finalBarriers[finalBarrierCount].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1, 1, 0, 1};
+	finalBarrierCount++;
+
+	vkCmdPipelineBarrier(theCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, finalBarrierCount, finalBarriers);
+}
+
+
+
+/*
+ * Compute fallback.
+ *
+ * The generator owns the pipeline running the downsampling shader (which reads and
+ * writes rgba8 storage images, see 05_textures/mipmap.comp), and the image views and
+ * descriptor pools created for each generation; these must live until the GPU has
+ * executed the command buffer, so they are kept until releaseMipmapGeneratorResources.
+ */
+struct MipmapComputeGenerator
+{
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks * pAllocator = nullptr;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	std::vector<VkDescriptorPool> pendingDescriptorPools;
+	std::vector<VkImageView> pendingImageViews;
+};
+
+
+
+/**
+ * Creates the compute pipeline used to downsample the mip levels.
+ * @param computeShaderFilename SPIR-V file of the downsampling shader.
+ */
+bool createMipmapComputeGenerator(const VkDevice theDevice,
+                                  const std::string & computeShaderFilename,
+                                  MipmapComputeGenerator & outGenerator,
+                                  const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+
+	MipmapComputeGenerator myGenerator;
+	myGenerator.device = theDevice;
+	myGenerator.pAllocator = pAllocator;
+
+	// Binding 0: source level, binding 1: destination level.
+	const VkDescriptorSetLayoutBinding bindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = nullptr,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = nullptr,
+		},
+	};
+
+	const VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = 2,
+		.pBindings = bindings,
+	};
+
+	result = vkCreateDescriptorSetLayout(theDevice, &descriptorSetLayoutCreateInfo, pAllocator, &myGenerator.descriptorSetLayout);
+	assert(result == VK_SUCCESS);
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = &myGenerator.descriptorSetLayout,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr,
+	};
+
+	result = vkCreatePipelineLayout(theDevice, &pipelineLayoutCreateInfo, pAllocator, &myGenerator.pipelineLayout);
+	assert(result == VK_SUCCESS);
+
+	VkShaderModule computeShaderModule;
+	if(!vkdemos::utils::loadAndCreateShaderModule(theDevice, computeShaderFilename, computeShaderModule, pAllocator)) {
+		std::cout << "!!! ERROR: couldn't create the mipmap compute shader module." << std::endl;
+		return false;
+	}
+
+	const VkComputePipelineCreateInfo computePipelineCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.stage = {
+			.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext  = nullptr,
+			.flags  = 0,
+			.stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = computeShaderModule,
+			.pName  = "main",
+			.pSpecializationInfo = nullptr,
+		},
+		.layout = myGenerator.pipelineLayout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1,
+	};
+
+	result = vkCreateComputePipelines(theDevice, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, pAllocator, &myGenerator.pipeline);
+	assert(result == VK_SUCCESS);
+
+	vkDestroyShaderModule(theDevice, computeShaderModule, pAllocator);
+
+	outGenerator = myGenerator;
+	return true;
+}
+
+
+
+/**
+ * Records the compute dispatches that generate levels 1..mipLevels-1 of a 2D image from level 0.
+ * The image must have been created with VK_IMAGE_USAGE_STORAGE_BIT, and theFormat must be
+ * compatible with the shader's rgba8 format qualifier.
+ *
+ * All the levels are moved to the GENERAL layout (the only one allowed for storage images);
+ * each dispatch writes a level, and a barrier makes it visible to the next dispatch that reads it.
+ * At the end, all the levels are transitioned to finalLayout.
+ */
+void recordMipmapComputeGeneration(MipmapComputeGenerator & theGenerator,
+                                   const VkCommandBuffer theCommandBuffer,
+                                   const VkImage theImage,
+                                   const VkFormat theFormat,
+                                   const uint32_t width,
+                                   const uint32_t height,
+                                   const uint32_t mipLevels,
+                                   const VkImageLayout finalLayout,
+                                   const VkPipelineStageFlags dstStageMask,
+                                   const VkAccessFlags dstAccessMask)
+{
+	VkResult result;
+	const VkDevice device = theGenerator.device;
+
+	if(mipLevels < 2)
+		return;
+
+	/*
+	 * One view per level, and one descriptor set per generated level,
+	 * from a pool sized for this image.
+	 */
+	std::vector<VkImageView> levelViews(mipLevels);
+
+	for(uint32_t level = 0; level < mipLevels; level++)
+	{
+		const VkImageViewCreateInfo imageViewCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.image = theImage,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = theFormat,
+			.components = {
+				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+				.a = VK_COMPONENT_SWIZZLE_IDENTITY
+			},
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1},
+		};
+
+		result = vkCreateImageView(device, &imageViewCreateInfo, theGenerator.pAllocator, &levelViews[level]);
+		assert(result == VK_SUCCESS);
+	}
+
+	const VkDescriptorPoolSize descriptorPoolSize = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		.descriptorCount = (mipLevels - 1) * 2,
+	};
+
+	const VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.maxSets = mipLevels - 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &descriptorPoolSize,
+	};
+
+	VkDescriptorPool myDescriptorPool;
+	result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, theGenerator.pAllocator, &myDescriptorPool);
+	assert(result == VK_SUCCESS);
+
+	std::vector<VkDescriptorSetLayout> setLayouts(mipLevels - 1, theGenerator.descriptorSetLayout);
+	std::vector<VkDescriptorSet> descriptorSets(mipLevels - 1);
+
+	const VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = myDescriptorPool,
+		.descriptorSetCount = mipLevels - 1,
+		.pSetLayouts = setLayouts.data(),
+	};
+
+	result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, descriptorSets.data());
+	assert(result == VK_SUCCESS);
+
+	for(uint32_t level = 1; level < mipLevels; level++)
+	{
+		const VkDescriptorImageInfo imageInfos[2] = {
+			{VK_NULL_HANDLE, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL},
+			{VK_NULL_HANDLE, levelViews[level],     VK_IMAGE_LAYOUT_GENERAL},
+		};
+
+		VkWriteDescriptorSet writeDescriptorSet = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = descriptorSets[level - 1],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 2,   // Consecutive bindings 0 and 1.
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = imageInfos,
+			.pBufferInfo = nullptr,
+			.pTexelBufferView = nullptr,
+		};
+
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	/*
+	 * Transition all the levels to GENERAL: level 0 after the transfer wrote it,
+	 * the other levels discarding their (undefined) contents.
+	 */
+	VkImageMemoryBarrier barriers[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = theImage,
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = theImage,
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1},
+		},
+	};
+
+	vkCmdPipelineBarrier(theCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	vkCmdBindPipeline(theCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, theGenerator.pipeline);
+
+	VkImageMemoryBarrier levelBarrier = barriers[0];
+	levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+
+	for(uint32_t level = 1; level < mipLevels; level++)
+	{
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+
+		vkCmdBindDescriptorSets(theCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, theGenerator.pipelineLayout, 0, 1, &descriptorSets[level - 1], 0, nullptr);
+
+		// The shader has 8x8 local size.
+		vkCmdDispatch(theCommandBuffer, (levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+
+		// Wait for this level to be written before the next dispatch reads it.
+		if(level + 1 < mipLevels) {
+			levelBarrier.subresourceRange.baseMipLevel = level;
+			vkCmdPipelineBarrier(theCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+		}
+	}
+
+	// All the levels to the final layout.
+	levelBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	levelBarrier.dstAccessMask = dstAccessMask;
+	levelBarrier.newLayout = finalLayout;
+	levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+
+	vkCmdPipelineBarrier(theCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+	theGenerator.pendingDescriptorPools.push_back(myDescriptorPool);
+	theGenerator.pendingImageViews.insert(theGenerator.pendingImageViews.end(), levelViews.begin(), levelViews.end());
+}
+
+
+
+/**
+ * Destroys the image views and descriptor pools of the recorded generations.
+ * Call it after the command buffers that used them have completed.
+ */
+void releaseMipmapGeneratorResources(MipmapComputeGenerator & theGenerator)
+{
+	for(VkDescriptorPool pool : theGenerator.pendingDescriptorPools)
+		vkDestroyDescriptorPool(theGenerator.device, pool, theGenerator.pAllocator);
+
+	for(VkImageView view : theGenerator.pendingImageViews)
+		vkDestroyImageView(theGenerator.device, view, theGenerator.pAllocator);
+
+	theGenerator.pendingDescriptorPools.clear();
+	theGenerator.pendingImageViews.clear();
+}
+
+
+
+/**
+ * Destroys the generator. The GPU must not be using it anymore.
+ */
+void destroyMipmapComputeGenerator(MipmapComputeGenerator & theGenerator)
+{
+	releaseMipmapGeneratorResources(theGenerator);
+
+	vkDestroyPipeline(theGenerator.device, theGenerator.pipeline, theGenerator.pAllocator);
+	vkDestroyPipelineLayout(theGenerator.device, theGenerator.pipelineLayout, theGenerator.pAllocator);
+	vkDestroyDescriptorSetLayout(theGenerator.device, theGenerator.descriptorSetLayout, theGenerator.pAllocator);
+
+	theGenerator = MipmapComputeGenerator{};
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef VKDEMOS_THREADPOOL_H
+#define VKDEMOS_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+namespace vkdemos {
+
+/*
+ * A minimal thread pool.
+ *
+ * A fixed number of worker threads take tasks from a single FIFO queue protected by a mutex.
+ * The thread that waits for the tasks doesn't sleep: it executes queued tasks too, so that
+ * a pool of N workers runs N+1 tasks at a time. Tasks must not wait on the pool themselves.
+ *
+ * This is enough for coarse-grained data-parallel work like processing the tiles of an image;
+ * every function taking a ThreadPool pointer also accepts nullptr, and then runs serially.
+ */
+struct ThreadPool
+{
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable allTasksDone;
+
+	std::deque<std::function<void()>> tasks;
+	size_t unfinishedTasks = 0;     // queued + running.
+	bool stopping = false;
+};
+
+
+
+/**
+ * Worker thread loop: runs tasks until the pool is destroyed.
+ */
+void threadPoolWorker(ThreadPool & thePool)
+{
+	std::unique_lock<std::mutex> lock(thePool.mutex);
+
+	while(true)
+	{
+		thePool.taskAvailable.wait(lock, [&thePool]{ return thePool.stopping || !thePool.tasks.empty(); });
+
+		if(thePool.tasks.empty())
+			return;  // stopping, and nothing left to do.
+
+		std::function<void()> task = std::move(thePool.tasks.front());
+		thePool.tasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		if(--thePool.unfinishedTasks == 0)
+			thePool.allTasksDone.notify_all();
+	}
+}
+
+
+
+/**
+ * Starts the worker threads of a pool.
+ * @param threadCount number of workers; 0 means one less than the hardware threads
+ *        (the thread waiting for the tasks works too).
+ */
+void initThreadPool(ThreadPool & thePool, size_t threadCount = 0)
+{
+	if(threadCount == 0)
+		threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+	thePool.stopping = false;
+	thePool.unfinishedTasks = 0;
+
+	for(size_t i = 0; i < threadCount; i++)
+		thePool.workers.emplace_back(threadPoolWorker, std::ref(thePool));
+}
+
+
+
+/**
+ * Returns how many threads execute the tasks of a pool (the workers and the waiting thread).
+ */
+size_t getThreadPoolConcurrency(const ThreadPool * thePool)
+{
+	return (thePool != nullptr) ? thePool->workers.size() + 1 : 1;
+}
+
+
+
+/**
+ * Queues a task for execution on the pool's workers.
+ */
+void submitThreadPoolTask(ThreadPool & thePool, std::function<void()> theTask)
+{
+	{
+		std::lock_guard<std::mutex> lock(thePool.mutex);
+		thePool.tasks.push_back(std::move(theTask));
+		thePool.unfinishedTasks++;
+	}
+
+	thePool.taskAvailable.notify_one();
+}
+
+
+
+/**
+ * Waits for all the submitted tasks to complete, executing queued tasks in the meantime.
+ */
+void waitThreadPoolIdle(ThreadPool & thePool)
+{
+	std::unique_lock<std::mutex> lock(thePool.mutex);
+
+	while(thePool.unfinishedTasks > 0)
+	{
+		if(thePool.tasks.empty()) {
+			thePool.allTasksDone.wait(lock, [&thePool]{ return thePool.unfinishedTasks == 0 || !thePool.tasks.empty(); });
+			continue;
+		}
+
+		std::function<void()> task = std::move(thePool.tasks.front());
+		thePool.tasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		if(--thePool.unfinishedTasks == 0)
+			thePool.allTasksDone.notify_all();
+	}
+}
+
+
+
+/**
+ * Splits the range [0, count) in chunks of at most grainSize elements, and calls
+ * theFunction(begin, end) for each chunk on the pool; returns when all the chunks (and any
+ * other task queued on the pool) are done. With a null pool, runs the whole range on the calling thread.
+ */
+void parallelFor(ThreadPool * thePool, const size_t count, const size_t grainSize, const std::function<void(size_t, size_t)> & theFunction)
+{
+	const size_t grain = std::max<size_t>(grainSize, 1);
+
+	if(thePool == nullptr || count <= grain) {
+		if(count > 0)
+			theFunction(0, count);
+		return;
+	}
+
+	for(size_t begin = 0; begin < count; begin += grain) {
+		const size_t end = std::min(begin + grain, count);
+		submitThreadPoolTask(*thePool, [&theFunction, begin, end]{ theFunction(begin, end); });
+	}
+
+	waitThreadPoolIdle(*thePool);
+}
+
+
+
+/**
+ * Waits for the queued tasks, and joins the worker threads.
+ */
+void destroyThreadPool(ThreadPool & thePool)
+{
+	{
+		std::lock_guard<std::mutex> lock(thePool.mutex);
+		thePool.stopping = true;
+	}
+
+	thePool.taskAvailable.notify_all();
+
+	for(auto & worker : thePool.workers)
+		worker.join();
+
+	thePool.workers.clear();
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,797 @@
+#ifndef VKDEMOS_CPUMIPMAPS_H
+#define VKDEMOS_CPUMIPMAPS_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "20_threadPool.h"
+
+#if defined(__x86_64__) && defined(__SSE2__)
+	#define VKDEMOS_CPU_SIMD_X86 1
+	#include <immintrin.h>
+	// AVX functions are compiled for AVX regardless of the compiler flags, and only called if the CPU supports it.
+	#define VKDEMOS_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace vkdemos {
+
+/*
+ * CPU generation of mip chains, and image resizing.
+ *
+ * Generating the mips when a texture is imported, instead of on the GPU at load time
+ * (see 19_mipmaps.h), allows better filters than the bilinear blit, and the result can
+ * be uploaded (or cached) as-is.
+ *
+ * The images are RGBA8, 4 bytes per pixel. Each level is computed from the previous one:
+ * - the pixels are converted to floating point; if the data is sRGB-encoded, the color
+ *   channels are converted to linear light with a table (alpha is always linear), so that
+ *   averaging doesn't darken the image;
+ * - the level is filtered with a 2x2 box filter, or with a separable Kaiser-windowed sinc,
+ *   which keeps more detail and aliases less. The Kaiser filter runs in two passes per
+ *   output row: a vertical pass, summing whole source rows (contiguous floats: 8 per AVX
+ *   operation, 4 per SSE operation), then a horizontal pass, one RGBA pixel per SSE register
+ *   (two output pixels per AVX register);
+ * - the result is kept in floating point as the source of the next level, and encoded
+ *   back to 8 bit (sRGB-encoded again with a table) in the output.
+ *
+ * The levels depend on each other, so they are computed in sequence; the rows of each level
+ * are split in tiles which are processed in parallel on a ThreadPool. The levels too small to
+ * be worth splitting are computed on the calling thread, and every thread reuses the same
+ * scratch memory for all its tiles.
+ *
+ * The output is the whole chain, tightly packed, at offsets aligned as requested:
+ * it can be written directly to a staging allocation, and uploaded with the regions
+ * returned by getCpuMipChainCopyRegions.
+ */
+
+enum CpuImageFilter
+{
+	CPU_IMAGE_FILTER_BOX,
+	CPU_IMAGE_FILTER_KAISER,
+};
+
+enum CpuSimdLevel
+{
+	CPU_SIMD_AUTO,      // The best level supported by the CPU.
+	CPU_SIMD_SCALAR,
+	CPU_SIMD_SSE2,
+	CPU_SIMD_AVX,
+};
+
+struct CpuImageProcessingOptions
+{
+	CpuImageFilter filter = CPU_IMAGE_FILTER_KAISER;
+	bool srgb = false;                  // The color channels are sRGB-encoded (VK_FORMAT_*_SRGB images).
+	CpuSimdLevel simdLevel = CPU_SIMD_AUTO;
+};
+
+struct CpuMipLevel
+{
+	uint32_t width;
+	uint32_t height;
+	VkDeviceSize offset;    // from the start of the chain.
+	VkDeviceSize size;
+};
+
+struct CpuMipChainLayout
+{
+	std::vector<CpuMipLevel> levels;
+	VkDeviceSize totalSize = 0;
+};
+
+static constexpr uint32_t CPU_IMAGE_PIXEL_SIZE = 4;
+static constexpr float KAISER_FILTER_RADIUS = 3.0f;
+static constexpr float KAISER_FILTER_ALPHA = 4.0f;
+static constexpr uint32_t LINEAR_TO_SRGB_TABLE_SIZE = 8192;     // Enough for less than half an 8-bit step of error near black.
+static constexpr size_t CPU_IMAGE_MIN_TILE_PIXELS = 64 * 1024;   // Smaller tiles cost more in queueing than they gain in parallelism.
+
+
+/*
+ * Precomputed filter taps for one dimension: for each output pixel, "taps" source indices
+ * (already clamped to the image edges) and normalized weights.
+ */
+struct ResampleWeights
+{
+	uint32_t taps = 0;
+	std::vector<int32_t> indices;
+	std::vector<float> weights;
+};
+
+/*
+ * Rows the resampling needs between its two passes. Every thread keeps its own, and reuses it
+ * for all the tiles and levels it processes, instead of allocating it for every tile.
+ */
+struct CpuResampleScratch
+{
+	std::vector<float> verticalRow;
+	std::vector<float> outputRow;
+	std::vector<const float *> rows;
+};
+
+struct SrgbConversionTables
+{
+	float srgbToLinear[256];
+	float unormToFloat[256];
+	uint8_t linearToSrgb[LINEAR_TO_SRGB_TABLE_SIZE];
+};
+
+
+
+/**
+ * Returns the conversion tables, computing them on first use.
+ */
+const SrgbConversionTables & getSrgbConversionTables()
+{
+	static const SrgbConversionTables tables = []{
+		SrgbConversionTables t;
+
+		for(uint32_t i = 0; i < 256; i++) {
+			const float c = i / 255.0f;
+			t.srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			t.unormToFloat[i] = c;
+		}
+
+		for(uint32_t i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; i++) {
+			const float l = i / float(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+			const float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			t.linearToSrgb[i] = (uint8_t)std::min(255.0f, c * 255.0f + 0.5f);
+		}
+
+		return t;
+	}();
+
+	return tables;
+}
+
+
+
+/**
+ * Returns the SIMD instruction set used for theRequested level: the best one supported
+ * by the CPU for CPU_SIMD_AUTO, otherwise the requested one if supported.
+ */
+CpuSimdLevel resolveCpuSimdLevel(const CpuSimdLevel theRequested)
+{
+#ifdef VKDEMOS_CPU_SIMD_X86
+	const CpuSimdLevel best = __builtin_cpu_supports("avx") ? CPU_SIMD_AVX : CPU_SIMD_SSE2;
+#else
+	const CpuSimdLevel best = CPU_SIMD_SCALAR;
+#endif
+
+	if(theRequested == CPU_SIMD_AUTO)
+		return best;
+
+	return std::min(theRequested, best);
+}
+
+
+
+/**
+ * Computes the layout of a mip chain packed in a single buffer.
+ * @param levelCount number of levels; 0 for the full chain, down to 1x1.
+ * @param alignment alignment of the offset of each level (e.g. StagingRing::imageCopyAlignment).
+ */
+void computeCpuMipChainLayout(const uint32_t width,
+                              const uint32_t height,
+                              uint32_t levelCount,
+                              const VkDeviceSize alignment,
+                              CpuMipChainLayout & outLayout)
+{
+	if(levelCount == 0) {
+		levelCount = 1;
+		for(uint32_t size = std::max(width, height); size > 1; size /= 2)
+			levelCount++;
+	}
+
+	outLayout.levels.clear();
+	outLayout.totalSize = 0;
+
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+
+	for(uint32_t i = 0; i < levelCount; i++)
+	{
+		CpuMipLevel level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.offset = (outLayout.totalSize + alignment - 1) / alignment * alignment;
+		level.size = (VkDeviceSize)levelWidth * levelHeight * CPU_IMAGE_PIXEL_SIZE;
+
+		outLayout.levels.push_back(level);
+		outLayout.totalSize = level.offset + level.size;
+
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+}
+
+
+
+/**
+ * Returns the regions to copy a mip chain from a buffer to the levels of an image.
+ * The bufferOffsets are relative to the start of the chain (as stageImageCopy expects).
+ */
+void getCpuMipChainCopyRegions(const CpuMipChainLayout & theLayout, std::vector<VkBufferImageCopy> & outRegions)
+{
+	outRegions.clear();
+
+	for(uint32_t i = 0; i < theLayout.levels.size(); i++)
+	{
+		const CpuMipLevel & level = theLayout.levels[i];
+
+		const VkBufferImageCopy region = {
+			.bufferOffset = level.offset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {level.width, level.height, 1},
+		};
+
+		outRegions.push_back(region);
+	}
+}
+
+
+
+/*
+ * Filter kernels, and their tap tables.
+ */
+float besselI0(const float x)
+{
+	// Power series: sum of ((x/2)^k / k!)^2.
+	float sum = 1.0f;
+	float term = 1.0f;
+	const float halfX = x * 0.5f;
+
+	for(int k = 1; k < 32; k++) {
+		term *= halfX / k;
+		sum += term * term;
+		if(term * term < sum * 1e-9f)
+			break;
+	}
+
+	return sum;
+}
+
+float kaiserKernel(const float x)
+{
+	if(std::fabs(x) >= KAISER_FILTER_RADIUS)
+		return 0.0f;
+
+	const float pix = 3.14159265358979f * x;
+	const float sinc = (std::fabs(x) < 1e-6f) ? 1.0f : std::sin(pix) / pix;
+	const float r = x / KAISER_FILTER_RADIUS;
+
+	return sinc * besselI0(KAISER_FILTER_ALPHA * std::sqrt(1.0f - r * r)) / besselI0(KAISER_FILTER_ALPHA);
+}
+
+void computeResampleWeights(const uint32_t srcSize, const uint32_t dstSize, const CpuImageFilter theFilter, ResampleWeights & outWeights)
+{
+	const float ratio = float(srcSize) / float(dstSize);
+	const float scale = std::max(ratio, 1.0f);     // When minifying, the kernel is stretched to cover the source pixels.
+	const float radius = (theFilter == CPU_IMAGE_FILTER_BOX) ? 0.5f : KAISER_FILTER_RADIUS;
+	const float support = radius * scale;
+
+	outWeights.taps = (uint32_t)std::ceil(support * 2.0f) + 1;
+	outWeights.indices.assign((size_t)dstSize * outWeights.taps, 0);
+	outWeights.weights.assign((size_t)dstSize * outWeights.taps, 0.0f);
+
+	for(uint32_t o = 0; o < dstSize; o++)
+	{
+		const float center = (o + 0.5f) * ratio - 0.5f;
+		const int32_t first = (int32_t)std::ceil(center - support);
+
+		int32_t * indices = &outWeights.indices[(size_t)o * outWeights.taps];
+		float * weights = &outWeights.weights[(size_t)o * outWeights.taps];
+		float sum = 0.0f;
+
+		for(uint32_t k = 0; k < outWeights.taps; k++)
+		{
+			const int32_t src = first + (int32_t)k;
+			const float x = (src - center) / scale;
+			const float w = (theFilter == CPU_IMAGE_FILTER_BOX) ? (std::fabs(x) < 0.5f ? 1.0f : 0.0f) : kaiserKernel(x);
+
+			indices[k] = std::min(std::max(src, 0), (int32_t)srcSize - 1);
+			weights[k] = w;
+			sum += w;
+		}
+
+		if(sum == 0.0f) {
+			// Can't happen with these kernels, but better not to divide by zero.
+			weights[0] = sum = 1.0f;
+		}
+
+		for(uint32_t k = 0; k < outWeights.taps; k++)
+			weights[k] /= sum;
+	}
+}
+
+
+
+/*
+ * Row kernels: scalar versions, and the SSE2 and AVX ones.
+ */
+
+// Converts a row of RGBA8 pixels to linear floats.
+void decodeRowToFloat(const uint8_t * src, float * dst, const uint32_t width, const bool srgb)
+{
+	const SrgbConversionTables & tables = getSrgbConversionTables();
+	const float * colorTable = srgb ? tables.srgbToLinear : tables.unormToFloat;
+
+	for(uint32_t x = 0; x < width; x++) {
+		dst[x*4 + 0] = colorTable[src[x*4 + 0]];
+		dst[x*4 + 1] = colorTable[src[x*4 + 1]];
+		dst[x*4 + 2] = colorTable[src[x*4 + 2]];
+		dst[x*4 + 3] = tables.unormToFloat[src[x*4 + 3]];
+	}
+}
+
+// Converts a row of linear floats to RGBA8, clamping and rounding.
+void encodeRowFromFloatScalar(const float * src, uint8_t * dst, const uint32_t width, const bool srgb)
+{
+	const SrgbConversionTables & tables = getSrgbConversionTables();
+
+	for(uint32_t x = 0; x < width; x++)
+	{
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			const float v = std::min(std::max(src[x*4 + c], 0.0f), 1.0f);
+
+			if(srgb && c < 3)
+				dst[x*4 + c] = tables.linearToSrgb[(uint32_t)(v * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+			else
+				dst[x*4 + c] = (uint8_t)(v * 255.0f + 0.5f);
+		}
+	}
+}
+
+void boxDownsampleRowScalar(const float * row0, const float * row1, const uint32_t srcWidth, float * dst, const uint32_t dstWidth)
+{
+	for(uint32_t x = 0; x < dstWidth; x++)
+	{
+		const uint32_t x0 = std::min(2*x, srcWidth - 1);
+		const uint32_t x1 = std::min(2*x + 1, srcWidth - 1);
+
+		for(uint32_t c = 0; c < 4; c++)
+			dst[x*4 + c] = (row0[x0*4 + c] + row0[x1*4 + c] + row1[x0*4 + c] + row1[x1*4 + c]) * 0.25f;
+	}
+}
+
+void resampleVerticalScalar(const float * const * rows, const float * weights, const uint32_t taps, float * dst, const size_t count)
+{
+	for(size_t i = 0; i < count; i++) {
+		float sum = 0.0f;
+		for(uint32_t k = 0; k < taps; k++)
+			sum += weights[k] * rows[k][i];
+		dst[i] = sum;
+	}
+}
+
+void resampleHorizontalScalar(const float * src, const ResampleWeights & theWeights, float * dst, const uint32_t dstWidth)
+{
+	const uint32_t taps = theWeights.taps;
+
+	for(uint32_t x = 0; x < dstWidth; x++)
+	{
+		const int32_t * indices = &theWeights.indices[(size_t)x * taps];
+		const float * weights = &theWeights.weights[(size_t)x * taps];
+
+		float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		for(uint32_t k = 0; k < taps; k++)
+			for(uint32_t c = 0; c < 4; c++)
+				sum[c] += weights[k] * src[indices[k]*4 + c];
+
+		memcpy(&dst[x*4], sum, sizeof(sum));
+	}
+}
+
+
+#ifdef VKDEMOS_CPU_SIMD_X86
+
+void encodeRowFromFloatSSE2(const float * src, uint8_t * dst, const uint32_t width, const bool srgb)
+{
+	const SrgbConversionTables & tables = getSrgbConversionTables();
+	const float colorScale = srgb ? float(LINEAR_TO_SRGB_TABLE_SIZE - 1) : 255.0f;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 scale = _mm_setr_ps(colorScale, colorScale, colorScale, 255.0f);
+
+	for(uint32_t x = 0; x < width; x++)
+	{
+		__m128 v = _mm_loadu_ps(&src[x*4]);
+		v = _mm_min_ps(_mm_max_ps(v, zero), one);
+		const __m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+
+		if(srgb) {
+			alignas(16) int32_t indices[4];
+			_mm_store_si128((__m128i*)indices, values);
+			dst[x*4 + 0] = tables.linearToSrgb[indices[0]];
+			dst[x*4 + 1] = tables.linearToSrgb[indices[1]];
+			dst[x*4 + 2] = tables.linearToSrgb[indices[2]];
+			dst[x*4 + 3] = (uint8_t)indices[3];
+		}
+		else {
+			const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(values, values), _mm_setzero_si128());
+			const int32_t pixel = _mm_cvtsi128_si32(packed);
+			memcpy(&dst[x*4], &pixel, 4);
+		}
+	}
+}
+
+void boxDownsampleRowSSE2(const float * row0, const float * row1, const uint32_t srcWidth, float * dst, const uint32_t dstWidth)
+{
+	const __m128 quarter = _mm_set1_ps(0.25f);
+
+	for(uint32_t x = 0; x < dstWidth; x++)
+	{
+		const uint32_t x0 = std::min(2*x, srcWidth - 1);
+		const uint32_t x1 = std::min(2*x + 1, srcWidth - 1);
+
+		const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&row0[x0*4]), _mm_loadu_ps(&row0[x1*4])),
+		                              _mm_add_ps(_mm_loadu_ps(&row1[x0*4]), _mm_loadu_ps(&row1[x1*4])));
+		_mm_storeu_ps(&dst[x*4], _mm_mul_ps(sum, quarter));
+	}
+}
+
+void resampleVerticalSSE2(const float * const * rows, const float * weights, const uint32_t taps, float * dst, const size_t count)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&rows[k][i])));
+		_mm_storeu_ps(&dst[i], sum);
+	}
+
+	// count is a multiple of 4 (whole RGBA pixels), so there's no scalar tail.
+}
+
+void resampleHorizontalSSE2(const float * src, const ResampleWeights & theWeights, float * dst, const uint32_t dstWidth)
+{
+	const uint32_t taps = theWeights.taps;
+
+	for(uint32_t x = 0; x < dstWidth; x++)
+	{
+		const int32_t * indices = &theWeights.indices[(size_t)x * taps];
+		const float * weights = &theWeights.weights[(size_t)x * taps];
+
+		__m128 sum = _mm_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&src[indices[k]*4])));
+
+		_mm_storeu_ps(&dst[x*4], sum);
+	}
+}
+
+VKDEMOS_TARGET_AVX
+void boxDownsampleRowAVX(const float * row0, const float * row1, const uint32_t srcWidth, float * dst, const uint32_t dstWidth)
+{
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	uint32_t x = 0;
+
+	// Two output pixels from four source pixels per row, as long as they're all inside the row.
+	for(; x + 2 <= dstWidth && 2*x + 4 <= srcWidth; x += 2)
+	{
+		const __m256 sumA = _mm256_add_ps(_mm256_loadu_ps(&row0[x*8]),     _mm256_loadu_ps(&row1[x*8]));       // source pixels 2x, 2x+1
+		const __m256 sumB = _mm256_add_ps(_mm256_loadu_ps(&row0[x*8 + 8]), _mm256_loadu_ps(&row1[x*8 + 8]));   // source pixels 2x+2, 2x+3
+
+		// [2x | 2x+2] + [2x+1 | 2x+3]
+		const __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(sumA, sumB, 0x20), _mm256_permute2f128_ps(sumA, sumB, 0x31));
+		_mm256_storeu_ps(&dst[x*4], _mm256_mul_ps(sum, quarter));
+	}
+
+	if(x < dstWidth) {
+		// The remaining pixels, clamped at the right edge, one at a time.
+		for(; x < dstWidth; x++)
+		{
+			const uint32_t x0 = std::min(2*x, srcWidth - 1);
+			const uint32_t x1 = std::min(2*x + 1, srcWidth - 1);
+
+			const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&row0[x0*4]), _mm_loadu_ps(&row0[x1*4])),
+			                              _mm_add_ps(_mm_loadu_ps(&row1[x0*4]), _mm_loadu_ps(&row1[x1*4])));
+			_mm_storeu_ps(&dst[x*4], _mm_mul_ps(sum, _mm256_castps256_ps128(quarter)));
+		}
+	}
+}
+
+VKDEMOS_TARGET_AVX
+void resampleVerticalAVX(const float * const * rows, const float * weights, const uint32_t taps, float * dst, const size_t count)
+{
+	size_t i = 0;
+
+	for(; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(&rows[k][i])));
+		_mm256_storeu_ps(&dst[i], sum);
+	}
+
+	for(; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&rows[k][i])));
+		_mm_storeu_ps(&dst[i], sum);
+	}
+
+	// count is a multiple of 4 (whole RGBA pixels), so there's no scalar tail.
+}
+
+VKDEMOS_TARGET_AVX
+void resampleHorizontalAVX(const float * src, const ResampleWeights & theWeights, float * dst, const uint32_t dstWidth)
+{
+	const uint32_t taps = theWeights.taps;
+	uint32_t x = 0;
+
+	// Two output pixels at a time: one per 128-bit lane.
+	for(; x + 2 <= dstWidth; x += 2)
+	{
+		const int32_t * indicesA = &theWeights.indices[(size_t)x * taps];
+		const int32_t * indicesB = indicesA + taps;
+		const float * weightsA = &theWeights.weights[(size_t)x * taps];
+		const float * weightsB = weightsA + taps;
+
+		__m256 sum = _mm256_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+		{
+			const __m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&src[indicesA[k]*4])), _mm_loadu_ps(&src[indicesB[k]*4]), 1);
+			const __m256 weights = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weightsA[k])), _mm_set1_ps(weightsB[k]), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weights, pixels));
+		}
+
+		_mm256_storeu_ps(&dst[x*4], sum);
+	}
+
+	if(x < dstWidth)
+	{
+		const int32_t * indices = &theWeights.indices[(size_t)x * taps];
+		const float * weights = &theWeights.weights[(size_t)x * taps];
+
+		__m128 sum = _mm_setzero_ps();
+		for(uint32_t k = 0; k < taps; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&src[indices[k]*4])));
+
+		_mm_storeu_ps(&dst[x*4], sum);
+	}
+}
+
+#endif
+
+
+/*
+ * Dispatch to the row kernels of the chosen SIMD level.
+ * The encoding is table- and conversion-bound, so AVX uses the SSE2 version.
+ */
+void encodeRowFromFloat(const float * src, uint8_t * dst, const uint32_t width, const bool srgb, const CpuSimdLevel simd)
+{
+#ifdef VKDEMOS_CPU_SIMD_X86
+	if(simd != CPU_SIMD_SCALAR)
+		return encodeRowFromFloatSSE2(src, dst, width, srgb);
+#endif
+	encodeRowFromFloatScalar(src, dst, width, srgb);
+}
+
+void boxDownsampleRow(const float * row0, const float * row1, const uint32_t srcWidth, float * dst, const uint32_t dstWidth, const CpuSimdLevel simd)
+{
+#ifdef VKDEMOS_CPU_SIMD_X86
+	if(simd == CPU_SIMD_AVX)
+		return boxDownsampleRowAVX(row0, row1, srcWidth, dst, dstWidth);
+	if(simd == CPU_SIMD_SSE2)
+		return boxDownsampleRowSSE2(row0, row1, srcWidth, dst, dstWidth);
+#endif
+	boxDownsampleRowScalar(row0, row1, srcWidth, dst, dstWidth);
+}
+
+void resampleVertical(const float * const * rows, const float * weights, const uint32_t taps, float * dst, const size_t count, const CpuSimdLevel simd)
+{
+#ifdef VKDEMOS_CPU_SIMD_X86
+	if(simd == CPU_SIMD_AVX)
+		return resampleVerticalAVX(rows, weights, taps, dst, count);
+	if(simd == CPU_SIMD_SSE2)
+		return resampleVerticalSSE2(rows, weights, taps, dst, count);
+#endif
+	resampleVerticalScalar(rows, weights, taps, dst, count);
+}
+
+void resampleHorizontal(const float * src, const ResampleWeights & theWeights, float * dst, const uint32_t dstWidth, const CpuSimdLevel simd)
+{
+#ifdef VKDEMOS_CPU_SIMD_X86
+	if(simd == CPU_SIMD_AVX)
+		return resampleHorizontalAVX(src, theWeights, dst, dstWidth);
+	if(simd == CPU_SIMD_SSE2)
+		return resampleHorizontalSSE2(src, theWeights, dst, dstWidth);
+#endif
+	resampleHorizontalScalar(src, theWeights, dst, dstWidth);
+}
+
+
+
+/*
+ * Image-level functions.
+ */
+
+/*
+ * Number of rows per task: about 4 tasks per thread, to balance the load, but at least
+ * CPU_IMAGE_MIN_TILE_PIXELS per task, so that the small levels of a chain run on the calling thread.
+ */
+size_t getCpuImageTileRows(ThreadPool * thePool, const uint32_t width, const uint32_t height)
+{
+	const size_t balancedRows = height / (getThreadPoolConcurrency(thePool) * 4);
+	const size_t minimumRows = (CPU_IMAGE_MIN_TILE_PIXELS + width - 1) / std::max(width, 1u);
+	return std::max<size_t>({balancedRows, minimumRows, 1});
+}
+
+
+/*
+ * Returns the scratch rows of the calling thread, grown to the requested sizes.
+ */
+CpuResampleScratch & getCpuResampleScratch(const size_t rowFloats, const size_t outputRowFloats, const uint32_t taps)
+{
+	static thread_local CpuResampleScratch scratch;
+
+	if(scratch.verticalRow.size() < rowFloats)
+		scratch.verticalRow.resize(rowFloats);
+	if(scratch.outputRow.size() < outputRowFloats)
+		scratch.outputRow.resize(outputRowFloats);
+	if(scratch.rows.size() < taps)
+		scratch.rows.resize(taps);
+
+	return scratch;
+}
+
+
+/**
+ * Filters a linear floating-point RGBA image to another size, writing both the floating-point
+ * result (if dstFloat is not null) and its RGBA8 encoding (if dst8 is not null, rows dst8RowPitch bytes apart).
+ */
+void resampleFloatImage(ThreadPool * thePool,
+                        const float * src,
+                        const uint32_t srcWidth,
+                        const uint32_t srcHeight,
+                        float * dstFloat,
+                        uint8_t * dst8,
+                        const size_t dst8RowPitch,
+                        const uint32_t dstWidth,
+                        const uint32_t dstHeight,
+                        const CpuImageFilter theFilter,
+                        const bool srgb,
+                        const CpuSimdLevel simd)
+{
+	const size_t srcRowFloats = (size_t)srcWidth * 4;
+	const size_t dstRowFloats = (size_t)dstWidth * 4;
+
+	// Exact halving with the box filter: the 2x2 average, no tables needed.
+	const bool boxHalving = (theFilter == CPU_IMAGE_FILTER_BOX)
+	                        && dstWidth == std::max(srcWidth / 2, 1u)
+	                        && dstHeight == std::max(srcHeight / 2, 1u);
+
+	ResampleWeights horizontalWeights, verticalWeights;
+	if(!boxHalving) {
+		computeResampleWeights(srcWidth, dstWidth, theFilter, horizontalWeights);
+		computeResampleWeights(srcHeight, dstHeight, theFilter, verticalWeights);
+	}
+
+	parallelFor(thePool, dstHeight, getCpuImageTileRows(thePool, dstWidth, dstHeight), [&](size_t begin, size_t end)
+	{
+		CpuResampleScratch & scratch = getCpuResampleScratch(boxHalving ? 0 : srcRowFloats, dstFloat == nullptr ? dstRowFloats : 0, verticalWeights.taps);
+		float * verticalRow = scratch.verticalRow.data();
+		const float ** rows = scratch.rows.data();
+
+		for(size_t y = begin; y < end; y++)
+		{
+			float * out = (dstFloat != nullptr) ? dstFloat + y * dstRowFloats : scratch.outputRow.data();
+
+			if(boxHalving) {
+				const size_t y0 = std::min<size_t>(2*y, srcHeight - 1);
+				const size_t y1 = std::min<size_t>(2*y + 1, srcHeight - 1);
+				boxDownsampleRow(src + y0 * srcRowFloats, src + y1 * srcRowFloats, srcWidth, out, dstWidth, simd);
+			}
+			else {
+				const int32_t * indices = &verticalWeights.indices[y * verticalWeights.taps];
+				for(uint32_t k = 0; k < verticalWeights.taps; k++)
+					rows[k] = src + indices[k] * srcRowFloats;
+
+				resampleVertical(rows, &verticalWeights.weights[y * verticalWeights.taps], verticalWeights.taps, verticalRow, srcRowFloats, simd);
+				resampleHorizontal(verticalRow, horizontalWeights, out, dstWidth, simd);
+			}
+
+			if(dst8 != nullptr)
+				encodeRowFromFloat(out, dst8 + y * dst8RowPitch, dstWidth, srgb, simd);
+		}
+	});
+}
+
+
+/**
+ * Converts an RGBA8 image (rows srcRowPitch bytes apart) to linear floating point.
+ */
+void decodeImageToFloat(ThreadPool * thePool, const uint8_t * src, const size_t srcRowPitch, const uint32_t width, const uint32_t height, const bool srgb, std::vector<float> & outImage)
+{
+	outImage.resize((size_t)width * height * 4);
+	float * dst = outImage.data();
+
+	parallelFor(thePool, height, getCpuImageTileRows(thePool, width, height), [&](size_t begin, size_t end) {
+		for(size_t y = begin; y < end; y++)
+			decodeRowToFloat(src + y * srcRowPitch, dst + y * width * 4, width, srgb);
+	});
+}
+
+
+
+/**
+ * Resizes an RGBA8 image with the filter of theOptions.
+ * @param srcRowPitch, dstRowPitch distance in bytes between the rows of the images.
+ * @param thePool the pool to run the tiles on, or nullptr to run on the calling thread.
+ */
+void resizeImageCpu(ThreadPool * thePool,
+                    const void * srcPixels,
+                    const uint32_t srcWidth,
+                    const uint32_t srcHeight,
+                    const size_t srcRowPitch,
+                    void * dstPixels,
+                    const uint32_t dstWidth,
+                    const uint32_t dstHeight,
+                    const size_t dstRowPitch,
+                    const CpuImageProcessingOptions & theOptions = CpuImageProcessingOptions())
+{
+	const CpuSimdLevel simd = resolveCpuSimdLevel(theOptions.simdLevel);
+
+	std::vector<float> srcFloat;
+	decodeImageToFloat(thePool, (const uint8_t*)srcPixels, srcRowPitch, srcWidth, srcHeight, theOptions.srgb, srcFloat);
+
+	resampleFloatImage(thePool, srcFloat.data(), srcWidth, srcHeight,
+	                   nullptr, (uint8_t*)dstPixels, dstRowPitch, dstWidth, dstHeight,
+	                   theOptions.filter, theOptions.srgb, simd);
+}
+
+
+
+/**
+ * Generates a mip chain from a tightly-packed RGBA8 image, writing all the levels
+ * (level 0 included) to outData with the layout computed by computeCpuMipChainLayout.
+ * outData can point directly to a staging allocation of theLayout.totalSize bytes.
+ */
+void generateCpuMipChain(ThreadPool * thePool,
+                         const void * level0Pixels,
+                         const CpuMipChainLayout & theLayout,
+                         void * outData,
+                         const CpuImageProcessingOptions & theOptions = CpuImageProcessingOptions())
+{
+	const CpuSimdLevel simd = resolveCpuSimdLevel(theOptions.simdLevel);
+	uint8_t * out = (uint8_t*)outData;
+
+	const CpuMipLevel & level0 = theLayout.levels[0];
+	memcpy(out + level0.offset, level0Pixels, level0.size);
+
+	if(theLayout.levels.size() < 2)
+		return;
+
+	// Each level is computed from the floating-point version of the previous one.
+	std::vector<float> previousLevel, currentLevel;
+	decodeImageToFloat(thePool, (const uint8_t*)level0Pixels, level0.width * CPU_IMAGE_PIXEL_SIZE, level0.width, level0.height, theOptions.srgb, previousLevel);
+
+	for(size_t i = 1; i < theLayout.levels.size(); i++)
+	{
+		const CpuMipLevel & source = theLayout.levels[i - 1];
+		const CpuMipLevel & level = theLayout.levels[i];
+
+		currentLevel.resize((size_t)level.width * level.height * 4);
+
+		resampleFloatImage(thePool, previousLevel.data(), source.width, source.height,
+		                   currentLevel.data(), out + level.offset, level.width * CPU_IMAGE_PIXEL_SIZE, level.width, level.height,
+		                   theOptions.filter, theOptions.srgb, simd);
+
+		std::swap(previousLevel, currentLevel);
+	}
+}
+
+}	// vkdemos
+
+#endif
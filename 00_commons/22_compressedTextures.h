@@ -0,0 +1,905 @@
+#ifndef VKDEMOS_COMPRESSEDTEXTURES_H
+#define VKDEMOS_COMPRESSEDTEXTURES_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "17_uploadEngine.h"
+#include "18_stagingRing.h"
+#include "19_mipmaps.h"
+
+namespace vkdemos {
+
+/*
+ * Block-compressed textures.
+ *
+ * Block compression formats store fixed-size blocks of texels (4x4 for BCn, up to 12x12
+ * for ASTC) in 8 or 16 bytes: 0.5 or 1 byte per texel for BCn, against the 4 bytes of
+ * RGBA8. The GPU decompresses them when sampling, so they use less memory and less
+ * bandwidth, and since they can't be compressed quickly at load time, they're stored
+ * in files already compressed, together with their mip levels.
+ *
+ * The loader reads the two most common containers:
+ * - KTX2 (Khronos), which stores the VkFormat directly;
+ * - DDS (Microsoft), with the format as a FourCC code or a DXGI_FORMAT in the DX10 header.
+ * Only 2D textures without array layers, faces or supercompression are supported.
+ *
+ * Not every device supports every format (desktop GPUs have BCn, mobile ones ASTC):
+ * isTextureFormatSupported checks the format's features, and decompressTexture converts
+ * a BC1/BC3/BC5/BC7 texture to RGBA8 on the CPU when the device can't sample it.
+ */
+
+struct CompressedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	VkDeviceSize offset;    // in CompressedTexture::data.
+	VkDeviceSize size;
+};
+
+struct CompressedTexture
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<CompressedTextureLevel> levels;
+	std::vector<uint8_t> data;
+};
+
+
+
+/**
+ * Returns the block size of the formats the loader understands.
+ * Uncompressed RGBA8/BGRA8 formats are reported as 1x1 blocks of 4 bytes.
+ * @returns false if the format is not supported by the loader.
+ */
+bool getTextureFormatBlockInfo(const VkFormat theFormat, uint32_t & outBlockWidth, uint32_t & outBlockHeight, uint32_t & outBlockSize)
+{
+	outBlockWidth = 4;
+	outBlockHeight = 4;
+
+	switch(theFormat)
+	{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			outBlockWidth = 1;
+			outBlockHeight = 1;
+			outBlockSize = 4;
+			return true;
+
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			outBlockSize = 8;
+			return true;
+
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			outBlockSize = 16;
+			return true;
+
+		default:
+			break;
+	}
+
+	// ASTC formats: all the block sizes, 16 bytes per block.
+	static const struct { VkFormat unorm; VkFormat srgb; uint32_t width; uint32_t height; } astcFormats[] = {
+		{VK_FORMAT_ASTC_4x4_UNORM_BLOCK,   VK_FORMAT_ASTC_4x4_SRGB_BLOCK,    4,  4},
+		{VK_FORMAT_ASTC_5x4_UNORM_BLOCK,   VK_FORMAT_ASTC_5x4_SRGB_BLOCK,    5,  4},
+		{VK_FORMAT_ASTC_5x5_UNORM_BLOCK,   VK_FORMAT_ASTC_5x5_SRGB_BLOCK,    5,  5},
+		{VK_FORMAT_ASTC_6x5_UNORM_BLOCK,   VK_FORMAT_ASTC_6x5_SRGB_BLOCK,    6,  5},
+		{VK_FORMAT_ASTC_6x6_UNORM_BLOCK,   VK_FORMAT_ASTC_6x6_SRGB_BLOCK,    6,  6},
+		{VK_FORMAT_ASTC_8x5_UNORM_BLOCK,   VK_FORMAT_ASTC_8x5_SRGB_BLOCK,    8,  5},
+		{VK_FORMAT_ASTC_8x6_UNORM_BLOCK,   VK_FORMAT_ASTC_8x6_SRGB_BLOCK,    8,  6},
+		{VK_FORMAT_ASTC_8x8_UNORM_BLOCK,   VK_FORMAT_ASTC_8x8_SRGB_BLOCK,    8,  8},
+		{VK_FORMAT_ASTC_10x5_UNORM_BLOCK,  VK_FORMAT_ASTC_10x5_SRGB_BLOCK,  10,  5},
+		{VK_FORMAT_ASTC_10x6_UNORM_BLOCK,  VK_FORMAT_ASTC_10x6_SRGB_BLOCK,  10,  6},
+		{VK_FORMAT_ASTC_10x8_UNORM_BLOCK,  VK_FORMAT_ASTC_10x8_SRGB_BLOCK,  10,  8},
+		{VK_FORMAT_ASTC_10x10_UNORM_BLOCK, VK_FORMAT_ASTC_10x10_SRGB_BLOCK, 10, 10},
+		{VK_FORMAT_ASTC_12x10_UNORM_BLOCK, VK_FORMAT_ASTC_12x10_SRGB_BLOCK, 12, 10},
+		{VK_FORMAT_ASTC_12x12_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK, 12, 12},
+	};
+
+	for(const auto & astc : astcFormats) {
+		if(theFormat == astc.unorm || theFormat == astc.srgb) {
+			outBlockWidth = astc.width;
+			outBlockHeight = astc.height;
+			outBlockSize = 16;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+/**
+ * Returns true if the format's color channels are sRGB-encoded.
+ */
+bool isSrgbTextureFormat(const VkFormat theFormat)
+{
+	switch(theFormat)
+	{
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+
+/**
+ * Returns true if optimally-tiled images of theFormat can be sampled by the device.
+ */
+bool isTextureFormatSupported(const VkPhysicalDevice thePhysicalDevice, const VkFormat theFormat)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(thePhysicalDevice, theFormat, &formatProperties);
+
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+
+
+/*
+ * File parsing helpers.
+ */
+bool readWholeFile(const std::string & path, std::vector<uint8_t> & outContents)
+{
+	std::ifstream inFile;
+	inFile.open(path, std::ios_base::binary | std::ios_base::ate);
+
+	if(!inFile) {
+		std::cout << "!!! ERROR: couldn't open texture file \"" << path << "\" for reading." << std::endl;
+		return false;
+	}
+
+	const std::streamoff fileSize = inFile.tellg();
+	if(fileSize < 0) {
+		std::cout << "!!! ERROR: couldn't read texture file \"" << path << "\"." << std::endl;
+		return false;
+	}
+
+	outContents.resize((size_t)fileSize);
+
+	inFile.seekg(0, std::ios::beg);
+	if(!inFile.read((char*)outContents.data(), fileSize)) {
+		std::cout << "!!! ERROR: couldn't read texture file \"" << path << "\"." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+template<typename T>
+T readFileValue(const std::vector<uint8_t> & theContents, const size_t offset)
+{
+	T value;
+	memcpy(&value, &theContents[offset], sizeof(T));    // The files are little-endian, like the machines we run on.
+	return value;
+}
+
+/*
+ * Checks the size and the level count read from a file header: levelIndex must stay below
+ * the levels of a full mip chain, for the shifts computing the level sizes.
+ */
+bool checkCompressedTextureSize(const uint32_t width, const uint32_t height, const uint32_t levelCount, const std::string & path)
+{
+	if(width == 0 || height == 0) {
+		std::cout << "!!! ERROR: texture file \"" << path << "\" has a zero size (" << width << "x" << height << ")." << std::endl;
+		return false;
+	}
+
+	if(levelCount > computeMipLevelCount(width, height)) {
+		std::cout << "!!! ERROR: texture file \"" << path << "\" has " << levelCount << " mip levels, more than a " << width << "x" << height << " texture can have." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Appends a level to the texture, copying its data from the file contents, and checks its size.
+ * Levels start at 16-byte aligned offsets, a multiple of every block size.
+ */
+bool addCompressedTextureLevel(CompressedTexture & theTexture,
+                               const std::vector<uint8_t> & theContents,
+                               const size_t fileOffset,
+                               const uint32_t levelIndex,
+                               const std::string & path)
+{
+	uint32_t blockWidth, blockHeight, blockSize;
+	getTextureFormatBlockInfo(theTexture.format, blockWidth, blockHeight, blockSize);
+
+	CompressedTextureLevel level;
+	level.width = std::max(theTexture.width >> levelIndex, 1u);
+	level.height = std::max(theTexture.height >> levelIndex, 1u);
+	level.size = (((VkDeviceSize)level.width + blockWidth - 1) / blockWidth) * (((VkDeviceSize)level.height + blockHeight - 1) / blockHeight) * blockSize;
+	level.offset = (theTexture.data.size() + 15) / 16 * 16;
+
+	if(fileOffset > theContents.size() || level.size > theContents.size() - fileOffset) {
+		std::cout << "!!! ERROR: texture file \"" << path << "\" is truncated at level " << levelIndex << "." << std::endl;
+		return false;
+	}
+
+	theTexture.data.resize(level.offset + level.size);
+	memcpy(&theTexture.data[level.offset], &theContents[fileOffset], level.size);
+	theTexture.levels.push_back(level);
+	return true;
+}
+
+
+
+/**
+ * Loads a 2D texture, with its mip levels, from a KTX2 file.
+ */
+bool loadKTX2Texture(const std::string & path, CompressedTexture & outTexture)
+{
+	static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+	static constexpr size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+
+	std::vector<uint8_t> contents;
+	if(!readWholeFile(path, contents))
+		return false;
+
+	if(contents.size() < KTX2_LEVEL_INDEX_OFFSET || memcmp(contents.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		std::cout << "!!! ERROR: \"" << path << "\" is not a KTX2 file." << std::endl;
+		return false;
+	}
+
+	const VkFormat format = (VkFormat)readFileValue<uint32_t>(contents, 12);
+	const uint32_t pixelWidth = readFileValue<uint32_t>(contents, 20);
+	const uint32_t pixelHeight = readFileValue<uint32_t>(contents, 24);
+	const uint32_t pixelDepth = readFileValue<uint32_t>(contents, 28);
+	const uint32_t layerCount = readFileValue<uint32_t>(contents, 32);
+	const uint32_t faceCount = readFileValue<uint32_t>(contents, 36);
+	const uint32_t levelCount = std::max(readFileValue<uint32_t>(contents, 40), 1u);
+	const uint32_t supercompressionScheme = readFileValue<uint32_t>(contents, 44);
+
+	uint32_t blockWidth, blockHeight, blockSize;
+	if(!getTextureFormatBlockInfo(format, blockWidth, blockHeight, blockSize)) {
+		std::cout << "!!! ERROR: KTX2 file \"" << path << "\" has unsupported VkFormat " << format << "." << std::endl;
+		return false;
+	}
+
+	if(pixelDepth > 1 || layerCount > 1 || faceCount != 1 || supercompressionScheme != 0) {
+		std::cout << "!!! ERROR: KTX2 file \"" << path << "\" is not a plain 2D texture (only 2D, non-array, non-cubemap, non-supercompressed textures are supported)." << std::endl;
+		return false;
+	}
+
+	if(!checkCompressedTextureSize(pixelWidth, pixelHeight, levelCount, path))
+		return false;
+
+	if((contents.size() - KTX2_LEVEL_INDEX_OFFSET) / 24 < levelCount) {
+		std::cout << "!!! ERROR: KTX2 file \"" << path << "\" is truncated." << std::endl;
+		return false;
+	}
+
+	CompressedTexture myTexture;
+	myTexture.format = format;
+	myTexture.width = pixelWidth;
+	myTexture.height = pixelHeight;
+
+	// The level index: byteOffset, byteLength, uncompressedByteLength for each level, level 0 first.
+	for(uint32_t i = 0; i < levelCount; i++)
+	{
+		const uint64_t byteOffset = readFileValue<uint64_t>(contents, KTX2_LEVEL_INDEX_OFFSET + i * 24);
+		if(!addCompressedTextureLevel(myTexture, contents, (size_t)byteOffset, i, path))
+			return false;
+	}
+
+	outTexture = std::move(myTexture);
+	return true;
+}
+
+
+
+/**
+ * Loads a 2D texture, with its mip levels, from a DDS file.
+ */
+bool loadDDSTexture(const std::string & path, CompressedTexture & outTexture)
+{
+	static constexpr uint32_t DDS_MAGIC = 0x20534444;            // "DDS "
+	static constexpr size_t DDS_HEADER_END = 4 + 124;
+	static constexpr size_t DDS_DX10_HEADER_END = DDS_HEADER_END + 20;
+	static constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+
+	auto fourCC = [](const char * code) {
+		return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+	};
+
+	std::vector<uint8_t> contents;
+	if(!readWholeFile(path, contents))
+		return false;
+
+	if(contents.size() < DDS_HEADER_END || readFileValue<uint32_t>(contents, 0) != DDS_MAGIC) {
+		std::cout << "!!! ERROR: \"" << path << "\" is not a DDS file." << std::endl;
+		return false;
+	}
+
+	const uint32_t height = readFileValue<uint32_t>(contents, 4 + 8);
+	const uint32_t width = readFileValue<uint32_t>(contents, 4 + 12);
+	const uint32_t mipMapCount = std::max(readFileValue<uint32_t>(contents, 4 + 24), 1u);
+	const uint32_t pixelFormatFourCC = readFileValue<uint32_t>(contents, 4 + 80);
+	const uint32_t caps2 = readFileValue<uint32_t>(contents, 4 + 108);
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	size_t dataOffset = DDS_HEADER_END;
+
+	if(pixelFormatFourCC == fourCC("DX10"))
+	{
+		if(contents.size() < DDS_DX10_HEADER_END) {
+			std::cout << "!!! ERROR: DDS file \"" << path << "\" is truncated." << std::endl;
+			return false;
+		}
+
+		const uint32_t dxgiFormat = readFileValue<uint32_t>(contents, DDS_HEADER_END);
+		const uint32_t arraySize = readFileValue<uint32_t>(contents, DDS_HEADER_END + 12);
+
+		switch(dxgiFormat)
+		{
+			case 28: format = VK_FORMAT_R8G8B8A8_UNORM;       break;   // DXGI_FORMAT_R8G8B8A8_UNORM
+			case 29: format = VK_FORMAT_R8G8B8A8_SRGB;        break;   // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+			case 71: format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;   // DXGI_FORMAT_BC1_UNORM
+			case 72: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;  break;   // DXGI_FORMAT_BC1_UNORM_SRGB
+			case 77: format = VK_FORMAT_BC3_UNORM_BLOCK;      break;   // DXGI_FORMAT_BC3_UNORM
+			case 78: format = VK_FORMAT_BC3_SRGB_BLOCK;       break;   // DXGI_FORMAT_BC3_UNORM_SRGB
+			case 83: format = VK_FORMAT_BC5_UNORM_BLOCK;      break;   // DXGI_FORMAT_BC5_UNORM
+			case 98: format = VK_FORMAT_BC7_UNORM_BLOCK;      break;   // DXGI_FORMAT_BC7_UNORM
+			case 99: format = VK_FORMAT_BC7_SRGB_BLOCK;       break;   // DXGI_FORMAT_BC7_UNORM_SRGB
+			default: break;
+		}
+
+		if(arraySize > 1) {
+			std::cout << "!!! ERROR: DDS file \"" << path << "\" is a texture array, which is not supported." << std::endl;
+			return false;
+		}
+
+		dataOffset = DDS_DX10_HEADER_END;
+	}
+	else if(pixelFormatFourCC == fourCC("DXT1"))
+		format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	else if(pixelFormatFourCC == fourCC("DXT5"))
+		format = VK_FORMAT_BC3_UNORM_BLOCK;
+	else if(pixelFormatFourCC == fourCC("ATI2") || pixelFormatFourCC == fourCC("BC5U"))
+		format = VK_FORMAT_BC5_UNORM_BLOCK;
+
+	if(format == VK_FORMAT_UNDEFINED) {
+		std::cout << "!!! ERROR: DDS file \"" << path << "\" has an unsupported pixel format." << std::endl;
+		return false;
+	}
+
+	if(caps2 & DDSCAPS2_CUBEMAP) {
+		std::cout << "!!! ERROR: DDS file \"" << path << "\" is a cubemap, which is not supported." << std::endl;
+		return false;
+	}
+
+	if(!checkCompressedTextureSize(width, height, mipMapCount, path))
+		return false;
+
+	CompressedTexture myTexture;
+	myTexture.format = format;
+	myTexture.width = width;
+	myTexture.height = height;
+
+	// The levels follow each other, level 0 first.
+	size_t fileOffset = dataOffset;
+	for(uint32_t i = 0; i < mipMapCount; i++)
+	{
+		if(!addCompressedTextureLevel(myTexture, contents, fileOffset, i, path))
+			return false;
+		fileOffset += myTexture.levels.back().size;
+	}
+
+	outTexture = std::move(myTexture);
+	return true;
+}
+
+
+
+/**
+ * Loads a texture from a KTX2 or DDS file, choosing the loader from the file extension.
+ */
+bool loadCompressedTexture(const std::string & path, CompressedTexture & outTexture)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	if(extension == "ktx2")
+		return loadKTX2Texture(path, outTexture);
+
+	if(extension == "dds")
+		return loadDDSTexture(path, outTexture);
+
+	std::cout << "!!! ERROR: unknown texture container for file \"" << path << "\"." << std::endl;
+	return false;
+}
+
+
+
+/*
+ * CPU decompression.
+ * Each decoder writes a 4x4 block of RGBA8 texels, 16 bytes per row.
+ */
+void decodeBC1Block(const uint8_t * block, uint8_t * outTexels, const bool alwaysFourColors, const bool hasAlpha)
+{
+	const uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	const uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+	const uint32_t indices = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+
+	uint8_t colors[4][4];
+
+	// RGB565 to RGB888.
+	for(int i = 0; i < 2; i++) {
+		const uint16_t c = i ? c1 : c0;
+		const uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		colors[i][0] = (uint8_t)((r << 3) | (r >> 2));
+		colors[i][1] = (uint8_t)((g << 2) | (g >> 4));
+		colors[i][2] = (uint8_t)((b << 3) | (b >> 2));
+		colors[i][3] = 255;
+	}
+
+	for(int c = 0; c < 3; c++)
+	{
+		if(c0 > c1 || alwaysFourColors) {
+			colors[2][c] = (uint8_t)((2 * colors[0][c] + colors[1][c]) / 3);
+			colors[3][c] = (uint8_t)((colors[0][c] + 2 * colors[1][c]) / 3);
+		}
+		else {
+			colors[2][c] = (uint8_t)((colors[0][c] + colors[1][c]) / 2);
+			colors[3][c] = 0;
+		}
+	}
+
+	colors[2][3] = 255;
+	colors[3][3] = (c0 > c1 || alwaysFourColors || !hasAlpha) ? 255 : 0;
+
+	for(int i = 0; i < 16; i++)
+		memcpy(&outTexels[i * 4], colors[(indices >> (2 * i)) & 3], 4);
+}
+
+// BC4-style single channel block: 2 endpoints and 3-bit indices, written to outTexels[i*4 + channel].
+void decodeBC4Block(const uint8_t * block, uint8_t * outTexels, const int channel)
+{
+	const uint32_t a0 = block[0], a1 = block[1];
+	uint8_t values[8];
+
+	values[0] = (uint8_t)a0;
+	values[1] = (uint8_t)a1;
+
+	if(a0 > a1) {
+		for(uint32_t i = 1; i < 7; i++)
+			values[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1) / 7);
+	}
+	else {
+		for(uint32_t i = 1; i < 5; i++)
+			values[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1) / 5);
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	for(int i = 0; i < 6; i++)
+		indices |= (uint64_t)block[2 + i] << (8 * i);
+
+	for(int i = 0; i < 16; i++)
+		outTexels[i * 4 + channel] = values[(indices >> (3 * i)) & 7];
+}
+
+
+/*
+ * BC7 decoding tables: the partitions of the 4x4 block in 2 and 3 subsets (one bit, or two bits,
+ * per texel, texel 0 in the lowest bits), and the anchor texels of the second and third subset.
+ */
+static const uint16_t BC7_PARTITIONS_2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static const uint32_t BC7_PARTITIONS_3[64] = {
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+static const uint8_t BC7_ANCHORS_2[64] = {
+	15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+	15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+	 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+};
+
+static const uint8_t BC7_ANCHORS_3_SECOND[64] = {
+	 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+	 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+	 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+	 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+};
+
+static const uint8_t BC7_ANCHORS_3_THIRD[64] = {
+	15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+	15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+	15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+	15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+};
+
+static const uint8_t BC7_WEIGHTS_2[4] = {0, 21, 43, 64};
+static const uint8_t BC7_WEIGHTS_3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint8_t BC7_WEIGHTS_4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7ModeInfo
+{
+	uint8_t subsets, partitionBits, rotationBits, indexSelectionBits;
+	uint8_t colorBits, alphaBits, endpointPBits, sharedPBits;
+	uint8_t indexBits, secondaryIndexBits;
+};
+
+static const BC7ModeInfo BC7_MODES[8] = {
+	{3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+	{2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+	{3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+	{2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+	{1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+	{1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+	{1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+	{2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+struct BC7BitReader
+{
+	const uint8_t * data;
+	uint32_t position = 0;
+
+	uint32_t read(const uint32_t count) {
+		uint32_t value = 0;
+		for(uint32_t i = 0; i < count; i++, position++)
+			value |= (uint32_t)((data[position >> 3] >> (position & 7)) & 1) << i;
+		return value;
+	}
+};
+
+uint8_t bc7Interpolate(const uint32_t e0, const uint32_t e1, const uint32_t index, const uint32_t indexBits)
+{
+	const uint32_t w = (indexBits == 2) ? BC7_WEIGHTS_2[index] : (indexBits == 3) ? BC7_WEIGHTS_3[index] : BC7_WEIGHTS_4[index];
+	return (uint8_t)(((64 - w) * e0 + w * e1 + 32) >> 6);
+}
+
+void decodeBC7Block(const uint8_t * block, uint8_t * outTexels)
+{
+	int mode = 0;
+	while(mode < 8 && !(block[0] & (1 << mode)))
+		mode++;
+
+	if(mode == 8) {
+		// Reserved mode: the block decodes to transparent black.
+		memset(outTexels, 0, 64);
+		return;
+	}
+
+	const BC7ModeInfo & info = BC7_MODES[mode];
+	BC7BitReader reader{block};
+	reader.read(mode + 1);
+
+	const uint32_t partition = reader.read(info.partitionBits);
+	const uint32_t rotation = reader.read(info.rotationBits);
+	const uint32_t indexSelection = reader.read(info.indexSelectionBits);
+
+	// Endpoints: all the red components, then green, blue and alpha.
+	uint32_t endpoints[3][2][4];
+	for(uint32_t c = 0; c < 4; c++) {
+		const uint32_t bits = (c < 3) ? info.colorBits : info.alphaBits;
+		for(uint32_t s = 0; s < info.subsets; s++)
+			for(uint32_t e = 0; e < 2; e++)
+				endpoints[s][e][c] = reader.read(bits);
+	}
+
+	// P-bits: an extra low bit, per endpoint or shared by the endpoints of a subset.
+	uint32_t pBits[3][2] = {};
+	if(info.endpointPBits) {
+		for(uint32_t s = 0; s < info.subsets; s++)
+			for(uint32_t e = 0; e < 2; e++)
+				pBits[s][e] = reader.read(1);
+	}
+	else if(info.sharedPBits) {
+		for(uint32_t s = 0; s < info.subsets; s++)
+			pBits[s][0] = pBits[s][1] = reader.read(1);
+	}
+
+	const bool hasPBits = info.endpointPBits || info.sharedPBits;
+
+	for(uint32_t s = 0; s < info.subsets; s++) {
+		for(uint32_t e = 0; e < 2; e++) {
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t bits = (c < 3) ? info.colorBits : info.alphaBits;
+				if(bits == 0) {
+					endpoints[s][e][c] = 255;
+					continue;
+				}
+
+				uint32_t value = endpoints[s][e][c];
+				if(hasPBits) {
+					value = (value << 1) | pBits[s][e];
+					bits++;
+				}
+
+				// Expand to 8 bits, replicating the high bits in the low ones.
+				value <<= (8 - bits);
+				endpoints[s][e][c] = value | (value >> bits);
+			}
+		}
+	}
+
+	// Subset of each texel, and the anchor texels (whose index has an implicit high bit of 0).
+	uint32_t subsetOf[16];
+	uint32_t anchors[3] = {0, 0, 0};
+
+	for(uint32_t i = 0; i < 16; i++) {
+		if(info.subsets == 2)
+			subsetOf[i] = (BC7_PARTITIONS_2[partition] >> i) & 1;
+		else if(info.subsets == 3)
+			subsetOf[i] = (BC7_PARTITIONS_3[partition] >> (2 * i)) & 3;
+		else
+			subsetOf[i] = 0;
+	}
+
+	if(info.subsets == 2)
+		anchors[1] = BC7_ANCHORS_2[partition];
+	else if(info.subsets == 3) {
+		anchors[1] = BC7_ANCHORS_3_SECOND[partition];
+		anchors[2] = BC7_ANCHORS_3_THIRD[partition];
+	}
+
+	uint32_t indices[16], secondaryIndices[16] = {};
+
+	for(uint32_t i = 0; i < 16; i++) {
+		const bool isAnchor = (i == anchors[subsetOf[i]]);
+		indices[i] = reader.read(info.indexBits - (isAnchor ? 1 : 0));
+	}
+
+	if(info.secondaryIndexBits) {
+		for(uint32_t i = 0; i < 16; i++)
+			secondaryIndices[i] = reader.read(info.secondaryIndexBits - (i == 0 ? 1 : 0));
+	}
+
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		const uint32_t (&e)[2][4] = endpoints[subsetOf[i]];
+		uint8_t * texel = &outTexels[i * 4];
+
+		if(info.secondaryIndexBits == 0) {
+			for(uint32_t c = 0; c < 4; c++)
+				texel[c] = bc7Interpolate(e[0][c], e[1][c], indices[i], info.indexBits);
+		}
+		else {
+			// Modes 4 and 5: separate indices for color and alpha, swapped by the index selection bit.
+			const uint32_t colorIndex = indexSelection ? secondaryIndices[i] : indices[i];
+			const uint32_t colorBits = indexSelection ? info.secondaryIndexBits : info.indexBits;
+			const uint32_t alphaIndex = indexSelection ? indices[i] : secondaryIndices[i];
+			const uint32_t alphaBits = indexSelection ? info.indexBits : info.secondaryIndexBits;
+
+			for(uint32_t c = 0; c < 3; c++)
+				texel[c] = bc7Interpolate(e[0][c], e[1][c], colorIndex, colorBits);
+			texel[3] = bc7Interpolate(e[0][3], e[1][3], alphaIndex, alphaBits);
+		}
+
+		// Rotation: swap alpha with one of the color channels.
+		if(rotation > 0)
+			std::swap(texel[3], texel[rotation - 1]);
+	}
+}
+
+
+
+/**
+ * Decompresses a BC1/BC3/BC5/BC7 texture, all its levels, to R8G8B8A8 (UNORM or SRGB, like the source).
+ * BC5's two channels go to red and green, with blue at 0 and alpha at 255, like when the GPU samples it.
+ * @returns false if the format can't be decompressed (ASTC, or already uncompressed).
+ */
+bool decompressTexture(const CompressedTexture & theTexture, CompressedTexture & outTexture)
+{
+	const VkFormat format = theTexture.format;
+
+	switch(format)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			break;
+		default:
+			std::cout << "!!! ERROR: no CPU decompressor for VkFormat " << format << "." << std::endl;
+			return false;
+	}
+
+	uint32_t blockWidth, blockHeight, blockSize;
+	getTextureFormatBlockInfo(format, blockWidth, blockHeight, blockSize);
+
+	CompressedTexture myTexture;
+	myTexture.format = isSrgbTextureFormat(format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	myTexture.width = theTexture.width;
+	myTexture.height = theTexture.height;
+
+	for(const CompressedTextureLevel & sourceLevel : theTexture.levels)
+	{
+		CompressedTextureLevel level;
+		level.width = sourceLevel.width;
+		level.height = sourceLevel.height;
+		level.offset = (myTexture.data.size() + 15) / 16 * 16;
+		level.size = (VkDeviceSize)level.width * level.height * 4;
+
+		myTexture.data.resize(level.offset + level.size);
+		uint8_t * dst = &myTexture.data[level.offset];
+
+		const uint32_t blocksX = (level.width + 3) / 4;
+		const uint32_t blocksY = (level.height + 3) / 4;
+
+		for(uint32_t by = 0; by < blocksY; by++) {
+			for(uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				const uint8_t * block = &theTexture.data[sourceLevel.offset + ((VkDeviceSize)by * blocksX + bx) * blockSize];
+				uint8_t texels[64];
+
+				switch(format)
+				{
+					case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+					case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+						decodeBC1Block(block, texels, false, false);
+						break;
+					case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+					case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+						decodeBC1Block(block, texels, false, true);
+						break;
+					case VK_FORMAT_BC3_UNORM_BLOCK:
+					case VK_FORMAT_BC3_SRGB_BLOCK:
+						decodeBC1Block(block + 8, texels, true, false);
+						decodeBC4Block(block, texels, 3);
+						break;
+					case VK_FORMAT_BC5_UNORM_BLOCK:
+						decodeBC4Block(block, texels, 0);
+						decodeBC4Block(block + 8, texels, 1);
+						for(int i = 0; i < 16; i++) {
+							texels[i * 4 + 2] = 0;
+							texels[i * 4 + 3] = 255;
+						}
+						break;
+					default:
+						decodeBC7Block(block, texels);
+						break;
+				}
+
+				// Copy the texels inside the level (the blocks at the edges may stick out).
+				for(uint32_t y = 0; y < 4 && by * 4 + y < level.height; y++) {
+					const uint32_t columns = std::min(4u, level.width - bx * 4);
+					memcpy(&dst[((VkDeviceSize)(by * 4 + y) * level.width + bx * 4) * 4], &texels[y * 16], columns * 4);
+				}
+			}
+		}
+
+		myTexture.levels.push_back(level);
+	}
+
+	outTexture = std::move(myTexture);
+	return true;
+}
+
+
+
+/**
+ * Records the upload of the levels of a texture, stored in theData at the offsets in theLevels,
+ * to theImage (created with theFormat, and as many levels), through the staging ring:
+ * one allocation and one copy per level, so that a texture bigger than the ring can be
+ * uploaded as long as each level fits.
+ * All the levels end up in finalLayout, available to dstStageMask/dstAccessMask.
+ */
+bool stageTextureLevels(StagingRing & theRing,
+                        UploadEngine & theEngine,
+                        const VkFormat theFormat,
+                        const std::vector<CompressedTextureLevel> & theLevels,
+                        const uint8_t * theData,
+                        const VkImage theImage,
+                        const VkImageLayout finalLayout,
+                        const VkPipelineStageFlags dstStageMask,
+                        const VkAccessFlags dstAccessMask)
+{
+	uint32_t blockWidth, blockHeight, blockSize;
+	if(!getTextureFormatBlockInfo(theFormat, blockWidth, blockHeight, blockSize))
+		return false;
+
+	// bufferOffset must be a multiple of the block size; both are powers of two.
+	const VkDeviceSize alignment = std::max<VkDeviceSize>(theRing.imageCopyAlignment, blockSize);
+
+	for(uint32_t i = 0; i < theLevels.size(); i++)
+	{
+		const CompressedTextureLevel & level = theLevels[i];
+
+		StagingAllocation myAllocation;
+		if(!allocateStagingMemory(theRing, theEngine, level.size, alignment, myAllocation))
+			return false;
+
+		memcpy(myAllocation.pointer, theData + level.offset, level.size);
+
+		// The extent is in texels, not blocks; the partial blocks at the edges are copied whole.
+		const VkBufferImageCopy region = {
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {level.width, level.height, 1},
+		};
+
+		stageImageCopy(theRing, theEngine, myAllocation, theImage, {region}, {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1}, finalLayout, dstStageMask, dstAccessMask);
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Records the upload of all the levels of a texture to theImage; see stageTextureLevels.
+ */
+bool stageCompressedTexture(StagingRing & theRing,
+                            UploadEngine & theEngine,
+                            const CompressedTexture & theTexture,
+                            const VkImage theImage,
+                            const VkImageLayout finalLayout,
+                            const VkPipelineStageFlags dstStageMask,
+                            const VkAccessFlags dstAccessMask)
+{
+	return stageTextureLevels(theRing, theEngine, theTexture.format, theTexture.levels, theTexture.data.data(), theImage, finalLayout, dstStageMask, dstAccessMask);
+}
+
+}	// vkdemos
+
+#endif
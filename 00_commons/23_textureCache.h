@@ -0,0 +1,378 @@
+#ifndef VKDEMOS_TEXTURECACHE_H
+#define VKDEMOS_TEXTURECACHE_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "11_loadimagefromfile.h"
+#include "18_stagingRing.h"
+#include "20_threadPool.h"
+#include "21_cpuMipmaps.h"
+#include "22_compressedTextures.h"
+
+namespace vkdemos {
+
+/*
+ * Preprocessed texture cache.
+ *
+ * Decoding a PNG and filtering its mip chain takes far longer than reading the result
+ * back from disk: so the first time a texture is loaded, its GPU-ready data (every level,
+ * already in the final VkFormat) is written to a cache file next to the source
+ * ("texture.png" -> "texture.png.vkcache"). The following runs map the cache file in
+ * memory and copy each level straight into the staging ring: no decode, no conversion,
+ * no intermediate buffer; the OS pages the data in while it's being copied.
+ *
+ * The cache file has a fixed-size header followed by the levels:
+ *
+ *     offset 0:   TextureCacheFileHeader (magic, version, hash, format, size, level table)
+ *     offset N:   level 0, level 1, ...  (16-byte aligned, tightly-packed rows)
+ *
+ * The header stores a hash of the source file's contents and of the processing options;
+ * if the source or the options change, the hash doesn't match and the cache file is
+ * regenerated. Hashing reads the source file, which is still much cheaper than decoding it.
+ */
+
+static constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x43544B56;    // "VKTC" in a little-endian file.
+static constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+static constexpr uint32_t TEXTURE_CACHE_MAX_LEVELS = 16;       // enough for a 32768x32768 texture.
+static constexpr VkDeviceSize TEXTURE_CACHE_ALIGNMENT = 16;
+
+struct TextureCacheFileLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;    // from the start of the file.
+	uint64_t size;
+};
+
+struct TextureCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t contentHash;       // of the source file and of the options used to process it.
+	uint64_t fileSize;          // to detect truncated files.
+	uint32_t format;            // VkFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	TextureCacheFileLevel levels[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+struct TextureCacheOptions
+{
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;         // RGBA8 or BGRA8; _SRGB formats are filtered in linear light.
+	uint32_t levelCount = 0;                            // 0 for a full mip chain.
+	CpuImageFilter filter = CPU_IMAGE_FILTER_KAISER;
+};
+
+struct MappedFile
+{
+	void * data = nullptr;
+	size_t size = 0;
+};
+
+struct CachedTexture
+{
+	MappedFile file;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<CompressedTextureLevel> levels;     // offsets from the start of the mapped file.
+};
+
+
+
+/**
+ * Maps a whole file in memory, read-only.
+ */
+bool mapFile(const std::string & path, MappedFile & outMappedFile)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void * data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);  // The mapping keeps the file open.
+
+	if(data == MAP_FAILED) {
+		std::cout << "!!! ERROR: couldn't map file \"" << path << "\": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// The whole file is going to be read sequentially: ask the OS to start reading it now.
+	madvise(data, (size_t)fileStat.st_size, MADV_WILLNEED);
+
+	outMappedFile.data = data;
+	outMappedFile.size = (size_t)fileStat.st_size;
+	return true;
+}
+
+
+
+/**
+ * Unmaps a file mapped by mapFile.
+ */
+void unmapFile(MappedFile & theMappedFile)
+{
+	if(theMappedFile.data != nullptr)
+		munmap(theMappedFile.data, theMappedFile.size);
+
+	theMappedFile = MappedFile{};
+}
+
+
+
+/**
+ * 64-bit FNV-1a hash, 8 bytes per step instead of one: not the standard FNV values,
+ * but good enough to detect changes, and 8 times faster on large files.
+ */
+uint64_t hashBytes(const void * theData, const size_t theSize, uint64_t hash = 0xCBF29CE484222325ull)
+{
+	const uint64_t prime = 0x100000001B3ull;
+	const uint8_t * bytes = (const uint8_t*)theData;
+	size_t i = 0;
+
+	for(; i + 8 <= theSize; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * prime;
+	}
+
+	for(; i < theSize; i++)
+		hash = (hash ^ bytes[i]) * prime;
+
+	return hash;
+}
+
+
+
+/**
+ * Returns the hash identifying the cache file of a source file's contents processed with theOptions.
+ */
+uint64_t computeTextureCacheHash(const void * sourceData, const size_t sourceSize, const TextureCacheOptions & theOptions)
+{
+	const uint32_t optionValues[4] = {TEXTURE_CACHE_VERSION, (uint32_t)theOptions.format, theOptions.levelCount, (uint32_t)theOptions.filter};
+
+	uint64_t hash = hashBytes(sourceData, sourceSize);
+	return hashBytes(optionValues, sizeof(optionValues), hash);
+}
+
+
+
+/**
+ * Returns the path of the cache file of an image file.
+ */
+std::string getTextureCachePath(const std::string & sourcePath)
+{
+	return sourcePath + ".vkcache";
+}
+
+
+
+/**
+ * Maps a cache file, and checks that it's complete and matches the expected hash and options.
+ * @returns false if the file doesn't exist or is stale; outTexture is left empty.
+ */
+bool openTextureCacheFile(const std::string & cachePath, const uint64_t expectedHash, const TextureCacheOptions & theOptions, CachedTexture & outTexture)
+{
+	MappedFile myFile;
+	if(!mapFile(cachePath, myFile))
+		return false;
+
+	bool valid = (myFile.size >= sizeof(TextureCacheFileHeader));
+	TextureCacheFileHeader header;
+
+	if(valid) {
+		memcpy(&header, myFile.data, sizeof(header));
+		valid = header.magic == TEXTURE_CACHE_MAGIC
+		        && header.version == TEXTURE_CACHE_VERSION
+		        && header.contentHash == expectedHash
+		        && header.fileSize == myFile.size
+		        && header.format == (uint32_t)theOptions.format
+		        && header.levelCount > 0 && header.levelCount <= TEXTURE_CACHE_MAX_LEVELS;
+	}
+
+	for(uint32_t i = 0; valid && i < header.levelCount; i++) {
+		const TextureCacheFileLevel & level = header.levels[i];
+		valid = (level.offset % TEXTURE_CACHE_ALIGNMENT == 0)
+		        && level.size == (uint64_t)level.width * level.height * CPU_IMAGE_PIXEL_SIZE
+		        && level.offset + level.size <= myFile.size;
+	}
+
+	if(!valid) {
+		unmapFile(myFile);
+		return false;
+	}
+
+	outTexture.file = myFile;
+	outTexture.format = (VkFormat)header.format;
+	outTexture.width = header.width;
+	outTexture.height = header.height;
+	outTexture.levels.clear();
+
+	for(uint32_t i = 0; i < header.levelCount; i++)
+		outTexture.levels.push_back({header.levels[i].width, header.levels[i].height, header.levels[i].offset, header.levels[i].size});
+
+	return true;
+}
+
+
+
+/**
+ * Decodes an image file, generates its mip chain on the CPU, and writes the result to a cache file.
+ * The file is written under a temporary name and then renamed, so that an interrupted write
+ * never leaves a valid-looking cache file behind.
+ */
+bool writeTextureCacheFile(ThreadPool * thePool,
+                           const std::string & sourcePath,
+                           const std::string & cachePath,
+                           const uint64_t contentHash,
+                           const TextureCacheOptions & theOptions)
+{
+	ImageFile myImageFile;
+	if(!openImageFile(sourcePath, myImageFile))
+		return false;
+
+	CpuMipChainLayout myLayout;
+	computeCpuMipChainLayout(myImageFile.width, myImageFile.height, theOptions.levelCount, TEXTURE_CACHE_ALIGNMENT, myLayout);
+
+	if(myLayout.levels.size() > TEXTURE_CACHE_MAX_LEVELS) {
+		std::cout << "!!! ERROR: image \"" << sourcePath << "\" is too big for the texture cache." << std::endl;
+		closeImageFile(myImageFile);
+		return false;
+	}
+
+	std::vector<uint8_t> myLevel0Pixels(myLayout.levels[0].size);
+	if(!readImagePixels(myImageFile, myLevel0Pixels.data(), myImageFile.width * CPU_IMAGE_PIXEL_SIZE, theOptions.format))
+		return false;
+
+	const VkDeviceSize dataOffset = (sizeof(TextureCacheFileHeader) + TEXTURE_CACHE_ALIGNMENT - 1) / TEXTURE_CACHE_ALIGNMENT * TEXTURE_CACHE_ALIGNMENT;
+	std::vector<uint8_t> myFileContents(dataOffset + myLayout.totalSize, 0);
+
+	CpuImageProcessingOptions myMipmapOptions;
+	myMipmapOptions.filter = theOptions.filter;
+	myMipmapOptions.srgb = isSrgbTextureFormat(theOptions.format);
+
+	generateCpuMipChain(thePool, myLevel0Pixels.data(), myLayout, myFileContents.data() + dataOffset, myMipmapOptions);
+
+	TextureCacheFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.contentHash = contentHash;
+	header.fileSize = myFileContents.size();
+	header.format = (uint32_t)theOptions.format;
+	header.width = myLayout.levels[0].width;
+	header.height = myLayout.levels[0].height;
+	header.levelCount = (uint32_t)myLayout.levels.size();
+
+	for(uint32_t i = 0; i < header.levelCount; i++)
+		header.levels[i] = {myLayout.levels[i].width, myLayout.levels[i].height, dataOffset + myLayout.levels[i].offset, myLayout.levels[i].size};
+
+	memcpy(myFileContents.data(), &header, sizeof(header));
+
+	const std::string temporaryPath = cachePath + ".tmp";
+	{
+		std::ofstream outFile(temporaryPath, std::ios_base::binary | std::ios_base::trunc);
+		if(!outFile || !outFile.write((const char*)myFileContents.data(), myFileContents.size())) {
+			std::cout << "~~~ WARNING: couldn't write texture cache file \"" << temporaryPath << "\"." << std::endl;
+			return false;
+		}
+	}
+
+	if(std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+		std::cout << "~~~ WARNING: couldn't rename texture cache file \"" << temporaryPath << "\"." << std::endl;
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Loads an image file through its cache file: hashes the source, maps the cache file if
+ * it's up to date, and otherwise regenerates it first (decoding the image and computing
+ * its mip chain on thePool).
+ * The texture stays mapped until closeCachedTexture.
+ */
+bool loadCachedTexture(ThreadPool * thePool, const std::string & sourcePath, const TextureCacheOptions & theOptions, CachedTexture & outTexture)
+{
+	MappedFile mySourceFile;
+	if(!mapFile(sourcePath, mySourceFile)) {
+		std::cout << "!!! ERROR: couldn't open image \"" << sourcePath << "\"." << std::endl;
+		return false;
+	}
+
+	const uint64_t myHash = computeTextureCacheHash(mySourceFile.data, mySourceFile.size, theOptions);
+	unmapFile(mySourceFile);
+
+	const std::string myCachePath = getTextureCachePath(sourcePath);
+
+	if(openTextureCacheFile(myCachePath, myHash, theOptions, outTexture))
+		return true;
+
+	std::cout << "--- Texture cache \"" << myCachePath << "\" missing or out of date, regenerating it." << std::endl;
+
+	if(!writeTextureCacheFile(thePool, sourcePath, myCachePath, myHash, theOptions))
+		return false;
+
+	if(!openTextureCacheFile(myCachePath, myHash, theOptions, outTexture)) {
+		std::cout << "!!! ERROR: couldn't read back texture cache file \"" << myCachePath << "\"." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Unmaps a cached texture. Its data must not be used anymore: do it after the copies
+ * to the staging ring are recorded (the ring has its own copy of the data).
+ */
+void closeCachedTexture(CachedTexture & theTexture)
+{
+	unmapFile(theTexture.file);
+	theTexture = CachedTexture{};
+}
+
+
+
+/**
+ * Records the upload of all the levels of a cached texture to theImage, copying them
+ * from the mapped file to the staging ring; see stageTextureLevels.
+ */
+bool stageCachedTexture(StagingRing & theRing,
+                        UploadEngine & theEngine,
+                        const CachedTexture & theTexture,
+                        const VkImage theImage,
+                        const VkImageLayout finalLayout,
+                        const VkPipelineStageFlags dstStageMask,
+                        const VkAccessFlags dstAccessMask)
+{
+	return stageTextureLevels(theRing, theEngine, theTexture.format, theTexture.levels, (const uint8_t*)theTexture.file.data, theImage, finalLayout, dstStageMask, dstAccessMask);
+}
+
+}	// vkdemos
+
+#endif
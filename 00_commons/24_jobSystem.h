@@ -0,0 +1,368 @@
+#ifndef VKDEMOS_JOBSYSTEM_H
+#define VKDEMOS_JOBSYSTEM_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace vkdemos {
+
+/*
+ * A work-stealing job system.
+ *
+ * Unlike the ThreadPool of 20_threadPool.h, where every task goes through a single queue,
+ * each worker thread has its own deque of jobs: a worker pushes the jobs it creates to the
+ * back of its deque and takes its next job from the back too (the most recent job, whose
+ * data is still in the cache), while idle workers steal the oldest jobs from the front of
+ * the other deques. Threads that aren't workers (the main thread) share one more deque.
+ * With many small jobs, the workers rarely touch the same deque at the same time.
+ *
+ * Jobs can depend on other jobs: a job becomes runnable only when all its dependencies
+ * have completed, so a chain like "read file -> decode -> generate mips" doesn't need
+ * anybody waiting in between.
+ *
+ * Every job belongs to a JobGroup, and waitJobGroup waits for all the jobs of a group
+ * while executing jobs itself (of any group); so unlike with the ThreadPool, a job can
+ * wait for a group of jobs it created. The Job pointers of a group stay valid until the
+ * group is waited for.
+ */
+struct JobGroup;
+
+struct Job
+{
+	std::function<void()> function;
+	JobGroup * group = nullptr;
+
+	std::mutex mutex;                           // protects finished and dependents.
+	bool finished = false;
+	std::vector<Job*> dependents;               // jobs to release when this one completes.
+	std::atomic<uint32_t> pendingCount{1};      // unfinished dependencies, plus one until the job is submitted.
+};
+
+struct JobGroup
+{
+	std::mutex mutex;
+	std::deque<Job> jobs;                       // a deque never moves its elements: Job pointers stay valid.
+	std::atomic<size_t> unfinishedJobs{0};
+};
+
+struct JobQueue
+{
+	std::mutex mutex;
+	std::deque<Job*> jobs;
+};
+
+struct JobSystem
+{
+	std::vector<std::thread> workers;
+	std::unique_ptr<JobQueue[]> queues;         // one per worker, and the last one for the other threads.
+	size_t queueCount = 0;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;             // a job was queued, a group completed, or the system is stopping.
+	std::atomic<size_t> queuedJobs{0};
+	std::atomic<bool> stopping{false};
+
+	// Statistics.
+	std::atomic<uint64_t> executedJobs{0};
+	std::atomic<uint64_t> stolenJobs{0};
+};
+
+
+
+/*
+ * The queue of the calling thread: its own if it's a worker of theSystem, the shared one otherwise.
+ */
+struct JobWorkerContext
+{
+	const JobSystem * system;
+	size_t queueIndex;
+};
+
+JobWorkerContext & getJobWorkerContext()
+{
+	static thread_local JobWorkerContext context = {nullptr, 0};
+	return context;
+}
+
+size_t getLocalJobQueueIndex(const JobSystem & theSystem)
+{
+	const JobWorkerContext & context = getJobWorkerContext();
+	return (context.system == &theSystem) ? context.queueIndex : theSystem.queueCount - 1;
+}
+
+
+
+/*
+ * Makes a job runnable, queueing it on the calling thread's deque.
+ */
+void pushJob(JobSystem & theSystem, Job * theJob)
+{
+	JobQueue & queue = theSystem.queues[getLocalJobQueueIndex(theSystem)];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(theJob);
+	}
+
+	theSystem.queuedJobs++;
+
+	// Taking the mutex makes sure a thread that just found nothing to do is already waiting.
+	{
+		std::lock_guard<std::mutex> lock(theSystem.sleepMutex);
+	}
+	theSystem.wakeUp.notify_one();
+}
+
+
+
+/*
+ * Takes the most recent job of the calling thread's deque, or else steals the oldest job of another one.
+ */
+Job * popJob(JobSystem & theSystem)
+{
+	const size_t localIndex = getLocalJobQueueIndex(theSystem);
+
+	for(size_t i = 0; i < theSystem.queueCount; i++)
+	{
+		JobQueue & queue = theSystem.queues[(localIndex + i) % theSystem.queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if(queue.jobs.empty())
+			continue;
+
+		Job * job;
+		if(i == 0) {
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else {
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+			theSystem.stolenJobs++;
+		}
+
+		theSystem.queuedJobs--;
+		return job;
+	}
+
+	return nullptr;
+}
+
+
+
+/*
+ * Runs a job, releases the jobs that depend on it, and updates its group.
+ */
+void executeJob(JobSystem & theSystem, Job * theJob)
+{
+	theJob->function();
+	theSystem.executedJobs++;
+
+	std::vector<Job*> dependents;
+	{
+		std::lock_guard<std::mutex> lock(theJob->mutex);
+		theJob->finished = true;
+		dependents.swap(theJob->dependents);
+	}
+
+	for(Job * dependent : dependents)
+		if(--dependent->pendingCount == 0)
+			pushJob(theSystem, dependent);
+
+	// The group (and the job) can be freed as soon as the counter reaches zero: don't touch them afterwards.
+	if(--theJob->group->unfinishedJobs == 0) {
+		std::lock_guard<std::mutex> lock(theSystem.sleepMutex);
+		theSystem.wakeUp.notify_all();
+	}
+}
+
+
+
+/**
+ * Worker thread loop: runs jobs until the system is destroyed.
+ */
+void jobSystemWorker(JobSystem & theSystem, const size_t queueIndex)
+{
+	getJobWorkerContext() = {&theSystem, queueIndex};
+
+	while(!theSystem.stopping)
+	{
+		Job * job = popJob(theSystem);
+
+		if(job != nullptr) {
+			executeJob(theSystem, job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(theSystem.sleepMutex);
+		theSystem.wakeUp.wait(lock, [&theSystem]{ return theSystem.stopping || theSystem.queuedJobs > 0; });
+	}
+}
+
+
+
+/**
+ * Starts the worker threads of a job system.
+ * @param threadCount number of workers; 0 means one less than the hardware threads
+ *        (the threads waiting for jobs work too).
+ */
+void initJobSystem(JobSystem & theSystem, size_t threadCount = 0)
+{
+	if(threadCount == 0)
+		threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+	theSystem.queueCount = threadCount + 1;
+	theSystem.queues.reset(new JobQueue[theSystem.queueCount]);
+	theSystem.queuedJobs = 0;
+	theSystem.stopping = false;
+
+	for(size_t i = 0; i < threadCount; i++)
+		theSystem.workers.emplace_back(jobSystemWorker, std::ref(theSystem), i);
+}
+
+
+
+/**
+ * Returns how many threads can execute jobs at the same time (the workers and one waiting thread).
+ */
+size_t getJobSystemConcurrency(const JobSystem & theSystem)
+{
+	return theSystem.workers.size() + 1;
+}
+
+
+
+/**
+ * Creates a job in theGroup, without submitting it: dependencies can be added
+ * with addJobDependency until submitJob is called.
+ */
+Job * createJob(JobGroup & theGroup, std::function<void()> theFunction)
+{
+	std::lock_guard<std::mutex> lock(theGroup.mutex);
+
+	theGroup.jobs.emplace_back();
+	Job * job = &theGroup.jobs.back();
+	job->function = std::move(theFunction);
+	job->group = &theGroup;
+
+	theGroup.unfinishedJobs++;
+	return job;
+}
+
+
+
+/**
+ * Makes theJob wait for theDependency to complete. Must be called before theJob is submitted;
+ * theDependency can be submitted or even completed already.
+ */
+void addJobDependency(Job * theJob, Job * theDependency)
+{
+	std::lock_guard<std::mutex> lock(theDependency->mutex);
+
+	if(!theDependency->finished) {
+		theDependency->dependents.push_back(theJob);
+		theJob->pendingCount++;
+	}
+}
+
+
+
+/**
+ * Submits a job: it runs as soon as all its dependencies have completed.
+ */
+void submitJob(JobSystem & theSystem, Job * theJob)
+{
+	if(--theJob->pendingCount == 0)
+		pushJob(theSystem, theJob);
+}
+
+
+
+/**
+ * Creates and submits a job in one go.
+ */
+Job * scheduleJob(JobSystem & theSystem, JobGroup & theGroup, std::function<void()> theFunction, std::initializer_list<Job*> theDependencies = {})
+{
+	Job * job = createJob(theGroup, std::move(theFunction));
+
+	for(Job * dependency : theDependencies)
+		if(dependency != nullptr)
+			addJobDependency(job, dependency);
+
+	submitJob(theSystem, job);
+	return job;
+}
+
+
+
+/**
+ * Waits for all the jobs of a group (including the ones created while waiting), executing
+ * queued jobs in the meantime; then frees the group's jobs, so the group can be reused.
+ * Can be called from inside a job.
+ */
+void waitJobGroup(JobSystem & theSystem, JobGroup & theGroup)
+{
+	while(theGroup.unfinishedJobs > 0)
+	{
+		Job * job = popJob(theSystem);
+
+		if(job != nullptr) {
+			executeJob(theSystem, job);
+			continue;
+		}
+
+		// Nothing to do: the remaining jobs are running on other threads, or waiting for dependencies.
+		std::unique_lock<std::mutex> lock(theSystem.sleepMutex);
+		theSystem.wakeUp.wait(lock, [&theSystem, &theGroup]{ return theGroup.unfinishedJobs == 0 || theSystem.queuedJobs > 0; });
+	}
+
+	std::lock_guard<std::mutex> lock(theGroup.mutex);
+	theGroup.jobs.clear();
+}
+
+
+
+/**
+ * Prints the number of jobs executed, and how many of them were stolen from another thread's deque.
+ */
+void printJobSystemStatistics(const JobSystem & theSystem)
+{
+	std::cout << "--- Job system: " << getJobSystemConcurrency(theSystem) << " threads, "
+	          << theSystem.executedJobs << " jobs executed, " << theSystem.stolenJobs << " stolen." << std::endl;
+}
+
+
+
+/**
+ * Stops and joins the worker threads. All the groups must have been waited for.
+ */
+void destroyJobSystem(JobSystem & theSystem)
+{
+	{
+		std::lock_guard<std::mutex> lock(theSystem.sleepMutex);
+		theSystem.stopping = true;
+	}
+
+	theSystem.wakeUp.notify_all();
+
+	for(auto & worker : theSystem.workers)
+		worker.join();
+
+	theSystem.workers.clear();
+	theSystem.queues.reset();
+	theSystem.queueCount = 0;
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,481 @@
+#ifndef VKDEMOS_TEXTURESTREAMING_H
+#define VKDEMOS_TEXTURESTREAMING_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "08_createAndAllocateImage.h"
+#include "12_memoryAllocator.h"
+#include "17_uploadEngine.h"
+#include "18_stagingRing.h"
+#include "22_compressedTextures.h"
+
+namespace vkdemos {
+
+/*
+ * Progressive texture streaming with a device memory budget.
+ *
+ * A streamed texture starts with only its smallest levels resident on the device
+ * (the "mip tail", up to STREAMING_INITIAL_LEVEL_SIZE texels per side): they're tiny, so
+ * the texture can be uploaded and rendered right away. Then, once per frame,
+ * updateTextureStreaming adds one level at a time on top of the resident ones, uploading
+ * it in the background through the staging ring, until the whole chain is resident.
+ *
+ * Vulkan 1.0 has no sparse-free way to resize an image's memory, so each residency change
+ * creates a new image with the new set of levels and uploads all of them (the levels below
+ * the new one add only a third of its size); the new image replaces the old one when its
+ * upload completes, and the old image is destroyed when the frames using it are done.
+ * The texture's view changes at that point: the application must update its descriptors
+ * when StreamedTexture::version changes (each frame in flight has its own descriptor set).
+ *
+ * A new level is faded in instead of popping: minLod starts at 1.0 (the previous top
+ * level) and goes down to 0 in STREAMING_FADE_FRAMES frames; the shader clamps the level
+ * of detail it samples with to it.
+ *
+ * The memory of all the texture images (resident, being uploaded, or waiting to be
+ * destroyed) is kept under a budget: when a new level doesn't fit, the textures that
+ * haven't been used for the longest time (see markStreamedTextureUsed) lose their top level,
+ * down to the mip tail.
+ *
+ * The source data of every level stays in host memory (a mapped texture cache file,
+ * or a CompressedTexture) while the texture exists, since evicted levels may be reloaded.
+ */
+
+static constexpr uint32_t STREAMING_INITIAL_LEVEL_SIZE = 64;   // levels up to 64x64 are always resident.
+static constexpr uint32_t STREAMING_FADE_FRAMES = 30;
+static constexpr uint64_t STREAMING_EVICTION_FRAMES = 60;      // textures used more recently than this are never evicted.
+
+struct StreamedTexture
+{
+	// Source data of all the levels (level 0 is the largest), owned by the caller.
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::vector<CompressedTextureLevel> levels;
+	const uint8_t * data = nullptr;
+
+	// The image in use: level i of the image is level residentLevel + i of the texture.
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+	uint32_t residentLevel = 0;
+	uint32_t version = 0;               // incremented every time image and view change.
+
+	// The image being uploaded to replace the one in use, if any.
+	VkImage pendingImage = VK_NULL_HANDLE;
+	VkImageView pendingView = VK_NULL_HANDLE;
+	MemoryAllocation pendingMemory;
+	uint32_t pendingLevel = 0;
+	UploadHandle pendingUpload;
+
+	float minLod = 0.0f;                // level-of-detail clamp, relative to the image in use.
+	uint64_t lastUsedFrame = 0;
+	uint32_t initialLevel = 0;          // first level of the mip tail.
+};
+
+struct TextureStreamer
+{
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks * pAllocator = nullptr;
+	MemoryAllocator * allocator = nullptr;
+	StagingRing * ring = nullptr;
+	UploadEngine * engine = nullptr;
+
+	VkDeviceSize budget = 0;
+	VkDeviceSize usedBytes = 0;         // memory of all the live images, including the retired ones.
+	VkDeviceSize maxUploadBytesPerFrame = 0;
+	uint32_t retireFrames = 0;
+	uint64_t frameNumber = 0;
+
+	std::vector<StreamedTexture*> textures;
+
+	struct RetiredImage
+	{
+		VkImage image;
+		VkImageView view;
+		MemoryAllocation memory;
+		uint64_t frameNumber;           // when it was last used.
+	};
+	std::deque<RetiredImage> retiredImages;
+
+	// Statistics.
+	uint64_t streamedLevels = 0;
+	uint64_t evictedLevels = 0;
+	uint64_t budgetStalls = 0;
+};
+
+
+
+/**
+ * Creates a texture streamer.
+ * @param theBudget maximum device memory used by the streamed textures' images.
+ * @param framesInFlight number of frames that can use an image after it's been replaced.
+ */
+void createTextureStreamer(const VkDevice theDevice,
+                           MemoryAllocator & theAllocator,
+                           StagingRing & theRing,
+                           UploadEngine & theEngine,
+                           const VkDeviceSize theBudget,
+                           const uint32_t framesInFlight,
+                           TextureStreamer & outStreamer,
+                           const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	outStreamer.device = theDevice;
+	outStreamer.pAllocator = pAllocator;
+	outStreamer.allocator = &theAllocator;
+	outStreamer.ring = &theRing;
+	outStreamer.engine = &theEngine;
+	outStreamer.budget = theBudget;
+	outStreamer.maxUploadBytesPerFrame = theRing.size / 4;  // leave room in the ring for the other uploads.
+	outStreamer.retireFrames = framesInFlight + 1;
+}
+
+
+
+/*
+ * Creates an image with the levels [firstLevel, end) of a texture, and records their upload.
+ * The copies are submitted with the next flush of the staging ring.
+ */
+bool createStreamedTextureImage(TextureStreamer & theStreamer,
+                                const StreamedTexture & theTexture,
+                                const uint32_t firstLevel,
+                                VkImage & outImage,
+                                VkImageView & outView,
+                                MemoryAllocation & outMemory)
+{
+	bool boolResult;
+
+	const CompressedTextureLevel & topLevel = theTexture.levels[firstLevel];
+	const std::vector<CompressedTextureLevel> myLevels(theTexture.levels.begin() + firstLevel, theTexture.levels.end());
+
+	boolResult = createAndAllocateImage(
+	                 theStreamer.device,
+	                 *theStreamer.allocator,
+	                 VK_IMAGE_USAGE_SAMPLED_BIT,
+	                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                 theTexture.format,
+	                 topLevel.width,
+	                 topLevel.height,
+	                 outImage,
+	                 outMemory,
+	                 &outView,
+	                 VK_IMAGE_ASPECT_COLOR_BIT,
+	                 VKDEMOS_ALLOCATION_SITE("streamed texture"),
+	                 vkdemos::utils::MEMORY_USAGE_GPU_ONLY,
+	                 theStreamer.pAllocator,
+	                 (uint32_t)myLevels.size()
+	             );
+
+	if(!boolResult) {
+		std::cout << "!!! ERROR: couldn't create the image of a streamed texture." << std::endl;
+		return false;
+	}
+
+	theStreamer.usedBytes += outMemory.size;
+
+	boolResult = stageTextureLevels(*theStreamer.ring, *theStreamer.engine, theTexture.format, myLevels, theTexture.data, outImage,
+	                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	/*
+	 * The staging only fails for a format it can't copy, or a level bigger than the whole ring;
+	 * since the levels go from the largest to the smallest, no copy to the image has been recorded
+	 * yet, and it can be destroyed right away.
+	 */
+	if(!boolResult) {
+		std::cout << "!!! ERROR: couldn't stage the levels of a streamed texture." << std::endl;
+		vkDestroyImageView(theStreamer.device, outView, theStreamer.pAllocator);
+		vkDestroyImage(theStreamer.device, outImage, theStreamer.pAllocator);
+		theStreamer.usedBytes -= outMemory.size;
+		freeMemoryToAllocator(*theStreamer.allocator, outMemory);
+		outImage = VK_NULL_HANDLE;
+		outView = VK_NULL_HANDLE;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/*
+ * Queues an image for destruction once the frames that may use it are done.
+ */
+void retireStreamedTextureImage(TextureStreamer & theStreamer, const VkImage theImage, const VkImageView theView, const MemoryAllocation & theMemory)
+{
+	theStreamer.retiredImages.push_back({theImage, theView, theMemory, theStreamer.frameNumber});
+}
+
+
+
+/**
+ * Creates a streamed texture, and records the upload of its mip tail.
+ * The levels' data must stay valid until destroyStreamedTexture.
+ */
+bool createStreamedTexture(TextureStreamer & theStreamer,
+                           const VkFormat theFormat,
+                           const std::vector<CompressedTextureLevel> & theLevels,
+                           const uint8_t * theData,
+                           StreamedTexture & outTexture)
+{
+	outTexture.format = theFormat;
+	outTexture.levels = theLevels;
+	outTexture.data = theData;
+
+	// The first level of the tail: the largest one that fits in STREAMING_INITIAL_LEVEL_SIZE.
+	uint32_t myInitialLevel = 0;
+	while(myInitialLevel + 1 < theLevels.size()
+	      && std::max(theLevels[myInitialLevel].width, theLevels[myInitialLevel].height) > STREAMING_INITIAL_LEVEL_SIZE)
+		myInitialLevel++;
+
+	if(!createStreamedTextureImage(theStreamer, outTexture, myInitialLevel, outTexture.image, outTexture.view, outTexture.memory))
+		return false;
+
+	outTexture.residentLevel = myInitialLevel;
+	outTexture.initialLevel = myInitialLevel;
+	outTexture.version = 1;
+	outTexture.lastUsedFrame = theStreamer.frameNumber;
+
+	theStreamer.textures.push_back(&outTexture);
+	return true;
+}
+
+
+
+/**
+ * Records that a texture is used by the current frame; textures not used for a while are evicted first.
+ */
+void markStreamedTextureUsed(TextureStreamer & theStreamer, StreamedTexture & theTexture)
+{
+	theTexture.lastUsedFrame = theStreamer.frameNumber;
+}
+
+
+
+/*
+ * Starts replacing a texture's image with one whose top level is newLevel.
+ * The upload is submitted, and pendingUpload set, by updateTextureStreaming.
+ * On failure nothing is pending, and the texture keeps its current image.
+ */
+bool beginStreamedTextureResidencyChange(TextureStreamer & theStreamer, StreamedTexture & theTexture, const uint32_t newLevel)
+{
+	if(!createStreamedTextureImage(theStreamer, theTexture, newLevel, theTexture.pendingImage, theTexture.pendingView, theTexture.pendingMemory))
+		return false;
+
+	theTexture.pendingLevel = newLevel;
+	return true;
+}
+
+
+
+/*
+ * Size of the image holding the levels [firstLevel, end) of a texture, as stored in the source
+ * (the device may need a bit more for alignment).
+ */
+VkDeviceSize getStreamedTextureLevelsSize(const StreamedTexture & theTexture, const uint32_t firstLevel)
+{
+	VkDeviceSize size = 0;
+	for(uint32_t i = firstLevel; i < theTexture.levels.size(); i++)
+		size += theTexture.levels[i].size;
+	return size;
+}
+
+
+
+/*
+ * Makes room for newBytes in the budget, evicting the top level of the least recently used
+ * textures. Returns true if the memory is available now.
+ */
+bool makeRoomInStreamingBudget(TextureStreamer & theStreamer,
+                               const VkDeviceSize newBytes,
+                               const StreamedTexture * theRequester,
+                               std::vector<StreamedTexture*> & theChangedTextures)
+{
+	if(theStreamer.usedBytes + newBytes <= theStreamer.budget)
+		return true;
+
+	// Memory being released: evicted images are freed a few frames later.
+	VkDeviceSize releasingBytes = 0;
+	for(const auto & retired : theStreamer.retiredImages)
+		releasingBytes += retired.memory.size;
+
+	std::vector<StreamedTexture*> myCandidates;
+	for(StreamedTexture * texture : theStreamer.textures)
+		if(texture != theRequester
+		   && texture->pendingImage == VK_NULL_HANDLE
+		   && texture->residentLevel < texture->initialLevel
+		   && texture->lastUsedFrame + STREAMING_EVICTION_FRAMES < theStreamer.frameNumber)
+			myCandidates.push_back(texture);
+
+	std::sort(myCandidates.begin(), myCandidates.end(), [](const StreamedTexture * a, const StreamedTexture * b){ return a->lastUsedFrame < b->lastUsedFrame; });
+
+	for(StreamedTexture * texture : myCandidates)
+	{
+		if(theStreamer.usedBytes - releasingBytes + newBytes <= theStreamer.budget)
+			break;
+
+		// Dropping the top level frees the whole current image, minus the new, smaller one.
+		const VkDeviceSize currentBytes = texture->memory.size;
+		if(!beginStreamedTextureResidencyChange(theStreamer, *texture, texture->residentLevel + 1))
+			break;
+
+		releasingBytes += currentBytes;
+		theChangedTextures.push_back(texture);
+		theStreamer.evictedLevels++;
+	}
+
+	return false;   // Try again when the evicted images are freed.
+}
+
+
+
+/**
+ * Advances the streaming by one frame. Call it once per frame, before recording the
+ * commands that use the streamed textures (and before submitPendingUploadAcquires):
+ * - destroys the images no frame in flight can use anymore;
+ * - swaps in the images whose upload has completed (their textures' version changes);
+ * - fades the newly streamed levels in;
+ * - starts uploading the next level of the most recently used textures, within the budget
+ *   and maxUploadBytesPerFrame, evicting levels of textures not used recently if needed.
+ */
+void updateTextureStreaming(TextureStreamer & theStreamer)
+{
+	theStreamer.frameNumber++;
+
+	while(!theStreamer.retiredImages.empty() && theStreamer.retiredImages.front().frameNumber + theStreamer.retireFrames <= theStreamer.frameNumber)
+	{
+		auto & retired = theStreamer.retiredImages.front();
+		vkDestroyImageView(theStreamer.device, retired.view, theStreamer.pAllocator);
+		vkDestroyImage(theStreamer.device, retired.image, theStreamer.pAllocator);
+		theStreamer.usedBytes -= retired.memory.size;
+		freeMemoryToAllocator(*theStreamer.allocator, retired.memory);
+		theStreamer.retiredImages.pop_front();
+	}
+
+	for(StreamedTexture * texture : theStreamer.textures)
+	{
+		if(texture->pendingImage != VK_NULL_HANDLE && isUploadComplete(*theStreamer.engine, texture->pendingUpload))
+		{
+			retireStreamedTextureImage(theStreamer, texture->image, texture->view, texture->memory);
+
+			// A new top level fades in from the previous one; an evicted one just disappears.
+			texture->minLod = (texture->pendingLevel < texture->residentLevel) ? 1.0f : 0.0f;
+
+			texture->image = texture->pendingImage;
+			texture->view = texture->pendingView;
+			texture->memory = texture->pendingMemory;
+			texture->residentLevel = texture->pendingLevel;
+			texture->version++;
+
+			texture->pendingImage = VK_NULL_HANDLE;
+			texture->pendingView = VK_NULL_HANDLE;
+			texture->pendingMemory = MemoryAllocation{};
+		}
+
+		texture->minLod = std::max(texture->minLod - 1.0f / STREAMING_FADE_FRAMES, 0.0f);
+	}
+
+	// Stream the textures used most recently first.
+	std::vector<StreamedTexture*> myCandidates;
+	for(StreamedTexture * texture : theStreamer.textures)
+		if(texture->residentLevel > 0 && texture->pendingImage == VK_NULL_HANDLE
+		   && texture->lastUsedFrame + STREAMING_EVICTION_FRAMES >= theStreamer.frameNumber)
+			myCandidates.push_back(texture);
+
+	std::sort(myCandidates.begin(), myCandidates.end(), [](const StreamedTexture * a, const StreamedTexture * b){ return a->lastUsedFrame > b->lastUsedFrame; });
+
+	VkDeviceSize myUploadedBytes = 0;
+	std::vector<StreamedTexture*> myChangedTextures;
+
+	for(StreamedTexture * texture : myCandidates)
+	{
+		const uint32_t newLevel = texture->residentLevel - 1;
+		const VkDeviceSize newBytes = getStreamedTextureLevelsSize(*texture, newLevel);
+
+		if(myUploadedBytes > 0 && myUploadedBytes + newBytes > theStreamer.maxUploadBytesPerFrame)
+			break;
+
+		if(!makeRoomInStreamingBudget(theStreamer, newBytes, texture, myChangedTextures)) {
+			theStreamer.budgetStalls++;
+			break;
+		}
+
+		if(!beginStreamedTextureResidencyChange(theStreamer, *texture, newLevel))
+			break;
+
+		myUploadedBytes += newBytes;
+		myChangedTextures.push_back(texture);
+		theStreamer.streamedLevels++;
+	}
+
+	// All the new images are uploaded by a single submit.
+	if(!myChangedTextures.empty()) {
+		const UploadHandle myUpload = flushStagingRing(*theStreamer.ring, *theStreamer.engine);
+		for(StreamedTexture * texture : myChangedTextures)
+			texture->pendingUpload = myUpload;
+	}
+}
+
+
+
+/**
+ * Destroys a streamed texture's images. The device must not be using them anymore.
+ */
+void destroyStreamedTexture(TextureStreamer & theStreamer, StreamedTexture & theTexture)
+{
+	if(theTexture.pendingImage != VK_NULL_HANDLE) {
+		waitForUpload(*theStreamer.engine, theTexture.pendingUpload);
+		vkDestroyImageView(theStreamer.device, theTexture.pendingView, theStreamer.pAllocator);
+		vkDestroyImage(theStreamer.device, theTexture.pendingImage, theStreamer.pAllocator);
+		theStreamer.usedBytes -= theTexture.pendingMemory.size;
+		freeMemoryToAllocator(*theStreamer.allocator, theTexture.pendingMemory);
+	}
+
+	vkDestroyImageView(theStreamer.device, theTexture.view, theStreamer.pAllocator);
+	vkDestroyImage(theStreamer.device, theTexture.image, theStreamer.pAllocator);
+	theStreamer.usedBytes -= theTexture.memory.size;
+	freeMemoryToAllocator(*theStreamer.allocator, theTexture.memory);
+
+	theStreamer.textures.erase(std::remove(theStreamer.textures.begin(), theStreamer.textures.end(), &theTexture), theStreamer.textures.end());
+	theTexture = StreamedTexture{};
+}
+
+
+
+/**
+ * Prints how many levels were streamed in and evicted, and the memory used.
+ */
+void printTextureStreamerStatistics(const TextureStreamer & theStreamer)
+{
+	std::cout << "--- Texture streaming: " << theStreamer.textures.size() << " textures, "
+	          << theStreamer.streamedLevels << " levels streamed, " << theStreamer.evictedLevels << " evicted, "
+	          << theStreamer.budgetStalls << " budget stalls, "
+	          << theStreamer.usedBytes / 1024 << " KiB used of " << theStreamer.budget / 1024 << " KiB." << std::endl;
+}
+
+
+
+/**
+ * Destroys the retired images. The streamed textures must have been destroyed,
+ * and the device must be idle.
+ */
+void destroyTextureStreamer(TextureStreamer & theStreamer)
+{
+	assert(theStreamer.textures.empty());
+
+	for(auto & retired : theStreamer.retiredImages) {
+		vkDestroyImageView(theStreamer.device, retired.view, theStreamer.pAllocator);
+		vkDestroyImage(theStreamer.device, retired.image, theStreamer.pAllocator);
+		freeMemoryToAllocator(*theStreamer.allocator, retired.memory);
+	}
+
+	theStreamer.retiredImages.clear();
+	theStreamer.usedBytes = 0;
+}
+
+}	// vkdemos
+
+#endif
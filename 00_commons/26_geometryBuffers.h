@@ -0,0 +1,318 @@
+#ifndef VKDEMOS_GEOMETRYBUFFERS_H
+#define VKDEMOS_GEOMETRYBUFFERS_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "00_utils.h"
+#include "09_createAndAllocateBuffer.h"
+#include "12_memoryAllocator.h"
+#include "14_mappedMemory.h"
+#include "15_memoryTracker.h"
+#include "17_uploadEngine.h"
+#include "18_stagingRing.h"
+
+namespace vkdemos {
+
+/*
+ * Vertex and index buffers, placed in the memory that suits how they're used.
+ *
+ * Geometry that is written once and drawn every frame belongs in device-local memory:
+ * on a discrete GPU, every vertex fetched from host-visible memory crosses the PCIe bus,
+ * every frame. Device-local memory usually isn't host-visible, so the data goes through
+ * a staging buffer and a copy on the device.
+ *
+ * Geometry rewritten by the host every frame (or so) is better left in host-visible
+ * memory and written in place: staging it would cost a copy for each rewrite, and the
+ * allocator already prefers host-visible memory that is also device-local (UMA, ReBAR).
+ *
+ * The caller only says which of the two cases a buffer is, with a GeometryUsageHint;
+ * the functions below pick the memory and the upload path.
+ */
+enum GeometryUsageHint
+{
+	GEOMETRY_USAGE_STATIC,    // written once (at load time), drawn many times: device-local memory, through staging.
+	GEOMETRY_USAGE_DYNAMIC,   // rewritten by the host often: host-visible memory, written in place.
+};
+
+
+
+/*
+ * Stage and access masks of the first use of a geometry buffer, to make the upload visible to it.
+ */
+void getGeometryBufferFirstUse(const VkBufferUsageFlags bufferUsage, VkPipelineStageFlags & outStageMask, VkAccessFlags & outAccessMask)
+{
+	outStageMask = 0;
+	outAccessMask = 0;
+
+	if(bufferUsage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+		outStageMask |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		outAccessMask |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	}
+
+	if(bufferUsage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+		outStageMask |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		outAccessMask |= VK_ACCESS_INDEX_READ_BIT;
+	}
+
+	if(bufferUsage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)) {
+		outStageMask |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		outAccessMask |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+	}
+
+	if(outStageMask == 0) {
+		outStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		outAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	}
+}
+
+
+
+/**
+ * Creates a vertex/index buffer sub-allocated from theAllocator, and fills it with "size" bytes of data.
+ *
+ * - GEOMETRY_USAGE_STATIC: the buffer is placed in device-local memory and the data is staged
+ *   through theRing; as for any staged upload, call flushStagingRing and then
+ *   submitPendingUploadAcquires before drawing with the buffer. On UMA devices, where the
+ *   device-local memory is host-visible, the data is written in place instead.
+ * - GEOMETRY_USAGE_DYNAMIC: the buffer is placed in host-visible memory (device-local too
+ *   if possible), and the data is written through the allocator's mapping and marked dirty
+ *   in theFlushBatch; rewrite it the same way, through outAllocation.mappedPointer.
+ *
+ * data can be nullptr, to create the buffer without filling it.
+ * allocationSite is recorded by the memory tracker; pass VKDEMOS_ALLOCATION_SITE("tag").
+ * Free outAllocation with freeMemoryToAllocator after destroying the buffer.
+ */
+bool createGeometryBuffer(const VkDevice theDevice,
+                          MemoryAllocator & theAllocator,
+                          StagingRing & theRing,
+                          UploadEngine & theEngine,
+                          MappedMemoryFlushBatch & theFlushBatch,
+                          const VkBufferUsageFlags bufferUsage,
+                          const GeometryUsageHint usageHint,
+                          const void * data,
+                          const VkDeviceSize size,
+                          VkBuffer & outBuffer,
+                          MemoryAllocation & outAllocation,
+                          const AllocationSite & allocationSite,
+                          const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkBuffer myBuffer;
+	MemoryAllocation myAllocation;
+	bool boolResult;
+
+	if(usageHint == GEOMETRY_USAGE_STATIC)
+		boolResult = createAndAllocateBuffer(theDevice, theAllocator, bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                                     size, myBuffer, myAllocation, allocationSite, vkdemos::utils::MEMORY_USAGE_GPU_ONLY, pAllocator);
+	else
+		boolResult = createAndAllocateBuffer(theDevice, theAllocator, bufferUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		                                     size, myBuffer, myAllocation, allocationSite, vkdemos::utils::MEMORY_USAGE_DYNAMIC, pAllocator);
+
+	if(!boolResult) {
+		std::cout << "!!! ERROR: Can't create the geometry buffer." << std::endl;
+		return false;
+	}
+
+	if(data != nullptr)
+	{
+		if(myAllocation.mappedPointer != nullptr)
+		{
+			memcpy(myAllocation.mappedPointer, data, size);
+			markAllocationDirty(theFlushBatch, theAllocator, myAllocation, 0, size);
+		}
+		else
+		{
+			VkPipelineStageFlags dstStageMask;
+			VkAccessFlags dstAccessMask;
+			getGeometryBufferFirstUse(bufferUsage, dstStageMask, dstAccessMask);
+
+			if(!stageBufferData(theRing, theEngine, data, size, myBuffer, 0, dstStageMask, dstAccessMask)) {
+				std::cout << "!!! ERROR: Can't stage the geometry buffer's data." << std::endl;
+				vkDestroyBuffer(theDevice, myBuffer, pAllocator);
+				freeMemoryToAllocator(theAllocator, myAllocation);
+				return false;
+			}
+		}
+	}
+
+	outBuffer = myBuffer;
+	outAllocation = myAllocation;
+	return true;
+}
+
+
+
+/**
+ * Creates a vertex/index buffer with its own VkDeviceMemory, and fills it with "size" bytes of data;
+ * for the demos that don't use a MemoryAllocator and a StagingRing.
+ *
+ * - GEOMETRY_USAGE_STATIC: the buffer is placed in device-local memory; the data is written to
+ *   a temporary staging buffer and copied with a command buffer allocated from thePool and
+ *   submitted to theQueue. The function waits for the copy, so it's meant for load time only.
+ * - GEOMETRY_USAGE_DYNAMIC: the buffer is placed in host-visible, host-coherent memory,
+ *   and the data is written with a map/memcpy/unmap.
+ *
+ * allocationSite is recorded by the memory tracker for the buffer's memory; pass VKDEMOS_ALLOCATION_SITE("tag").
+ * Free outBufferMemory with trackedFreeMemory, with the same pAllocator.
+ */
+bool createGeometryBuffer(const VkDevice theDevice,
+                          const VkPhysicalDeviceMemoryProperties theMemoryProperties,
+                          const VkQueue theQueue,
+                          const VkCommandPool thePool,
+                          const VkBufferUsageFlags bufferUsage,
+                          const GeometryUsageHint usageHint,
+                          const void * data,
+                          const VkDeviceSize size,
+                          VkBuffer & outBuffer,
+                          VkDeviceMemory & outBufferMemory,
+                          const AllocationSite & allocationSite,
+                          const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+	bool boolResult;
+	VkBuffer myBuffer;
+	VkDeviceMemory myBufferMemory;
+
+	if(usageHint == GEOMETRY_USAGE_DYNAMIC)
+	{
+		boolResult = createAndAllocateBuffer(theDevice, theMemoryProperties, bufferUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                                     size, myBuffer, myBufferMemory, allocationSite, pAllocator);
+		if(!boolResult)
+			return false;
+
+		if(data != nullptr)
+		{
+			void * mappedBuffer;
+			result = vkMapMemory(theDevice, myBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
+			assert(result == VK_SUCCESS);
+
+			memcpy(mappedBuffer, data, size);
+
+			vkUnmapMemory(theDevice, myBufferMemory);
+		}
+
+		outBuffer = myBuffer;
+		outBufferMemory = myBufferMemory;
+		return true;
+	}
+
+	boolResult = createAndAllocateBuffer(theDevice, theMemoryProperties, bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                                     size, myBuffer, myBufferMemory, allocationSite, pAllocator);
+	if(!boolResult)
+		return false;
+
+	if(data == nullptr) {
+		outBuffer = myBuffer;
+		outBufferMemory = myBufferMemory;
+		return true;
+	}
+
+	/*
+	 * Write the data to a staging buffer in host-visible memory.
+	 */
+	VkBuffer myStagingBuffer;
+	VkDeviceMemory myStagingBufferMemory;
+	boolResult = createAndAllocateBuffer(theDevice, theMemoryProperties, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                                     size, myStagingBuffer, myStagingBufferMemory, VKDEMOS_ALLOCATION_SITE("geometry staging buffer"), pAllocator);
+	if(!boolResult) {
+		vkDestroyBuffer(theDevice, myBuffer, pAllocator);
+		trackedFreeMemory(theDevice, myBufferMemory, pAllocator);
+		return false;
+	}
+
+	{
+		void * mappedBuffer;
+		result = vkMapMemory(theDevice, myStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
+		assert(result == VK_SUCCESS);
+
+		memcpy(mappedBuffer, data, size);
+
+		vkUnmapMemory(theDevice, myStagingBufferMemory);
+	}
+
+	/*
+	 * Copy it to the device-local buffer.
+	 * The barrier makes the copy visible to the vertex input stage of all the commands
+	 * submitted afterwards, on this queue.
+	 */
+	VkCommandBuffer myCommandBuffer;
+	boolResult = allocateCommandBuffer(theDevice, thePool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCommandBuffer);
+	assert(boolResult);
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	result = vkBeginCommandBuffer(myCommandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	const VkBufferCopy bufferCopy = {
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size,
+	};
+
+	vkCmdCopyBuffer(myCommandBuffer, myStagingBuffer, myBuffer, 1, &bufferCopy);
+
+	VkPipelineStageFlags dstStageMask;
+	VkAccessFlags dstAccessMask;
+	getGeometryBufferFirstUse(bufferUsage, dstStageMask, dstAccessMask);
+
+	const VkBufferMemoryBarrier bufferMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = dstAccessMask,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = myBuffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+
+	vkCmdPipelineBarrier(myCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	result = vkEndCommandBuffer(myCommandBuffer);
+	assert(result == VK_SUCCESS);
+
+	VkFence myFence;
+	result = vkdemos::utils::createFence(theDevice, myFence);
+	assert(result == VK_SUCCESS);
+
+	const VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = nullptr,
+		.pWaitDstStageMask = nullptr,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &myCommandBuffer,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = nullptr,
+	};
+
+	result = vkQueueSubmit(theQueue, 1, &submitInfo, myFence);
+	assert(result == VK_SUCCESS);
+
+	result = vkWaitForFences(theDevice, 1, &myFence, VK_TRUE, UINT64_MAX);
+	assert(result == VK_SUCCESS);
+
+	vkDestroyFence(theDevice, myFence, nullptr);
+	vkFreeCommandBuffers(theDevice, thePool, 1, &myCommandBuffer);
+	vkDestroyBuffer(theDevice, myStagingBuffer, pAllocator);
+	trackedFreeMemory(theDevice, myStagingBufferMemory, pAllocator);
+
+	outBuffer = myBuffer;
+	outBufferMemory = myBufferMemory;
+	return true;
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef VKDEMOS_MESHPROCESSING_H
+#define VKDEMOS_MESHPROCESSING_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+namespace vkdemos {
+
+/*
+ * Mesh processing for indexed drawing: turns a triangle list into a vertex buffer and an
+ * index buffer that the device can draw with as few vertex shader invocations and as
+ * little memory traffic as possible.
+ *
+ * - Deduplication: vertices with identical bytes are merged, and the triangles refer to
+ *   them by index. A vertex shared by several triangles is then stored (and fetched) once.
+ * - Triangle reordering: the GPU keeps the results of the last few vertex shader
+ *   invocations in a small post-transform cache, and reuses them when an index repeats
+ *   soon enough. The triangles are reordered with Tom Forsyth's "Linear-Speed Vertex Cache
+ *   Optimisation": the next triangle is always the one whose vertices score best, where
+ *   vertices score high if they're in the (simulated, LRU) cache, and if they have few
+ *   triangles left, so that they can leave the cache for good.
+ * - Vertex reordering: the vertices are stored in the order the reordered triangles
+ *   first use them, so the vertex fetches walk the buffer mostly forward.
+ *
+ * The quality of the result is measured by the ACMR (average cache miss ratio): the vertex
+ * shader invocations per triangle, simulating a FIFO post-transform cache. It's 3 for an
+ * unindexed triangle list, and 0.5 in the limit for a large regular grid.
+ */
+
+static constexpr uint32_t MESH_OPTIMIZER_CACHE_SIZE = 32;   // size of the LRU cache modeled by the optimizer.
+static constexpr uint32_t MESH_ACMR_FIFO_SIZE = 16;         // size of the FIFO cache simulated to compute the ACMR.
+
+struct MeshStatistics
+{
+	size_t inputVertexCount = 0;
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	float acmrBefore = 0.0f;      // of the input, drawn unindexed: always 3.
+	float acmrIndexed = 0.0f;     // after the deduplication, with the triangles in their original order.
+	float acmrAfter = 0.0f;       // of the optimized index buffer.
+};
+
+
+
+/*
+ * Hashes and compares vertices by their bytes, inside the vertex array being deduplicated.
+ */
+struct VertexBytesHash
+{
+	const uint8_t * vertices;
+	size_t vertexSize;
+
+	size_t operator()(const uint32_t index) const
+	{
+		const uint8_t * bytes = vertices + (size_t)index * vertexSize;
+		uint64_t hash = 0xCBF29CE484222325ull;
+
+		for(size_t i = 0; i < vertexSize; i++)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+
+		return (size_t)hash;
+	}
+};
+
+struct VertexBytesEqual
+{
+	const uint8_t * vertices;
+	size_t vertexSize;
+
+	bool operator()(const uint32_t a, const uint32_t b) const
+	{
+		return memcmp(vertices + (size_t)a * vertexSize, vertices + (size_t)b * vertexSize, vertexSize) == 0;
+	}
+};
+
+
+
+/**
+ * Merges the identical vertices of an unindexed triangle list (vertexCount vertices of vertexSize bytes each).
+ * Fills outVertices with the unique vertices, in order of first appearance, and outIndices
+ * with one index per input vertex.
+ * Vertices are compared byte by byte: the vertex struct must have no padding.
+ */
+void deduplicateVertices(const void * theVertices,
+                         const size_t vertexCount,
+                         const size_t vertexSize,
+                         std::vector<uint8_t> & outVertices,
+                         std::vector<uint32_t> & outIndices)
+{
+	const uint8_t * vertices = (const uint8_t*)theVertices;
+
+	std::unordered_map<uint32_t, uint32_t, VertexBytesHash, VertexBytesEqual> uniqueVertices(
+		vertexCount, VertexBytesHash{vertices, vertexSize}, VertexBytesEqual{vertices, vertexSize});
+
+	outVertices.clear();
+	outVertices.reserve(vertexCount * vertexSize);
+	outIndices.resize(vertexCount);
+
+	for(size_t i = 0; i < vertexCount; i++)
+	{
+		const uint32_t newIndex = (uint32_t)(outVertices.size() / vertexSize);
+		const auto inserted = uniqueVertices.emplace((uint32_t)i, newIndex);
+
+		if(inserted.second)
+			outVertices.insert(outVertices.end(), vertices + i * vertexSize, vertices + (i + 1) * vertexSize);
+
+		outIndices[i] = inserted.first->second;
+	}
+}
+
+
+
+/**
+ * Computes the average cache miss ratio of an indexed triangle list: the number of vertex
+ * shader invocations per triangle, with a FIFO post-transform cache of cacheSize entries.
+ */
+float computeACMR(const std::vector<uint32_t> & theIndices, const size_t vertexCount, const uint32_t cacheSize = MESH_ACMR_FIFO_SIZE)
+{
+	if(theIndices.size() < 3)
+		return 0.0f;
+
+	// The cache is a ring of the last cacheSize misses; a vertex is in it if it missed recently enough.
+	std::vector<size_t> missTimestamp(vertexCount, 0);
+	size_t misses = 0;
+
+	for(const uint32_t index : theIndices)
+	{
+		assert(index < vertexCount);
+
+		if(missTimestamp[index] == 0 || misses - missTimestamp[index] >= cacheSize) {
+			misses++;
+			missTimestamp[index] = misses;
+		}
+	}
+
+	return (float)misses / (float)(theIndices.size() / 3);
+}
+
+
+
+/*
+ * Forsyth's vertex score: higher for the vertices recently used (except the very last three,
+ * which the current triangle already has), and for vertices with few triangles left.
+ */
+float computeForsythVertexScore(const int cachePosition, const uint32_t remainingTriangles, const uint32_t cacheSize)
+{
+	static constexpr float CACHE_DECAY_POWER = 1.5f;
+	static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	if(remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if(cachePosition >= 0)
+	{
+		if(cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+			score = std::pow(1.0f - (float)(cachePosition - 3) / (float)(cacheSize - 3), CACHE_DECAY_POWER);
+	}
+
+	score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+
+
+/**
+ * Reorders the triangles of an indexed triangle list for the post-transform vertex cache,
+ * with Forsyth's algorithm. The set of triangles, and their winding, don't change.
+ */
+void optimizeVertexCache(std::vector<uint32_t> & theIndices, const size_t vertexCount, const uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE)
+{
+	const size_t triangleCount = theIndices.size() / 3;
+	if(triangleCount == 0)
+		return;
+
+	/*
+	 * Vertex -> triangles adjacency, packed in a single array; each vertex's slice
+	 * is kept with the triangles not yet emitted at the front.
+	 */
+	std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+	for(const uint32_t index : theIndices)
+		remainingTriangles[index]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for(size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+
+	std::vector<uint32_t> adjacency(theIndices.size());
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for(size_t i = 0; i < theIndices.size(); i++)
+			adjacency[fill[theIndices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = computeForsythVertexScore(-1, remainingTriangles[v], cacheSize);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> triangleEmitted(triangleCount, false);
+	for(size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = vertexScore[theIndices[t*3]] + vertexScore[theIndices[t*3+1]] + vertexScore[theIndices[t*3+2]];
+
+	// The cache holds up to cacheSize vertices, plus the 3 of the triangle being added.
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(cacheSize + 3);
+	newCache.reserve(cacheSize + 3);
+
+	std::vector<uint32_t> output;
+	output.reserve(theIndices.size());
+
+	size_t nextUnemitted = 0;   // cursor for the linear search, when the cache has nothing to offer.
+
+	int bestTriangle = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	while(bestTriangle >= 0)
+	{
+		const uint32_t * triangle = &theIndices[(size_t)bestTriangle * 3];
+		triangleEmitted[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// Remove the triangle from its vertices' slices.
+		for(int k = 0; k < 3; k++)
+		{
+			const uint32_t v = triangle[k];
+			uint32_t * slice = &adjacency[adjacencyOffsets[v]];
+			const uint32_t count = remainingTriangles[v];
+
+			for(uint32_t i = 0; i < count; i++) {
+				if(slice[i] == (uint32_t)bestTriangle) {
+					std::swap(slice[i], slice[count - 1]);
+					break;
+				}
+			}
+
+			remainingTriangles[v]--;
+		}
+
+		// The triangle's vertices go to the front of the LRU cache.
+		newCache.assign(triangle, triangle + 3);
+		for(const uint32_t v : cache)
+			if(v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache.push_back(v);
+
+		// Update the scores of the vertices in the cache (and of those just pushed out of it).
+		for(size_t i = 0; i < newCache.size(); i++)
+		{
+			const uint32_t v = newCache[i];
+			cachePosition[v] = (i < cacheSize) ? (int)i : -1;
+
+			const float newScore = computeForsythVertexScore(cachePosition[v], remainingTriangles[v], cacheSize);
+			const float delta = newScore - vertexScore[v];
+			vertexScore[v] = newScore;
+
+			for(uint32_t j = 0; j < remainingTriangles[v]; j++)
+				triangleScore[adjacency[adjacencyOffsets[v] + j]] += delta;
+		}
+
+		if(newCache.size() > cacheSize)
+			newCache.resize(cacheSize);
+		cache.swap(newCache);
+
+		// The next triangle is the best one using a vertex in the cache...
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+
+		for(const uint32_t v : cache) {
+			for(uint32_t j = 0; j < remainingTriangles[v]; j++) {
+				const uint32_t t = adjacency[adjacencyOffsets[v] + j];
+				if(triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = (int)t;
+				}
+			}
+		}
+
+		// ...or, if none, the first one not emitted yet.
+		if(bestTriangle < 0) {
+			while(nextUnemitted < triangleCount && triangleEmitted[nextUnemitted])
+				nextUnemitted++;
+
+			if(nextUnemitted < triangleCount)
+				bestTriangle = (int)nextUnemitted;
+		}
+	}
+
+	assert(output.size() == triangleCount * 3);
+	theIndices.swap(output);
+}
+
+
+
+/**
+ * Reorders the vertices in the order the indices first reference them, and remaps the indices;
+ * vertices not referenced by any index are removed.
+ * Returns the new number of vertices.
+ */
+size_t optimizeVertexFetch(std::vector<uint32_t> & theIndices, std::vector<uint8_t> & theVertices, const size_t vertexSize)
+{
+	const size_t vertexCount = theVertices.size() / vertexSize;
+
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	std::vector<uint8_t> newVertices;
+	newVertices.reserve(theVertices.size());
+
+	uint32_t nextVertex = 0;
+	for(uint32_t & index : theIndices)
+	{
+		if(remap[index] == UINT32_MAX) {
+			remap[index] = nextVertex++;
+			newVertices.insert(newVertices.end(), &theVertices[(size_t)index * vertexSize], &theVertices[(size_t)index * vertexSize] + vertexSize);
+		}
+
+		index = remap[index];
+	}
+
+	theVertices.swap(newVertices);
+	return nextVertex;
+}
+
+
+
+/**
+ * Turns an unindexed triangle list into an optimized indexed one: deduplicates the vertices,
+ * reorders the triangles for the post-transform cache and the vertices for fetch locality.
+ * Fills theStatistics (if not nullptr) with the vertex counts and the ACMR before and after.
+ */
+void optimizeMesh(const void * theVertices,
+                  const size_t vertexCount,
+                  const size_t vertexSize,
+                  std::vector<uint8_t> & outVertices,
+                  std::vector<uint32_t> & outIndices,
+                  MeshStatistics * theStatistics = nullptr)
+{
+	deduplicateVertices(theVertices, vertexCount, vertexSize, outVertices, outIndices);
+	const float acmrIndexed = computeACMR(outIndices, outVertices.size() / vertexSize);
+
+	optimizeVertexCache(outIndices, outVertices.size() / vertexSize);
+	const size_t newVertexCount = optimizeVertexFetch(outIndices, outVertices, vertexSize);
+
+	if(theStatistics != nullptr) {
+		theStatistics->inputVertexCount = vertexCount;
+		theStatistics->vertexCount = newVertexCount;
+		theStatistics->triangleCount = outIndices.size() / 3;
+		theStatistics->acmrBefore = (vertexCount >= 3) ? 3.0f : 0.0f;   // Unindexed: every vertex is shaded.
+		theStatistics->acmrIndexed = acmrIndexed;
+		theStatistics->acmrAfter = computeACMR(outIndices, newVertexCount);
+	}
+}
+
+
+
+/**
+ * Same as above, for vertices of type Vertex.
+ */
+template<typename Vertex>
+void optimizeMesh(const Vertex * theVertices,
+                  const size_t vertexCount,
+                  std::vector<Vertex> & outVertices,
+                  std::vector<uint32_t> & outIndices,
+                  MeshStatistics * theStatistics = nullptr)
+{
+	std::vector<uint8_t> vertexBytes;
+	optimizeMesh((const void*)theVertices, vertexCount, sizeof(Vertex), vertexBytes, outIndices, theStatistics);
+
+	outVertices.resize(vertexBytes.size() / sizeof(Vertex));
+	memcpy(outVertices.data(), vertexBytes.data(), vertexBytes.size());
+}
+
+
+
+/**
+ * Prints the vertex counts and the ACMR of a processed mesh.
+ */
+void printMeshStatistics(const MeshStatistics & theStatistics, const char * meshName)
+{
+	std::cout << "--- Mesh \"" << meshName << "\": " << theStatistics.triangleCount << " triangles, "
+	          << theStatistics.inputVertexCount << " -> " << theStatistics.vertexCount << " vertices, ACMR "
+	          << std::fixed << std::setprecision(3) << theStatistics.acmrBefore << " unindexed, "
+	          << theStatistics.acmrIndexed << " indexed, " << theStatistics.acmrAfter << " optimized" << std::defaultfloat << std::endl;
+}
+
+}	// vkdemos
+
+#endif
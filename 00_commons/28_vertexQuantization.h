@@ -0,0 +1,327 @@
+#ifndef VKDEMOS_VERTEXQUANTIZATION_H
+#define VKDEMOS_VERTEXQUANTIZATION_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "glm/glm/glm.hpp"
+#include "glm/glm/gtc/packing.hpp"
+#include "glm/glm/gtc/matrix_transform.hpp"
+
+namespace vkdemos {
+
+/*
+ * Quantized vertex formats.
+ *
+ * Meshes are usually authored with 32-bit floats for every component, but positions,
+ * normals and texture coordinates need much less precision than that: storing them in
+ * 16-bit integers or half-floats halves the memory the vertices take and the bandwidth
+ * of fetching them. The vertex input stage converts them back to floats for free,
+ * using a normalized (_SNORM, _UNORM) or half-float (_SFLOAT) format.
+ *
+ * - Positions (SNORM16): normalized to the mesh's bounding box, so that the 16 bits span
+ *   the mesh and not the whole float range; each vertex stores (position - bias) / scale,
+ *   in [-1, 1]. The shader gets the position back with "encoded * scale + bias", which is
+ *   an affine transform: multiply the model matrix by getPositionDequantizationMatrix,
+ *   and the shader doesn't need to change.
+ * - Texture coordinates: half-floats (HALF) for any range, or UNORM16 for coordinates in
+ *   [0, 1], with a uniform precision of 1/65535.
+ * - Normals (OCTAHEDRAL): a unit vector is projected on an octahedron, whose faces are
+ *   unfolded on a square; the two coordinates on the square are stored as SNORM16, 4 bytes
+ *   instead of 12. The vertex shader decodes them with:
+ *
+ *       vec3 decodeOctahedral(vec2 e) {
+ *           vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+ *           float t = max(-n.z, 0.0);
+ *           n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+ *           return normalize(n);
+ *       }
+ *
+ * The encoding uses the packing functions of glm (glm/gtc/packing.hpp), which round the
+ * same way as the device converts the values back.
+ *
+ * The 3-component 16-bit formats have optional vertex buffer support, so 3-component
+ * attributes are stored in 4 components (the shader can still declare a vec3 input).
+ */
+
+enum VertexAttributeType
+{
+	VERTEX_ATTRIBUTE_POSITION,   // 3 floats.
+	VERTEX_ATTRIBUTE_NORMAL,     // 3 floats, unit length.
+	VERTEX_ATTRIBUTE_UV,         // 2 floats.
+};
+
+enum VertexAttributeEncoding
+{
+	VERTEX_ENCODING_FLOAT,       // 32-bit floats, unchanged.
+	VERTEX_ENCODING_SNORM16,     // 16-bit signed normalized; positions are scaled to the mesh's bounding box.
+	VERTEX_ENCODING_UNORM16,     // 16-bit unsigned normalized, for values in [0, 1].
+	VERTEX_ENCODING_HALF,        // 16-bit floats.
+	VERTEX_ENCODING_OCTAHEDRAL,  // normals only: 2 x SNORM16 octahedral coordinates.
+};
+
+/*
+ * An attribute of the source vertices (floats), and how to encode it.
+ */
+struct VertexAttributeSource
+{
+	VertexAttributeType type;
+	uint32_t location;           // shader input location.
+	uint32_t sourceOffset;       // offset of the first float in the source vertex.
+	VertexAttributeEncoding encoding;
+};
+
+struct QuantizedVertexAttribute
+{
+	VertexAttributeSource source;
+	VkFormat format;
+	uint32_t offset;             // in the quantized vertex.
+	uint32_t size;
+};
+
+struct QuantizedVertexFormat
+{
+	std::vector<QuantizedVertexAttribute> attributes;
+	uint32_t stride = 0;
+
+	// Position = encoded position * positionScale + positionBias; set by quantizeVertices.
+	glm::vec3 positionScale{1.0f, 1.0f, 1.0f};
+	glm::vec3 positionBias{0.0f, 0.0f, 0.0f};
+};
+
+
+
+/**
+ * Computes the formats and offsets of the quantized attributes.
+ * Returns false if an encoding doesn't apply to its attribute.
+ */
+bool createQuantizedVertexFormat(const std::vector<VertexAttributeSource> & theAttributes, QuantizedVertexFormat & outFormat)
+{
+	QuantizedVertexFormat myFormat;
+
+	for(const VertexAttributeSource & source : theAttributes)
+	{
+		const bool twoComponents = (source.type == VERTEX_ATTRIBUTE_UV);
+
+		QuantizedVertexAttribute attribute;
+		attribute.source = source;
+		attribute.offset = myFormat.stride;
+
+		switch(source.encoding)
+		{
+			case VERTEX_ENCODING_FLOAT:
+				attribute.format = twoComponents ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
+				attribute.size = twoComponents ? 8 : 12;
+				break;
+
+			case VERTEX_ENCODING_SNORM16:
+				attribute.format = twoComponents ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R16G16B16A16_SNORM;
+				attribute.size = twoComponents ? 4 : 8;
+				break;
+
+			case VERTEX_ENCODING_UNORM16:
+				attribute.format = twoComponents ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16B16A16_UNORM;
+				attribute.size = twoComponents ? 4 : 8;
+				break;
+
+			case VERTEX_ENCODING_HALF:
+				attribute.format = twoComponents ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+				attribute.size = twoComponents ? 4 : 8;
+				break;
+
+			case VERTEX_ENCODING_OCTAHEDRAL:
+				if(source.type != VERTEX_ATTRIBUTE_NORMAL) {
+					std::cout << "!!! ERROR: the octahedral encoding only applies to normals (location " << source.location << ")." << std::endl;
+					return false;
+				}
+				attribute.format = VK_FORMAT_R16G16_SNORM;
+				attribute.size = 4;
+				break;
+		}
+
+		myFormat.attributes.push_back(attribute);
+		myFormat.stride += attribute.size;
+	}
+
+	outFormat = myFormat;
+	return true;
+}
+
+
+
+/**
+ * Encodes a unit vector in octahedral coordinates, in [-1, 1].
+ */
+glm::vec2 encodeOctahedral(const glm::vec3 & n)
+{
+	const glm::vec3 p = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+	glm::vec2 e(p.x, p.y);
+
+	// The lower hemisphere is folded over the diagonals.
+	if(p.z < 0.0f)
+		e = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+
+	return e;
+}
+
+
+
+/**
+ * Encodes sourceVertexCount vertices of sourceStride bytes each into theFormat.
+ * If the positions are encoded as SNORM16, computes theFormat's position scale and bias first.
+ */
+void quantizeVertices(const void * theSourceVertices,
+                      const size_t sourceVertexCount,
+                      const size_t sourceStride,
+                      QuantizedVertexFormat & theFormat,
+                      std::vector<uint8_t> & outVertices)
+{
+	const uint8_t * source = (const uint8_t*)theSourceVertices;
+
+	auto readFloats = [source, sourceStride](const size_t vertex, const uint32_t offset, float * out, const int count) {
+		memcpy(out, source + vertex * sourceStride + offset, count * sizeof(float));
+	};
+
+	/*
+	 * Bounding box of the positions.
+	 */
+	theFormat.positionScale = glm::vec3(1.0f);
+	theFormat.positionBias = glm::vec3(0.0f);
+
+	for(const QuantizedVertexAttribute & attribute : theFormat.attributes)
+	{
+		if(attribute.source.type != VERTEX_ATTRIBUTE_POSITION || attribute.source.encoding != VERTEX_ENCODING_SNORM16 || sourceVertexCount == 0)
+			continue;
+
+		glm::vec3 minimum(INFINITY), maximum(-INFINITY);
+		for(size_t i = 0; i < sourceVertexCount; i++) {
+			glm::vec3 p;
+			readFloats(i, attribute.source.sourceOffset, &p.x, 3);
+			minimum = glm::min(minimum, p);
+			maximum = glm::max(maximum, p);
+		}
+
+		theFormat.positionBias = (minimum + maximum) * 0.5f;
+		theFormat.positionScale = glm::max((maximum - minimum) * 0.5f, glm::vec3(1e-20f));
+	}
+
+	/*
+	 * Encode.
+	 */
+	outVertices.assign(sourceVertexCount * theFormat.stride, 0);
+
+	for(size_t i = 0; i < sourceVertexCount; i++)
+	{
+		for(const QuantizedVertexAttribute & attribute : theFormat.attributes)
+		{
+			const int componentCount = (attribute.source.type == VERTEX_ATTRIBUTE_UV) ? 2 : 3;
+			glm::vec4 value(0.0f);
+			readFloats(i, attribute.source.sourceOffset, &value.x, componentCount);
+
+			uint8_t * destination = &outVertices[i * theFormat.stride + attribute.offset];
+
+			uint32_t packed32;
+			uint64_t packed64;
+
+			switch(attribute.source.encoding)
+			{
+				case VERTEX_ENCODING_FLOAT:
+					memcpy(destination, &value.x, attribute.size);
+					break;
+
+				case VERTEX_ENCODING_SNORM16:
+					if(attribute.source.type == VERTEX_ATTRIBUTE_POSITION)
+						value = glm::vec4((glm::vec3(value) - theFormat.positionBias) / theFormat.positionScale, 0.0f);
+
+					if(componentCount == 2) {
+						packed32 = glm::packSnorm2x16(glm::vec2(value));
+						memcpy(destination, &packed32, 4);
+					}
+					else {
+						packed64 = glm::packSnorm4x16(value);
+						memcpy(destination, &packed64, 8);
+					}
+					break;
+
+				case VERTEX_ENCODING_UNORM16:
+					if(componentCount == 2) {
+						packed32 = glm::packUnorm2x16(glm::vec2(value));
+						memcpy(destination, &packed32, 4);
+					}
+					else {
+						packed64 = glm::packUnorm4x16(value);
+						memcpy(destination, &packed64, 8);
+					}
+					break;
+
+				case VERTEX_ENCODING_HALF:
+					if(componentCount == 2) {
+						packed32 = glm::packHalf2x16(glm::vec2(value));
+						memcpy(destination, &packed32, 4);
+					}
+					else {
+						packed64 = glm::packHalf4x16(value);
+						memcpy(destination, &packed64, 8);
+					}
+					break;
+
+				case VERTEX_ENCODING_OCTAHEDRAL:
+					packed32 = glm::packSnorm2x16(encodeOctahedral(glm::vec3(value)));
+					memcpy(destination, &packed32, 4);
+					break;
+			}
+		}
+	}
+}
+
+
+
+/**
+ * Returns the matrix turning the encoded positions back to the mesh's positions;
+ * multiply the model matrix by it.
+ */
+glm::mat4 getPositionDequantizationMatrix(const QuantizedVertexFormat & theFormat)
+{
+	const glm::mat4 translation = glm::translate(glm::mat4(1.0f), theFormat.positionBias);
+	return glm::scale(translation, theFormat.positionScale);
+}
+
+
+
+/**
+ * Fills the vertex input binding and attribute descriptions for a pipeline reading vertices in theFormat.
+ */
+void getQuantizedVertexInputDescriptions(const QuantizedVertexFormat & theFormat,
+                                         const uint32_t vertexInputBinding,
+                                         VkVertexInputBindingDescription & outBindingDescription,
+                                         std::vector<VkVertexInputAttributeDescription> & outAttributeDescriptions)
+{
+	outBindingDescription = {
+		.binding = vertexInputBinding,
+		.stride = theFormat.stride,
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+	};
+
+	outAttributeDescriptions.clear();
+	for(const QuantizedVertexAttribute & attribute : theFormat.attributes)
+	{
+		const VkVertexInputAttributeDescription attributeDescription = {
+			.location = attribute.source.location,
+			.binding = vertexInputBinding,
+			.format = attribute.format,
+			.offset = attribute.offset,
+		};
+
+		outAttributeDescriptions.push_back(attributeDescription);
+	}
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef VKDEMOS_PRERECORDEDCOMMANDBUFFERS_H
+#define VKDEMOS_PRERECORDEDCOMMANDBUFFERS_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+
+namespace vkdemos {
+
+/*
+ * Pre-recorded command buffers, one per swapchain image.
+ *
+ * When the content of a frame doesn't change, the only thing that differs between frames
+ * is the swapchain image (or framebuffer) being rendered to: instead of recording the same
+ * commands every frame, record one command buffer per swapchain image once, and just submit
+ * the one of the acquired image.
+ *
+ * The command buffers are recorded lazily by getPrerecordedCommandBuffer, with a callback,
+ * the first time each image is used; invalidatePrerecordedCommandBuffers marks all of them
+ * as out of date (call it when the pipeline, the render pass or the frame's content change),
+ * so that each one is re-recorded the next time its image is acquired.
+ * When the swapchain is recreated, its images (and possibly their count) change: destroy
+ * and create the PrerecordedCommandBuffers again.
+ *
+ * Each command buffer has a fence, signaled when its last submission completed: it's waited
+ * on before the buffer is submitted or re-recorded again, so the buffers don't need
+ * VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT. The pool must have been created with
+ * VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT.
+ */
+struct PrerecordedCommandBuffers
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+
+	std::vector<VkCommandBuffer> commandBuffers;   // one per swapchain image.
+	std::vector<VkFence> fences;                   // signaled when the last submission of each buffer completed.
+	std::vector<uint64_t> recordedVersions;        // content version each buffer was recorded with (0 = never).
+
+	uint64_t contentVersion = 1;                   // incremented by invalidatePrerecordedCommandBuffers.
+
+	// Statistics.
+	uint64_t recordCount = 0;
+	uint64_t reuseCount = 0;
+};
+
+/*
+ * Records the commands for the swapchain image imageIndex in theCommandBuffer,
+ * including vkBeginCommandBuffer and vkEndCommandBuffer.
+ */
+typedef std::function<bool(VkCommandBuffer theCommandBuffer, uint32_t imageIndex)> RecordCommandBufferFunction;
+
+
+
+/**
+ * Allocates a primary command buffer and a fence for each of the swapchainImageCount swapchain images.
+ * Nothing is recorded yet.
+ */
+bool createPrerecordedCommandBuffers(const VkDevice theDevice,
+                                     const VkCommandPool theCommandPool,
+                                     const uint32_t swapchainImageCount,
+                                     PrerecordedCommandBuffers & outPrerecorded,
+                                     const VkAllocationCallbacks * pAllocator = nullptr
+                                     )
+{
+	VkResult result;
+	PrerecordedCommandBuffers myPrerecorded;
+
+	myPrerecorded.device = theDevice;
+	myPrerecorded.commandPool = theCommandPool;
+	myPrerecorded.commandBuffers.resize(swapchainImageCount, VK_NULL_HANDLE);
+	myPrerecorded.fences.resize(swapchainImageCount, VK_NULL_HANDLE);
+	myPrerecorded.recordedVersions.resize(swapchainImageCount, 0);
+
+	if(swapchainImageCount == 0) {
+		outPrerecorded = myPrerecorded;
+		return true;
+	}
+
+	const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = theCommandPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = swapchainImageCount
+	};
+
+	result = vkAllocateCommandBuffers(theDevice, &commandBufferAllocateInfo, myPrerecorded.commandBuffers.data());
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: failed to allocate the pre-recorded command buffers: " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	// Created signaled, so that the first wait doesn't block.
+	const VkFenceCreateInfo fenceCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT
+	};
+
+	for(VkFence & fence : myPrerecorded.fences)
+	{
+		result = vkCreateFence(theDevice, &fenceCreateInfo, pAllocator, &fence);
+		assert(result == VK_SUCCESS);
+	}
+
+	outPrerecorded = myPrerecorded;
+	return true;
+}
+
+
+
+/**
+ * Marks all the command buffers as out of date; each one is re-recorded the next time
+ * getPrerecordedCommandBuffer is called for its image.
+ */
+void invalidatePrerecordedCommandBuffers(PrerecordedCommandBuffers & thePrerecorded)
+{
+	thePrerecorded.contentVersion++;
+}
+
+
+
+/**
+ * Records the command buffers of all the swapchain images now, e.g. at startup,
+ * so that the first frames don't have to.
+ */
+bool recordAllPrerecordedCommandBuffers(PrerecordedCommandBuffers & thePrerecorded, const RecordCommandBufferFunction & recordFunction)
+{
+	VkResult result;
+
+	if(!thePrerecorded.fences.empty()) {
+		result = vkWaitForFences(thePrerecorded.device, (uint32_t)thePrerecorded.fences.size(), thePrerecorded.fences.data(), VK_TRUE, UINT64_MAX);
+		assert(result == VK_SUCCESS);
+	}
+
+	for(uint32_t i = 0; i < thePrerecorded.commandBuffers.size(); i++)
+	{
+		result = vkResetCommandBuffer(thePrerecorded.commandBuffers[i], 0);
+		assert(result == VK_SUCCESS);
+
+		if(!recordFunction(thePrerecorded.commandBuffers[i], i)) {
+			std::cout << "!!! ERROR: failed to record the command buffer for swapchain image " << i << "." << std::endl;
+			thePrerecorded.recordedVersions[i] = 0;
+			return false;
+		}
+
+		thePrerecorded.recordedVersions[i] = thePrerecorded.contentVersion;
+		thePrerecorded.recordCount++;
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Returns the command buffer to submit for the swapchain image imageIndex, and the fence to
+ * pass to vkQueueSubmit (already reset).
+ * The command buffer is (re-)recorded with recordFunction if it's out of date.
+ */
+bool getPrerecordedCommandBuffer(PrerecordedCommandBuffers & thePrerecorded,
+                                 const uint32_t imageIndex,
+                                 const RecordCommandBufferFunction & recordFunction,
+                                 VkCommandBuffer & outCommandBuffer,
+                                 VkFence & outFence
+                                 )
+{
+	VkResult result;
+
+	if(imageIndex >= thePrerecorded.commandBuffers.size()) {
+		std::cout << "!!! ERROR: no pre-recorded command buffer for swapchain image " << imageIndex << "." << std::endl;
+		return false;
+	}
+
+	const VkCommandBuffer myCommandBuffer = thePrerecorded.commandBuffers[imageIndex];
+	const VkFence myFence = thePrerecorded.fences[imageIndex];
+
+	// The previous submission of this buffer must have completed before it can be submitted
+	// again or re-recorded; since the image has been acquired again, it usually already has.
+	result = vkWaitForFences(thePrerecorded.device, 1, &myFence, VK_TRUE, UINT64_MAX);
+	assert(result == VK_SUCCESS);
+
+	if(thePrerecorded.recordedVersions[imageIndex] != thePrerecorded.contentVersion)
+	{
+		result = vkResetCommandBuffer(myCommandBuffer, 0);
+		assert(result == VK_SUCCESS);
+
+		if(!recordFunction(myCommandBuffer, imageIndex)) {
+			std::cout << "!!! ERROR: failed to record the command buffer for swapchain image " << imageIndex << "." << std::endl;
+			thePrerecorded.recordedVersions[imageIndex] = 0;
+			return false;
+		}
+
+		thePrerecorded.recordedVersions[imageIndex] = thePrerecorded.contentVersion;
+		thePrerecorded.recordCount++;
+	}
+	else
+		thePrerecorded.reuseCount++;
+
+	result = vkResetFences(thePrerecorded.device, 1, &myFence);
+	assert(result == VK_SUCCESS);
+
+	outCommandBuffer = myCommandBuffer;
+	outFence = myFence;
+	return true;
+}
+
+
+
+/**
+ * Prints how many times the command buffers were recorded and reused.
+ */
+void printPrerecordedCommandBuffersStatistics(const PrerecordedCommandBuffers & thePrerecorded)
+{
+	std::cout << "--- Pre-recorded command buffers: " << thePrerecorded.commandBuffers.size() << " buffers, "
+	          << thePrerecorded.recordCount << " recordings, "
+	          << thePrerecorded.reuseCount << " frames submitted without recording."
+	          << std::endl;
+}
+
+
+
+/**
+ * Waits for the pending submissions, then frees the command buffers and destroys the fences.
+ */
+void destroyPrerecordedCommandBuffers(PrerecordedCommandBuffers & thePrerecorded, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	if(!thePrerecorded.fences.empty())
+		vkWaitForFences(thePrerecorded.device, (uint32_t)thePrerecorded.fences.size(), thePrerecorded.fences.data(), VK_TRUE, UINT64_MAX);
+
+	for(VkFence fence : thePrerecorded.fences)
+		vkDestroyFence(thePrerecorded.device, fence, pAllocator);
+
+	if(!thePrerecorded.commandBuffers.empty())
+		vkFreeCommandBuffers(thePrerecorded.device, thePrerecorded.commandPool, (uint32_t)thePrerecorded.commandBuffers.size(), thePrerecorded.commandBuffers.data());
+
+	thePrerecorded = PrerecordedCommandBuffers();
+}
+
+}	// vkdemos
+
+#endif
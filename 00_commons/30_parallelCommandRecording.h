@@ -0,0 +1,291 @@
+#ifndef VKDEMOS_PARALLELCOMMANDRECORDING_H
+#define VKDEMOS_PARALLELCOMMANDRECORDING_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "20_threadPool.h"
+
+namespace vkdemos {
+
+/*
+ * Multithreaded command recording with secondary command buffers.
+ *
+ * Recording thousands of draws on a single thread can take milliseconds of CPU time every
+ * frame. Vulkan lets any thread record commands, as long as a command pool (and the buffers
+ * allocated from it) is used by one thread at a time: the draw list of a render pass is split
+ * in slices, each slice is recorded by a thread pool task into a secondary command buffer
+ * (VK_COMMAND_BUFFER_LEVEL_SECONDARY) from its own pool, and the primary command buffer just
+ * executes them in order with vkCmdExecuteCommands, inside the render pass.
+ *
+ * The tasks of the ThreadPool run on whichever worker is free, so the pools belong to the
+ * slices rather than to the threads: each slice is recorded by exactly one task, which gives
+ * the same guarantee. There's a set of pools for every frame in flight, so that the slices of
+ * the next frame can be recorded while the GPU still executes the previous one; the pools are
+ * created with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT and reset all at once with vkResetCommandPool
+ * when their frame comes around again, instead of resetting every buffer.
+ *
+ * Secondary command buffers don't inherit any state from the primary: every slice must bind
+ * its pipeline, descriptor sets and vertex buffers, and set the dynamic state, again.
+ */
+struct ParallelRecordingFrame
+{
+	std::vector<VkCommandPool> commandPools;       // one per slice.
+	std::vector<VkCommandBuffer> commandBuffers;   // one secondary buffer per slice, from the slice's pool.
+};
+
+struct ParallelCommandRecorder
+{
+	VkDevice device = VK_NULL_HANDLE;
+	ThreadPool * threadPool = nullptr;            // nullptr: the slices are recorded on the calling thread.
+	uint32_t maxSliceCount = 0;
+	std::vector<ParallelRecordingFrame> frames;   // one per frame in flight.
+
+	// Statistics.
+	uint64_t recordedPasses = 0;
+	uint64_t recordedSlices = 0;
+	uint64_t recordedDraws = 0;
+};
+
+/*
+ * Records the draws [firstDraw, endDraw) of the draw list in theCommandBuffer, a secondary command
+ * buffer already begun inside the render pass. Called concurrently from several threads.
+ */
+typedef std::function<void(VkCommandBuffer theCommandBuffer, size_t firstDraw, size_t endDraw)> RecordDrawRangeFunction;
+
+
+
+/**
+ * Creates the command pools and secondary command buffers for frameCount frames in flight,
+ * split in at most maxSliceCount slices (0 means one per thread of thePool).
+ */
+bool createParallelCommandRecorder(const VkDevice theDevice,
+                                   const uint32_t theQueueFamilyIndex,
+                                   ThreadPool * thePool,
+                                   const uint32_t frameCount,
+                                   uint32_t maxSliceCount,
+                                   ParallelCommandRecorder & outRecorder,
+                                   const VkAllocationCallbacks * pAllocator = nullptr
+                                   )
+{
+	VkResult result;
+
+	if(maxSliceCount == 0)
+		maxSliceCount = (uint32_t)getThreadPoolConcurrency(thePool);
+
+	ParallelCommandRecorder myRecorder;
+	myRecorder.device = theDevice;
+	myRecorder.threadPool = thePool;
+	myRecorder.maxSliceCount = maxSliceCount;
+	myRecorder.frames.resize(frameCount);
+
+	const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = theQueueFamilyIndex,
+	};
+
+	for(ParallelRecordingFrame & frame : myRecorder.frames)
+	{
+		frame.commandPools.resize(maxSliceCount, VK_NULL_HANDLE);
+		frame.commandBuffers.resize(maxSliceCount, VK_NULL_HANDLE);
+
+		for(uint32_t slice = 0; slice < maxSliceCount; slice++)
+		{
+			result = vkCreateCommandPool(theDevice, &commandPoolCreateInfo, pAllocator, &frame.commandPools[slice]);
+			if(result != VK_SUCCESS) {
+				std::cout << "!!! ERROR: failed to create a recording command pool: " << vkdemos::utils::VkResultToString(result) << std::endl;
+
+				// Destroy the pools created so far.
+				frame.commandPools[slice] = VK_NULL_HANDLE;
+				for(const ParallelRecordingFrame & createdFrame : myRecorder.frames)
+					for(VkCommandPool pool : createdFrame.commandPools)
+						if(pool != VK_NULL_HANDLE)
+							vkDestroyCommandPool(theDevice, pool, pAllocator);
+
+				return false;
+			}
+
+			const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.pNext = nullptr,
+				.commandPool = frame.commandPools[slice],
+				.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+				.commandBufferCount = 1
+			};
+
+			result = vkAllocateCommandBuffers(theDevice, &commandBufferAllocateInfo, &frame.commandBuffers[slice]);
+			assert(result == VK_SUCCESS);
+		}
+	}
+
+	std::cout << "--- Parallel command recording: " << frameCount << " frames, up to " << maxSliceCount << " slices per pass." << std::endl;
+
+	outRecorder = myRecorder;
+	return true;
+}
+
+
+
+/**
+ * Records drawCount draws in secondary command buffers, in parallel, for subpass theSubpass of
+ * theRenderPass (theFramebuffer can be VK_NULL_HANDLE if it isn't known yet).
+ * The draw list is split in slices of at least minDrawsPerSlice draws.
+ * The GPU must have finished the previous use of frameIndex (i.e. its fence has been waited on).
+ * Returns the secondary command buffers to execute, in order.
+ */
+bool recordParallelDraws(ParallelCommandRecorder & theRecorder,
+                         const uint32_t frameIndex,
+                         const VkRenderPass theRenderPass,
+                         const uint32_t theSubpass,
+                         const VkFramebuffer theFramebuffer,
+                         const size_t drawCount,
+                         const size_t minDrawsPerSlice,
+                         const RecordDrawRangeFunction & recordFunction,
+                         std::vector<VkCommandBuffer> & outCommandBuffers
+                         )
+{
+	VkResult result;
+
+	outCommandBuffers.clear();
+
+	if(frameIndex >= theRecorder.frames.size()) {
+		std::cout << "!!! ERROR: no recording command pools for frame " << frameIndex << "." << std::endl;
+		return false;
+	}
+
+	ParallelRecordingFrame & frame = theRecorder.frames[frameIndex];
+
+	// All the buffers of the frame go back to the initial state at once.
+	for(VkCommandPool pool : frame.commandPools) {
+		result = vkResetCommandPool(theRecorder.device, pool, 0);
+		assert(result == VK_SUCCESS);
+	}
+
+	if(drawCount == 0)
+		return true;
+
+	// Don't split the list more than needed: tiny slices cost more in scheduling and in
+	// vkCmdExecuteCommands than they save.
+	const size_t minDraws = std::max<size_t>(minDrawsPerSlice, 1);
+	const size_t sliceCount = std::min<size_t>(theRecorder.maxSliceCount, (drawCount + minDraws - 1) / minDraws);
+	const size_t drawsPerSlice = (drawCount + sliceCount - 1) / sliceCount;
+	const size_t usedSlices = (drawCount + drawsPerSlice - 1) / drawsPerSlice;
+
+	const VkCommandBufferInheritanceInfo inheritanceInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = nullptr,
+		.renderPass = theRenderPass,
+		.subpass = theSubpass,
+		.framebuffer = theFramebuffer,
+		.occlusionQueryEnable = VK_FALSE,
+		.queryFlags = 0,
+		.pipelineStatistics = 0,
+	};
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritanceInfo,
+	};
+
+	/*
+	 * parallelFor runs over the slices: the slice index tells which pool to record with.
+	 * Without a thread pool it calls the function once for the whole range, so each call
+	 * records all the slices it's given, one command buffer each.
+	 */
+	parallelFor(theRecorder.threadPool, usedSlices, 1, [&](size_t firstSlice, size_t endSlice) {
+		for(size_t slice = firstSlice; slice < endSlice; slice++)
+		{
+			const VkCommandBuffer commandBuffer = frame.commandBuffers[slice];
+			const size_t firstDraw = slice * drawsPerSlice;
+			const size_t endDraw = std::min(firstDraw + drawsPerSlice, drawCount);
+
+			VkResult sliceResult = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+			assert(sliceResult == VK_SUCCESS);
+
+			recordFunction(commandBuffer, firstDraw, endDraw);
+
+			sliceResult = vkEndCommandBuffer(commandBuffer);
+			assert(sliceResult == VK_SUCCESS);
+		}
+	});
+
+	outCommandBuffers.assign(frame.commandBuffers.begin(), frame.commandBuffers.begin() + usedSlices);
+
+	theRecorder.recordedPasses++;
+	theRecorder.recordedSlices += usedSlices;
+	theRecorder.recordedDraws += drawCount;
+	return true;
+}
+
+
+
+/**
+ * Records a whole render pass in thePrimaryCommandBuffer: begins the render pass with
+ * secondary command buffer contents, records the draws in parallel with recordParallelDraws,
+ * executes them and ends the render pass.
+ */
+bool recordParallelRenderPass(ParallelCommandRecorder & theRecorder,
+                              const uint32_t frameIndex,
+                              const VkCommandBuffer thePrimaryCommandBuffer,
+                              const VkRenderPassBeginInfo & theRenderPassBeginInfo,
+                              const size_t drawCount,
+                              const size_t minDrawsPerSlice,
+                              const RecordDrawRangeFunction & recordFunction
+                              )
+{
+	std::vector<VkCommandBuffer> mySecondaryCommandBuffers;
+	if(!recordParallelDraws(theRecorder, frameIndex, theRenderPassBeginInfo.renderPass, 0, theRenderPassBeginInfo.framebuffer,
+	                        drawCount, minDrawsPerSlice, recordFunction, mySecondaryCommandBuffers))
+		return false;
+
+	vkCmdBeginRenderPass(thePrimaryCommandBuffer, &theRenderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	if(!mySecondaryCommandBuffers.empty())
+		vkCmdExecuteCommands(thePrimaryCommandBuffer, (uint32_t)mySecondaryCommandBuffers.size(), mySecondaryCommandBuffers.data());
+
+	vkCmdEndRenderPass(thePrimaryCommandBuffer);
+	return true;
+}
+
+
+
+/**
+ * Prints the number of passes, slices and draws recorded.
+ */
+void printParallelCommandRecorderStatistics(const ParallelCommandRecorder & theRecorder)
+{
+	std::cout << "--- Parallel command recording: " << theRecorder.recordedPasses << " passes, "
+	          << theRecorder.recordedDraws << " draws in "
+	          << theRecorder.recordedSlices << " secondary command buffers." << std::endl;
+}
+
+
+
+/**
+ * Destroys the command pools (and with them the secondary command buffers).
+ * The GPU must have finished executing them.
+ */
+void destroyParallelCommandRecorder(ParallelCommandRecorder & theRecorder, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	for(ParallelRecordingFrame & frame : theRecorder.frames)
+		for(VkCommandPool pool : frame.commandPools)
+			if(pool != VK_NULL_HANDLE)
+				vkDestroyCommandPool(theRecorder.device, pool, pAllocator);
+
+	theRecorder = ParallelCommandRecorder();
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef VKDEMOS_FRAMECOMMANDPOOL_H
+#define VKDEMOS_FRAMECOMMANDPOOL_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "00_utils.h"
+
+namespace vkdemos {
+
+/*
+ * Per-frame transient command pools.
+ *
+ * A pool created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT lets every command
+ * buffer be reset on its own (explicitly, or implicitly by vkBeginCommandBuffer), which forces
+ * the driver to track the memory of each buffer separately. Command buffers recorded every
+ * frame all live exactly one frame, so they can be reset together instead: each frame in
+ * flight owns a pool created with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT (a hint that its
+ * buffers are short-lived) and without the reset flag, and once the frame's fence has signaled
+ * the whole pool is reset with a single vkResetCommandPool, which lets the driver recycle
+ * the pool's memory in bulk.
+ *
+ * The command buffers aren't freed by the reset, just returned to the initial state:
+ * getFrameCommandBuffer hands them out again, in order, and only allocates new ones when a
+ * frame needs more than any previous frame did. After the first frames nothing is allocated.
+ */
+struct FrameCommandPool
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+
+	// All the buffers allocated from the pool; the ones after the "used" index are free.
+	std::vector<VkCommandBuffer> primaryBuffers;
+	std::vector<VkCommandBuffer> secondaryBuffers;
+	size_t usedPrimaryBuffers = 0;
+	size_t usedSecondaryBuffers = 0;
+
+	// Statistics.
+	uint64_t resetCount = 0;
+	uint64_t handedOutBuffers = 0;
+};
+
+
+
+/**
+ * Creates a transient command pool for one frame in flight.
+ */
+bool createFrameCommandPool(const VkDevice theDevice,
+                            const uint32_t theQueueFamilyIndex,
+                            FrameCommandPool & outFramePool,
+                            const VkAllocationCallbacks * pAllocator = nullptr
+                            )
+{
+	VkResult result;
+	FrameCommandPool myFramePool;
+
+	const VkCommandPoolCreateInfo commandPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = theQueueFamilyIndex,
+	};
+
+	result = vkCreateCommandPool(theDevice, &commandPoolCreateInfo, pAllocator, &myFramePool.commandPool);
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: failed to create a frame command pool: " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	myFramePool.device = theDevice;
+
+	outFramePool = myFramePool;
+	return true;
+}
+
+
+
+/**
+ * Resets all the command buffers of the pool at once, and makes them available again.
+ * The GPU must have finished executing them (i.e. the frame's fence has been waited on).
+ */
+void resetFrameCommandPool(FrameCommandPool & theFramePool)
+{
+	VkResult result;
+
+	result = vkResetCommandPool(theFramePool.device, theFramePool.commandPool, 0);
+	assert(result == VK_SUCCESS);
+
+	theFramePool.usedPrimaryBuffers = 0;
+	theFramePool.usedSecondaryBuffers = 0;
+	theFramePool.resetCount++;
+}
+
+
+
+/**
+ * Returns a command buffer of the given level in the initial state, ready to be recorded;
+ * it's valid until the next resetFrameCommandPool.
+ * Returns VK_NULL_HANDLE if a new buffer was needed and couldn't be allocated.
+ */
+VkCommandBuffer getFrameCommandBuffer(FrameCommandPool & theFramePool, const VkCommandBufferLevel theLevel)
+{
+	VkResult result;
+
+	const bool isPrimary = (theLevel == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	std::vector<VkCommandBuffer> & buffers = isPrimary ? theFramePool.primaryBuffers : theFramePool.secondaryBuffers;
+	size_t & usedBuffers = isPrimary ? theFramePool.usedPrimaryBuffers : theFramePool.usedSecondaryBuffers;
+
+	if(usedBuffers == buffers.size())
+	{
+		const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.commandPool = theFramePool.commandPool,
+			.level = theLevel,
+			.commandBufferCount = 1
+		};
+
+		VkCommandBuffer myCommandBuffer;
+		result = vkAllocateCommandBuffers(theFramePool.device, &commandBufferAllocateInfo, &myCommandBuffer);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: failed to allocate a frame command buffer: " << vkdemos::utils::VkResultToString(result) << std::endl;
+			return VK_NULL_HANDLE;
+		}
+
+		buffers.push_back(myCommandBuffer);
+	}
+
+	theFramePool.handedOutBuffers++;
+	return buffers[usedBuffers++];
+}
+
+
+
+/**
+ * Prints the number of resets and buffers handed out, against the buffers actually allocated.
+ */
+void printFrameCommandPoolStatistics(const FrameCommandPool & theFramePool, const std::string & theName)
+{
+	std::cout << "--- " << theName << ": " << theFramePool.resetCount << " resets, "
+	          << theFramePool.handedOutBuffers << " command buffers handed out, "
+	          << theFramePool.primaryBuffers.size() + theFramePool.secondaryBuffers.size() << " allocated." << std::endl;
+}
+
+
+
+/**
+ * Destroys the pool, and with it all its command buffers.
+ * The GPU must have finished executing them.
+ */
+void destroyFrameCommandPool(FrameCommandPool & theFramePool, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	if(theFramePool.commandPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(theFramePool.device, theFramePool.commandPool, pAllocator);
+
+	theFramePool = FrameCommandPool();
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,461 @@
+#ifndef VKDEMOS_STATEFILTERINGRECORDER_H
+#define VKDEMOS_STATEFILTERINGRECORDER_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+namespace vkdemos {
+
+/*
+ * A command recorder filtering redundant state changes.
+ *
+ * A renderer drawing many objects usually sets all the state each object needs before its
+ * draw: pipeline, descriptor sets, vertex and index buffers, viewport, scissor and push
+ * constants, even when the previous object already set the same values. Every vkCmd* call
+ * costs CPU time to record and often to validate in the driver, even if it changes nothing.
+ *
+ * The recorder keeps a shadow copy of the state bound in a command buffer, and the record*
+ * functions only call the vkCmd* function when the state actually changes; the others are
+ * counted as elided. Draw and other commands are recorded directly in recorder.commandBuffer.
+ *
+ * The shadow state must match the command buffer: call beginStateFilteringRecorder after
+ * vkBeginCommandBuffer (the state is undefined at the beginning of a command buffer), and
+ * invalidateRecorderState after anything changing the state behind the recorder's back, like
+ * vkCmdExecuteCommands or a vkCmd* call made directly.
+ *
+ * The filtering is conservative: descriptor sets and push constants are only compared when
+ * they're bound with the same pipeline layout, viewports and scissors are forgotten when the
+ * graphics pipeline changes, a call is either elided as a whole or recorded
+ * as a whole, and calls beyond the RECORDER_MAX_* limits are always recorded (and make the
+ * recorder forget the state they may have changed).
+ */
+constexpr uint32_t RECORDER_MAX_VIEWPORTS = 16;
+constexpr uint32_t RECORDER_MAX_VERTEX_BINDINGS = 16;
+constexpr uint32_t RECORDER_MAX_DESCRIPTOR_SETS = 8;
+constexpr uint32_t RECORDER_MAX_PUSH_CONSTANTS_SIZE = 256;
+constexpr uint32_t RECORDER_BIND_POINT_COUNT = 2;     // graphics and compute.
+
+enum RecorderStateCategory
+{
+	RECORDER_STATE_PIPELINE,
+	RECORDER_STATE_VIEWPORT,
+	RECORDER_STATE_SCISSOR,
+	RECORDER_STATE_VERTEX_BUFFERS,
+	RECORDER_STATE_INDEX_BUFFER,
+	RECORDER_STATE_DESCRIPTOR_SETS,
+	RECORDER_STATE_PUSH_CONSTANTS,
+	RECORDER_STATE_CATEGORY_COUNT
+};
+
+struct StateFilteringStatistics
+{
+	uint64_t recorded[RECORDER_STATE_CATEGORY_COUNT] = {};
+	uint64_t elided[RECORDER_STATE_CATEGORY_COUNT] = {};
+};
+
+struct RecorderDescriptorSetState
+{
+	bool valid = false;
+	VkPipelineLayout layout;
+	VkDescriptorSet set;
+
+	// The call that bound the set: the dynamic offsets belong to all the sets of the call,
+	// so a call with dynamic offsets is only redundant if it's the same call.
+	uint32_t callFirstSet;
+	uint32_t callSetCount;
+	std::vector<uint32_t> callDynamicOffsets;
+};
+
+struct StateFilteringRecorder
+{
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+	VkPipeline pipelines[RECORDER_BIND_POINT_COUNT];
+	bool pipelineValid[RECORDER_BIND_POINT_COUNT] = {};
+
+	VkViewport viewports[RECORDER_MAX_VIEWPORTS];
+	bool viewportValid[RECORDER_MAX_VIEWPORTS] = {};
+	VkRect2D scissors[RECORDER_MAX_VIEWPORTS];
+	bool scissorValid[RECORDER_MAX_VIEWPORTS] = {};
+
+	VkBuffer vertexBuffers[RECORDER_MAX_VERTEX_BINDINGS];
+	VkDeviceSize vertexBufferOffsets[RECORDER_MAX_VERTEX_BINDINGS];
+	bool vertexBufferValid[RECORDER_MAX_VERTEX_BINDINGS] = {};
+
+	VkBuffer indexBuffer;
+	VkDeviceSize indexBufferOffset;
+	VkIndexType indexType;
+	bool indexBufferValid = false;
+
+	RecorderDescriptorSetState descriptorSets[RECORDER_BIND_POINT_COUNT][RECORDER_MAX_DESCRIPTOR_SETS];
+
+	// Each byte of push constants has one known value, for the stages in pushConstantStages.
+	VkPipelineLayout pushConstantLayout = VK_NULL_HANDLE;
+	uint8_t pushConstantData[RECORDER_MAX_PUSH_CONSTANTS_SIZE];
+	VkShaderStageFlags pushConstantStages[RECORDER_MAX_PUSH_CONSTANTS_SIZE] = {};
+
+	StateFilteringStatistics statistics;
+};
+
+
+
+/**
+ * Forgets all the shadow state: the next record* call of each kind is always recorded.
+ */
+void invalidateRecorderState(StateFilteringRecorder & theRecorder)
+{
+	std::fill(std::begin(theRecorder.pipelineValid), std::end(theRecorder.pipelineValid), false);
+	std::fill(std::begin(theRecorder.viewportValid), std::end(theRecorder.viewportValid), false);
+	std::fill(std::begin(theRecorder.scissorValid), std::end(theRecorder.scissorValid), false);
+	std::fill(std::begin(theRecorder.vertexBufferValid), std::end(theRecorder.vertexBufferValid), false);
+	theRecorder.indexBufferValid = false;
+
+	for(auto & bindPointSets : theRecorder.descriptorSets)
+		for(RecorderDescriptorSetState & setState : bindPointSets)
+			setState.valid = false;
+
+	theRecorder.pushConstantLayout = VK_NULL_HANDLE;
+	std::fill(std::begin(theRecorder.pushConstantStages), std::end(theRecorder.pushConstantStages), 0);
+}
+
+
+
+/**
+ * Starts recording in theCommandBuffer (already begun) with an unknown state.
+ * The statistics keep accumulating across command buffers.
+ */
+void beginStateFilteringRecorder(StateFilteringRecorder & theRecorder, const VkCommandBuffer theCommandBuffer)
+{
+	theRecorder.commandBuffer = theCommandBuffer;
+	invalidateRecorderState(theRecorder);
+}
+
+
+
+/* Shadow state index of a bind point; returns false for bind points the recorder doesn't know. */
+static bool getRecorderBindPointIndex(const VkPipelineBindPoint theBindPoint, uint32_t & outIndex)
+{
+	if(theBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+		outIndex = 0;
+	else if(theBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)
+		outIndex = 1;
+	else
+		return false;
+
+	return true;
+}
+
+
+
+/**
+ * vkCmdBindPipeline, unless the pipeline is already bound.
+ * Binding a graphics pipeline whose viewport and scissor are static overwrites them, and the
+ * recorder doesn't know which state a pipeline has as dynamic: every graphics pipeline change
+ * makes it forget the viewports and scissors.
+ */
+void recordBindPipeline(StateFilteringRecorder & theRecorder, const VkPipelineBindPoint theBindPoint, const VkPipeline thePipeline)
+{
+	uint32_t bindPointIndex;
+	const bool known = getRecorderBindPointIndex(theBindPoint, bindPointIndex);
+
+	if(known && theRecorder.pipelineValid[bindPointIndex] && theRecorder.pipelines[bindPointIndex] == thePipeline) {
+		theRecorder.statistics.elided[RECORDER_STATE_PIPELINE]++;
+		return;
+	}
+
+	vkCmdBindPipeline(theRecorder.commandBuffer, theBindPoint, thePipeline);
+	theRecorder.statistics.recorded[RECORDER_STATE_PIPELINE]++;
+
+	if(known) {
+		theRecorder.pipelines[bindPointIndex] = thePipeline;
+		theRecorder.pipelineValid[bindPointIndex] = true;
+	}
+
+	if(theBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+		std::fill(std::begin(theRecorder.viewportValid), std::end(theRecorder.viewportValid), false);
+		std::fill(std::begin(theRecorder.scissorValid), std::end(theRecorder.scissorValid), false);
+	}
+}
+
+
+
+/**
+ * vkCmdSetViewport, unless all the viewports are already set to the same values.
+ */
+void recordSetViewport(StateFilteringRecorder & theRecorder, const uint32_t firstViewport, const uint32_t viewportCount, const VkViewport * pViewports)
+{
+	const bool tracked = (firstViewport + viewportCount <= RECORDER_MAX_VIEWPORTS);
+
+	if(tracked)
+	{
+		bool redundant = true;
+		for(uint32_t i = 0; i < viewportCount && redundant; i++)
+			redundant = theRecorder.viewportValid[firstViewport + i] && memcmp(&theRecorder.viewports[firstViewport + i], &pViewports[i], sizeof(VkViewport)) == 0;
+
+		if(redundant) {
+			theRecorder.statistics.elided[RECORDER_STATE_VIEWPORT]++;
+			return;
+		}
+
+		for(uint32_t i = 0; i < viewportCount; i++) {
+			theRecorder.viewports[firstViewport + i] = pViewports[i];
+			theRecorder.viewportValid[firstViewport + i] = true;
+		}
+	}
+	else
+		for(uint32_t i = firstViewport; i < RECORDER_MAX_VIEWPORTS; i++)
+			theRecorder.viewportValid[i] = false;
+
+	vkCmdSetViewport(theRecorder.commandBuffer, firstViewport, viewportCount, pViewports);
+	theRecorder.statistics.recorded[RECORDER_STATE_VIEWPORT]++;
+}
+
+
+
+/**
+ * vkCmdSetScissor, unless all the scissors are already set to the same values.
+ */
+void recordSetScissor(StateFilteringRecorder & theRecorder, const uint32_t firstScissor, const uint32_t scissorCount, const VkRect2D * pScissors)
+{
+	const bool tracked = (firstScissor + scissorCount <= RECORDER_MAX_VIEWPORTS);
+
+	if(tracked)
+	{
+		bool redundant = true;
+		for(uint32_t i = 0; i < scissorCount && redundant; i++)
+			redundant = theRecorder.scissorValid[firstScissor + i] && memcmp(&theRecorder.scissors[firstScissor + i], &pScissors[i], sizeof(VkRect2D)) == 0;
+
+		if(redundant) {
+			theRecorder.statistics.elided[RECORDER_STATE_SCISSOR]++;
+			return;
+		}
+
+		for(uint32_t i = 0; i < scissorCount; i++) {
+			theRecorder.scissors[firstScissor + i] = pScissors[i];
+			theRecorder.scissorValid[firstScissor + i] = true;
+		}
+	}
+	else
+		for(uint32_t i = firstScissor; i < RECORDER_MAX_VIEWPORTS; i++)
+			theRecorder.scissorValid[i] = false;
+
+	vkCmdSetScissor(theRecorder.commandBuffer, firstScissor, scissorCount, pScissors);
+	theRecorder.statistics.recorded[RECORDER_STATE_SCISSOR]++;
+}
+
+
+
+/**
+ * vkCmdBindVertexBuffers, unless all the bindings already have the same buffers and offsets.
+ */
+void recordBindVertexBuffers(StateFilteringRecorder & theRecorder,
+                             const uint32_t firstBinding,
+                             const uint32_t bindingCount,
+                             const VkBuffer * pBuffers,
+                             const VkDeviceSize * pOffsets)
+{
+	const bool tracked = (firstBinding + bindingCount <= RECORDER_MAX_VERTEX_BINDINGS);
+
+	if(tracked)
+	{
+		bool redundant = true;
+		for(uint32_t i = 0; i < bindingCount && redundant; i++) {
+			const uint32_t binding = firstBinding + i;
+			redundant = theRecorder.vertexBufferValid[binding]
+			            && theRecorder.vertexBuffers[binding] == pBuffers[i]
+			            && theRecorder.vertexBufferOffsets[binding] == pOffsets[i];
+		}
+
+		if(redundant) {
+			theRecorder.statistics.elided[RECORDER_STATE_VERTEX_BUFFERS]++;
+			return;
+		}
+
+		for(uint32_t i = 0; i < bindingCount; i++) {
+			theRecorder.vertexBuffers[firstBinding + i] = pBuffers[i];
+			theRecorder.vertexBufferOffsets[firstBinding + i] = pOffsets[i];
+			theRecorder.vertexBufferValid[firstBinding + i] = true;
+		}
+	}
+	else
+		for(uint32_t i = firstBinding; i < RECORDER_MAX_VERTEX_BINDINGS; i++)
+			theRecorder.vertexBufferValid[i] = false;
+
+	vkCmdBindVertexBuffers(theRecorder.commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+	theRecorder.statistics.recorded[RECORDER_STATE_VERTEX_BUFFERS]++;
+}
+
+
+
+/**
+ * vkCmdBindIndexBuffer, unless the same buffer, offset and index type are already bound.
+ */
+void recordBindIndexBuffer(StateFilteringRecorder & theRecorder, const VkBuffer theBuffer, const VkDeviceSize theOffset, const VkIndexType theIndexType)
+{
+	if(theRecorder.indexBufferValid
+	   && theRecorder.indexBuffer == theBuffer
+	   && theRecorder.indexBufferOffset == theOffset
+	   && theRecorder.indexType == theIndexType)
+	{
+		theRecorder.statistics.elided[RECORDER_STATE_INDEX_BUFFER]++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(theRecorder.commandBuffer, theBuffer, theOffset, theIndexType);
+	theRecorder.statistics.recorded[RECORDER_STATE_INDEX_BUFFER]++;
+
+	theRecorder.indexBuffer = theBuffer;
+	theRecorder.indexBufferOffset = theOffset;
+	theRecorder.indexType = theIndexType;
+	theRecorder.indexBufferValid = true;
+}
+
+
+
+/**
+ * vkCmdBindDescriptorSets, unless all the sets are already bound with the same layout
+ * (and, with dynamic offsets, by an identical call).
+ */
+void recordBindDescriptorSets(StateFilteringRecorder & theRecorder,
+                              const VkPipelineBindPoint theBindPoint,
+                              const VkPipelineLayout theLayout,
+                              const uint32_t firstSet,
+                              const uint32_t descriptorSetCount,
+                              const VkDescriptorSet * pDescriptorSets,
+                              const uint32_t dynamicOffsetCount,
+                              const uint32_t * pDynamicOffsets)
+{
+	uint32_t bindPointIndex;
+	const bool tracked = getRecorderBindPointIndex(theBindPoint, bindPointIndex) && (firstSet + descriptorSetCount <= RECORDER_MAX_DESCRIPTOR_SETS);
+
+	if(tracked)
+	{
+		RecorderDescriptorSetState * setStates = theRecorder.descriptorSets[bindPointIndex];
+
+		bool redundant = true;
+		for(uint32_t i = 0; i < descriptorSetCount && redundant; i++)
+		{
+			const RecorderDescriptorSetState & setState = setStates[firstSet + i];
+			redundant = setState.valid && setState.layout == theLayout && setState.set == pDescriptorSets[i];
+
+			if(redundant && dynamicOffsetCount > 0)
+				redundant = setState.callFirstSet == firstSet
+				            && setState.callSetCount == descriptorSetCount
+				            && setState.callDynamicOffsets.size() == dynamicOffsetCount
+				            && std::equal(pDynamicOffsets, pDynamicOffsets + dynamicOffsetCount, setState.callDynamicOffsets.begin());
+		}
+
+		if(redundant) {
+			theRecorder.statistics.elided[RECORDER_STATE_DESCRIPTOR_SETS]++;
+			return;
+		}
+
+		// Binding with a different layout may disturb the sets bound with the old one.
+		for(uint32_t set = 0; set < RECORDER_MAX_DESCRIPTOR_SETS; set++)
+			if(setStates[set].valid && setStates[set].layout != theLayout)
+				setStates[set].valid = false;
+
+		for(uint32_t i = 0; i < descriptorSetCount; i++) {
+			RecorderDescriptorSetState & setState = setStates[firstSet + i];
+			setState.valid = true;
+			setState.layout = theLayout;
+			setState.set = pDescriptorSets[i];
+			setState.callFirstSet = firstSet;
+			setState.callSetCount = descriptorSetCount;
+			setState.callDynamicOffsets.assign(pDynamicOffsets, pDynamicOffsets + dynamicOffsetCount);
+		}
+	}
+	else if(getRecorderBindPointIndex(theBindPoint, bindPointIndex))
+		for(RecorderDescriptorSetState & setState : theRecorder.descriptorSets[bindPointIndex])
+			setState.valid = false;
+
+	vkCmdBindDescriptorSets(theRecorder.commandBuffer, theBindPoint, theLayout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+	theRecorder.statistics.recorded[RECORDER_STATE_DESCRIPTOR_SETS]++;
+}
+
+
+
+/**
+ * vkCmdPushConstants, unless every byte already has the same value for all theStageFlags,
+ * pushed with the same layout.
+ */
+void recordPushConstants(StateFilteringRecorder & theRecorder,
+                         const VkPipelineLayout theLayout,
+                         const VkShaderStageFlags theStageFlags,
+                         const uint32_t theOffset,
+                         const uint32_t theSize,
+                         const void * pValues)
+{
+	const uint8_t * values = (const uint8_t*)pValues;
+	const bool tracked = (theOffset + theSize <= RECORDER_MAX_PUSH_CONSTANTS_SIZE);
+
+	if(tracked)
+	{
+		if(theRecorder.pushConstantLayout != theLayout) {
+			theRecorder.pushConstantLayout = theLayout;
+			std::fill(std::begin(theRecorder.pushConstantStages), std::end(theRecorder.pushConstantStages), 0);
+		}
+
+		bool redundant = true;
+		for(uint32_t i = 0; i < theSize && redundant; i++)
+			redundant = (theRecorder.pushConstantStages[theOffset + i] & theStageFlags) == theStageFlags
+			            && theRecorder.pushConstantData[theOffset + i] == values[i];
+
+		if(redundant) {
+			theRecorder.statistics.elided[RECORDER_STATE_PUSH_CONSTANTS]++;
+			return;
+		}
+
+		// A byte keeps a single known value: pushing a different one forgets the other stages.
+		for(uint32_t i = 0; i < theSize; i++) {
+			const uint32_t byte = theOffset + i;
+			if(theRecorder.pushConstantData[byte] == values[i])
+				theRecorder.pushConstantStages[byte] |= theStageFlags;
+			else {
+				theRecorder.pushConstantData[byte] = values[i];
+				theRecorder.pushConstantStages[byte] = theStageFlags;
+			}
+		}
+	}
+	else
+		theRecorder.pushConstantLayout = VK_NULL_HANDLE;
+
+	vkCmdPushConstants(theRecorder.commandBuffer, theLayout, theStageFlags, theOffset, theSize, pValues);
+	theRecorder.statistics.recorded[RECORDER_STATE_PUSH_CONSTANTS]++;
+}
+
+
+
+/**
+ * Prints, for each kind of state, how many calls were recorded and how many were elided.
+ */
+void printStateFilteringStatistics(const StateFilteringStatistics & theStatistics, const std::string & theName)
+{
+	static const char * categoryNames[RECORDER_STATE_CATEGORY_COUNT] = {
+		"pipeline", "viewport", "scissor", "vertex buffers", "index buffer", "descriptor sets", "push constants"
+	};
+
+	uint64_t totalRecorded = 0, totalElided = 0;
+
+	std::cout << "--- " << theName << ": state changes recorded / elided:" << std::endl;
+	for(int i = 0; i < RECORDER_STATE_CATEGORY_COUNT; i++)
+	{
+		totalRecorded += theStatistics.recorded[i];
+		totalElided += theStatistics.elided[i];
+
+		if(theStatistics.recorded[i] + theStatistics.elided[i] > 0)
+			std::cout << "    " << categoryNames[i] << ": " << theStatistics.recorded[i] << " / " << theStatistics.elided[i] << std::endl;
+	}
+
+	std::cout << "    total: " << totalRecorded << " / " << totalElided << std::endl;
+}
+
+}	// vkdemos
+
+#endif
@@ -0,0 +1,559 @@
+#ifndef VKDEMOS_RESOURCESTATETRACKER_H
+#define VKDEMOS_RESOURCESTATETRACKER_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <cassert>
+#include <cstdint>
+
+namespace vkdemos {
+
+/*
+ * Automatic resource state tracking.
+ *
+ * Writing barriers by hand means knowing, at every use of an image or buffer, how it was last
+ * used: its layout, the pipeline stages that accessed it and whether they wrote it. Getting one
+ * wrong is a data race; playing safe (TOP_OF_PIPE/ALL_COMMANDS, or a barrier per resource)
+ * serializes work that could overlap.
+ *
+ * The tracker remembers that state for every image subresource (mip level and array layer)
+ * and buffer it knows. Before recording commands, declare how they use each resource with
+ * useImage/useBuffer, passing one of the ResourceUsage values; the tracker works out the
+ * barrier each use needs, if any:
+ *  - a layout change always needs one, waiting for the previous readers and writers;
+ *  - a write needs one if anything accessed the resource before (write-after-read only needs
+ *    an execution dependency, write-after-write also makes the previous write available);
+ *  - a read needs one only if the last write hasn't already been made visible to its stage
+ *    and access type by a previous barrier; reads after reads never need one.
+ * The barriers are not recorded immediately: flushResourceBarriers records all the pending
+ * ones in a single vkCmdPipelineBarrier, with the union of their stage masks, and merges the
+ * barriers of neighbouring subresources of an image in one VkImageMemoryBarrier.
+ *
+ * All the uses declared between two flushes are of commands recorded after the second one,
+ * so they may run concurrently: a subresource can be read by several of them, but not written
+ * or transitioned to two layouts. The tracked state follows the order of recording, so the
+ * command buffers must be submitted in the same order (or the state be tracked per command
+ * buffer). Queue family ownership transfers are not handled.
+ */
+enum ResourceUsage
+{
+	RESOURCE_USAGE_TRANSFER_READ,
+	RESOURCE_USAGE_TRANSFER_WRITE,
+	RESOURCE_USAGE_VERTEX_BUFFER,
+	RESOURCE_USAGE_INDEX_BUFFER,
+	RESOURCE_USAGE_INDIRECT_BUFFER,
+	RESOURCE_USAGE_UNIFORM_BUFFER_GRAPHICS,     // read in the vertex and fragment shaders.
+	RESOURCE_USAGE_UNIFORM_BUFFER_COMPUTE,
+	RESOURCE_USAGE_SAMPLED_FRAGMENT,
+	RESOURCE_USAGE_SAMPLED_COMPUTE,
+	RESOURCE_USAGE_STORAGE_READ_FRAGMENT,
+	RESOURCE_USAGE_STORAGE_READ_COMPUTE,
+	RESOURCE_USAGE_STORAGE_WRITE_COMPUTE,
+	RESOURCE_USAGE_STORAGE_READ_WRITE_COMPUTE,
+	RESOURCE_USAGE_COLOR_ATTACHMENT,
+	RESOURCE_USAGE_DEPTH_ATTACHMENT,
+	RESOURCE_USAGE_DEPTH_ATTACHMENT_READ_ONLY,
+	RESOURCE_USAGE_PRESENT,
+	RESOURCE_USAGE_HOST_READ,
+	RESOURCE_USAGE_COUNT
+};
+
+struct ResourceUsageInfo
+{
+	VkPipelineStageFlags stageMask;
+	VkAccessFlags accessMask;
+	VkImageLayout imageLayout;     // ignored for buffers.
+	bool isWrite;
+};
+
+constexpr VkAccessFlags RESOURCE_WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                                                   | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                                                   | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+/* State of an image subresource, or of a whole buffer. */
+struct TrackedResourceState
+{
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags writeStages = 0;      // stages of the last write (or layout transition).
+	VkAccessFlags writeAccess = 0;             // accesses of the last write, not yet made available.
+	VkPipelineStageFlags readStages = 0;       // stages that read the resource since the last write.
+	VkPipelineStageFlags visibleStages = 0;    // stages and accesses the last write was made visible to.
+	VkAccessFlags visibleAccess = 0;
+
+	// Flush interval of the last use, to catch conflicting uses between two flushes.
+	uint64_t lastUseEpoch = 0;
+	bool lastUseConflicts = false;             // it was a write or a layout transition.
+};
+
+struct TrackedImage
+{
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+	std::vector<TrackedResourceState> subresources;     // [mipLevel * arrayLayers + arrayLayer]
+};
+
+struct ResourceTrackerStatistics
+{
+	uint64_t uses = 0;
+	uint64_t elidedBarriers = 0;       // uses (of a subresource) that didn't need a barrier.
+	uint64_t imageBarriers = 0;
+	uint64_t bufferBarriers = 0;
+	uint64_t pipelineBarrierCalls = 0;
+};
+
+struct ResourceStateTracker
+{
+	std::unordered_map<VkImage, TrackedImage> images;
+	std::unordered_map<VkBuffer, TrackedResourceState> buffers;
+
+	// Barriers waiting for the next flush.
+	std::vector<VkImageMemoryBarrier> pendingImageBarriers;
+	std::vector<VkBufferMemoryBarrier> pendingBufferBarriers;
+	VkPipelineStageFlags pendingSrcStageMask = 0;
+	VkPipelineStageFlags pendingDstStageMask = 0;
+	uint64_t epoch = 1;
+
+	ResourceTrackerStatistics statistics;
+};
+
+
+
+/**
+ * Returns the stages, accesses and image layout of a kind of use.
+ */
+ResourceUsageInfo getResourceUsageInfo(const ResourceUsage theUsage)
+{
+	static const ResourceUsageInfo usageInfos[RESOURCE_USAGE_COUNT] = {
+		/* TRANSFER_READ */ {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false},
+		/* TRANSFER_WRITE */ {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true},
+		/* VERTEX_BUFFER */ {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+		/* INDEX_BUFFER */ {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+		/* INDIRECT_BUFFER */ {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+		/* UNIFORM_BUFFER_GRAPHICS */ {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+		/* UNIFORM_BUFFER_COMPUTE */ {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+		/* SAMPLED_FRAGMENT */ {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false},
+		/* SAMPLED_COMPUTE */ {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false},
+		/* STORAGE_READ_FRAGMENT */ {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false},
+		/* STORAGE_READ_COMPUTE */ {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false},
+		/* STORAGE_WRITE_COMPUTE */ {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true},
+		/* STORAGE_READ_WRITE_COMPUTE */ {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true},
+		/* COLOR_ATTACHMENT */ {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true},
+		/* DEPTH_ATTACHMENT */ {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true},
+		/* DEPTH_ATTACHMENT_READ_ONLY */ {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false},
+		// The presentation engine waits on a semaphore: the barrier only needs the layout transition.
+		/* PRESENT */ {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false},
+		/* HOST_READ */ {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false},
+	};
+
+	assert(theUsage >= 0 && theUsage < RESOURCE_USAGE_COUNT);
+	return usageInfos[theUsage];
+}
+
+
+
+/**
+ * Starts tracking an image, whose subresources are all in theInitialLayout.
+ * theInitialStageMask are the stages the first barrier must wait for: 0 for a new image, the
+ * pWaitDstStageMask of the acquire semaphore for a swapchain image.
+ */
+void trackImage(ResourceStateTracker & theTracker,
+                const VkImage theImage,
+                const uint32_t theMipLevels,
+                const uint32_t theArrayLayers,
+                const VkImageLayout theInitialLayout,
+                const VkPipelineStageFlags theInitialStageMask = 0
+                )
+{
+	TrackedResourceState initialState;
+	initialState.layout = theInitialLayout;
+	initialState.writeStages = theInitialStageMask;
+
+	TrackedImage & myImage = theTracker.images[theImage];
+	myImage.mipLevels = theMipLevels;
+	myImage.arrayLayers = theArrayLayers;
+	myImage.subresources.assign(theMipLevels * theArrayLayers, initialState);
+}
+
+
+
+/**
+ * Starts tracking a buffer, whose content hasn't been accessed by the GPU yet.
+ */
+void trackBuffer(ResourceStateTracker & theTracker, const VkBuffer theBuffer)
+{
+	theTracker.buffers[theBuffer] = TrackedResourceState();
+}
+
+
+
+/**
+ * Stops tracking an image or a buffer, e.g. before destroying it.
+ */
+void untrackImage(ResourceStateTracker & theTracker, const VkImage theImage)
+{
+	theTracker.images.erase(theImage);
+}
+
+void untrackBuffer(ResourceStateTracker & theTracker, const VkBuffer theBuffer)
+{
+	theTracker.buffers.erase(theBuffer);
+}
+
+
+
+/*
+ * Updates the state of a subresource for a use, and computes the barrier it needs.
+ * Returns false if no barrier is needed.
+ */
+static bool transitionTrackedState(ResourceStateTracker & theTracker,
+                                   TrackedResourceState & theState,
+                                   const ResourceUsageInfo & theUsageInfo,
+                                   const bool isImage,
+                                   VkPipelineStageFlags & outSrcStageMask,
+                                   VkAccessFlags & outSrcAccessMask,
+                                   VkImageLayout & outOldLayout
+                                   )
+{
+	const bool layoutChange = isImage && (theUsageInfo.imageLayout != theState.layout);
+	const bool conflicts = theUsageInfo.isWrite || layoutChange;
+
+	// Uses declared between two flushes run concurrently: only reads of the same layout can share a subresource.
+	assert(theState.lastUseEpoch != theTracker.epoch || (!conflicts && !theState.lastUseConflicts));
+	theState.lastUseEpoch = theTracker.epoch;
+	theState.lastUseConflicts = conflicts;
+
+	outOldLayout = theState.layout;
+
+	if(conflicts)
+	{
+		// Wait for everything that accessed the resource, and make the last write available.
+		outSrcStageMask = theState.writeStages | theState.readStages;
+		outSrcAccessMask = theState.writeAccess;
+
+		theState.layout = isImage ? theUsageInfo.imageLayout : theState.layout;
+		theState.writeStages = theUsageInfo.stageMask;
+		theState.readStages = 0;
+
+		if(theUsageInfo.isWrite) {
+			theState.writeAccess = theUsageInfo.accessMask & RESOURCE_WRITE_ACCESS_MASK;
+			theState.visibleStages = 0;
+			theState.visibleAccess = 0;
+		}
+		else {
+			// A layout transition for a read: the barrier makes it visible to the reader.
+			theState.writeAccess = 0;
+			theState.visibleStages = theUsageInfo.stageMask;
+			theState.visibleAccess = theUsageInfo.accessMask;
+			theState.readStages = theUsageInfo.stageMask;
+		}
+
+		return layoutChange || outSrcStageMask != 0;
+	}
+
+	// A read: it needs a barrier only if the last write isn't visible to it yet.
+	const bool needsBarrier = theState.writeStages != 0
+	                       && ((theUsageInfo.stageMask & ~theState.visibleStages) != 0 || (theUsageInfo.accessMask & ~theState.visibleAccess) != 0);
+
+	theState.readStages |= theUsageInfo.stageMask;
+
+	if(!needsBarrier)
+		return false;
+
+	outSrcStageMask = theState.writeStages;
+	outSrcAccessMask = theState.writeAccess;
+	theState.visibleStages |= theUsageInfo.stageMask;
+	theState.visibleAccess |= theUsageInfo.accessMask;
+	return true;
+}
+
+
+
+/*
+ * Appends an image barrier to the pending ones, extending the last one instead if it's
+ * the same transition of the next array layers of the same mip levels.
+ */
+static bool isSameImageTransition(const VkImageMemoryBarrier & theFirst, const VkImageMemoryBarrier & theSecond)
+{
+	return theFirst.image == theSecond.image
+	    && theFirst.srcAccessMask == theSecond.srcAccessMask && theFirst.dstAccessMask == theSecond.dstAccessMask
+	    && theFirst.oldLayout == theSecond.oldLayout && theFirst.newLayout == theSecond.newLayout
+	    && theFirst.subresourceRange.aspectMask == theSecond.subresourceRange.aspectMask;
+}
+
+static void appendImageBarrier(ResourceStateTracker & theTracker, const VkImageMemoryBarrier & theBarrier)
+{
+	if(!theTracker.pendingImageBarriers.empty())
+	{
+		VkImageMemoryBarrier & last = theTracker.pendingImageBarriers.back();
+		VkImageSubresourceRange & lastRange = last.subresourceRange;
+		const VkImageSubresourceRange & range = theBarrier.subresourceRange;
+
+		if(isSameImageTransition(last, theBarrier) && lastRange.baseMipLevel == range.baseMipLevel && lastRange.levelCount == range.levelCount
+		   && lastRange.baseArrayLayer + lastRange.layerCount == range.baseArrayLayer) {
+			lastRange.layerCount += range.layerCount;
+			return;
+		}
+	}
+
+	theTracker.pendingImageBarriers.push_back(theBarrier);
+}
+
+
+
+/*
+ * Merges the last two pending image barriers if they're the same transition of the same
+ * array layers of consecutive mip levels; called after appending the barriers of a mip level.
+ */
+static void mergeLastImageBarrierLevels(ResourceStateTracker & theTracker)
+{
+	const size_t barrierCount = theTracker.pendingImageBarriers.size();
+	if(barrierCount < 2)
+		return;
+
+	VkImageMemoryBarrier & previous = theTracker.pendingImageBarriers[barrierCount - 2];
+	const VkImageMemoryBarrier & last = theTracker.pendingImageBarriers[barrierCount - 1];
+	VkImageSubresourceRange & previousRange = previous.subresourceRange;
+	const VkImageSubresourceRange & lastRange = last.subresourceRange;
+
+	if(isSameImageTransition(previous, last) && previousRange.baseArrayLayer == lastRange.baseArrayLayer && previousRange.layerCount == lastRange.layerCount
+	   && previousRange.baseMipLevel + previousRange.levelCount == lastRange.baseMipLevel) {
+		previousRange.levelCount += lastRange.levelCount;
+		theTracker.pendingImageBarriers.pop_back();
+	}
+}
+
+
+
+/*
+ * Lets another reader of the same flush interval share a pending layout transition for a
+ * read (a second barrier of the subresource would transition it twice): widens the pending
+ * barrier of the subresource to the new reader's stage and access.
+ */
+static void widenPendingImageBarrier(ResourceStateTracker & theTracker,
+                                     TrackedResourceState & theState,
+                                     const VkImage theImage,
+                                     const uint32_t theMipLevel,
+                                     const uint32_t theArrayLayer,
+                                     const ResourceUsageInfo & theUsageInfo
+                                     )
+{
+	for(auto barrierIt = theTracker.pendingImageBarriers.rbegin(); barrierIt != theTracker.pendingImageBarriers.rend(); ++barrierIt)
+	{
+		const VkImageSubresourceRange & range = barrierIt->subresourceRange;
+
+		if(barrierIt->image == theImage
+		   && theMipLevel >= range.baseMipLevel && theMipLevel < range.baseMipLevel + range.levelCount
+		   && theArrayLayer >= range.baseArrayLayer && theArrayLayer < range.baseArrayLayer + range.layerCount) {
+			barrierIt->dstAccessMask |= theUsageInfo.accessMask;
+			break;
+		}
+	}
+
+	theTracker.pendingDstStageMask |= theUsageInfo.stageMask;
+
+	theState.writeStages |= theUsageInfo.stageMask;
+	theState.readStages |= theUsageInfo.stageMask;
+	theState.visibleStages |= theUsageInfo.stageMask;
+	theState.visibleAccess |= theUsageInfo.accessMask;
+}
+
+
+
+/**
+ * Declares that the next commands use theSubresourceRange of an image (VK_REMAINING_MIP_LEVELS
+ * and VK_REMAINING_ARRAY_LAYERS are allowed) as theUsage, and queues the barriers they need.
+ * Returns false if the image isn't tracked.
+ */
+bool useImage(ResourceStateTracker & theTracker,
+              const VkImage theImage,
+              const VkImageSubresourceRange & theSubresourceRange,
+              const ResourceUsage theUsage
+              )
+{
+	auto imageIt = theTracker.images.find(theImage);
+	if(imageIt == theTracker.images.end()) {
+		std::cout << "!!! ERROR: useImage called on an image that isn't tracked." << std::endl;
+		return false;
+	}
+
+	TrackedImage & myImage = imageIt->second;
+	const ResourceUsageInfo usageInfo = getResourceUsageInfo(theUsage);
+
+	const uint32_t levelCount = (theSubresourceRange.levelCount == VK_REMAINING_MIP_LEVELS) ? myImage.mipLevels - theSubresourceRange.baseMipLevel : theSubresourceRange.levelCount;
+	const uint32_t layerCount = (theSubresourceRange.layerCount == VK_REMAINING_ARRAY_LAYERS) ? myImage.arrayLayers - theSubresourceRange.baseArrayLayer : theSubresourceRange.layerCount;
+	assert(theSubresourceRange.baseMipLevel + levelCount <= myImage.mipLevels);
+	assert(theSubresourceRange.baseArrayLayer + layerCount <= myImage.arrayLayers);
+
+	theTracker.statistics.uses++;
+
+	for(uint32_t level = theSubresourceRange.baseMipLevel; level < theSubresourceRange.baseMipLevel + levelCount; level++)
+	{
+		for(uint32_t layer = theSubresourceRange.baseArrayLayer; layer < theSubresourceRange.baseArrayLayer + layerCount; layer++)
+		{
+			TrackedResourceState & state = myImage.subresources[level * myImage.arrayLayers + layer];
+
+			const bool sharesPendingTransition = state.lastUseEpoch == theTracker.epoch && state.lastUseConflicts && state.writeAccess == 0
+			                                  && !usageInfo.isWrite && usageInfo.imageLayout == state.layout;
+			if(sharesPendingTransition) {
+				widenPendingImageBarrier(theTracker, state, theImage, level, layer, usageInfo);
+				continue;
+			}
+
+			VkPipelineStageFlags srcStageMask = 0;
+			VkAccessFlags srcAccessMask = 0;
+			VkImageLayout oldLayout;
+
+			if(!transitionTrackedState(theTracker, state, usageInfo, true, srcStageMask, srcAccessMask, oldLayout)) {
+				theTracker.statistics.elidedBarriers++;
+				continue;
+			}
+
+			const VkImageMemoryBarrier imageMemoryBarrier = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = srcAccessMask,
+				.dstAccessMask = usageInfo.accessMask,
+				.oldLayout = oldLayout,
+				.newLayout = usageInfo.imageLayout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = theImage,
+				.subresourceRange = {theSubresourceRange.aspectMask, level, 1, layer, 1},
+			};
+
+			appendImageBarrier(theTracker, imageMemoryBarrier);
+			theTracker.pendingSrcStageMask |= srcStageMask;
+			theTracker.pendingDstStageMask |= usageInfo.stageMask;
+		}
+
+		mergeLastImageBarrierLevels(theTracker);
+	}
+
+	return true;
+}
+
+
+
+/**
+ * Declares that the next commands use a buffer as theUsage, and queues the barrier they need.
+ * The state is tracked for the whole buffer, so the barrier covers the whole buffer too: one
+ * limited to the range in use would leave the previous accesses to the rest of it unsynchronized.
+ * Returns false if the buffer isn't tracked.
+ */
+bool useBuffer(ResourceStateTracker & theTracker,
+               const VkBuffer theBuffer,
+               const ResourceUsage theUsage
+               )
+{
+	auto bufferIt = theTracker.buffers.find(theBuffer);
+	if(bufferIt == theTracker.buffers.end()) {
+		std::cout << "!!! ERROR: useBuffer called on a buffer that isn't tracked." << std::endl;
+		return false;
+	}
+
+	const ResourceUsageInfo usageInfo = getResourceUsageInfo(theUsage);
+
+	VkPipelineStageFlags srcStageMask = 0;
+	VkAccessFlags srcAccessMask = 0;
+	VkImageLayout unusedLayout;
+
+	theTracker.statistics.uses++;
+
+	if(!transitionTrackedState(theTracker, bufferIt->second, usageInfo, false, srcStageMask, srcAccessMask, unusedLayout)) {
+		theTracker.statistics.elidedBarriers++;
+		return true;
+	}
+
+	const VkBufferMemoryBarrier bufferMemoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = srcAccessMask,
+		.dstAccessMask = usageInfo.accessMask,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = theBuffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+
+	theTracker.pendingBufferBarriers.push_back(bufferMemoryBarrier);
+	theTracker.pendingSrcStageMask |= srcStageMask;
+	theTracker.pendingDstStageMask |= usageInfo.stageMask;
+	return true;
+}
+
+
+
+/**
+ * Marks the content of the whole image as no longer needed: the next use transitions it from
+ * VK_IMAGE_LAYOUT_UNDEFINED, which lets the driver skip preserving it.
+ */
+void discardImageContents(ResourceStateTracker & theTracker, const VkImage theImage)
+{
+	auto imageIt = theTracker.images.find(theImage);
+	assert(imageIt != theTracker.images.end());
+
+	for(TrackedResourceState & state : imageIt->second.subresources)
+		state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+
+
+/**
+ * Records all the pending barriers in theCommandBuffer with a single vkCmdPipelineBarrier
+ * (nothing if there are none), before the commands of the uses declared since the last flush.
+ */
+void flushResourceBarriers(ResourceStateTracker & theTracker, const VkCommandBuffer theCommandBuffer)
+{
+	theTracker.epoch++;
+
+	if(theTracker.pendingImageBarriers.empty() && theTracker.pendingBufferBarriers.empty())
+		return;
+
+	// Barriers with nothing to wait for (new resources) still need a valid source stage.
+	const VkPipelineStageFlags srcStageMask = (theTracker.pendingSrcStageMask != 0) ? theTracker.pendingSrcStageMask : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+	vkCmdPipelineBarrier(theCommandBuffer,
+		srcStageMask,
+		theTracker.pendingDstStageMask,
+		0,
+		0, nullptr,
+		(uint32_t)theTracker.pendingBufferBarriers.size(), theTracker.pendingBufferBarriers.data(),
+		(uint32_t)theTracker.pendingImageBarriers.size(), theTracker.pendingImageBarriers.data()
+	);
+
+	theTracker.statistics.imageBarriers += theTracker.pendingImageBarriers.size();
+	theTracker.statistics.bufferBarriers += theTracker.pendingBufferBarriers.size();
+	theTracker.statistics.pipelineBarrierCalls++;
+
+	theTracker.pendingImageBarriers.clear();
+	theTracker.pendingBufferBarriers.clear();
+	theTracker.pendingSrcStageMask = 0;
+	theTracker.pendingDstStageMask = 0;
+}
+
+
+
+/**
+ * Prints the uses declared, the barriers they needed and the vkCmdPipelineBarrier calls recording them.
+ */
+void printResourceTrackerStatistics(const ResourceStateTracker & theTracker, const std::string & theName)
+{
+	const ResourceTrackerStatistics & stats = theTracker.statistics;
+
+	std::cout << "--- " << theName << ": " << stats.uses << " uses, "
+	          << stats.imageBarriers << " image and " << stats.bufferBarriers << " buffer barriers in "
+	          << stats.pipelineBarrierCalls << " vkCmdPipelineBarrier calls, "
+	          << stats.elidedBarriers << " subresource uses without a barrier." << std::endl;
+}
+
+}	// vkdemos
+
+#endif
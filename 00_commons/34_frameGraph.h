@@ -0,0 +1,1185 @@
+#ifndef VKDEMOS_FRAMEGRAPH_H
+#define VKDEMOS_FRAMEGRAPH_H
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "00_utils.h"
+#include "12_memoryAllocator.h"
+#include "31_frameCommandPool.h"
+#include "33_resourceStateTracker.h"
+
+namespace vkdemos {
+
+/*
+ * A declarative frame graph.
+ *
+ * Instead of hard-coding the order of the passes of a frame, the barriers between them and
+ * the lifetime of the images they exchange, each pass declares the resources it accesses and
+ * how (a ResourceUsage, see 33_resourceStateTracker.h), together with a callback recording
+ * its commands. compileFrameGraph then:
+ *  - culls the passes whose results are never used: a pass is kept if it writes an imported
+ *    resource, or a transient one read by a pass that is kept;
+ *  - orders the passes: any order respecting the dependencies between their accesses
+ *    (read-after-write, write-after-read, write-after-write) is valid; among the passes ready
+ *    to run, the first declared one on the queue of the previous pass is picked, so that
+ *    passes of the same queue are grouped;
+ *  - groups consecutive passes of the same queue in batches, each one submitted with a single
+ *    command buffer, and creates a semaphore for every batch depending on a batch of another queue;
+ *  - creates the transient images, placing in the same memory the ones whose lifetimes
+ *    (from the first to the last pass using them) don't overlap.
+ * executeFrameGraph records and submits the batches of a frame: before every pass it declares
+ * the pass's accesses to a ResourceStateTracker and flushes the barriers they need, and after
+ * the last use of an output it transitions it to its final usage (e.g. RESOURCE_USAGE_PRESENT).
+ *
+ * Transient images are created and owned by the graph; their content doesn't survive a frame,
+ * and they must be used by passes of a single queue. Imported images and buffers (the swapchain
+ * image, resources living across frames) are owned by the caller, and bound to the graph every
+ * frame with their current layout and the semaphores to wait and signal; if they're used on two
+ * queue families, they must have been created with VK_SHARING_MODE_CONCURRENT.
+ * A handle bound again (to the same resource or to another one, e.g. swapping ping-pong images)
+ * keeps the state the previous executions left it in, so that its first use in a frame waits
+ * for them. When an imported resource is last used on a queue and first used on the other one,
+ * its last pass signals a semaphore that its first pass waits for in the next execution: the
+ * frames must then be executed in order, with no gaps.
+ *
+ * Passes using attachments record their own render pass, whose attachments must begin and end
+ * in the layout of their usage (e.g. COLOR_ATTACHMENT_OPTIMAL): the graph does the transitions.
+ * A pass must declare each resource once (use the READ_WRITE usages to read and write it).
+ */
+enum FrameGraphQueue
+{
+	FRAME_GRAPH_QUEUE_GRAPHICS,
+	FRAME_GRAPH_QUEUE_COMPUTE,
+	FRAME_GRAPH_QUEUE_COUNT
+};
+
+typedef uint32_t FrameGraphResource;
+
+typedef std::function<void(VkCommandBuffer theCommandBuffer)> RecordFrameGraphPassFunction;
+
+struct FrameGraphImageDesc
+{
+	VkFormat format;
+	VkExtent2D extent;
+	uint32_t mipLevels;
+	VkImageUsageFlags usage;
+	VkImageAspectFlags aspectMask;
+};
+
+struct FrameGraphAccess
+{
+	FrameGraphResource resource;
+	ResourceUsage usage;
+};
+
+struct FrameGraphResourceData
+{
+	std::string name;
+	bool isImage = true;
+	bool isTransient = false;
+	bool isOutput = false;
+	ResourceUsage finalUsage = RESOURCE_USAGE_PRESENT;     // for outputs.
+
+	// Transient images (only the aspect mask for the imported ones).
+	FrameGraphImageDesc desc = {};
+	VkDeviceSize memoryOffset = 0;
+	VkDeviceSize memorySize = 0;
+	std::vector<FrameGraphResource> aliases;               // transients sharing some of its memory.
+	VkImageView imageView = VK_NULL_HANDLE;
+
+	// Imported resources: bound every frame.
+	uint32_t mipLevels = 1;
+	uint32_t arrayLayers = 1;
+	VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+	VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+
+	VkImage image = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+
+	// Compiled: position in the execution order of the first and last pass using it.
+	uint32_t firstUse = UINT32_MAX;
+	uint32_t lastUse = 0;
+};
+
+struct FrameGraphPassData
+{
+	std::string name;
+	FrameGraphQueue queue;
+	std::vector<FrameGraphAccess> accesses;
+	RecordFrameGraphPassFunction record;
+
+	// Compiled.
+	bool culled = false;
+	uint32_t batch = 0;
+	std::vector<bool> acquiresFromOtherQueue;     // per access: the previous use was on the other queue.
+};
+
+struct FrameGraphBatch
+{
+	FrameGraphQueue queue;
+	std::vector<uint32_t> passes;                 // indices in FrameGraph::passes, in execution order.
+};
+
+struct FrameGraphDependency
+{
+	uint32_t srcBatch;
+	uint32_t dstBatch;
+	VkPipelineStageFlags waitStageMask;
+};
+
+struct FrameGraph
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queues[FRAME_GRAPH_QUEUE_COUNT] = {};
+	uint32_t frameCount = 0;
+
+	std::vector<FrameGraphResourceData> resources;
+	std::vector<FrameGraphPassData> passes;
+
+	// Compiled.
+	bool compiled = false;
+	std::vector<uint32_t> executionOrder;
+	std::vector<FrameGraphBatch> batches;
+	std::vector<FrameGraphDependency> dependencies;
+	std::vector<VkSemaphore> semaphores;           // [frameIndex * dependencies.size() + dependency]
+	std::vector<FrameGraphDependency> carriedDependencies;     // from a batch to a batch of the next execution.
+	std::vector<VkSemaphore> carriedSemaphores;    // [signaling frameIndex * carriedDependencies.size() + dependency]
+	MemoryAllocation transientMemory;
+	VkDeviceSize unaliasedTransientBytes = 0;
+
+	std::vector<FrameCommandPool> commandPools;    // [frameIndex * FRAME_GRAPH_QUEUE_COUNT + queue]
+	ResourceStateTracker tracker;
+
+	// Executions: the batch of the last use of every imported handle.
+	uint32_t previousFrameIndex = UINT32_MAX;
+	std::unordered_map<VkImage, uint32_t> importedImageBatches;
+	std::unordered_map<VkBuffer, uint32_t> importedBufferBatches;
+};
+
+
+
+/**
+ * Creates an empty frame graph, executed with up to theFrameCount frames in flight.
+ * theComputeQueue may be VK_NULL_HANDLE or the graphics queue: compute passes then run on the graphics queue.
+ */
+bool createFrameGraph(const VkDevice theDevice,
+                      const VkQueue theGraphicsQueue,
+                      const uint32_t theGraphicsQueueFamilyIndex,
+                      const VkQueue theComputeQueue,
+                      const uint32_t theComputeQueueFamilyIndex,
+                      const uint32_t theFrameCount,
+                      FrameGraph & outGraph,
+                      const VkAllocationCallbacks * pAllocator = nullptr
+                      )
+{
+	FrameGraph myGraph;
+	myGraph.device = theDevice;
+	myGraph.frameCount = theFrameCount;
+	myGraph.queues[FRAME_GRAPH_QUEUE_GRAPHICS] = theGraphicsQueue;
+	myGraph.queues[FRAME_GRAPH_QUEUE_COMPUTE] = (theComputeQueue != VK_NULL_HANDLE) ? theComputeQueue : theGraphicsQueue;
+
+	const uint32_t queueFamilyIndices[FRAME_GRAPH_QUEUE_COUNT] = {theGraphicsQueueFamilyIndex, (theComputeQueue != VK_NULL_HANDLE) ? theComputeQueueFamilyIndex : theGraphicsQueueFamilyIndex};
+
+	myGraph.commandPools.resize(theFrameCount * FRAME_GRAPH_QUEUE_COUNT);
+	for(uint32_t frame = 0; frame < theFrameCount; frame++)
+		for(int queue = 0; queue < FRAME_GRAPH_QUEUE_COUNT; queue++)
+			if(!createFrameCommandPool(theDevice, queueFamilyIndices[queue], myGraph.commandPools[frame * FRAME_GRAPH_QUEUE_COUNT + queue], pAllocator)) {
+				for(FrameCommandPool & commandPool : myGraph.commandPools)
+					destroyFrameCommandPool(commandPool, pAllocator);
+				return false;
+			}
+
+	outGraph = myGraph;
+	return true;
+}
+
+
+
+/**
+ * Declares an image created by the graph, that lives only during a frame.
+ */
+FrameGraphResource addFrameGraphTransientImage(FrameGraph & theGraph, const std::string & theName, const FrameGraphImageDesc & theDesc)
+{
+	assert(!theGraph.compiled);
+
+	FrameGraphResourceData myResource;
+	myResource.name = theName;
+	myResource.isTransient = true;
+	myResource.desc = theDesc;
+	myResource.mipLevels = theDesc.mipLevels;
+
+	theGraph.resources.push_back(myResource);
+	return (FrameGraphResource)(theGraph.resources.size() - 1);
+}
+
+
+
+/**
+ * Declares an image owned by the caller, to bind with bindFrameGraphImage before every execution.
+ */
+FrameGraphResource addFrameGraphImportedImage(FrameGraph & theGraph,
+                                              const std::string & theName,
+                                              const VkImageAspectFlags theAspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                              const uint32_t theMipLevels = 1,
+                                              const uint32_t theArrayLayers = 1
+                                              )
+{
+	assert(!theGraph.compiled);
+
+	FrameGraphResourceData myResource;
+	myResource.name = theName;
+	myResource.desc.aspectMask = theAspectMask;
+	myResource.mipLevels = theMipLevels;
+	myResource.arrayLayers = theArrayLayers;
+
+	theGraph.resources.push_back(myResource);
+	return (FrameGraphResource)(theGraph.resources.size() - 1);
+}
+
+
+
+/**
+ * Declares a buffer owned by the caller, to bind with bindFrameGraphBuffer before every execution.
+ */
+FrameGraphResource addFrameGraphImportedBuffer(FrameGraph & theGraph, const std::string & theName)
+{
+	assert(!theGraph.compiled);
+
+	FrameGraphResourceData myResource;
+	myResource.name = theName;
+	myResource.isImage = false;
+
+	theGraph.resources.push_back(myResource);
+	return (FrameGraphResource)(theGraph.resources.size() - 1);
+}
+
+
+
+/**
+ * Marks an imported resource as a result of the frame: after its last use it's transitioned to
+ * theFinalUsage (e.g. RESOURCE_USAGE_PRESENT for the swapchain image).
+ */
+void setFrameGraphOutput(FrameGraph & theGraph, const FrameGraphResource theResource, const ResourceUsage theFinalUsage)
+{
+	assert(!theGraph.compiled);
+	assert(!theGraph.resources[theResource].isTransient);
+
+	theGraph.resources[theResource].isOutput = true;
+	theGraph.resources[theResource].finalUsage = theFinalUsage;
+}
+
+
+
+/**
+ * Adds a pass, executed on theQueue, accessing theAccesses and recording its commands with theRecordFunction.
+ * Returns the index of the pass.
+ */
+uint32_t addFrameGraphPass(FrameGraph & theGraph,
+                           const std::string & theName,
+                           const FrameGraphQueue theQueue,
+                           const std::vector<FrameGraphAccess> & theAccesses,
+                           const RecordFrameGraphPassFunction & theRecordFunction
+                           )
+{
+	assert(!theGraph.compiled);
+
+	FrameGraphPassData myPass;
+	myPass.name = theName;
+	myPass.queue = (theGraph.queues[theQueue] == theGraph.queues[FRAME_GRAPH_QUEUE_GRAPHICS]) ? FRAME_GRAPH_QUEUE_GRAPHICS : theQueue;
+	myPass.accesses = theAccesses;
+	myPass.record = theRecordFunction;
+
+	theGraph.passes.push_back(myPass);
+	return (uint32_t)(theGraph.passes.size() - 1);
+}
+
+
+
+/*
+ * Marks the passes whose writes are never used as culled, walking the passes backwards:
+ * a transient resource is needed before a pass if the pass (or a later one) reads it.
+ */
+static void cullFrameGraphPasses(FrameGraph & theGraph)
+{
+	std::vector<bool> needed(theGraph.resources.size());
+	for(size_t i = 0; i < theGraph.resources.size(); i++)
+		needed[i] = !theGraph.resources[i].isTransient;
+
+	for(size_t passIndex = theGraph.passes.size(); passIndex-- > 0; )
+	{
+		FrameGraphPassData & pass = theGraph.passes[passIndex];
+
+		pass.culled = true;
+		for(const FrameGraphAccess & access : pass.accesses)
+			if(getResourceUsageInfo(access.usage).isWrite && needed[access.resource])
+				pass.culled = false;
+
+		if(pass.culled)
+			continue;
+
+		for(const FrameGraphAccess & access : pass.accesses) {
+			const ResourceUsageInfo usageInfo = getResourceUsageInfo(access.usage);
+			const bool reads = (usageInfo.accessMask & ~RESOURCE_WRITE_ACCESS_MASK) != 0;
+
+			if(reads)
+				needed[access.resource] = true;
+			else if(theGraph.resources[access.resource].isTransient)
+				needed[access.resource] = false;
+		}
+	}
+}
+
+
+
+/*
+ * Orders the passes that aren't culled: a pass is ready when all the passes it depends on
+ * (in declaration order) are scheduled; the first ready pass on the queue of the last scheduled
+ * one is preferred, otherwise the first ready pass.
+ */
+static void orderFrameGraphPasses(FrameGraph & theGraph)
+{
+	const size_t passCount = theGraph.passes.size();
+	std::vector<std::vector<uint32_t>> dependsOn(passCount);
+
+	// Last writer and readers since then of every resource, in declaration order.
+	std::vector<uint32_t> lastWriter(theGraph.resources.size(), UINT32_MAX);
+	std::vector<std::vector<uint32_t>> readers(theGraph.resources.size());
+
+	for(uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+	{
+		if(theGraph.passes[passIndex].culled)
+			continue;
+
+		for(const FrameGraphAccess & access : theGraph.passes[passIndex].accesses)
+		{
+			if(lastWriter[access.resource] != UINT32_MAX)
+				dependsOn[passIndex].push_back(lastWriter[access.resource]);
+
+			if(getResourceUsageInfo(access.usage).isWrite) {
+				dependsOn[passIndex].insert(dependsOn[passIndex].end(), readers[access.resource].begin(), readers[access.resource].end());
+				lastWriter[access.resource] = passIndex;
+				readers[access.resource].clear();
+			}
+			else
+				readers[access.resource].push_back(passIndex);
+		}
+	}
+
+	std::vector<bool> scheduled(passCount, false);
+	theGraph.executionOrder.clear();
+
+	FrameGraphQueue currentQueue = FRAME_GRAPH_QUEUE_GRAPHICS;
+
+	for(;;)
+	{
+		uint32_t chosenPass = UINT32_MAX;
+
+		for(uint32_t passIndex = 0; passIndex < passCount; passIndex++)
+		{
+			if(theGraph.passes[passIndex].culled || scheduled[passIndex])
+				continue;
+
+			const bool ready = std::all_of(dependsOn[passIndex].begin(), dependsOn[passIndex].end(), [&](uint32_t dependency) { return scheduled[dependency]; });
+			if(!ready)
+				continue;
+
+			if(chosenPass == UINT32_MAX)
+				chosenPass = passIndex;
+
+			if(theGraph.passes[passIndex].queue == currentQueue) {
+				chosenPass = passIndex;
+				break;
+			}
+		}
+
+		if(chosenPass == UINT32_MAX)
+			break;
+
+		scheduled[chosenPass] = true;
+		currentQueue = theGraph.passes[chosenPass].queue;
+		theGraph.executionOrder.push_back(chosenPass);
+	}
+}
+
+
+
+/*
+ * Splits the execution order in batches, and finds the batches that must wait for a batch of
+ * the other queue: the last writer of a resource used on another queue, and for writes also the
+ * readers since then. The last batch also waits for the last batch of the other queue, so that
+ * the fence it signals covers the whole frame.
+ */
+static void batchFrameGraphPasses(FrameGraph & theGraph)
+{
+	theGraph.batches.clear();
+	theGraph.dependencies.clear();
+
+	for(const uint32_t passIndex : theGraph.executionOrder)
+	{
+		FrameGraphPassData & pass = theGraph.passes[passIndex];
+
+		if(theGraph.batches.empty() || theGraph.batches.back().queue != pass.queue)
+			theGraph.batches.push_back({pass.queue, {}});
+
+		pass.batch = (uint32_t)(theGraph.batches.size() - 1);
+		theGraph.batches.back().passes.push_back(passIndex);
+	}
+
+	std::vector<uint32_t> lastWriter(theGraph.resources.size(), UINT32_MAX);
+	std::vector<std::vector<uint32_t>> readers(theGraph.resources.size());
+
+	auto addDependency = [&](const uint32_t srcPass, FrameGraphPassData & dstPass, const VkPipelineStageFlags waitStageMask) {
+		const uint32_t srcBatch = theGraph.passes[srcPass].batch;
+		if(theGraph.passes[srcPass].queue == dstPass.queue)
+			return false;
+
+		for(FrameGraphDependency & dependency : theGraph.dependencies)
+			if(dependency.srcBatch == srcBatch && dependency.dstBatch == dstPass.batch) {
+				dependency.waitStageMask |= waitStageMask;
+				return true;
+			}
+
+		theGraph.dependencies.push_back({srcBatch, dstPass.batch, waitStageMask});
+		return true;
+	};
+
+	for(const uint32_t passIndex : theGraph.executionOrder)
+	{
+		FrameGraphPassData & pass = theGraph.passes[passIndex];
+		pass.acquiresFromOtherQueue.assign(pass.accesses.size(), false);
+
+		for(size_t i = 0; i < pass.accesses.size(); i++)
+		{
+			const FrameGraphAccess & access = pass.accesses[i];
+			const ResourceUsageInfo usageInfo = getResourceUsageInfo(access.usage);
+			bool acquires = false;
+
+			if(lastWriter[access.resource] != UINT32_MAX)
+				acquires |= addDependency(lastWriter[access.resource], pass, usageInfo.stageMask);
+
+			if(usageInfo.isWrite) {
+				for(const uint32_t reader : readers[access.resource])
+					acquires |= addDependency(reader, pass, usageInfo.stageMask);
+
+				lastWriter[access.resource] = passIndex;
+				readers[access.resource].clear();
+			}
+			else
+				readers[access.resource].push_back(passIndex);
+
+			pass.acquiresFromOtherQueue[i] = acquires;
+		}
+	}
+
+	// The wait blocks no stage of the last batch: its fence signal still comes after the wait.
+	if(!theGraph.batches.empty()) {
+		const uint32_t lastBatch = (uint32_t)(theGraph.batches.size() - 1);
+
+		for(uint32_t batchIndex = lastBatch; batchIndex-- > 0; )
+			if(theGraph.batches[batchIndex].queue != theGraph.batches[lastBatch].queue) {
+				const bool chained = std::any_of(theGraph.dependencies.begin(), theGraph.dependencies.end(), [&](const FrameGraphDependency & dependency) {
+					return dependency.srcBatch == batchIndex && dependency.dstBatch == lastBatch;
+				});
+
+				if(!chained)
+					theGraph.dependencies.push_back({batchIndex, lastBatch, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT});
+				break;
+			}
+	}
+}
+
+
+
+/*
+ * Creates the transient images used by the remaining passes, and places them in a single
+ * allocation: every image, from the biggest, goes at the lowest offset where it doesn't overlap
+ * an already placed image whose lifetime overlaps its own.
+ */
+static bool createFrameGraphTransientImages(FrameGraph & theGraph, MemoryAllocator * theAllocator, const VkAllocationCallbacks * pAllocator)
+{
+	VkResult result;
+	std::vector<FrameGraphResource> transients;
+
+	for(uint32_t order = 0; order < theGraph.executionOrder.size(); order++)
+		for(const FrameGraphAccess & access : theGraph.passes[theGraph.executionOrder[order]].accesses) {
+			FrameGraphResourceData & resource = theGraph.resources[access.resource];
+			resource.firstUse = std::min(resource.firstUse, order);
+			resource.lastUse = std::max(resource.lastUse, order);
+		}
+
+	uint32_t memoryTypeBits = UINT32_MAX;
+	VkDeviceSize alignment = 1;
+
+	for(FrameGraphResource resourceIndex = 0; resourceIndex < theGraph.resources.size(); resourceIndex++)
+	{
+		FrameGraphResourceData & resource = theGraph.resources[resourceIndex];
+		if(!resource.isTransient || resource.firstUse == UINT32_MAX)
+			continue;
+
+		if(theAllocator == nullptr) {
+			std::cout << "!!! ERROR: the frame graph has transient images, but no allocator for their memory." << std::endl;
+			return false;
+		}
+
+		const VkImageCreateInfo imageCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = resource.desc.format,
+			.extent = {resource.desc.extent.width, resource.desc.extent.height, 1},
+			.mipLevels = resource.desc.mipLevels,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = resource.desc.usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = 0,
+			.pQueueFamilyIndices = nullptr,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+
+		result = vkCreateImage(theGraph.device, &imageCreateInfo, pAllocator, &resource.image);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: failed to create the transient image \"" << resource.name << "\": " << vkdemos::utils::VkResultToString(result) << std::endl;
+			return false;
+		}
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(theGraph.device, resource.image, &memoryRequirements);
+
+		resource.memorySize = memoryRequirements.size;
+		memoryTypeBits &= memoryRequirements.memoryTypeBits;
+		alignment = std::max(alignment, memoryRequirements.alignment);
+		theGraph.unaliasedTransientBytes += memoryRequirements.size;
+
+		transients.push_back(resourceIndex);
+	}
+
+	if(transients.empty())
+		return true;
+
+	if(memoryTypeBits == 0) {
+		std::cout << "!!! ERROR: the transient images of the frame graph have no memory type in common." << std::endl;
+		return false;
+	}
+
+	std::stable_sort(transients.begin(), transients.end(), [&](FrameGraphResource a, FrameGraphResource b) {
+		return theGraph.resources[a].memorySize > theGraph.resources[b].memorySize;
+	});
+
+	VkDeviceSize totalSize = 0;
+
+	for(size_t i = 0; i < transients.size(); i++)
+	{
+		FrameGraphResourceData & resource = theGraph.resources[transients[i]];
+
+		auto livesTogether = [&](const FrameGraphResourceData & other) {
+			return resource.firstUse <= other.lastUse && other.firstUse <= resource.lastUse;
+		};
+
+		// Candidate offsets: the start of the memory, and the end of every placed image living at the same time.
+		std::vector<VkDeviceSize> candidates = {0};
+		for(size_t j = 0; j < i; j++) {
+			const FrameGraphResourceData & other = theGraph.resources[transients[j]];
+			if(livesTogether(other))
+				candidates.push_back(alignDeviceSize(other.memoryOffset + other.memorySize, alignment));
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for(const VkDeviceSize offset : candidates)
+		{
+			const bool fits = std::none_of(transients.begin(), transients.begin() + i, [&](FrameGraphResource otherIndex) {
+				const FrameGraphResourceData & other = theGraph.resources[otherIndex];
+				return livesTogether(other) && offset < other.memoryOffset + other.memorySize && other.memoryOffset < offset + resource.memorySize;
+			});
+
+			if(fits) {
+				resource.memoryOffset = offset;
+				break;
+			}
+		}
+
+		totalSize = std::max(totalSize, resource.memoryOffset + resource.memorySize);
+	}
+
+	const VkMemoryRequirements transientRequirements = {totalSize, alignment, memoryTypeBits};
+	if(!allocateMemoryFromAllocator(*theAllocator, transientRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, VKDEMOS_ALLOCATION_SITE("frame graph transient images"), theGraph.transientMemory, vkdemos::utils::MEMORY_USAGE_GPU_ONLY)) {
+		std::cout << "!!! ERROR: can't allocate the memory of the frame graph's transient images." << std::endl;
+		return false;
+	}
+
+	for(const FrameGraphResource resourceIndex : transients)
+	{
+		FrameGraphResourceData & resource = theGraph.resources[resourceIndex];
+
+		result = vkBindImageMemory(theGraph.device, resource.image, theGraph.transientMemory.memory, theGraph.transientMemory.offset + resource.memoryOffset);
+		assert(result == VK_SUCCESS);
+
+		const VkImageViewCreateInfo imageViewCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.image = resource.image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = resource.desc.format,
+			.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+			.subresourceRange = {resource.desc.aspectMask, 0, resource.desc.mipLevels, 0, 1},
+		};
+
+		result = vkCreateImageView(theGraph.device, &imageViewCreateInfo, pAllocator, &resource.imageView);
+		assert(result == VK_SUCCESS);
+
+		// Transients sharing memory with this one: its first use in a frame must wait for them.
+		for(const FrameGraphResource otherIndex : transients) {
+			const FrameGraphResourceData & other = theGraph.resources[otherIndex];
+			if(otherIndex != resourceIndex && resource.memoryOffset < other.memoryOffset + other.memorySize && other.memoryOffset < resource.memoryOffset + resource.memorySize)
+				resource.aliases.push_back(otherIndex);
+		}
+
+		trackImage(theGraph.tracker, resource.image, resource.desc.mipLevels, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+
+	return true;
+}
+
+
+
+/*
+ * Finds the imported resources first used on a queue and last used on the other: the batch
+ * of the first use must wait for the batch of the last use of the previous execution.
+ */
+static void carryFrameGraphDependencies(FrameGraph & theGraph)
+{
+	theGraph.carriedDependencies.clear();
+
+	for(size_t resourceIndex = 0; resourceIndex < theGraph.resources.size(); resourceIndex++)
+	{
+		const FrameGraphResourceData & resource = theGraph.resources[resourceIndex];
+		if(resource.isTransient || resource.firstUse == UINT32_MAX)
+			continue;
+
+		const FrameGraphPassData & firstPass = theGraph.passes[theGraph.executionOrder[resource.firstUse]];
+		const FrameGraphPassData & lastPass = theGraph.passes[theGraph.executionOrder[resource.lastUse]];
+		if(firstPass.queue == lastPass.queue)
+			continue;
+
+		VkPipelineStageFlags waitStageMask = 0;
+		for(const FrameGraphAccess & access : firstPass.accesses)
+			if(access.resource == resourceIndex)
+				waitStageMask = getResourceUsageInfo(access.usage).stageMask;
+
+		auto dependencyIt = std::find_if(theGraph.carriedDependencies.begin(), theGraph.carriedDependencies.end(), [&](const FrameGraphDependency & dependency) {
+			return dependency.srcBatch == lastPass.batch && dependency.dstBatch == firstPass.batch;
+		});
+
+		if(dependencyIt != theGraph.carriedDependencies.end())
+			dependencyIt->waitStageMask |= waitStageMask;
+		else
+			theGraph.carriedDependencies.push_back({lastPass.batch, firstPass.batch, waitStageMask});
+	}
+}
+
+
+
+/*
+ * Destroys what compileFrameGraph created: the transient images, their memory and the semaphores.
+ * Objects not created yet are VK_NULL_HANDLE, so it also cleans up after a failed compilation.
+ */
+static void destroyFrameGraphCompiledObjects(FrameGraph & theGraph, MemoryAllocator * theAllocator, const VkAllocationCallbacks * pAllocator)
+{
+	for(FrameGraphResourceData & resource : theGraph.resources)
+		if(resource.isTransient && resource.image != VK_NULL_HANDLE) {
+			untrackImage(theGraph.tracker, resource.image);
+			vkDestroyImageView(theGraph.device, resource.imageView, pAllocator);
+			vkDestroyImage(theGraph.device, resource.image, pAllocator);
+			resource.imageView = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+		}
+
+	if(theAllocator != nullptr)
+		freeMemoryToAllocator(*theAllocator, theGraph.transientMemory);
+
+	assert(theGraph.transientMemory.memory == VK_NULL_HANDLE);
+
+	for(VkSemaphore semaphore : theGraph.semaphores)
+		vkDestroySemaphore(theGraph.device, semaphore, pAllocator);
+
+	for(VkSemaphore semaphore : theGraph.carriedSemaphores)
+		vkDestroySemaphore(theGraph.device, semaphore, pAllocator);
+
+	theGraph.semaphores.clear();
+	theGraph.carriedSemaphores.clear();
+}
+
+
+
+/**
+ * Culls and orders the passes, creates the semaphores between the queues, and creates
+ * (and aliases) the transient images in memory taken from theAllocator.
+ * theAllocator can be nullptr if the graph has no transient images.
+ * The graph can't be changed after it's compiled. On failure, nothing created here is left behind.
+ */
+bool compileFrameGraph(FrameGraph & theGraph, MemoryAllocator * theAllocator = nullptr, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	VkResult result;
+	assert(!theGraph.compiled);
+
+	cullFrameGraphPasses(theGraph);
+	orderFrameGraphPasses(theGraph);
+	batchFrameGraphPasses(theGraph);
+
+	// Transient images must stay on one queue: the tracker doesn't transfer ownership.
+	for(const FrameGraphPassData & pass : theGraph.passes)
+		for(size_t i = 0; i < pass.accesses.size(); i++)
+			if(!pass.culled && pass.acquiresFromOtherQueue[i] && theGraph.resources[pass.accesses[i].resource].isTransient) {
+				std::cout << "!!! ERROR: the transient image \"" << theGraph.resources[pass.accesses[i].resource].name << "\" is used on two queues." << std::endl;
+				return false;
+			}
+
+	if(!createFrameGraphTransientImages(theGraph, theAllocator, pAllocator)) {
+		destroyFrameGraphCompiledObjects(theGraph, theAllocator, pAllocator);
+		return false;
+	}
+
+	carryFrameGraphDependencies(theGraph);
+
+	const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+	};
+
+	theGraph.semaphores.resize(theGraph.frameCount * theGraph.dependencies.size());
+	theGraph.carriedSemaphores.resize(theGraph.frameCount * theGraph.carriedDependencies.size());
+
+	for(VkSemaphore & semaphore : theGraph.semaphores) {
+		result = vkCreateSemaphore(theGraph.device, &semaphoreCreateInfo, pAllocator, &semaphore);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: failed to create a frame graph semaphore: " << vkdemos::utils::VkResultToString(result) << std::endl;
+			destroyFrameGraphCompiledObjects(theGraph, theAllocator, pAllocator);
+			return false;
+		}
+	}
+
+	for(VkSemaphore & semaphore : theGraph.carriedSemaphores) {
+		result = vkCreateSemaphore(theGraph.device, &semaphoreCreateInfo, pAllocator, &semaphore);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: failed to create a frame graph semaphore: " << vkdemos::utils::VkResultToString(result) << std::endl;
+			destroyFrameGraphCompiledObjects(theGraph, theAllocator, pAllocator);
+			return false;
+		}
+	}
+
+	theGraph.compiled = true;
+	return true;
+}
+
+
+
+/**
+ * Binds the image to use as an imported resource in the next execution, in theCurrentLayout.
+ * An image already bound to the graph keeps its state, and theCurrentLayout must be the one
+ * it was left in, or VK_IMAGE_LAYOUT_UNDEFINED to discard its contents (e.g. a swapchain image).
+ * If theWaitSemaphore isn't VK_NULL_HANDLE, the first pass using the image waits for it;
+ * if theSignalSemaphore isn't VK_NULL_HANDLE, it's signaled after the image's last use.
+ */
+void bindFrameGraphImage(FrameGraph & theGraph,
+                         const FrameGraphResource theResource,
+                         const VkImage theImage,
+                         const VkImageLayout theCurrentLayout,
+                         const VkSemaphore theWaitSemaphore = VK_NULL_HANDLE,
+                         const VkSemaphore theSignalSemaphore = VK_NULL_HANDLE
+                         )
+{
+	FrameGraphResourceData & resource = theGraph.resources[theResource];
+	assert(resource.isImage && !resource.isTransient);
+
+	resource.image = theImage;
+	resource.waitSemaphore = theWaitSemaphore;
+	resource.signalSemaphore = theSignalSemaphore;
+
+	auto imageIt = theGraph.tracker.images.find(theImage);
+	if(imageIt == theGraph.tracker.images.end()) {
+		trackImage(theGraph.tracker, theImage, resource.mipLevels, resource.arrayLayers, theCurrentLayout);
+		return;
+	}
+
+	assert(imageIt->second.mipLevels == resource.mipLevels && imageIt->second.arrayLayers == resource.arrayLayers);
+
+	if(theCurrentLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+		discardImageContents(theGraph.tracker, theImage);
+	else
+		for(const TrackedResourceState & state : imageIt->second.subresources)
+			assert(state.layout == theCurrentLayout);
+}
+
+
+
+/**
+ * Binds the buffer to use as an imported resource in the next execution; a buffer already bound
+ * to the graph keeps its state, and the semaphores work as in bindFrameGraphImage.
+ */
+void bindFrameGraphBuffer(FrameGraph & theGraph,
+                          const FrameGraphResource theResource,
+                          const VkBuffer theBuffer,
+                          const VkSemaphore theWaitSemaphore = VK_NULL_HANDLE,
+                          const VkSemaphore theSignalSemaphore = VK_NULL_HANDLE
+                          )
+{
+	FrameGraphResourceData & resource = theGraph.resources[theResource];
+	assert(!resource.isImage);
+
+	resource.buffer = theBuffer;
+	resource.waitSemaphore = theWaitSemaphore;
+	resource.signalSemaphore = theSignalSemaphore;
+
+	if(theGraph.tracker.buffers.count(theBuffer) == 0)
+		trackBuffer(theGraph.tracker, theBuffer);
+}
+
+
+
+/**
+ * Forgets the state of an image or a buffer bound to the graph, before destroying it
+ * (e.g. when the swapchain is recreated): a new handle could reuse its value.
+ */
+void forgetFrameGraphImage(FrameGraph & theGraph, const VkImage theImage)
+{
+	untrackImage(theGraph.tracker, theImage);
+	theGraph.importedImageBatches.erase(theImage);
+}
+
+void forgetFrameGraphBuffer(FrameGraph & theGraph, const VkBuffer theBuffer)
+{
+	untrackBuffer(theGraph.tracker, theBuffer);
+	theGraph.importedBufferBatches.erase(theBuffer);
+}
+
+
+
+/**
+ * Returns the image of a resource (transient images exist after compileFrameGraph), and its view for transient images.
+ */
+VkImage getFrameGraphImage(const FrameGraph & theGraph, const FrameGraphResource theResource)
+{
+	return theGraph.resources[theResource].image;
+}
+
+VkImageView getFrameGraphImageView(const FrameGraph & theGraph, const FrameGraphResource theResource)
+{
+	return theGraph.resources[theResource].imageView;
+}
+
+
+
+/*
+ * Makes the tracked state of a resource wait for theWaitStageMask, the stages a semaphore wait
+ * blocks: the next barrier on it starts from there, which chains it to the semaphore. The
+ * accesses before the semaphore (maybe on the other queue, whose stages mustn't appear in this
+ * queue's barriers) are complete, and made available and visible by the semaphore itself.
+ */
+static void acquireTrackedStateAfterWait(TrackedResourceState & theState, const VkPipelineStageFlags theWaitStageMask)
+{
+	theState.writeStages = theWaitStageMask;
+	theState.writeAccess = 0;
+	theState.readStages = 0;
+	theState.visibleStages = 0;
+	theState.visibleAccess = 0;
+}
+
+
+
+/*
+ * Returns the stages that theBatch (or an earlier batch of its queue) blocks waiting for a
+ * semaphore signaled by the previous execution after theLastUseBatch, or 0 if there are none.
+ */
+static VkPipelineStageFlags getPreviousExecutionWaitStages(const FrameGraph & theGraph, const uint32_t theLastUseBatch, const uint32_t theBatch)
+{
+	VkPipelineStageFlags waitStageMask = 0;
+
+	for(const FrameGraphDependency & dependency : theGraph.carriedDependencies)
+		if(theGraph.batches[dependency.srcBatch].queue == theGraph.batches[theLastUseBatch].queue && dependency.srcBatch >= theLastUseBatch
+		   && theGraph.batches[dependency.dstBatch].queue == theGraph.batches[theBatch].queue && dependency.dstBatch <= theBatch)
+			waitStageMask |= dependency.waitStageMask;
+
+	return waitStageMask;
+}
+
+
+
+/*
+ * Before the first use of a transient image in a frame: its content is undefined, and it must
+ * wait for the last uses of the transients sharing its memory.
+ */
+static void beginTransientImageFrame(FrameGraph & theGraph, const FrameGraphResourceData & theResource)
+{
+	discardImageContents(theGraph.tracker, theResource.image);
+
+	VkPipelineStageFlags aliasStages = 0;
+	VkAccessFlags aliasWriteAccess = 0;
+
+	for(const FrameGraphResource aliasIndex : theResource.aliases)
+		for(const TrackedResourceState & aliasState : theGraph.tracker.images[theGraph.resources[aliasIndex].image].subresources) {
+			aliasStages |= aliasState.writeStages | aliasState.readStages;
+			aliasWriteAccess |= aliasState.writeAccess;
+		}
+
+	for(TrackedResourceState & state : theGraph.tracker.images[theResource.image].subresources) {
+		state.readStages |= aliasStages;
+		state.writeAccess |= aliasWriteAccess;
+	}
+}
+
+
+
+/**
+ * Records and submits the passes of a frame. The caller must have waited for the fence of the
+ * previous execution with the same theFrameIndex, and the imported resources must be bound;
+ * the semaphores carried from the previous execution are waited for if there was one. theFence (if not VK_NULL_HANDLE) is signaled
+ * by the last batch submitted, which waits for the last batch of the other queue: once it has
+ * signaled, the whole frame has completed.
+ */
+bool executeFrameGraph(FrameGraph & theGraph, const uint32_t theFrameIndex, const VkFence theFence = VK_NULL_HANDLE)
+{
+	VkResult result;
+	assert(theGraph.compiled && theFrameIndex < theGraph.frameCount);
+
+	for(int queue = 0; queue < FRAME_GRAPH_QUEUE_COUNT; queue++)
+		resetFrameCommandPool(theGraph.commandPools[theFrameIndex * FRAME_GRAPH_QUEUE_COUNT + queue]);
+
+	const size_t dependencyCount = theGraph.dependencies.size();
+	const size_t carriedDependencyCount = theGraph.carriedDependencies.size();
+	std::vector<bool> usedThisFrame(theGraph.resources.size(), false);
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	for(uint32_t batchIndex = 0; batchIndex < theGraph.batches.size(); batchIndex++)
+	{
+		const FrameGraphBatch & batch = theGraph.batches[batchIndex];
+
+		const VkCommandBuffer myCommandBuffer = getFrameCommandBuffer(theGraph.commandPools[theFrameIndex * FRAME_GRAPH_QUEUE_COUNT + batch.queue], VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		if(myCommandBuffer == VK_NULL_HANDLE)
+			return false;
+
+		result = vkBeginCommandBuffer(myCommandBuffer, &commandBufferBeginInfo);
+		assert(result == VK_SUCCESS);
+
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStageMasks;
+		std::vector<VkSemaphore> signalSemaphores;
+
+		for(size_t i = 0; i < dependencyCount; i++) {
+			if(theGraph.dependencies[i].dstBatch == batchIndex) {
+				waitSemaphores.push_back(theGraph.semaphores[theFrameIndex * dependencyCount + i]);
+				waitStageMasks.push_back(theGraph.dependencies[i].waitStageMask);
+			}
+			if(theGraph.dependencies[i].srcBatch == batchIndex)
+				signalSemaphores.push_back(theGraph.semaphores[theFrameIndex * dependencyCount + i]);
+		}
+
+		for(size_t i = 0; i < carriedDependencyCount; i++) {
+			if(theGraph.carriedDependencies[i].dstBatch == batchIndex && theGraph.previousFrameIndex != UINT32_MAX) {
+				waitSemaphores.push_back(theGraph.carriedSemaphores[theGraph.previousFrameIndex * carriedDependencyCount + i]);
+				waitStageMasks.push_back(theGraph.carriedDependencies[i].waitStageMask);
+			}
+			if(theGraph.carriedDependencies[i].srcBatch == batchIndex)
+				signalSemaphores.push_back(theGraph.carriedSemaphores[theFrameIndex * carriedDependencyCount + i]);
+		}
+
+		for(const uint32_t passIndex : batch.passes)
+		{
+			const FrameGraphPassData & pass = theGraph.passes[passIndex];
+
+			for(size_t i = 0; i < pass.accesses.size(); i++)
+			{
+				const FrameGraphAccess & access = pass.accesses[i];
+				FrameGraphResourceData & resource = theGraph.resources[access.resource];
+				const ResourceUsageInfo usageInfo = getResourceUsageInfo(access.usage);
+
+				const bool firstUse = !usedThisFrame[access.resource];
+				usedThisFrame[access.resource] = true;
+
+				if(firstUse && resource.isTransient)
+					beginTransientImageFrame(theGraph, resource);
+
+				// Waits for the caller's semaphore (e.g. the swapchain image acquisition) or the other queue.
+				const bool waitsSemaphore = firstUse && resource.waitSemaphore != VK_NULL_HANDLE;
+				if(waitsSemaphore) {
+					waitSemaphores.push_back(resource.waitSemaphore);
+					waitStageMasks.push_back(usageInfo.stageMask);
+				}
+
+				// An imported handle last used on the other queue by the previous execution: its semaphore was carried here.
+				VkPipelineStageFlags acquireStageMask = (waitsSemaphore || pass.acquiresFromOtherQueue[i]) ? usageInfo.stageMask : 0;
+
+				if(firstUse && !waitsSemaphore && !resource.isTransient)
+				{
+					uint32_t lastUseBatch = UINT32_MAX;
+					if(resource.isImage) {
+						auto lastUseIt = theGraph.importedImageBatches.find(resource.image);
+						if(lastUseIt != theGraph.importedImageBatches.end())
+							lastUseBatch = lastUseIt->second;
+					}
+					else {
+						auto lastUseIt = theGraph.importedBufferBatches.find(resource.buffer);
+						if(lastUseIt != theGraph.importedBufferBatches.end())
+							lastUseBatch = lastUseIt->second;
+					}
+
+					if(lastUseBatch != UINT32_MAX && theGraph.batches[lastUseBatch].queue != batch.queue) {
+						acquireStageMask = getPreviousExecutionWaitStages(theGraph, lastUseBatch, batchIndex);
+						if(acquireStageMask == 0) {
+							std::cout << "!!! ERROR: \"" << resource.name << "\" is bound to a handle last used on the other queue, and nothing waits for it: bind it with a semaphore." << std::endl;
+							return false;
+						}
+					}
+				}
+
+				if(acquireStageMask != 0) {
+					if(resource.isImage)
+						for(TrackedResourceState & state : theGraph.tracker.images[resource.image].subresources)
+							acquireTrackedStateAfterWait(state, acquireStageMask);
+					else
+						acquireTrackedStateAfterWait(theGraph.tracker.buffers[resource.buffer], acquireStageMask);
+				}
+
+				bool boolResult;
+				if(resource.isImage)
+					boolResult = useImage(theGraph.tracker, resource.image, {resource.desc.aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}, access.usage);
+				else
+					boolResult = useBuffer(theGraph.tracker, resource.buffer, access.usage);
+
+				if(!boolResult)
+					return false;
+			}
+
+			flushResourceBarriers(theGraph.tracker, myCommandBuffer);
+
+			pass.record(myCommandBuffer);
+		}
+
+		// Outputs whose last use is in this batch: transition them to their final usage, and signal their semaphore.
+		for(FrameGraphResourceData & resource : theGraph.resources)
+		{
+			if(resource.firstUse == UINT32_MAX || theGraph.passes[theGraph.executionOrder[resource.lastUse]].batch != batchIndex)
+				continue;
+
+			if(resource.isOutput) {
+				if(resource.isImage)
+					useImage(theGraph.tracker, resource.image, {resource.desc.aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}, resource.finalUsage);
+				else
+					useBuffer(theGraph.tracker, resource.buffer, resource.finalUsage);
+			}
+
+			if(resource.signalSemaphore != VK_NULL_HANDLE)
+				signalSemaphores.push_back(resource.signalSemaphore);
+		}
+
+		flushResourceBarriers(theGraph.tracker, myCommandBuffer);
+
+		result = vkEndCommandBuffer(myCommandBuffer);
+		assert(result == VK_SUCCESS);
+
+		const VkSubmitInfo submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreCount = (uint32_t)waitSemaphores.size(),
+			.pWaitSemaphores = waitSemaphores.data(),
+			.pWaitDstStageMask = waitStageMasks.data(),
+			.commandBufferCount = 1,
+			.pCommandBuffers = &myCommandBuffer,
+			.signalSemaphoreCount = (uint32_t)signalSemaphores.size(),
+			.pSignalSemaphores = signalSemaphores.data(),
+		};
+
+		const bool lastBatch = (batchIndex + 1 == theGraph.batches.size());
+		result = vkQueueSubmit(theGraph.queues[batch.queue], 1, &submitInfo, lastBatch ? theFence : VK_NULL_HANDLE);
+		if(result != VK_SUCCESS) {
+			std::cout << "!!! ERROR: failed to submit the frame graph batch " << batchIndex << ": " << vkdemos::utils::VkResultToString(result) << std::endl;
+			return false;
+		}
+	}
+
+	for(const FrameGraphResourceData & resource : theGraph.resources)
+	{
+		if(resource.isTransient || resource.firstUse == UINT32_MAX)
+			continue;
+
+		const uint32_t lastUseBatch = theGraph.passes[theGraph.executionOrder[resource.lastUse]].batch;
+		if(resource.isImage)
+			theGraph.importedImageBatches[resource.image] = lastUseBatch;
+		else
+			theGraph.importedBufferBatches[resource.buffer] = lastUseBatch;
+	}
+
+	theGraph.previousFrameIndex = theFrameIndex;
+	return true;
+}
+
+
+
+/**
+ * Prints the execution order of the passes, their batches, and the memory saved by aliasing the transient images.
+ */
+void printFrameGraphStatistics(const FrameGraph & theGraph)
+{
+	const char * queueNames[FRAME_GRAPH_QUEUE_COUNT] = {"graphics", "compute"};
+
+	size_t culledPasses = 0;
+	for(const FrameGraphPassData & pass : theGraph.passes)
+		if(pass.culled)
+			culledPasses++;
+
+	std::cout << "--- Frame graph: " << theGraph.executionOrder.size() << " passes (" << culledPasses << " culled), "
+	          << theGraph.batches.size() << " batches, " << theGraph.dependencies.size() << " semaphores between queues, "
+	          << theGraph.carriedDependencies.size() << " to the next frame." << std::endl;
+
+	for(size_t batchIndex = 0; batchIndex < theGraph.batches.size(); batchIndex++) {
+		std::cout << "    batch " << batchIndex << " (" << queueNames[theGraph.batches[batchIndex].queue] << "):";
+		for(const uint32_t passIndex : theGraph.batches[batchIndex].passes)
+			std::cout << " " << theGraph.passes[passIndex].name;
+		std::cout << std::endl;
+	}
+
+	std::cout << "    transient images: " << std::fixed << std::setprecision(2) << theGraph.transientMemory.size / (1024.0 * 1024.0) << " MiB, "
+	          << theGraph.unaliasedTransientBytes / (1024.0 * 1024.0) << " MiB without aliasing." << std::endl;
+
+	printResourceTrackerStatistics(theGraph.tracker, "Frame graph barriers");
+}
+
+
+
+/**
+ * Destroys the transient images, the semaphores and the command pools.
+ * theAllocator must be the one given to compileFrameGraph.
+ * The GPU must have finished executing the graph.
+ */
+void destroyFrameGraph(FrameGraph & theGraph, MemoryAllocator * theAllocator = nullptr, const VkAllocationCallbacks * pAllocator = nullptr)
+{
+	destroyFrameGraphCompiledObjects(theGraph, theAllocator, pAllocator);
+
+	for(FrameCommandPool & commandPool : theGraph.commandPools)
+		destroyFrameCommandPool(commandPool, pAllocator);
+
+	theGraph = FrameGraph();
+}
+
+}	// vkdemos
+
+#endif
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 
 #include "../00_commons/00_utils.h"
+#include "../00_commons/29_prerecordedCommandBuffers.h"
 #include "demo01fillpresentcommandbuffer.h"
 
 #include <vector>
@@ -12,13 +13,18 @@
 /**
  * Renders a single frame for this demo (i.e. we clear the screen).
  * Returns true on success and false on failure.
+ *
+ * If thePrerecordedCmdBuffers is not null, thePresentCmdBuffer is not used: the frame
+ * submits the command buffer pre-recorded for the acquired swapchain image, and only
+ * records it if it's out of date (see 00_commons/29_prerecordedCommandBuffers.h).
  */
 bool demo01RenderSingleFrame(const VkDevice theDevice,
                        const VkQueue theQueue,
                        const VkSwapchainKHR theSwapchain,
                        const VkCommandBuffer thePresentCmdBuffer,
                        const std::vector<VkImage> & theSwapchainImagesVector,
-                       const float clearColorR, const float clearColorG, const float clearColorB)
+                       const float clearColorR, const float clearColorG, const float clearColorB,
+                       vkdemos::PrerecordedCommandBuffers * thePrerecordedCmdBuffers = nullptr)
 {
 	VkResult result;
 	VkSemaphore imageAcquiredSemaphore, renderingCompletedSemaphore;
@@ -60,8 +66,25 @@ bool demo01RenderSingleFrame(const VkDevice theDevice,
 
 	/*
 	 * Fill the present command buffer with... the present commands.
+	 *
+	 * With pre-recorded command buffers, the commands for this swapchain image are already
+	 * there, unless the clear color changed since they were recorded.
 	 */
-	bool boolResult = demo01FillPresentCommandBuffer(thePresentCmdBuffer, theSwapchainImagesVector[imageIndex], clearColorR, clearColorG, clearColorB);
+	VkCommandBuffer myPresentCmdBuffer = thePresentCmdBuffer;
+	VkFence mySubmitFence = VK_NULL_HANDLE;
+	bool boolResult;
+
+	if(thePrerecordedCmdBuffers != nullptr)
+	{
+		auto recordFunction = [&](VkCommandBuffer theCommandBuffer, uint32_t theImageIndex) {
+			return demo01FillPresentCommandBuffer(theCommandBuffer, theSwapchainImagesVector[theImageIndex], clearColorR, clearColorG, clearColorB);
+		};
+
+		boolResult = vkdemos::getPrerecordedCommandBuffer(*thePrerecordedCmdBuffers, imageIndex, recordFunction, myPresentCmdBuffer, mySubmitFence);
+	}
+	else
+		boolResult = demo01FillPresentCommandBuffer(thePresentCmdBuffer, theSwapchainImagesVector[imageIndex], clearColorR, clearColorG, clearColorB);
+
 	assert(boolResult);
 
 
@@ -80,12 +103,12 @@ bool demo01RenderSingleFrame(const VkDevice theDevice,
 		.pWaitSemaphores = &imageAcquiredSemaphore,
 		.pWaitDstStageMask = &pipelineStageFlags,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &thePresentCmdBuffer,
+		.pCommandBuffers = &myPresentCmdBuffer,
 		.signalSemaphoreCount = 1,
 		.pSignalSemaphores = &renderingCompletedSemaphore
 	};
 
-	result = vkQueueSubmit(theQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	result = vkQueueSubmit(theQueue, 1, &submitInfo, mySubmitFence);
 	assert(result == VK_SUCCESS);
 
 
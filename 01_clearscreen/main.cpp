@@ -12,6 +12,7 @@
 #include "../00_commons/05_createVkDeviceAndVkQueue.h"
 #include "../00_commons/06_swapchain.h"
 #include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/29_prerecordedCommandBuffers.h"
 
 #include "demo01rendersingleframe.h"
 
@@ -122,6 +123,15 @@ int main(int argc, char* argv[])
 	boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCmdBufferPresent);
 	assert(boolResult);
 
+	// Pre-record one command buffer per swapchain image, instead of recording the present
+	// command buffer every frame: the only thing changing between frames is the swapchain
+	// image, and the clear color every FRAMES_PER_COLOR frames.
+	constexpr bool PRERECORD_COMMAND_BUFFERS = true;
+
+	vkdemos::PrerecordedCommandBuffers myPrerecordedCmdBuffers;
+	boolResult = vkdemos::createPrerecordedCommandBuffers(myDevice, myCommandPool, (uint32_t)mySwapchainImagesVector.size(), myPrerecordedCmdBuffers);
+	assert(boolResult);
+
 	std::cout << "\n---- Rendering Start ----" << std::endl;
 
 	/*
@@ -177,9 +187,14 @@ int main(int argc, char* argv[])
 			float colG = screenColors[(frameNumber/FRAMES_PER_COLOR) % MAX_COLORS][1];
 			float colB = screenColors[(frameNumber/FRAMES_PER_COLOR) % MAX_COLORS][2];
 
+			// The pre-recorded command buffers clear to the previous color: re-record them.
+			if(frameNumber % FRAMES_PER_COLOR == 0)
+				vkdemos::invalidatePrerecordedCommandBuffers(myPrerecordedCmdBuffers);
+
 			// Render a single frame
 			auto renderStartTime = std::chrono::high_resolution_clock::now();
-			quit = !demo01RenderSingleFrame(myDevice, myQueue, mySwapchain, myCmdBufferPresent, mySwapchainImagesVector, colR, colG, colB);
+			quit = !demo01RenderSingleFrame(myDevice, myQueue, mySwapchain, myCmdBufferPresent, mySwapchainImagesVector, colR, colG, colB,
+			                                PRERECORD_COMMAND_BUFFERS ? &myPrerecordedCmdBuffers : nullptr);
 			auto renderStopTime = std::chrono::high_resolution_clock::now();
 
 			// Compute frame time statistics
@@ -220,6 +235,11 @@ int main(int argc, char* argv[])
 	result = vkQueueWaitIdle(myQueue);
 	assert(result == VK_SUCCESS);
 
+	if(PRERECORD_COMMAND_BUFFERS)
+		vkdemos::printPrerecordedCommandBuffersStatistics(myPrerecordedCmdBuffers);
+
+	vkdemos::destroyPrerecordedCommandBuffers(myPrerecordedCmdBuffers);
+
 	// You don't need to call vkFreeCommandBuffers for all command buffers; all command buffers
 	// allocated from a command pool are released when the command pool is destroyed.
 	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
@@ -6,11 +6,15 @@
 
 /**
  * Create the renderpass for this demo.
+ * theColorFinalLayout is the layout the swapchain image is left in: PRESENT_SRC, unless
+ * something else (e.g. a frame graph) transitions it for presentation afterwards.
  */
 bool demo02CreateRenderPass(const VkDevice theDevice,
                                   const VkFormat theSwapchainImagesFormat,
                                   const VkFormat theDepthBufferFormat,
-                                  VkRenderPass & outRenderPass)
+                                  VkRenderPass & outRenderPass,
+                                  const VkAllocationCallbacks * pAllocator = nullptr,
+                                  const VkImageLayout theColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
 {
 	VkResult result;
 
@@ -27,6 +31,13 @@ bool demo02CreateRenderPass(const VkDevice theDevice,
 	 * and the layout we expect to see after the render pass finishes.
 	 * This way the driver will insert the appropriate layout change operations for us,
 	 * with all the correct barriers in place!
+	 *
+	 * The depth buffer is only needed while rendering: it's cleared when the renderpass
+	 * begins, and its contents are discarded when it ends (storeOp DONT_CARE), so
+	 * its initial layout can be UNDEFINED too. With these load/store operations the
+	 * depth buffer never needs to be read from or written to memory, and on tiled GPUs
+	 * it can live entirely in on-chip memory: that's why the demos create it as a
+	 * transient attachment (see createAndAllocateImage).
 	 */
 	const VkAttachmentDescription attachmentDescription[2] = {
 		[0] = {
@@ -38,7 +49,7 @@ bool demo02CreateRenderPass(const VkDevice theDevice,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+			.finalLayout = theColorFinalLayout
 		},
 		[1] = {
 			.flags = 0,
@@ -48,7 +59,7 @@ bool demo02CreateRenderPass(const VkDevice theDevice,
 			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 		},
 	};
@@ -115,7 +126,7 @@ bool demo02CreateRenderPass(const VkDevice theDevice,
 	};
 
 	VkRenderPass myRenderPass;
-	result = vkCreateRenderPass(theDevice, &renderPassCreateInfo, nullptr, &myRenderPass);
+	result = vkCreateRenderPass(theDevice, &renderPassCreateInfo, pAllocator, &myRenderPass);
 	assert(result == VK_SUCCESS);
 
 	outRenderPass = myRenderPass;
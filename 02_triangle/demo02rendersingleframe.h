@@ -2,6 +2,7 @@
 #define DEMO02RENDERSINGLEFRAME_H
 
 #include "../00_commons/00_utils.h"
+#include "../00_commons/29_prerecordedCommandBuffers.h"
 #include "demo02fillrenderingcommandbuffer.h"
 
 #include <vulkan/vulkan.h>
@@ -13,6 +14,9 @@
  * Returns true on success and false on failure.
  *
  * For a more detailed description, refer to demo 01_clearscreen.
+ *
+ * If thePrerecordedCmdBuffers is not null, thePresentCmdBuffer is not used: the frame
+ * submits the command buffer pre-recorded for the acquired swapchain image.
  */
 bool demo02RenderSingleFrame(const VkDevice theDevice,
                              const VkQueue theQueue,
@@ -24,7 +28,8 @@ bool demo02RenderSingleFrame(const VkDevice theDevice,
                              const VkBuffer theVertexBuffer,
                              const uint32_t vertexInputBinding,
                              const int width,
-                             const int height
+                             const int height,
+                             vkdemos::PrerecordedCommandBuffers * thePrerecordedCmdBuffers = nullptr
                              )
 {
 	VkResult result;
@@ -57,7 +62,21 @@ bool demo02RenderSingleFrame(const VkDevice theDevice,
 	/*
 	 * Fill the present command buffer with... the present commands.
 	 */
-	bool boolResult = demo02FillRenderingCommandBuffer(thePresentCmdBuffer, theFramebuffersVector[imageIndex], theRenderPass, thePipeline, theVertexBuffer, vertexInputBinding, width, height);
+	VkCommandBuffer myPresentCmdBuffer = thePresentCmdBuffer;
+	VkFence mySubmitFence = VK_NULL_HANDLE;
+	bool boolResult;
+
+	if(thePrerecordedCmdBuffers != nullptr)
+	{
+		auto recordFunction = [&](VkCommandBuffer theCommandBuffer, uint32_t theImageIndex) {
+			return demo02FillRenderingCommandBuffer(theCommandBuffer, theFramebuffersVector[theImageIndex], theRenderPass, thePipeline, theVertexBuffer, vertexInputBinding, width, height);
+		};
+
+		boolResult = vkdemos::getPrerecordedCommandBuffer(*thePrerecordedCmdBuffers, imageIndex, recordFunction, myPresentCmdBuffer, mySubmitFence);
+	}
+	else
+		boolResult = demo02FillRenderingCommandBuffer(thePresentCmdBuffer, theFramebuffersVector[imageIndex], theRenderPass, thePipeline, theVertexBuffer, vertexInputBinding, width, height);
+
 	assert(boolResult);
 
 
@@ -72,12 +91,12 @@ bool demo02RenderSingleFrame(const VkDevice theDevice,
 		.pWaitSemaphores = &imageAcquiredSemaphore,
 		.pWaitDstStageMask = &pipelineStageFlags,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &thePresentCmdBuffer,
+		.pCommandBuffers = &myPresentCmdBuffer,
 		.signalSemaphoreCount = 1,
 		.pSignalSemaphores = &renderingCompletedSemaphore
 	};
 
-	result = vkQueueSubmit(theQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	result = vkQueueSubmit(theQueue, 1, &submitInfo, mySubmitFence);
 	assert(result == VK_SUCCESS);
 
 
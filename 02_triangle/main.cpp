@@ -14,6 +14,9 @@
 #include "../00_commons/07_commandPoolAndBuffer.h"
 #include "../00_commons/08_createAndAllocateImage.h"
 #include "../00_commons/09_createAndAllocateBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/29_prerecordedCommandBuffers.h"
 
 #include "demo02createpipeline.h"
 #include "demo02createrenderpass.h"
@@ -150,7 +153,7 @@ int main(int argc, char* argv[])
 	VkDeviceMemory myDepthMemory;
 	boolResult = vkdemos::createAndAllocateImage(myDevice,
 	                                    myMemoryProperties,
-	                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+	                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
 	                                    0,
 	                                    myDepthBufferFormat,
 	                                    windowWidth,
@@ -158,7 +161,8 @@ int main(int argc, char* argv[])
 	                                    myDepthImage,
 	                                    myDepthMemory,
 	                                    &myDepthImageView,
-	                                    VK_IMAGE_ASPECT_DEPTH_BIT
+	                                    VK_IMAGE_ASPECT_DEPTH_BIT,
+	                                    VKDEMOS_ALLOCATION_SITE("depth buffer")
 	                                    );
 	assert(boolResult);
 
@@ -180,31 +184,28 @@ int main(int argc, char* argv[])
 	}
 
 
-	// Create a buffer to use as the vertex buffer.
+	/*
+	 * Create the vertex buffer.
+	 * The vertices never change: a static geometry buffer lives in device-local memory,
+	 * and the data is copied there through a staging buffer.
+	 */
 	const size_t vertexBufferSize = sizeof(TriangleDemoVertex)*NUM_DEMO_VERTICES;
 	VkBuffer myVertexBuffer;
 	VkDeviceMemory myVertexBufferMemory;
-	boolResult = vkdemos::createAndAllocateBuffer(myDevice,
-	                                     myMemoryProperties,
-	                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-	                                     vertexBufferSize,
-	                                     myVertexBuffer,
-	                                     myVertexBufferMemory
-	                                     );
+	boolResult = vkdemos::createGeometryBuffer(myDevice,
+	                                           myMemoryProperties,
+	                                           myQueue,
+	                                           myCommandPool,
+	                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                                           vkdemos::GEOMETRY_USAGE_STATIC,
+	                                           vertices,
+	                                           vertexBufferSize,
+	                                           myVertexBuffer,
+	                                           myVertexBufferMemory,
+	                                           VKDEMOS_ALLOCATION_SITE("vertex buffer")
+	                                           );
 	assert(boolResult);
 
-	// Map vertex buffer and insert data
-	{
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myVertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
-
-		memcpy(mappedBuffer, vertices, vertexBufferSize);
-
-		vkUnmapMemory(myDevice, myVertexBufferMemory);
-	}
-
 
 	// Create the pipeline.
 	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
@@ -260,6 +261,26 @@ int main(int argc, char* argv[])
 	result = vkQueueWaitIdle(myQueue);
 	assert(result == VK_SUCCESS);
 
+	/*
+	 * The triangle never changes: record the rendering commands once per swapchain image
+	 * (i.e. per framebuffer), and then just submit them every frame.
+	 * They'd need to be re-recorded (vkdemos::invalidatePrerecordedCommandBuffers) if the
+	 * pipeline or the render pass changed, and created again with the swapchain.
+	 */
+	constexpr bool PRERECORD_COMMAND_BUFFERS = true;
+
+	vkdemos::PrerecordedCommandBuffers myPrerecordedCmdBuffers;
+	boolResult = vkdemos::createPrerecordedCommandBuffers(myDevice, myCommandPool, (uint32_t)myFramebuffersVector.size(), myPrerecordedCmdBuffers);
+	assert(boolResult);
+
+	if(PRERECORD_COMMAND_BUFFERS)
+	{
+		boolResult = vkdemos::recordAllPrerecordedCommandBuffers(myPrerecordedCmdBuffers, [&](VkCommandBuffer theCommandBuffer, uint32_t imageIndex) {
+			return demo02FillRenderingCommandBuffer(theCommandBuffer, myFramebuffersVector[imageIndex], myRenderPass, myGraphicsPipeline, myVertexBuffer, VERTEX_INPUT_BINDING, windowWidth, windowHeight);
+		});
+		assert(boolResult);
+	}
+
 	std::cout << "\n---- Rendering Start ----" << std::endl;
 
 	/*
@@ -295,7 +316,8 @@ int main(int argc, char* argv[])
 		{
 			// Render a single frame
 			auto renderStartTime = std::chrono::high_resolution_clock::now();
-			quit = !demo02RenderSingleFrame(myDevice, myQueue, mySwapchain, myCmdBufferPresent, myFramebuffersVector, myRenderPass, myGraphicsPipeline, myVertexBuffer, VERTEX_INPUT_BINDING, windowWidth, windowHeight);
+			quit = !demo02RenderSingleFrame(myDevice, myQueue, mySwapchain, myCmdBufferPresent, myFramebuffersVector, myRenderPass, myGraphicsPipeline, myVertexBuffer, VERTEX_INPUT_BINDING, windowWidth, windowHeight,
+			                                PRERECORD_COMMAND_BUFFERS ? &myPrerecordedCmdBuffers : nullptr);
 			auto renderStopTime = std::chrono::high_resolution_clock::now();
 
 			// Compute frame time statistics
@@ -336,12 +358,17 @@ int main(int argc, char* argv[])
 	result = vkQueueWaitIdle(myQueue);
 	assert(result == VK_SUCCESS);
 
+	if(PRERECORD_COMMAND_BUFFERS)
+		vkdemos::printPrerecordedCommandBuffersStatistics(myPrerecordedCmdBuffers);
+
+	vkdemos::destroyPrerecordedCommandBuffers(myPrerecordedCmdBuffers);
+
 	vkDestroyPipeline(myDevice, myGraphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
 
 	// Destroy vertex buffer and free its memory.
 	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
-	vkFreeMemory(myDevice, myVertexBufferMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
 
 	// Destroy framebuffers.
 	for(auto framebuffer : myFramebuffersVector)
@@ -353,7 +380,7 @@ int main(int argc, char* argv[])
 	// Destroy View, Image and release memory of our depth buffer.
 	vkDestroyImageView(myDevice, myDepthImageView, nullptr);
 	vkDestroyImage(myDevice, myDepthImage, nullptr);
-	vkFreeMemory(myDevice, myDepthMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myDepthMemory);
 
 	/*
 	 * For more informations on the following commands, refer to Demo 01.
@@ -364,6 +391,10 @@ int main(int argc, char* argv[])
 		vkDestroyImageView(myDevice, imgView, nullptr);
 
 	vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+
+	// All the device memory should have been freed by now.
+	vkdemos::printMemoryLeakReport();
+
 	vkDestroyDevice(myDevice, nullptr);
 	vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
 	vkdemos::destroyDebugReportCallback(myInstance, myDebugReportCallback);
@@ -14,6 +14,8 @@
 #include "../00_commons/07_commandPoolAndBuffer.h"
 #include "../00_commons/08_createAndAllocateImage.h"
 #include "../00_commons/09_createAndAllocateBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/26_geometryBuffers.h"
 
 #include "demo03rendersingleframe.h"
 
@@ -148,7 +150,7 @@ int main(int argc, char* argv[])
 	VkDeviceMemory myDepthMemory;
 	boolResult = vkdemos::createAndAllocateImage(myDevice,
 	                                    myMemoryProperties,
-	                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+	                                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
 	                                    0,
 	                                    myDepthBufferFormat,
 	                                    windowWidth,
@@ -156,7 +158,8 @@ int main(int argc, char* argv[])
 	                                    myDepthImage,
 	                                    myDepthMemory,
 	                                    &myDepthImageView,
-	                                    VK_IMAGE_ASPECT_DEPTH_BIT
+	                                    VK_IMAGE_ASPECT_DEPTH_BIT,
+	                                    VKDEMOS_ALLOCATION_SITE("depth buffer")
 	                                    );
 	assert(boolResult);
 
@@ -178,31 +181,28 @@ int main(int argc, char* argv[])
 	}
 
 
-	// Create a buffer to use as the vertex buffer.
+	/*
+	 * Create the vertex buffer.
+	 * The vertices never change: a static geometry buffer lives in device-local memory,
+	 * and the data is copied there through a staging buffer.
+	 */
 	const size_t vertexBufferSize = sizeof(TriangleDemoVertex)*NUM_DEMO_VERTICES;
 	VkBuffer myVertexBuffer;
 	VkDeviceMemory myVertexBufferMemory;
-	boolResult = vkdemos::createAndAllocateBuffer(myDevice,
-	                                     myMemoryProperties,
-	                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-	                                     vertexBufferSize,
-	                                     myVertexBuffer,
-	                                     myVertexBufferMemory
-	                                     );
+	boolResult = vkdemos::createGeometryBuffer(myDevice,
+	                                           myMemoryProperties,
+	                                           myQueue,
+	                                           myCommandPool,
+	                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                                           vkdemos::GEOMETRY_USAGE_STATIC,
+	                                           vertices,
+	                                           vertexBufferSize,
+	                                           myVertexBuffer,
+	                                           myVertexBufferMemory,
+	                                           VKDEMOS_ALLOCATION_SITE("vertex buffer")
+	                                           );
 	assert(boolResult);
 
-	// Map vertex buffer and insert data
-	{
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myVertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
-
-		memcpy(mappedBuffer, vertices, vertexBufferSize);
-
-		vkUnmapMemory(myDevice, myVertexBufferMemory);
-	}
-
 
 	// Create the pipeline.
 	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
@@ -235,7 +235,7 @@ int main(int argc, char* argv[])
 
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, perFrameDataVector[i].presentCmdBuffer);
+		boolResult = vkdemos::createFrameCommandPool(myDevice, myQueueFamilyIndex, perFrameDataVector[i].commandPool);
 		assert(boolResult);
 
 		result = vkdemos::utils::createFence(myDevice, perFrameDataVector[i].presentFence);
@@ -357,6 +357,7 @@ int main(int argc, char* argv[])
 	// Destroy the objects in the perFrameDataVector array.
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
+		vkdemos::destroyFrameCommandPool(perFrameDataVector[i].commandPool);
 		vkDestroyFence(myDevice, perFrameDataVector[i].presentFence, nullptr);
 		vkDestroySemaphore(myDevice, perFrameDataVector[i].imageAcquiredSemaphore, nullptr);
 		vkDestroySemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore, nullptr);
@@ -368,7 +369,7 @@ int main(int argc, char* argv[])
 	vkDestroyPipeline(myDevice, myGraphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
 	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
-	vkFreeMemory(myDevice, myVertexBufferMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
 
 	for(auto framebuffer : myFramebuffersVector)
 		vkDestroyFramebuffer(myDevice, framebuffer, nullptr);
@@ -376,7 +377,7 @@ int main(int argc, char* argv[])
 	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
 	vkDestroyImageView(myDevice, myDepthImageView, nullptr);
 	vkDestroyImage(myDevice, myDepthImage, nullptr);
-	vkFreeMemory(myDevice, myDepthMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myDepthMemory);
 
 	/*
 	 * For more informations on the following commands, refer to Demo 01.
@@ -387,6 +388,10 @@ int main(int argc, char* argv[])
 		vkDestroyImageView(myDevice, imgView, nullptr);
 
 	vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+
+	// All the device memory should have been freed by now.
+	vkdemos::printMemoryLeakReport();
+
 	vkDestroyDevice(myDevice, nullptr);
 	vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
 	vkdemos::destroyDebugReportCallback(myInstance, myDebugReportCallback);
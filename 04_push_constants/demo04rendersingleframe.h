@@ -1,6 +1,7 @@
 #ifndef DEMO04RENDERSINGLEFRAME_H
 #define DEMO04RENDERSINGLEFRAME_H
 
+#include "../00_commons/31_frameCommandPool.h"
 #include "demo04fillrenderingcommandbuffer.h"
 
 #include <vulkan/vulkan.h>
@@ -11,7 +12,8 @@
 
 struct PerFrameData
 {
-	VkCommandBuffer presentCmdBuffer;
+	vkdemos::FrameCommandPool commandPool;	// reset as a whole when the frame's fence has signaled.
+	VkCommandBuffer presentCmdBuffer;	// taken from commandPool every frame.
 	VkSemaphore imageAcquiredSemaphore;
 	VkSemaphore renderingCompletedSemaphore;
 	VkFence presentFence;
@@ -68,6 +70,15 @@ bool demo04RenderSingleFrame(const VkDevice theDevice,
 		assert(result == VK_SUCCESS);
 
 
+	/*
+	 * The GPU has finished with this frame's command buffers (its fence has been waited on above):
+	 * reset them all with a single vkResetCommandPool, and take the present command buffer again.
+	 */
+	vkdemos::resetFrameCommandPool(thePerFrameData.commandPool);
+	thePerFrameData.presentCmdBuffer = vkdemos::getFrameCommandBuffer(thePerFrameData.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	assert(thePerFrameData.presentCmdBuffer != VK_NULL_HANDLE);
+
+
 	/*
 	 * Fill the present command buffer with... the present commands.
 	 */
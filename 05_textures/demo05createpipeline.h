@@ -2,9 +2,11 @@
 #define DEMO05CREATEPIPELINE_H
 
 #include "../00_commons/00_utils.h"
+#include "../00_commons/28_vertexQuantization.h"
 
 #include <vulkan/vulkan.h>
 #include <string>
+#include <vector>
 #include <cassert>
 
 
@@ -29,7 +31,9 @@ bool demo05CreatePipeline(const VkDevice theDevice,
                           const std::string & vertexShaderFilename,
                           const std::string & fragmentShaderFilename,
                           const uint32_t vertexInputBinding,
-                          VkPipeline & outPipeline
+                          const vkdemos::QuantizedVertexFormat & theVertexFormat,
+                          VkPipeline & outPipeline,
+                          const VkAllocationCallbacks * pAllocator = nullptr
                           )
 {
 	VkResult result;
@@ -39,8 +43,8 @@ bool demo05CreatePipeline(const VkDevice theDevice,
 	 */
 	VkShaderModule vertexShaderModule, fragmentShaderModule;
 	bool b1, b2;
-	b1 = vkdemos::utils::loadAndCreateShaderModule(theDevice, vertexShaderFilename, vertexShaderModule);
-	b2 = vkdemos::utils::loadAndCreateShaderModule(theDevice, fragmentShaderFilename, fragmentShaderModule);
+	b1 = vkdemos::utils::loadAndCreateShaderModule(theDevice, vertexShaderFilename, vertexShaderModule, pAllocator);
+	b2 = vkdemos::utils::loadAndCreateShaderModule(theDevice, fragmentShaderFilename, fragmentShaderModule, pAllocator);
 
 	if(!b1 || !b2) {
 		std::cout << "!!! ERROR: couldn't create shader modules." << std::endl;
@@ -77,30 +81,11 @@ bool demo05CreatePipeline(const VkDevice theDevice,
 	/*
 	 * Specify parameters for vertex input.
 	 */
-	VkVertexInputBindingDescription vertexInputBindingDescription = {
-		.binding = vertexInputBinding,
-		.stride = sizeof(Demo05Vertex),
-		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-	};
-
-	// Two Attribute Descriptions: a vector of 3 float elements for vertex position (x,y,z),
-	// and a vector of 2 float elements for texture UV coordinate.
-	constexpr int inputAttributeDescCount = 2;
-	VkVertexInputAttributeDescription vertexInputAttributeDescription[inputAttributeDescCount] =
-	{
-		[0] = {
-			.location = 0,
-			.binding = vertexInputBinding,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = offsetof(Demo05Vertex, x),
-		},
-		[1] = {
-			.location = 1,
-			.binding = vertexInputBinding,
-			.format = VK_FORMAT_R32G32_SFLOAT,
-			.offset = offsetof(Demo05Vertex, u),
-		},
-	};
+	// The vertex buffer holds Demo05Vertex-es encoded in theVertexFormat (plain floats, or quantized):
+	// the binding's stride and the attributes' formats and offsets come from it.
+	VkVertexInputBindingDescription vertexInputBindingDescription;
+	std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescription;
+	vkdemos::getQuantizedVertexInputDescriptions(theVertexFormat, vertexInputBinding, vertexInputBindingDescription, vertexInputAttributeDescription);
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -108,8 +93,8 @@ bool demo05CreatePipeline(const VkDevice theDevice,
 		.flags = 0,
 		.vertexBindingDescriptionCount = 1,
 		.pVertexBindingDescriptions = &vertexInputBindingDescription,
-		.vertexAttributeDescriptionCount = inputAttributeDescCount,
-		.pVertexAttributeDescriptions = vertexInputAttributeDescription,
+		.vertexAttributeDescriptionCount = (uint32_t)vertexInputAttributeDescription.size(),
+		.pVertexAttributeDescriptions = vertexInputAttributeDescription.data(),
 	};
 
 
@@ -275,11 +260,11 @@ bool demo05CreatePipeline(const VkDevice theDevice,
 	};
 
 	VkPipeline myGraphicsPipeline;
-	result = vkCreateGraphicsPipelines(theDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &myGraphicsPipeline);
+	result = vkCreateGraphicsPipelines(theDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, pAllocator, &myGraphicsPipeline);
 	assert(result == VK_SUCCESS);
 
-	vkDestroyShaderModule(theDevice, vertexShaderModule, nullptr);
-	vkDestroyShaderModule(theDevice, fragmentShaderModule, nullptr);
+	vkDestroyShaderModule(theDevice, vertexShaderModule, pAllocator);
+	vkDestroyShaderModule(theDevice, fragmentShaderModule, pAllocator);
 
 	outPipeline = myGraphicsPipeline;
 	return true;
@@ -17,8 +17,10 @@ bool demo05FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
                                       const VkPipelineLayout thePipelineLayout,
                                       const VkBuffer theVertexBuffer,
                                       const uint32_t vertexInputBinding,
-                                      const uint32_t numberOfVertices,
+                                      const VkBuffer theIndexBuffer,
+                                      const uint32_t numberOfIndices,
                                       const VkDescriptorSet theDescriptorSet,
+                                      const uint32_t objectDataOffset,
                                       const int width,
                                       const int height,
                                       const PushConstData & pushConstData
@@ -90,8 +92,13 @@ bool demo05FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
 	VkDeviceSize buffersOffsets = 0;
 	vkCmdBindVertexBuffers(theCommandBuffer, vertexInputBinding, 1, &theVertexBuffer, &buffersOffsets);
 
+	// Bind the index buffer (32-bit indices, produced by vkdemos::optimizeMesh).
+	vkCmdBindIndexBuffer(theCommandBuffer, theIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
 	/*
 	 * Bind the descriptor set.
+	 * The object data binding is a dynamic uniform buffer: the offset
+	 * of this frame's data inside the ring buffer is specified here.
 	 */
 	vkCmdBindDescriptorSets(
 		theCommandBuffer,
@@ -100,8 +107,8 @@ bool demo05FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
 	    0,                 // firstSet
 		1,                 // descriptorSetCount
 		&theDescriptorSet, // pDescriptorSets
-		0,                 // dynamicOffsetCount
-		nullptr            // pDynamicOffsets
+		1,                 // dynamicOffsetCount
+		&objectDataOffset  // pDynamicOffsets
 	);
 
 	// Send the Push Constants.
@@ -115,7 +122,7 @@ bool demo05FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
 	);
 
 	// Send the draw command, that will begin all the rendering magic
-	vkCmdDraw(theCommandBuffer, numberOfVertices, 1, 0, 0);
+	vkCmdDrawIndexed(theCommandBuffer, numberOfIndices, 1, 0, 0, 0);
 
 	// End the render pass commands.
 	vkCmdEndRenderPass(theCommandBuffer);
@@ -1,6 +1,7 @@
 #ifndef DEMO05RENDERSINGLEFRAME_H
 #define DEMO05RENDERSINGLEFRAME_H
 
+#include "../00_commons/31_frameCommandPool.h"
 #include "demo05fillrenderingcommandbuffer.h"
 #include "pushconstdata.h"
 
@@ -12,7 +13,8 @@
 
 struct PerFrameData
 {
-	VkCommandBuffer presentCmdBuffer;
+	vkdemos::FrameCommandPool commandPool;	// reset as a whole when the frame's fence has signaled.
+	VkCommandBuffer presentCmdBuffer;	// taken from commandPool every frame.
 	VkSemaphore imageAcquiredSemaphore;
 	VkSemaphore renderingCompletedSemaphore;
 	VkFence presentFence;
@@ -33,8 +35,10 @@ bool demo05RenderSingleFrame(const VkDevice theDevice,
                              const VkPipelineLayout thePipelineLayout,
                              const VkBuffer theVertexBuffer,
                              const uint32_t vertexInputBinding,
-                             const uint32_t numberOfVertices,
+                             const VkBuffer theIndexBuffer,
+                             const uint32_t numberOfIndices,
                              const VkDescriptorSet theDescriptorSet,
+                             const uint32_t objectDataOffset,
                              PerFrameData & thePerFrameData,
                              const int width,
                              const int height,
@@ -71,10 +75,19 @@ bool demo05RenderSingleFrame(const VkDevice theDevice,
 		assert(result == VK_SUCCESS);
 
 
+	/*
+	 * The GPU has finished with this frame's command buffers (its fence has been waited on above):
+	 * reset them all with a single vkResetCommandPool, and take the present command buffer again.
+	 */
+	vkdemos::resetFrameCommandPool(thePerFrameData.commandPool);
+	thePerFrameData.presentCmdBuffer = vkdemos::getFrameCommandBuffer(thePerFrameData.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	assert(thePerFrameData.presentCmdBuffer != VK_NULL_HANDLE);
+
+
 	/*
 	 * Fill the present command buffer with... the present commands.
 	 */
-	bool boolResult = demo05FillRenderingCommandBuffer(thePerFrameData.presentCmdBuffer, theFramebuffersVector[imageIndex], theRenderPass, thePipeline, thePipelineLayout, theVertexBuffer, vertexInputBinding, numberOfVertices, theDescriptorSet, width, height, pushConstData);
+	bool boolResult = demo05FillRenderingCommandBuffer(thePerFrameData.presentCmdBuffer, theFramebuffersVector[imageIndex], theRenderPass, thePipeline, thePipelineLayout, theVertexBuffer, vertexInputBinding, theIndexBuffer, numberOfIndices, theDescriptorSet, objectDataOffset, width, height, pushConstData);
 	assert(boolResult);
 
 
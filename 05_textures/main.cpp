@@ -16,15 +16,33 @@
 #include "../00_commons/09_createAndAllocateBuffer.h"
 #include "../00_commons/10_submitimagebarrier.h"
 #include "../00_commons/11_loadimagefromfile.h"
+#include "../00_commons/12_memoryAllocator.h"
+#include "../00_commons/13_frameRingBuffer.h"
+#include "../00_commons/14_mappedMemory.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/16_hostAllocator.h"
+#include "../00_commons/17_uploadEngine.h"
+#include "../00_commons/18_stagingRing.h"
+#include "../00_commons/19_mipmaps.h"
+#include "../00_commons/20_threadPool.h"
+#include "../00_commons/21_cpuMipmaps.h"
+#include "../00_commons/22_compressedTextures.h"
+#include "../00_commons/23_textureCache.h"
+#include "../00_commons/24_jobSystem.h"
+#include "../00_commons/25_textureStreaming.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/27_meshProcessing.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../00_commons/glm/glm/glm.hpp"
 #include "../00_commons/glm/glm/gtc/matrix_transform.hpp"
+#include "../00_commons/28_vertexQuantization.h"   // Uses glm: included after the GLM_FORCE defines.
 
 #include "demo05rendersingleframe.h"
 #include "demo05createpipeline.h"
 #include "pushconstdata.h"
+#include "objectuniformdata.h"
 
 // CreateRenderPass are the same as Demo 02
 #include "../02_triangle/demo02createrenderpass.h"
@@ -33,7 +51,9 @@
 // Includes for this file
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <vector>
+#include <string>
 #include <algorithm>
 #include <chrono>
 #include <thread>
@@ -52,6 +72,8 @@ static const std::string FRAGMENT_SHADER_FILENAME = "fragment.spirv";
 
 static constexpr int VERTEX_INPUT_BINDING = 0;
 
+static constexpr VkDeviceSize RING_BUFFER_SIZE = 64 * 1024;
+
 
 // Vertex data to draw.
 static constexpr int NUM_DEMO_VERTICES = 3*2*6;
@@ -118,7 +140,20 @@ struct PixelData {    // data for a single pixel.
 
 static constexpr int TEXTURE_WIDTH = 256;
 static constexpr int TEXTURE_HEIGHT = 256;
+
+static constexpr VkDeviceSize STAGING_RING_SIZE = 4 * 1024 * 1024;
+static constexpr VkDeviceSize TEXTURE_STREAMING_BUDGET = 64 * 1024 * 1024;   // Device memory for the streamed textures.
 static constexpr const char* TEXTURE_FILE_NAME = "texture.png";
+static constexpr const char* COMPRESSED_TEXTURE_FILE_NAME = "texture.ktx2";   // Used instead of TEXTURE_FILE_NAME if it exists.
+static constexpr const char* MIPMAP_SHADER_FILE_NAME = "mipmap.spirv";
+
+// Generate the texture's mip chain on the CPU (with a Kaiser filter) instead of on the GPU,
+// and keep the result in a cache file ("texture.png.vkcache") for the next runs.
+// The command line options "--gpu-mipmaps" and "--cpu-mipmaps" override it.
+static constexpr bool GENERATE_MIPMAPS_ON_CPU_BY_DEFAULT = true;
+
+// Store the cube's vertices quantized (16-bit positions and UVs, 12 bytes) instead of as floats (20 bytes).
+static constexpr bool QUANTIZE_VERTICES = true;
 
 
 /**
@@ -134,6 +169,20 @@ int main(int argc, char* argv[])
 	bool boolResult;
 	VkResult result;
 
+	bool myGenerateMipmapsOnCpu = GENERATE_MIPMAPS_ON_CPU_BY_DEFAULT;
+	for(int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if(argument == "--gpu-mipmaps")
+			myGenerateMipmapsOnCpu = false;
+		else if(argument == "--cpu-mipmaps")
+			myGenerateMipmapsOnCpu = true;
+		else
+			std::cout << "~~~ WARNING: unknown option \"" << argument << "\"; the options are --cpu-mipmaps and --gpu-mipmaps." << std::endl;
+	}
+
+	std::cout << "--- The texture's mipmaps are generated on the " << (myGenerateMipmapsOnCpu ? "CPU" : "GPU") << "." << std::endl;
+
 	/*
 	 * SDL2 Initialization
 	 */
@@ -143,6 +192,55 @@ int main(int argc, char* argv[])
 	boolResult = vkdemos::utils::sdl2Initialization(applicationName, windowWidth, windowHeight, mySdlWindow, mySdlSysWmInfo);
 	assert(boolResult);
 
+	/*
+	 * Start loading the assets in the background.
+	 * Reading and decoding the texture files doesn't need Vulkan: it's done by jobs on the
+	 * worker threads of a job system while the main thread initializes Vulkan, and the main
+	 * thread collects the results when it creates the texture (see below), where it uploads
+	 * them through the staging ring, which only the main thread uses.
+	 * One job loads the block-compressed texture, and another one, at the same time, the PNG
+	 * (through the texture cache); the main thread chooses which one to use once both are done,
+	 * so that the PNG is ready if the compressed texture turns out to be unusable on this device.
+	 */
+	vkdemos::JobSystem myJobSystem;
+	vkdemos::initJobSystem(myJobSystem);
+	vkdemos::JobGroup myAssetJobs;
+
+	vkdemos::CompressedTexture myCompressedTexture;
+	vkdemos::CachedTexture myCachedTexture;
+	vkdemos::ImageFile myImageFile;
+	bool myUseCompressedTexture = false;
+	bool myTextureFileLoaded = false;
+
+	vkdemos::scheduleJob(myJobSystem, myAssetJobs, [&]{
+		myUseCompressedTexture = std::ifstream(COMPRESSED_TEXTURE_FILE_NAME).good()
+		                         && vkdemos::loadCompressedTexture(COMPRESSED_TEXTURE_FILE_NAME, myCompressedTexture);
+	});
+
+	vkdemos::scheduleJob(myJobSystem, myAssetJobs, [&]{
+		/*
+		 * When the mipmaps are generated on the CPU, the texture comes from the preprocessed texture cache:
+		 * the first run decodes the image and computes its mip chain, and saves the result
+		 * next to the image; the following runs just map that file.
+		 * The data is filtered as linear because the texture format is UNORM
+		 * (for an _SRGB format, the filtering is done in linear light).
+		 * Otherwise, the image file is just decoded; its pixels are converted to the texture's
+		 * format later, directly where they're needed (see readImagePixels).
+		 */
+		if(myGenerateMipmapsOnCpu) {
+			vkdemos::TextureCacheOptions myCacheOptions;
+			myCacheOptions.format = VK_FORMAT_R8G8B8A8_UNORM;
+			myCacheOptions.levelCount = vkdemos::computeMipLevelCount(TEXTURE_WIDTH, TEXTURE_HEIGHT);
+			myCacheOptions.filter = vkdemos::CPU_IMAGE_FILTER_KAISER;
+
+			// No thread pool: with many textures, each one is processed by its own job.
+			myTextureFileLoaded = vkdemos::loadCachedTexture(nullptr, TEXTURE_FILE_NAME, myCacheOptions, myCachedTexture);
+		}
+		else {
+			myTextureFileLoaded = vkdemos::openImageFile(TEXTURE_FILE_NAME, myImageFile);
+		}
+	});
+
 	/*
 	 * Vulkan initialization.
 	 */
@@ -154,15 +252,27 @@ int main(int argc, char* argv[])
 	extensionsNamesToEnable.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 	extensionsNamesToEnable.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME); // TODO: add support for other windowing systems
 
+	/*
+	 * Create the host allocator.
+	 * Its callbacks are passed to every function that creates or destroys a Vulkan object,
+	 * so that all the host memory the driver allocates for us goes through it; this way
+	 * we can count how many host allocations every frame causes, and short-lived ones
+	 * are served by a fast linear arena instead of malloc.
+	 */
+	vkdemos::HostAllocator myHostAllocator;
+	vkdemos::initHostAllocator(myHostAllocator);
+	const VkAllocationCallbacks * myHostAllocationCallbacks = vkdemos::getHostAllocationCallbacks(myHostAllocator);
+
 	VkInstance myInstance;
-	boolResult = vkdemos::createVkInstance(layersNamesToEnable, extensionsNamesToEnable, applicationName, engineName, myInstance);
+	boolResult = vkdemos::createVkInstance(layersNamesToEnable, extensionsNamesToEnable, applicationName, engineName, myInstance, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	VkDebugReportCallbackEXT myDebugReportCallback;
 	vkdemos::createDebugReportCallback(myInstance,
 		VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT,
 		vkdemos::debugCallback,
-		myDebugReportCallback
+		myDebugReportCallback,
+		myHostAllocationCallbacks
 	);
 
 	VkPhysicalDevice myPhysicalDevice;
@@ -170,47 +280,73 @@ int main(int argc, char* argv[])
 	assert(boolResult);
 
 	VkSurfaceKHR mySurface;
-	boolResult = vkdemos::createVkSurface(myInstance, mySdlSysWmInfo, mySurface);
+	boolResult = vkdemos::createVkSurface(myInstance, mySdlSysWmInfo, mySurface, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	VkDevice myDevice;
 	VkQueue myQueue;
 	uint32_t myQueueFamilyIndex;
-	boolResult = vkdemos::createVkDeviceAndVkQueue(myPhysicalDevice, mySurface, layersNamesToEnable, myDevice, myQueue, myQueueFamilyIndex);
+	VkQueue myTransferQueue;
+	uint32_t myTransferQueueFamilyIndex;
+	boolResult = vkdemos::createVkDeviceAndVkQueue(myPhysicalDevice, mySurface, layersNamesToEnable, myDevice, myQueue, myQueueFamilyIndex, myHostAllocationCallbacks, &myTransferQueue, &myTransferQueueFamilyIndex);
 	assert(boolResult);
 
 	VkSwapchainKHR mySwapchain;
 	VkFormat mySurfaceFormat;
-	boolResult = vkdemos::createVkSwapchain(myPhysicalDevice, myDevice, mySurface, windowWidth, windowHeight, FRAME_LAG, VK_NULL_HANDLE, mySwapchain, mySurfaceFormat);
+	boolResult = vkdemos::createVkSwapchain(myPhysicalDevice, myDevice, mySurface, windowWidth, windowHeight, FRAME_LAG, VK_NULL_HANDLE, mySwapchain, mySurfaceFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	std::vector<VkImage> mySwapchainImagesVector;
 	std::vector<VkImageView> mySwapchainImageViewsVector;
-	boolResult = vkdemos::getSwapchainImagesAndViews(myDevice, mySwapchain, mySurfaceFormat, mySwapchainImagesVector, mySwapchainImageViewsVector);
+	boolResult = vkdemos::getSwapchainImagesAndViews(myDevice, mySwapchain, mySurfaceFormat, mySwapchainImagesVector, mySwapchainImageViewsVector, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	VkCommandPool myCommandPool;
-	boolResult = vkdemos::createCommandPool(myDevice, myQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
+	boolResult = vkdemos::createCommandPool(myDevice, myQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool, myHostAllocationCallbacks);
+	assert(boolResult);
+
+	// The upload engine copies data on the transfer queue, and hands the resources over to the graphics queue.
+	vkdemos::UploadEngine myUploadEngine;
+	boolResult = vkdemos::createUploadEngine(myDevice, myTransferQueue, myTransferQueueFamilyIndex, myQueue, myQueueFamilyIndex, myUploadEngine, myHostAllocationCallbacks);
+	assert(boolResult);
+
+	// All the uploads go through a single staging ring, reused for the whole program.
+	vkdemos::StagingRing myStagingRing;
+	boolResult = vkdemos::createStagingRing(myPhysicalDevice, myDevice, STAGING_RING_SIZE, myStagingRing, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	VkCommandBuffer myCmdBufferInitialization;
 	boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCmdBufferInitialization);
 	assert(boolResult);
 
-	VkPhysicalDeviceMemoryProperties myMemoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(myPhysicalDevice, &myMemoryProperties);
+	/*
+	 * Create the memory allocator.
+	 * All the images and buffers of this demo are sub-allocated from a few big
+	 * VkDeviceMemory blocks, instead of calling vkAllocateMemory for each of them.
+	 */
+	vkdemos::MemoryAllocator myMemoryAllocator;
+	boolResult = vkdemos::createMemoryAllocator(myPhysicalDevice, myDevice, myMemoryAllocator);
+	assert(boolResult);
+
+	/*
+	 * Host-visible allocations are persistently mapped by the allocator; after writing
+	 * to them we just record the written range in this batch, and flush all the
+	 * ranges together before submitting the commands that read them.
+	 */
+	vkdemos::MappedMemoryFlushBatch myFlushBatch;
+	vkdemos::createMappedMemoryFlushBatch(myMemoryAllocator, myFlushBatch);
 
 	// Create the Depth Buffer's Image and View.
 	const VkFormat myDepthBufferFormat = VK_FORMAT_D16_UNORM;
 
 	VkImage myDepthImage;
 	VkImageView myDepthImageView;
-	VkDeviceMemory myDepthMemory;
+	vkdemos::MemoryAllocation myDepthMemory;
 
 	boolResult = vkdemos::createAndAllocateImage(
 	                 myDevice,
-	                 myMemoryProperties,
-	                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+	                 myMemoryAllocator,
+	                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
 	                 0,
 	                 myDepthBufferFormat,
 	                 windowWidth,
@@ -218,13 +354,16 @@ int main(int argc, char* argv[])
 	                 myDepthImage,
 	                 myDepthMemory,
 	                 &myDepthImageView,
-	                 VK_IMAGE_ASPECT_DEPTH_BIT
+	                 VK_IMAGE_ASPECT_DEPTH_BIT,
+	                 VKDEMOS_ALLOCATION_SITE("depth buffer"),
+	                 vkdemos::utils::MEMORY_USAGE_GPU_ONLY,
+	                 myHostAllocationCallbacks
 	             );
 	assert(boolResult);
 
 	// Create the renderpass.
 	VkRenderPass myRenderPass;
-	boolResult = demo02CreateRenderPass(myDevice, mySurfaceFormat, myDepthBufferFormat, myRenderPass);
+	boolResult = demo02CreateRenderPass(myDevice, mySurfaceFormat, myDepthBufferFormat, myRenderPass, myHostAllocationCallbacks);
 	assert(boolResult);
 
 	// Create the Framebuffers, based on the number of swapchain images.
@@ -233,37 +372,86 @@ int main(int argc, char* argv[])
 
 	for(const auto view : mySwapchainImageViewsVector) {
 		VkFramebuffer fb;
-		boolResult = vkdemos::utils::createFramebuffer(myDevice, myRenderPass, {view, myDepthImageView}, windowWidth, windowHeight, fb);
+		boolResult = vkdemos::utils::createFramebuffer(myDevice, myRenderPass, {view, myDepthImageView}, windowWidth, windowHeight, fb, myHostAllocationCallbacks);
 		assert(boolResult);
 		myFramebuffersVector.push_back(fb);
 	}
 
-	// Create a buffer to use as the vertex buffer.
-	const size_t vertexBufferSize = sizeof(Demo05Vertex)*NUM_DEMO_VERTICES;
+	/*
+	 * Turn the cube's triangle list into indexed geometry: the identical vertices are merged,
+	 * and the triangles and vertices reordered for the post-transform cache and for fetch locality.
+	 */
+	std::vector<Demo05Vertex> myMeshVertices;
+	std::vector<uint32_t> myMeshIndices;
+	vkdemos::MeshStatistics myMeshStatistics;
+	vkdemos::optimizeMesh(vertices, NUM_DEMO_VERTICES, myMeshVertices, myMeshIndices, &myMeshStatistics);
+	vkdemos::printMeshStatistics(myMeshStatistics, "cube");
+
+	/*
+	 * Encode the vertices in the format the vertex buffer will have: positions as 16-bit
+	 * snorms relative to the cube's bounding box (the model matrix is multiplied by the
+	 * dequantization matrix to scale them back), and UVs, all in [0, 1], as 16-bit unorms.
+	 */
+	vkdemos::QuantizedVertexFormat myVertexFormat;
+	boolResult = vkdemos::createQuantizedVertexFormat({
+		{vkdemos::VERTEX_ATTRIBUTE_POSITION, 0, offsetof(Demo05Vertex, x), QUANTIZE_VERTICES ? vkdemos::VERTEX_ENCODING_SNORM16 : vkdemos::VERTEX_ENCODING_FLOAT},
+		{vkdemos::VERTEX_ATTRIBUTE_UV,       1, offsetof(Demo05Vertex, u), QUANTIZE_VERTICES ? vkdemos::VERTEX_ENCODING_UNORM16 : vkdemos::VERTEX_ENCODING_FLOAT},
+	}, myVertexFormat);
+	assert(boolResult);
+
+	std::vector<uint8_t> myEncodedVertices;
+	vkdemos::quantizeVertices(myMeshVertices.data(), myMeshVertices.size(), sizeof(Demo05Vertex), myVertexFormat, myEncodedVertices);
+
+	std::cout << "--- Cube vertex format: " << myVertexFormat.stride << " bytes per vertex (" << sizeof(Demo05Vertex) << " as floats)." << std::endl;
+
+	/*
+	 * Create the vertex and index buffers.
+	 * The cube never changes: as static geometry, it goes in device-local memory,
+	 * staged through the ring together with the texture.
+	 */
 	VkBuffer myVertexBuffer;
-	VkDeviceMemory myVertexBufferMemory;
+	vkdemos::MemoryAllocation myVertexBufferMemory;
 
-	boolResult = vkdemos::createAndAllocateBuffer(
+	boolResult = vkdemos::createGeometryBuffer(
 	                 myDevice,
-	                 myMemoryProperties,
+	                 myMemoryAllocator,
+	                 myStagingRing,
+	                 myUploadEngine,
+	                 myFlushBatch,
 	                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-	                 vertexBufferSize,
+	                 vkdemos::GEOMETRY_USAGE_STATIC,
+	                 myEncodedVertices.data(),
+	                 myEncodedVertices.size(),
 	                 myVertexBuffer,
-	                 myVertexBufferMemory
+	                 myVertexBufferMemory,
+	                 VKDEMOS_ALLOCATION_SITE("vertex buffer"),
+	                 myHostAllocationCallbacks
 	             );
 	assert(boolResult);
 
-	// Map vertex buffer and insert data
-	{
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myVertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
+	VkBuffer myIndexBuffer;
+	vkdemos::MemoryAllocation myIndexBufferMemory;
 
-		memcpy(mappedBuffer, vertices, vertexBufferSize);
+	boolResult = vkdemos::createGeometryBuffer(
+	                 myDevice,
+	                 myMemoryAllocator,
+	                 myStagingRing,
+	                 myUploadEngine,
+	                 myFlushBatch,
+	                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+	                 vkdemos::GEOMETRY_USAGE_STATIC,
+	                 myMeshIndices.data(),
+	                 sizeof(uint32_t)*myMeshIndices.size(),
+	                 myIndexBuffer,
+	                 myIndexBufferMemory,
+	                 VKDEMOS_ALLOCATION_SITE("index buffer"),
+	                 myHostAllocationCallbacks
+	             );
+	assert(boolResult);
 
-		vkUnmapMemory(myDevice, myVertexBufferMemory);
-	}
+	// On UMA devices the data was written in place, instead.
+	result = vkdemos::flushMappedMemoryBatch(myFlushBatch);
+	assert(result == VK_SUCCESS);
 
 
 
@@ -272,189 +460,202 @@ int main(int argc, char* argv[])
 	 * Create the texture.
 	 *
 	 */
-	VkBuffer myStagingBuffer;
-	VkDeviceMemory myStagingBufferMemory;
-	VkImage myTextureImage;
-	VkImageView myTextureImageView;
-	VkDeviceMemory myTextureImageMemory;
-
-	{
-		SDL_Surface* image = loadImageFromFile(TEXTURE_FILE_NAME);
-		assert(image != nullptr && image->pixels != nullptr);
-		assert(image->w == TEXTURE_WIDTH && image->h == TEXTURE_HEIGHT);
+	VkImage myTextureImage = VK_NULL_HANDLE;
+	VkImageView myTextureImageView = VK_NULL_HANDLE;
+	vkdemos::MemoryAllocation myTextureImageMemory;
 
-		/*
-		 * Allocate memory for staging buffer, map it, and fill it with our texture's data.
-		 */
-		boolResult = vkdemos::createAndAllocateBuffer(
-		                 myDevice,
-		                 myMemoryProperties,
-		                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Use this buffer as a source for transfers
-		                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,                                 // It must be host-visible since we'll map it and copy data to it.
-		                 TEXTURE_WIDTH*TEXTURE_HEIGHT*sizeof(PixelData),
-		                 myStagingBuffer,
-		                 myStagingBufferMemory
-		             );
-		assert(boolResult);
+	// Collect the texture files loaded in the background (usually done long ago).
+	vkdemos::waitJobGroup(myJobSystem, myAssetJobs);
 
-		// Map the buffer and fill it with data.
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
+	/*
+	 * If a block-compressed version of the texture exists (a KTX2 or DDS file), it's uploaded as-is,
+	 * with the mip levels it contains: it takes 4 to 8 times less memory than RGBA8.
+	 * If the device can't sample its format, it's decompressed to RGBA8 on the CPU; if there's
+	 * no CPU decoder for the format either (ASTC), the PNG is used instead.
+	 */
+	if(myUseCompressedTexture && !vkdemos::isTextureFormatSupported(myPhysicalDevice, myCompressedTexture.format)) {
+		std::cout << "~~~ WARNING: the device can't sample the format of \"" << COMPRESSED_TEXTURE_FILE_NAME << "\"; decompressing it on the CPU." << std::endl;
+		if(!vkdemos::decompressTexture(myCompressedTexture, myCompressedTexture)) {
+			std::cout << "~~~ WARNING: can't decompress \"" << COMPRESSED_TEXTURE_FILE_NAME << "\"; using \"" << TEXTURE_FILE_NAME << "\" instead." << std::endl;
+			myUseCompressedTexture = false;
+			myCompressedTexture = vkdemos::CompressedTexture();
+		}
+	}
 
-		memcpy(mappedBuffer, reinterpret_cast<unsigned char *>(image->pixels), TEXTURE_WIDTH*TEXTURE_HEIGHT*sizeof(PixelData));
+	assert(myUseCompressedTexture || myTextureFileLoaded);
 
-		VkMappedMemoryRange mappedMemoryRange = {
-			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-			.pNext = nullptr,
-			.memory = myStagingBufferMemory,
-			.offset = 0,
-			.size = VK_WHOLE_SIZE,
-		};
+	// Release the version of the texture that isn't used.
+	if(myUseCompressedTexture) {
+		vkdemos::closeImageFile(myImageFile);
+		vkdemos::closeCachedTexture(myCachedTexture);
+	}
 
-		vkFlushMappedMemoryRanges(myDevice, 1, &mappedMemoryRange);
-		vkUnmapMemory(myDevice, myStagingBufferMemory);
+	/*
+	 * Otherwise, the texture has a full mip chain. By default (or with --cpu-mipmaps), all the levels are computed
+	 * on the CPU and uploaded together; with --gpu-mipmaps they're generated on the GPU from the uploaded
+	 * level 0: with a cascade of blits if the format supports linear blits, or else with a compute shader.
+	 */
+	const VkFormat myTextureFormat = myUseCompressedTexture ? myCompressedTexture.format : VK_FORMAT_R8G8B8A8_UNORM;
+	const uint32_t myTextureWidth = myUseCompressedTexture ? myCompressedTexture.width : TEXTURE_WIDTH;
+	const uint32_t myTextureHeight = myUseCompressedTexture ? myCompressedTexture.height : TEXTURE_HEIGHT;
+
+	const vkdemos::MipmapGenerationMethod myMipmapMethod = (myGenerateMipmapsOnCpu || myUseCompressedTexture) ? vkdemos::MIPMAP_GENERATION_NONE : vkdemos::chooseMipmapGenerationMethod(myPhysicalDevice, myTextureFormat);
+	const bool myGpuMipmaps = (myMipmapMethod != vkdemos::MIPMAP_GENERATION_NONE);
+	const uint32_t myTextureMipLevels = myUseCompressedTexture ? (uint32_t)myCompressedTexture.levels.size()
+	                                  : (myGenerateMipmapsOnCpu || myGpuMipmaps) ? vkdemos::computeMipLevelCount(myTextureWidth, myTextureHeight) : 1;
+
+	vkdemos::MipmapComputeGenerator myMipmapGenerator;
+	if(myMipmapMethod == vkdemos::MIPMAP_GENERATION_COMPUTE) {
+		boolResult = vkdemos::createMipmapComputeGenerator(myDevice, MIPMAP_SHADER_FILE_NAME, myMipmapGenerator, myHostAllocationCallbacks);
+		assert(boolResult);
+	}
+	else if(!myUseCompressedTexture && !myGenerateMipmapsOnCpu && !myGpuMipmaps) {
+		std::cout << "~~~ WARNING: the texture format supports neither linear blits nor storage images; the texture will have no mipmaps." << std::endl;
+	}
 
+	VkCommandBuffer myMipmapCmdBuffer = VK_NULL_HANDLE;
 
+	const bool myStreamTexture = myUseCompressedTexture || myGenerateMipmapsOnCpu;
+	vkdemos::TextureStreamer myTextureStreamer;
+	vkdemos::StreamedTexture myStreamedTexture;
 
-		/*
-		 * Allocate memory for our texture's Image
-		 */
-		boolResult = vkdemos::createAndAllocateImage(
-		                 myDevice,
-		                 myMemoryProperties,
-		                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,   // The image will be used as a sampling source and a transfer destination
-		                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,    // The Image will reside in device-local memory.
-		                 VK_FORMAT_R8G8B8A8_UNORM,
-		                 TEXTURE_WIDTH,  // width
-		                 TEXTURE_HEIGHT,  // height
-		                 myTextureImage,
-		                 myTextureImageMemory,
-		                 &myTextureImageView,
-		                 VK_IMAGE_ASPECT_COLOR_BIT
-		             );
-		assert(boolResult);
+	{
+		if(myGenerateMipmapsOnCpu && !myUseCompressedTexture)
+			assert(myCachedTexture.width == TEXTURE_WIDTH && myCachedTexture.height == TEXTURE_HEIGHT);
+		else if(!myUseCompressedTexture)
+			assert(myImageFile.width == TEXTURE_WIDTH && myImageFile.height == TEXTURE_HEIGHT);
 
 
 		/*
-		 * Submit a copy command to the GPU to copy data from the staging buffer to the GPU's memory,
-		 * with the appropriate format conversion.
+		 * Textures whose whole mip chain is already in host memory (compressed, or from the
+		 * texture cache) are streamed: only their smallest levels are uploaded now, so the
+		 * first frame doesn't wait for the big ones, which are added in the background by
+		 * updateTextureStreaming, during the event loop.
 		 */
-		VkCommandBuffer textureCopyCmdBuffer;
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, textureCopyCmdBuffer);
-		assert(boolResult);
+		if(myStreamTexture)
+		{
+			vkdemos::createTextureStreamer(myDevice, myMemoryAllocator, myStagingRing, myUploadEngine, TEXTURE_STREAMING_BUDGET, FRAME_LAG, myTextureStreamer, myHostAllocationCallbacks);
 
-		// Begin command buffer recording.
-		VkCommandBufferBeginInfo commandBufferBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.pNext = nullptr,
-			.flags = (VkCommandBufferUsageFlags)0,
-			.pInheritanceInfo = nullptr,
-		};
+			if(myUseCompressedTexture)
+				boolResult = vkdemos::createStreamedTexture(myTextureStreamer, myTextureFormat, myCompressedTexture.levels, myCompressedTexture.data.data(), myStreamedTexture);
+			else
+				boolResult = vkdemos::createStreamedTexture(myTextureStreamer, myTextureFormat, myCachedTexture.levels, (const uint8_t*)myCachedTexture.file.data, myStreamedTexture);
+			assert(boolResult);
+		}
+		else
+		{
+			/*
+			 * Allocate memory for our texture's Image
+			 */
+			boolResult = vkdemos::createAndAllocateImage(
+			                 myDevice,
+			                 myMemoryAllocator,
+			                 vkdemos::getMipmapGenerationImageUsage(myMipmapMethod) | VK_IMAGE_USAGE_SAMPLED_BIT,   // The image will be used as a sampling source, plus what the mip generation needs
+			                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,    // The Image will reside in device-local memory.
+			                 myTextureFormat,
+			                 myTextureWidth,  // width
+			                 myTextureHeight,  // height
+			                 myTextureImage,
+			                 myTextureImageMemory,
+			                 &myTextureImageView,
+			                 VK_IMAGE_ASPECT_COLOR_BIT,
+			                 VKDEMOS_ALLOCATION_SITE("texture"),
+			                 vkdemos::utils::MEMORY_USAGE_GPU_ONLY,
+			                 myHostAllocationCallbacks,
+			                 myTextureMipLevels
+			             );
+			assert(boolResult);
+
+			/*
+			 * Write the texture's data in the staging ring, and record the copy to level 0 of the image.
+			 * The copy runs asynchronously on the transfer queue; all the levels are left in
+			 * TRANSFER_DST_OPTIMAL, ready for the mip generation on the graphics queue.
+			 */
+			vkdemos::StagingAllocation myTextureStaging;
+			boolResult = vkdemos::allocateStagingMemory(myStagingRing, myUploadEngine, TEXTURE_WIDTH*TEXTURE_HEIGHT*sizeof(PixelData), myStagingRing.imageCopyAlignment, myTextureStaging);
+			assert(boolResult);
+
+			// Convert the decoded pixels straight into the staging memory: no intermediate copy.
+			boolResult = vkdemos::readImagePixels(myImageFile, myTextureStaging.pointer, TEXTURE_WIDTH * sizeof(PixelData), myTextureFormat);
+			assert(boolResult);
+
+			const VkBufferImageCopy textureCopyRegion = {
+				.bufferOffset = 0,
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+				.imageOffset = {0, 0, 0},
+				.imageExtent = {TEXTURE_WIDTH, TEXTURE_HEIGHT, 1},
+			};
 
-		result = vkBeginCommandBuffer(textureCopyCmdBuffer, &commandBufferBeginInfo);
-		assert(result == VK_SUCCESS);
+			vkdemos::stageImageCopy(
+				myStagingRing,
+				myUploadEngine,
+				myTextureStaging,
+				myTextureImage,
+				{textureCopyRegion},
+				{VK_IMAGE_ASPECT_COLOR_BIT, 0, myTextureMipLevels, 0, 1},
+				myGpuMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				myGpuMipmaps ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				myGpuMipmaps ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT
+			);
+		}
+
+		// Submit all the staged uploads (here, the vertex and index buffers and the texture) at once.
+		vkdemos::flushStagingRing(myStagingRing, myUploadEngine);
 
 
 		/*
-		 * Transition the Image to an optimal layout for use as a copy command's destination;
-		 * also set a memory barrier on the buffer such that the transfer of data is guaranteed
-		 * to be completed before using it as a source for the copy.
-		 * We can do both operations with a single Pipeline Barrier.
+		 * Generate the mip chain.
+		 * Blits need a queue with graphics capabilities, which the transfer queue doesn't have;
+		 * so we submit the acquire of the uploaded texture to the graphics queue now, and
+		 * right after it, on the same queue, the command buffer generating the levels.
+		 * The generation's barriers wait for the acquire because it was submitted before.
 		 */
+		if(myGpuMipmaps)
 		{
-			VkImageMemoryBarrier imageMemoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			vkdemos::submitPendingUploadAcquires(myUploadEngine);
+
+			boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myMipmapCmdBuffer);
+			assert(boolResult);
+
+			const VkCommandBufferBeginInfo mipmapBeginInfo = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 				.pNext = nullptr,
-				.srcAccessMask = 0,
-				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.subresourceRange =  {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
-				.image = myTextureImage,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+				.pInheritanceInfo = nullptr,
 			};
 
-			VkBufferMemoryBarrier bufferMemoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			result = vkBeginCommandBuffer(myMipmapCmdBuffer, &mipmapBeginInfo);
+			assert(result == VK_SUCCESS);
+
+			if(myMipmapMethod == vkdemos::MIPMAP_GENERATION_BLIT)
+				vkdemos::recordMipmapBlitCascade(myMipmapCmdBuffer, myTextureImage, myTextureWidth, myTextureHeight, myTextureMipLevels,
+				                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			else
+				vkdemos::recordMipmapComputeGeneration(myMipmapGenerator, myMipmapCmdBuffer, myTextureImage, myTextureFormat, myTextureWidth, myTextureHeight, myTextureMipLevels,
+				                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+			result = vkEndCommandBuffer(myMipmapCmdBuffer);
+			assert(result == VK_SUCCESS);
+
+			const VkSubmitInfo mipmapSubmitInfo = {
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 				.pNext = nullptr,
-				.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT,
-				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.buffer = myStagingBuffer,
-				.offset = 0,
-				.size = VK_WHOLE_SIZE,
+				.waitSemaphoreCount = 0,
+				.pWaitSemaphores = nullptr,
+				.pWaitDstStageMask = nullptr,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &myMipmapCmdBuffer,
+				.signalSemaphoreCount = 0,
+				.pSignalSemaphores = nullptr,
 			};
 
-			vkCmdPipelineBarrier(textureCopyCmdBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // dstStageMask
-				0,                                 // dependencyFlags
-				0,                                 // memoryBarrierCount
-				nullptr,                           // pMemoryBarriers
-				1,                                 // bufferMemoryBarrierCount
-				&bufferMemoryBarrier,              // pBufferMemoryBarriers
-				1,                                 // imageMemoryBarrierCount
-				&imageMemoryBarrier                // pImageMemoryBarriers
-			);
+			// No fence: the frames are submitted after it on the same queue, and the
+			// command buffer is freed after the vkQueueWaitIdle at deinitialization.
+			result = vkQueueSubmit(myQueue, 1, &mipmapSubmitInfo, VK_NULL_HANDLE);
+			assert(result == VK_SUCCESS);
 		}
-
-
-		// Copy mip levels from staging buffer
-		VkBufferImageCopy bufferImageCopy = {
-			.bufferOffset = 0,
-			.bufferRowLength = 0,
-			.bufferImageHeight = 0,
-			.imageSubresource = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
-		    },
-		    .imageOffset = {0, 0, 0},
-		    .imageExtent = {.width = TEXTURE_WIDTH, .height = TEXTURE_HEIGHT, .depth = 1},
-		};
-
-		vkCmdCopyBufferToImage(
-			textureCopyCmdBuffer,
-			myStagingBuffer,
-			myTextureImage,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferImageCopy
-		);
-
-		// Transition the Image to an optimal layout for use as a shader's read-only sampling source.
-		vkdemos::submitImageBarrier(
-			textureCopyCmdBuffer,
-			myTextureImage,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		    {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
-		);
-
-		// End command buffer recording.
-		result = vkEndCommandBuffer(textureCopyCmdBuffer);
-
-		// Submit the command buffer to the queue
-		VkSubmitInfo submitInfo = {
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.pNext = nullptr,
-			.waitSemaphoreCount = 0,
-			.pWaitSemaphores = nullptr,
-			.pWaitDstStageMask = nullptr,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &textureCopyCmdBuffer,
-			.signalSemaphoreCount = 0,
-			.pSignalSemaphores = nullptr
-		};
-
-		result = vkQueueSubmit(myQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		assert(result == VK_SUCCESS);
 	}
 
 
@@ -478,7 +679,7 @@ int main(int argc, char* argv[])
 		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
 		.mipLodBias = 0.0f,
 		.minLod = 0.0f,
-		.maxLod = 0.0f,
+		.maxLod = (float)myTextureMipLevels,   // Allow sampling from all the levels of the texture.
 		.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
 		.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
 		.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
@@ -490,10 +691,23 @@ int main(int argc, char* argv[])
 		.unnormalizedCoordinates = VK_FALSE,
 	};
 
-	result = vkCreateSampler(myDevice, &samplerCreateInfo, nullptr, &mySampler);
+	result = vkCreateSampler(myDevice, &samplerCreateInfo, myHostAllocationCallbacks, &mySampler);
 	assert(result == VK_SUCCESS);
 
 
+	/*
+	 * Create the ring buffer for per-frame data.
+	 *
+	 * Every frame, the per-object data is written in the next free range of this buffer,
+	 * and the shader reads it through a dynamic uniform buffer descriptor, whose offset
+	 * is specified when the descriptor set is bound.
+	 * This way we are not limited by the (small) size of push constants.
+	 */
+	vkdemos::FrameRingBuffer myRingBuffer;
+	boolResult = vkdemos::createFrameRingBuffer(myPhysicalDevice, myDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, RING_BUFFER_SIZE, FRAME_LAG, myRingBuffer, myHostAllocationCallbacks);
+	assert(boolResult);
+
+
 	/*
 	 * Create the descriptor set layout.
 	 *
@@ -501,91 +715,142 @@ int main(int argc, char* argv[])
 	 * at draw time, you can set the samplers now and you won't need to set them
 	 * at draw time. Refer to section 13.2.1 of Vulkan's specification for more informations.
 	 */
-	VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {
-		.binding = 0,
-		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-		.descriptorCount = 1,
-		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-		.pImmutableSamplers = nullptr,
+	VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,   // The fragment shader reads the texture's LOD clamp.
+			.pImmutableSamplers = nullptr,
+		},
 	};
 
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0,
-		.bindingCount = 1,
-		.pBindings = &descriptorSetLayoutBinding,
+		.bindingCount = 2,
+		.pBindings = descriptorSetLayoutBindings,
 	};
 
 	VkDescriptorSetLayout myDescriptorSetLayout;
-	result = vkCreateDescriptorSetLayout(myDevice, &descriptorSetLayoutCreateInfo, nullptr, &myDescriptorSetLayout);
+	result = vkCreateDescriptorSetLayout(myDevice, &descriptorSetLayoutCreateInfo, myHostAllocationCallbacks, &myDescriptorSetLayout);
 	assert(result == VK_SUCCESS);
 
 
 
 	/*
 	 * Create descriptor pool.
+	 * One descriptor set per frame in flight: the streamed texture's view changes while
+	 * the demo runs, and a descriptor set can't be updated while a frame is using it.
 	 */
-	VkDescriptorPoolSize descriptorPoolSize = {
-	    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-	    .descriptorCount = 1,
+	VkDescriptorPoolSize descriptorPoolSizes[2] = {
+		{
+		    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		    .descriptorCount = FRAME_LAG,
+		},
+		{
+		    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		    .descriptorCount = FRAME_LAG,
+		},
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
 	    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 	    .pNext = nullptr,
 	    .flags = 0,
-	    .maxSets = 1,
-	    .poolSizeCount = 1,
-	    .pPoolSizes = &descriptorPoolSize,
+	    .maxSets = FRAME_LAG,
+	    .poolSizeCount = 2,
+	    .pPoolSizes = descriptorPoolSizes,
 	};
 
 	VkDescriptorPool myDescriptorPool;
-	result = vkCreateDescriptorPool(myDevice, &descriptorPoolCreateInfo, nullptr, &myDescriptorPool);
+	result = vkCreateDescriptorPool(myDevice, &descriptorPoolCreateInfo, myHostAllocationCallbacks, &myDescriptorPool);
 	assert(result == VK_SUCCESS);
 
 
 
 
 	/*
-	 * Create descriptor set.
+	 * Create the descriptor sets.
 	 */
+	VkDescriptorSetLayout descriptorSetLayouts[FRAME_LAG];
+	std::fill_n(descriptorSetLayouts, FRAME_LAG, myDescriptorSetLayout);
+
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
 	    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 	    .pNext = nullptr,
 	    .descriptorPool = myDescriptorPool,
-	    .descriptorSetCount = 1,
-	    .pSetLayouts = &myDescriptorSetLayout,
+	    .descriptorSetCount = FRAME_LAG,
+	    .pSetLayouts = descriptorSetLayouts,
 	};
 
-	VkDescriptorSet myDescriptorSet;
-	result = vkAllocateDescriptorSets(myDevice, &descriptorSetAllocateInfo, &myDescriptorSet);
+	VkDescriptorSet myDescriptorSets[FRAME_LAG];
+	result = vkAllocateDescriptorSets(myDevice, &descriptorSetAllocateInfo, myDescriptorSets);
 	assert(result == VK_SUCCESS);
 
+	// Version of the streamed texture each descriptor set points to.
+	uint32_t myDescriptorSetTextureVersions[FRAME_LAG];
+
 
 	/*
-	 * Update the descriptor set.
+	 * Update the descriptor sets.
 	 */
 	VkDescriptorImageInfo descriptorImageInfo = {
 	    .sampler = mySampler,
-	    .imageView = myTextureImageView,
+	    .imageView = myStreamTexture ? myStreamedTexture.view : myTextureImageView,
 	    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 	};
 
-	VkWriteDescriptorSet writeDescriptorSet = {
-	    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-	    .pNext = nullptr,
-	    .dstSet = myDescriptorSet,
-	    .dstBinding = 0,
-	    .dstArrayElement = 0,
-	    .descriptorCount = 1,
-	    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-	    .pImageInfo = &descriptorImageInfo,
-	    .pBufferInfo = nullptr,
-	    .pTexelBufferView = nullptr,
+	// The dynamic uniform buffer covers a single ObjectUniformData; the offset is given at bind time.
+	VkDescriptorBufferInfo descriptorBufferInfo = {
+	    .buffer = myRingBuffer.buffer,
+	    .offset = 0,
+	    .range = sizeof(ObjectUniformData),
 	};
 
-	vkUpdateDescriptorSets(myDevice, 1, &writeDescriptorSet, 0, nullptr);
+	VkWriteDescriptorSet writeDescriptorSets[2] = {
+		{
+		    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		    .pNext = nullptr,
+		    .dstSet = VK_NULL_HANDLE,   // set below, for each frame.
+		    .dstBinding = 0,
+		    .dstArrayElement = 0,
+		    .descriptorCount = 1,
+		    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		    .pImageInfo = &descriptorImageInfo,
+		    .pBufferInfo = nullptr,
+		    .pTexelBufferView = nullptr,
+		},
+		{
+		    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		    .pNext = nullptr,
+		    .dstSet = VK_NULL_HANDLE,
+		    .dstBinding = 1,
+		    .dstArrayElement = 0,
+		    .descriptorCount = 1,
+		    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		    .pImageInfo = nullptr,
+		    .pBufferInfo = &descriptorBufferInfo,
+		    .pTexelBufferView = nullptr,
+		},
+	};
+
+	for(int i = 0; i < FRAME_LAG; i++)
+	{
+		writeDescriptorSets[0].dstSet = myDescriptorSets[i];
+		writeDescriptorSets[1].dstSet = myDescriptorSets[i];
+		vkUpdateDescriptorSets(myDevice, 2, writeDescriptorSets, 0, nullptr);
+
+		myDescriptorSetTextureVersions[i] = myStreamedTexture.version;
+	}
 
 
 
@@ -614,11 +879,11 @@ int main(int argc, char* argv[])
 	};
 
 	VkPipelineLayout myPipelineLayout;
-	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, nullptr, &myPipelineLayout);
+	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, myHostAllocationCallbacks, &myPipelineLayout);
 	assert(result == VK_SUCCESS);
 
 	VkPipeline myGraphicsPipeline;
-	boolResult = demo05CreatePipeline(myDevice, myRenderPass, myPipelineLayout, VERTEX_SHADER_FILENAME, FRAGMENT_SHADER_FILENAME, VERTEX_INPUT_BINDING, myGraphicsPipeline);
+	boolResult = demo05CreatePipeline(myDevice, myRenderPass, myPipelineLayout, VERTEX_SHADER_FILENAME, FRAGMENT_SHADER_FILENAME, VERTEX_INPUT_BINDING, myVertexFormat, myGraphicsPipeline, myHostAllocationCallbacks);
 	assert(boolResult);
 
 
@@ -651,24 +916,24 @@ int main(int argc, char* argv[])
 
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, perFrameDataVector[i].presentCmdBuffer);
+		boolResult = vkdemos::createFrameCommandPool(myDevice, myQueueFamilyIndex, perFrameDataVector[i].commandPool, myHostAllocationCallbacks);
 		assert(boolResult);
 
-		result = vkdemos::utils::createFence(myDevice, perFrameDataVector[i].presentFence);
+		result = vkdemos::utils::createFence(myDevice, perFrameDataVector[i].presentFence, myHostAllocationCallbacks);
 		assert(result == VK_SUCCESS);
 
-		result = vkdemos::utils::createSemaphore(myDevice, perFrameDataVector[i].imageAcquiredSemaphore);
+		result = vkdemos::utils::createSemaphore(myDevice, perFrameDataVector[i].imageAcquiredSemaphore, myHostAllocationCallbacks);
 		assert(result == VK_SUCCESS);
 
-		result = vkdemos::utils::createSemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore);
+		result = vkdemos::utils::createSemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore, myHostAllocationCallbacks);
 		assert(result == VK_SUCCESS);
 
 		perFrameDataVector[i].fenceInitialized = false;
 	}
 
-	// Wait for the queue to complete its work.
-	result = vkQueueWaitIdle(myQueue);
-	assert(result == VK_SUCCESS);
+	vkdemos::printMemoryAllocatorStatistics(myMemoryAllocator);
+	vkdemos::printMemoryTrackerStatistics();
+	vkdemos::printJobSystemStatistics(myJobSystem);
 
 	/*
 	 * Event loop
@@ -726,6 +991,44 @@ int main(int argc, char* argv[])
 		// Rendering code
 		if(!quit)
 		{
+			PerFrameData & currentFrameData = perFrameDataVector[frameNumber % FRAME_LAG];
+
+			// Start counting the host allocations of this frame.
+			vkdemos::beginHostAllocatorFrame(myHostAllocator);
+
+			// Reclaim the ring buffer space used by the last frame that used this slot.
+			vkdemos::beginRingBufferFrame(myRingBuffer, frameNumber % FRAME_LAG, currentFrameData.presentFence, currentFrameData.fenceInitialized);
+
+			/*
+			 * Stream the texture's next level, and swap in the levels uploaded in the previous frames.
+			 * The last frame that used this slot's descriptor set is complete (beginRingBufferFrame
+			 * waited for its fence), so it can point to the new view.
+			 */
+			VkDescriptorSet currentDescriptorSet = myDescriptorSets[frameNumber % FRAME_LAG];
+
+			if(myStreamTexture)
+			{
+				vkdemos::markStreamedTextureUsed(myTextureStreamer, myStreamedTexture);
+				vkdemos::updateTextureStreaming(myTextureStreamer);
+
+				uint32_t & descriptorSetVersion = myDescriptorSetTextureVersions[frameNumber % FRAME_LAG];
+				if(descriptorSetVersion != myStreamedTexture.version)
+				{
+					const VkDescriptorImageInfo streamedImageInfo = {
+					    .sampler = mySampler,
+					    .imageView = myStreamedTexture.view,
+					    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					};
+
+					VkWriteDescriptorSet writeTextureDescriptor = writeDescriptorSets[0];
+					writeTextureDescriptor.dstSet = currentDescriptorSet;
+					writeTextureDescriptor.pImageInfo = &streamedImageInfo;
+					vkUpdateDescriptorSets(myDevice, 1, &writeTextureDescriptor, 0, nullptr);
+
+					descriptorSetVersion = myStreamedTexture.version;
+				}
+			}
+
 			float animatedRotation = glm::mod(pushConstData.animationTime / 60.0f, 360.0f);
 
 			// Calculate projection*model matrix.
@@ -736,11 +1039,26 @@ int main(int argc, char* argv[])
 			modelMatrix = glm::rotate(modelMatrix, glm::radians(cubeRotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
 			modelMatrix = glm::rotate(modelMatrix, glm::radians(cubeRotation.y+animatedRotation), glm::vec3(0.0f, 1.0f, 0.0f));
 
-			pushConstData.projMatrix = projMatrix * modelMatrix;
+			// Write the object data in the ring buffer.
+			VkDeviceSize objectDataOffset;
+			void * objectDataPointer;
+			boolResult = vkdemos::allocateFromRingBuffer(myRingBuffer, sizeof(ObjectUniformData), myRingBuffer.uniformBufferAlignment, objectDataOffset, objectDataPointer);
+			assert(boolResult);
+
+			ObjectUniformData * objectData = reinterpret_cast<ObjectUniformData *>(objectDataPointer);
+			objectData->mvpMatrix = projMatrix * modelMatrix * vkdemos::getPositionDequantizationMatrix(myVertexFormat);
+			objectData->textureMinLod = myStreamTexture ? myStreamedTexture.minLod : 0.0f;
+
+			// Flush all the host writes to non-coherent memory done in this frame, with a single call.
+			result = vkdemos::flushMappedMemoryBatch(myFlushBatch);
+			assert(result == VK_SUCCESS);
+
+			// Make the graphics queue wait for the uploads completed on the transfer queue, if any.
+			vkdemos::submitPendingUploadAcquires(myUploadEngine);
 
 			// Render a single frame
 			auto renderStartTime = std::chrono::high_resolution_clock::now();
-			quit = !demo05RenderSingleFrame(myDevice, myQueue, mySwapchain, myFramebuffersVector, myRenderPass, myGraphicsPipeline, myPipelineLayout, myVertexBuffer, VERTEX_INPUT_BINDING, NUM_DEMO_VERTICES, myDescriptorSet, perFrameDataVector[frameNumber % FRAME_LAG], windowWidth, windowHeight, pushConstData);
+			quit = !demo05RenderSingleFrame(myDevice, myQueue, mySwapchain, myFramebuffersVector, myRenderPass, myGraphicsPipeline, myPipelineLayout, myVertexBuffer, VERTEX_INPUT_BINDING, myIndexBuffer, (uint32_t)myMeshIndices.size(), currentDescriptorSet, (uint32_t)objectDataOffset, currentFrameData, windowWidth, windowHeight, pushConstData);
 			auto renderStopTime = std::chrono::high_resolution_clock::now();
 
 			// Compute frame time statistics
@@ -764,6 +1082,8 @@ int main(int argc, char* argv[])
 				          << " (" << std::fixed << std::setprecision(2) << (stddev/average * 100.0f) << "%)"
 				          << std::endl;
 
+				vkdemos::printHostAllocatorStatistics(myHostAllocator);
+
 				frameMaxTime = LONG_MIN;
 				frameMinTime = LONG_MAX;
 				frameAvgTimeSum = 0;
@@ -785,52 +1105,89 @@ int main(int argc, char* argv[])
 	result = vkQueueWaitIdle(myQueue);
 	assert(result == VK_SUCCESS);
 
+	// Destroy the streamed texture first: it may have an upload in flight.
+	if(myStreamTexture) {
+		vkdemos::printTextureStreamerStatistics(myTextureStreamer);
+		vkdemos::destroyStreamedTexture(myTextureStreamer, myStreamedTexture);
+		vkdemos::destroyTextureStreamer(myTextureStreamer);
+		vkdemos::closeCachedTexture(myCachedTexture);   // The streamer read the levels from it.
+	}
+
+	// Also waits for the uploads still in flight on the transfer queue.
+	vkdemos::printStagingRingStatistics(myStagingRing);
+	vkdemos::destroyStagingRing(myStagingRing, myUploadEngine);
+	vkdemos::destroyUploadEngine(myUploadEngine);
+
 	// Destroy the objects in the perFrameDataVector array.
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
-		vkDestroyFence(myDevice, perFrameDataVector[i].presentFence, nullptr);
-		vkDestroySemaphore(myDevice, perFrameDataVector[i].imageAcquiredSemaphore, nullptr);
-		vkDestroySemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore, nullptr);
+		vkdemos::printFrameCommandPoolStatistics(perFrameDataVector[i].commandPool, "Frame " + std::to_string(i) + " command pool");
+		vkdemos::destroyFrameCommandPool(perFrameDataVector[i].commandPool, myHostAllocationCallbacks);
+		vkDestroyFence(myDevice, perFrameDataVector[i].presentFence, myHostAllocationCallbacks);
+		vkDestroySemaphore(myDevice, perFrameDataVector[i].imageAcquiredSemaphore, myHostAllocationCallbacks);
+		vkDestroySemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore, myHostAllocationCallbacks);
 	}
 
 	// Destroy sampler and descriptor pool/set layout
-	vkDestroyDescriptorPool(myDevice, myDescriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(myDevice, myDescriptorSetLayout, nullptr);
-	vkDestroySampler(myDevice, mySampler, nullptr);
+	vkDestroyDescriptorPool(myDevice, myDescriptorPool, myHostAllocationCallbacks);
+	vkDestroyDescriptorSetLayout(myDevice, myDescriptorSetLayout, myHostAllocationCallbacks);
+	vkDestroySampler(myDevice, mySampler, myHostAllocationCallbacks);
 
-	// Free the staging buffer and the texture image.
-	vkFreeMemory(myDevice, myStagingBufferMemory, nullptr);
-	vkDestroyBuffer(myDevice, myStagingBuffer, nullptr);
+	vkdemos::destroyFrameRingBuffer(myRingBuffer);
 
-	vkDestroyImageView(myDevice, myTextureImageView, nullptr);
-	vkDestroyImage(myDevice, myTextureImage, nullptr);
-	vkFreeMemory(myDevice, myTextureImageMemory, nullptr);
+	// Free the texture image, and the objects used to generate its mip chain.
+	if(myMipmapCmdBuffer != VK_NULL_HANDLE)
+		vkFreeCommandBuffers(myDevice, myCommandPool, 1, &myMipmapCmdBuffer);
+
+	if(myMipmapMethod == vkdemos::MIPMAP_GENERATION_COMPUTE)
+		vkdemos::destroyMipmapComputeGenerator(myMipmapGenerator);
+
+	if(!myStreamTexture) {
+		vkDestroyImageView(myDevice, myTextureImageView, myHostAllocationCallbacks);
+		vkDestroyImage(myDevice, myTextureImage, myHostAllocationCallbacks);
+		vkdemos::freeMemoryToAllocator(myMemoryAllocator, myTextureImageMemory);
+	}
 
 	// For more informations on the following commands, refer to Demo 02.
-	vkDestroyPipeline(myDevice, myGraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
-	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
-	vkFreeMemory(myDevice, myVertexBufferMemory, nullptr);
+	vkDestroyPipeline(myDevice, myGraphicsPipeline, myHostAllocationCallbacks);
+	vkDestroyPipelineLayout(myDevice, myPipelineLayout, myHostAllocationCallbacks);
+	vkDestroyBuffer(myDevice, myIndexBuffer, myHostAllocationCallbacks);
+	vkdemos::freeMemoryToAllocator(myMemoryAllocator, myIndexBufferMemory);
+	vkDestroyBuffer(myDevice, myVertexBuffer, myHostAllocationCallbacks);
+	vkdemos::freeMemoryToAllocator(myMemoryAllocator, myVertexBufferMemory);
 
 	for(auto framebuffer : myFramebuffersVector)
-		vkDestroyFramebuffer(myDevice, framebuffer, nullptr);
+		vkDestroyFramebuffer(myDevice, framebuffer, myHostAllocationCallbacks);
+
+	vkDestroyRenderPass(myDevice, myRenderPass, myHostAllocationCallbacks);
+	vkDestroyImageView(myDevice, myDepthImageView, myHostAllocationCallbacks);
+	vkDestroyImage(myDevice, myDepthImage, myHostAllocationCallbacks);
+	vkdemos::freeMemoryToAllocator(myMemoryAllocator, myDepthMemory);
 
-	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
-	vkDestroyImageView(myDevice, myDepthImageView, nullptr);
-	vkDestroyImage(myDevice, myDepthImage, nullptr);
-	vkFreeMemory(myDevice, myDepthMemory, nullptr);
+	// All the resources have been destroyed, we can release the memory blocks.
+	vkdemos::destroyMemoryAllocator(myMemoryAllocator);
 
 	// For more informations on the following commands, refer to Demo 01.
-	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+	vkDestroyCommandPool(myDevice, myCommandPool, myHostAllocationCallbacks);
 
 	for(auto imgView : mySwapchainImageViewsVector)
-		vkDestroyImageView(myDevice, imgView, nullptr);
+		vkDestroyImageView(myDevice, imgView, myHostAllocationCallbacks);
+
+	vkDestroySwapchainKHR(myDevice, mySwapchain, myHostAllocationCallbacks);
+
+	// All the device memory should have been freed by now.
+	vkdemos::printMemoryLeakReport();
+
+	vkDestroyDevice(myDevice, myHostAllocationCallbacks);
+	vkDestroySurfaceKHR(myInstance, mySurface, myHostAllocationCallbacks);
+	vkdemos::destroyDebugReportCallback(myInstance, myDebugReportCallback, myHostAllocationCallbacks);
+	vkDestroyInstance(myInstance, myHostAllocationCallbacks);
+
+	vkdemos::destroyJobSystem(myJobSystem);
 
-	vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
-	vkDestroyDevice(myDevice, nullptr);
-	vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
-	vkdemos::destroyDebugReportCallback(myInstance, myDebugReportCallback);
-	vkDestroyInstance(myInstance, nullptr);
+	// Every Vulkan object has been destroyed: the host allocator can go too.
+	vkdemos::printHostAllocatorStatistics(myHostAllocator);
+	vkdemos::destroyHostAllocator(myHostAllocator);
 
 	SDL_DestroyWindow(mySdlWindow);
 	SDL_Quit();
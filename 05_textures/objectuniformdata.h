@@ -0,0 +1,16 @@
+#ifndef OBJECTUNIFORMDATA_H
+#define OBJECTUNIFORMDATA_H
+
+#include "../00_commons/glm/glm/mat4x4.hpp"
+
+/*
+ * Per-object data, written every frame in the ring buffer and
+ * read by the shaders from a dynamic uniform buffer.
+ */
+struct ObjectUniformData
+{
+	glm::mat4 mvpMatrix;
+	float textureMinLod;    // LOD clamp of the streamed texture, to fade its new levels in.
+};
+
+#endif // OBJECTUNIFORMDATA_H
@@ -1,14 +1,13 @@
 #ifndef PUSHCONSTDATA_H
 #define PUSHCONSTDATA_H
 
-#include "../00_commons/glm/glm/mat4x4.hpp"
-
 /*
- * Data for push constants
+ * Data for push constants.
+ * The transformation matrix is not here anymore: it's per-object data,
+ * and lives in the ring buffer (see objectuniformdata.h).
  */
 struct PushConstData
 {
-	glm::mat4 projMatrix;
 	float animationTime = 0;
 };
 
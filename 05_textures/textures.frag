@@ -5,13 +5,19 @@
 // Push Constants block
 layout(push_constant) uniform PushConstants
 {
-	mat4 projMatrix;
 	float animationTime;
 } pushConstants;
 
 // Combined Image Sampler Binding
 layout(set = 0, binding = 0) uniform sampler2D textureSampler;	// this sampler is attached to binding point 0 inside descriptor set 0
 
+// Per-object data, bound as a dynamic uniform buffer pointing inside the ring buffer.
+layout(set = 0, binding = 1) uniform ObjectData
+{
+	mat4 mvpMatrix;
+	float textureMinLod;	// Clamp of the level of detail, while a new level of the streamed texture fades in.
+} objectData;
+
 // Inputs
 layout(location = 0) in vec2 inUV;
 
@@ -21,5 +27,14 @@ layout(location = 0) out vec4 outFragmentColor;
 
 void main()
 {
-	outFragmentColor = texture(textureSampler, inUV);
+	if(objectData.textureMinLod > 0.0)
+	{
+		// textureQueryLod().y is the level of detail the hardware would use, before any clamping.
+		float lod = max(textureQueryLod(textureSampler, inUV).y, objectData.textureMinLod);
+		outFragmentColor = textureLod(textureSampler, inUV, lod);
+	}
+	else
+	{
+		outFragmentColor = texture(textureSampler, inUV);
+	}
 }
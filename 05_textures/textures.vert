@@ -5,10 +5,16 @@
 // Push Constants block
 layout(push_constant) uniform PushConstants
 {
-	mat4 projMatrix;
 	float animationTime;
 } pushConstants;
 
+// Per-object data, bound as a dynamic uniform buffer pointing inside the ring buffer.
+layout(set = 0, binding = 1) uniform ObjectData
+{
+	mat4 mvpMatrix;
+	float textureMinLod;
+} objectData;
+
 // Inputs
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 inUV;
@@ -21,5 +27,5 @@ void main()
 {
 	outUV = inUV;
 
-	gl_Position = (pushConstants.projMatrix * vec4(position, 1.0));
+	gl_Position = (objectData.mvpMatrix * vec4(position, 1.0));
 }
@@ -9,7 +9,9 @@
 #include <cstring>
 
 /**
- * Demo 06: Creates a VkDevice, a graphics VkQueue and a compute VkQueue.
+ * Demo 06: Creates a VkDevice, a graphics VkQueue, a compute VkQueue and a transfer VkQueue.
+ * The transfer queue is taken from a transfer-only family if there's one, otherwise
+ * it's the compute queue.
  *
  * For more details, see 00_commons/05_createVkDeviceAndVkQueue.h
  */
@@ -20,7 +22,9 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
                                      VkQueue & outGraphicsQueue,
                                      uint32_t & outGraphicsQueueFamilyIndex,
                                      VkQueue & outComputeQueue,
-                                     uint32_t & outComputeQueueFamilyIndex
+                                     uint32_t & outComputeQueueFamilyIndex,
+                                     VkQueue & outTransferQueue,
+                                     uint32_t & outTransferQueueFamilyIndex
                                      )
 {
 	VkResult result;
@@ -67,6 +71,7 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 	int queueFamilyIndex = 0;
 	int indexOfGraphicsQueueFamily = -1;
 	int indexOfComputeQueueFamily = -1;
+	int indexOfTransferQueueFamily = -1;
 	for(const auto & queueFamProp : queueFamilyPropertiesVector)
 	{
 		// Check if the queue family supports presentation
@@ -107,6 +112,11 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 				indexOfComputeQueueFamily = queueFamilyIndex;
 		}
 
+		if(bool(queueFamProp.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamProp.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			if(indexOfTransferQueueFamily < 0)
+				indexOfTransferQueueFamily = queueFamilyIndex;
+		}
+
 		queueFamilyIndex++;
 	}
 
@@ -131,14 +141,21 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 	qciToFill.pNext = nullptr;
 	qciToFill.flags = 0;
 
-	float queuePriority = 1.0f;
+	const float queuePriorities[2] = {1.0f, 1.0f};
 	qciToFill.queueFamilyIndex = (uint32_t)indexOfGraphicsQueueFamily;
 	qciToFill.queueCount = (indexOfGraphicsQueueFamily != indexOfComputeQueueFamily) ? 1 : 2;
-	qciToFill.pQueuePriorities = &queuePriority;
+	qciToFill.pQueuePriorities = queuePriorities;
 	deviceQueueCreateInfoVector.push_back(qciToFill);
 
 	if(indexOfGraphicsQueueFamily != indexOfComputeQueueFamily) {
 		qciToFill.queueFamilyIndex = (uint32_t)indexOfComputeQueueFamily;
+		qciToFill.queueCount = 1;
+		deviceQueueCreateInfoVector.push_back(qciToFill);
+	}
+
+	if(indexOfTransferQueueFamily >= 0) {
+		qciToFill.queueFamilyIndex = (uint32_t)indexOfTransferQueueFamily;
+		qciToFill.queueCount = 1;
 		deviceQueueCreateInfoVector.push_back(qciToFill);
 	}
 
@@ -175,7 +192,7 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 	/*
 	 * Get queues
 	 */
-	VkQueue myGraphicsQueue, myComputeQueue;
+	VkQueue myGraphicsQueue, myComputeQueue, myTransferQueue;
 
 	vkGetDeviceQueue(myDevice,
 		(uint32_t)indexOfGraphicsQueueFamily,
@@ -189,6 +206,14 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 		&myComputeQueue
 	);
 
+	if(indexOfTransferQueueFamily >= 0) {
+		vkGetDeviceQueue(myDevice, (uint32_t)indexOfTransferQueueFamily, 0, &myTransferQueue);
+	}
+	else {
+		myTransferQueue = myComputeQueue;
+		indexOfTransferQueueFamily = indexOfComputeQueueFamily;
+	}
+
 	std::cout << "\n+++ VkDevice and VkQueues created succesfully!\n" << std::endl;
 
 	outDevice = myDevice;
@@ -196,6 +221,8 @@ bool demo06createVkDeviceAndVkQueues(const VkPhysicalDevice thePhysicalDevice,
 	outGraphicsQueueFamilyIndex = (uint32_t)indexOfGraphicsQueueFamily;
 	outComputeQueue = myComputeQueue;
 	outComputeQueueFamilyIndex = (uint32_t)indexOfComputeQueueFamily;
+	outTransferQueue = myTransferQueue;
+	outTransferQueueFamilyIndex = (uint32_t)indexOfTransferQueueFamily;
 	return true;
 }
 
@@ -9,6 +9,8 @@
 
 /**
  * Fill the specified command buffer with the present commands for this demo.
+ * The command buffer is begun and submitted by the frame graph, which also transitions the
+ * swapchain image to COLOR_ATTACHMENT_OPTIMAL before the renderpass, and to PRESENT_SRC after.
  */
 bool demo06FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
                                       const VkFramebuffer theCurrentFramebuffer,
@@ -24,21 +26,6 @@ bool demo06FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
                                       const PushConstData & pushConstData
                                       )
 {
-	VkResult result;
-
-	/*
-	 * Begin recording of the command buffer
-	 */
-	VkCommandBufferBeginInfo commandBufferBeginInfo = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.pNext = nullptr,
-		.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-		.pInheritanceInfo = nullptr,
-	};
-
-	result = vkBeginCommandBuffer(theCommandBuffer, &commandBufferBeginInfo);
-	assert(result == VK_SUCCESS);
-
 	/*
 	 * Record the state setup and drawing commands.
 	 */
@@ -119,11 +106,6 @@ bool demo06FillRenderingCommandBuffer(const VkCommandBuffer theCommandBuffer,
 
 	// End the render pass commands.
 	vkCmdEndRenderPass(theCommandBuffer);
-
-	/*
-	 * End recording of the command buffer
-	 */
-	result = vkEndCommandBuffer(theCommandBuffer);
 	return true;
 }
 
@@ -1,8 +1,7 @@
 #ifndef DEMO06RENDERSINGLEFRAME_H
 #define DEMO06RENDERSINGLEFRAME_H
 
-#include "demo06fillrenderingcommandbuffer.h"
-#include "pushconstdata.h"
+#include "../00_commons/34_frameGraph.h"
 
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -12,34 +11,28 @@
 
 struct PerFrameData
 {
-	VkCommandBuffer presentCmdBuffer;
 	VkSemaphore imageAcquiredSemaphore;
 	VkSemaphore renderingCompletedSemaphore;
-	VkFence presentFence;
+	VkFence presentFence;	// signaled when both the compute and the graphics work of the frame have completed.
 	bool fenceInitialized;
 };
 
 
 /**
- * Renders a single frame.
+ * Renders a single frame: acquires a swapchain image, binds it to the frame graph, executes
+ * the graph (the compute step and the rendering), and presents the image.
+ * theImageIndex is written before the graph is executed, so that its passes can use it.
  * Returns true on success and false on failure.
  */
 bool demo06RenderSingleFrame(const VkDevice theDevice,
                              const VkQueue theQueue,
                              const VkSwapchainKHR theSwapchain,
-                             const std::vector<VkFramebuffer> & theFramebuffersVector,
-                             const VkRenderPass theRenderPass,
-                             const VkPipeline thePipeline,
-                             const VkPipelineLayout thePipelineLayout,
-                             const VkBuffer theVertexBuffer,
-                             const uint32_t vertexInputBinding,
-                             const uint32_t numberOfVertices,
-                             const VkDescriptorSet theDescriptorSet,
-                             const VkSemaphore theComputeSemaphoreToWait,
+                             const std::vector<VkImage> & theSwapchainImagesVector,
+                             vkdemos::FrameGraph & theFrameGraph,
+                             const vkdemos::FrameGraphResource theSwapchainResource,
+                             const uint32_t theFrameIndex,
                              PerFrameData & thePerFrameData,
-                             const int width,
-                             const int height,
-                             const PushConstData & pushConstData
+                             uint32_t & theImageIndex
                              )
 {
 	VkResult result;
@@ -62,49 +55,22 @@ bool demo06RenderSingleFrame(const VkDevice theDevice,
 	else
 		assert(result == VK_SUCCESS);
 
-
-	/*
-	 * Fill the present command buffer with... the present commands.
-	 */
-	bool boolResult = demo06FillRenderingCommandBuffer(
-		thePerFrameData.presentCmdBuffer,
-		theFramebuffersVector[imageIndex],
-		theRenderPass,
-		thePipeline,
-		thePipelineLayout,
-		theVertexBuffer,
-		vertexInputBinding,
-		numberOfVertices,
-		theDescriptorSet,
-		width,
-		height,
-		pushConstData
-	);
-	assert(boolResult);
+	theImageIndex = imageIndex;
 
 
 	/*
-	 * Submit the present command buffer to the queue.
+	 * Execute the frame graph: the swapchain image's previous contents aren't needed (UNDEFINED),
+	 * the rendering pass waits for the acquisition, and after the image's last use the graph
+	 * transitions it to PRESENT_SRC and signals the semaphore the presentation waits for.
+	 * The graph records the command buffers of this frame index from scratch: the fence of the
+	 * frame has been waited on in main.cpp, and it covers both queues.
 	 */
-	VkPipelineStageFlags pipelineWaitStageFlags[2] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
-	VkSemaphore waitSemaphores[2] = {thePerFrameData.imageAcquiredSemaphore, theComputeSemaphoreToWait};
-
-	const uint32_t waitSemaphoreCount = (theComputeSemaphoreToWait == VK_NULL_HANDLE) ? 1 : 2;
+	vkdemos::bindFrameGraphImage(theFrameGraph, theSwapchainResource, theSwapchainImagesVector[imageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
+	                             thePerFrameData.imageAcquiredSemaphore, thePerFrameData.renderingCompletedSemaphore);
 
-	VkSubmitInfo submitInfo = {
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = nullptr,
-		.waitSemaphoreCount = waitSemaphoreCount,
-		.pWaitSemaphores = waitSemaphores,
-		.pWaitDstStageMask = pipelineWaitStageFlags,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &thePerFrameData.presentCmdBuffer,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &thePerFrameData.renderingCompletedSemaphore
-	};
-
-	result = vkQueueSubmit(theQueue, 1, &submitInfo, thePerFrameData.presentFence);
-	assert(result == VK_SUCCESS);
+	bool boolResult = vkdemos::executeFrameGraph(theFrameGraph, theFrameIndex, thePerFrameData.presentFence);
+	if(!boolResult)
+		return false;
 
 
 	/*
@@ -16,6 +16,11 @@
 #include "../00_commons/09_createAndAllocateBuffer.h"
 #include "../00_commons/10_submitimagebarrier.h"
 #include "../00_commons/11_loadimagefromfile.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/17_uploadEngine.h"
+#include "../00_commons/18_stagingRing.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/34_frameGraph.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -23,6 +28,7 @@
 #include "../00_commons/glm/glm/gtc/matrix_transform.hpp"
 
 #include "demo06rendersingleframe.h"
+#include "demo06fillrenderingcommandbuffer.h"
 #include "demo06createpipeline.h"
 #include "demo06createcomputepipeline.h"
 #include "demo06createvkdeviceandvkqueues.h"
@@ -57,7 +63,7 @@ static const std::string COMPUTE_SHADER_FILENAME = "compute.spirv";
 
 static constexpr int VERTEX_INPUT_BINDING = 0;
 
-static constexpr int NUM_COMPUTE_STORAGE_IMAGES = 4;
+static constexpr int NUM_COMPUTE_STORAGE_IMAGES = 2;	// Ping-pong: the previous and the next state.
 
 static constexpr int FRAMES_PER_COMPUTE = 5;	// How many frames to render for every compute dispatch.
 
@@ -75,6 +81,8 @@ static const Demo06Vertex vertices[NUM_DEMO_VERTICES] =
 // Arena for Conway's Game of Life simulation
 static constexpr int ARENA_WIDTH = 256;
 static constexpr int ARENA_HEIGHT = 256;
+
+static constexpr VkDeviceSize STAGING_RING_SIZE = 1024 * 1024;
 uint8_t arenaInitialization[ARENA_WIDTH*ARENA_HEIGHT];
 
 
@@ -136,7 +144,9 @@ int main(int argc, char* argv[])
 	uint32_t myQueueFamilyIndex;
 	VkQueue myComputeQueue;
 	uint32_t myComputeQueueFamilyIndex;
-	boolResult = demo06createVkDeviceAndVkQueues(myPhysicalDevice, mySurface, layersNamesToEnable, myDevice, myQueue, myQueueFamilyIndex, myComputeQueue, myComputeQueueFamilyIndex);
+	VkQueue myTransferQueue;
+	uint32_t myTransferQueueFamilyIndex;
+	boolResult = demo06createVkDeviceAndVkQueues(myPhysicalDevice, mySurface, layersNamesToEnable, myDevice, myQueue, myQueueFamilyIndex, myComputeQueue, myComputeQueueFamilyIndex, myTransferQueue, myTransferQueueFamilyIndex);
 	assert(boolResult);
 
 	VkSwapchainKHR mySwapchain;
@@ -153,6 +163,15 @@ int main(int argc, char* argv[])
 	boolResult = vkdemos::createCommandPool(myDevice, myQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
 	assert(boolResult);
 
+	// The arena is uploaded on the transfer queue, and its first reader is the compute queue.
+	vkdemos::UploadEngine myUploadEngine;
+	boolResult = vkdemos::createUploadEngine(myDevice, myTransferQueue, myTransferQueueFamilyIndex, myComputeQueue, myComputeQueueFamilyIndex, myUploadEngine);
+	assert(boolResult);
+
+	vkdemos::StagingRing myStagingRing;
+	boolResult = vkdemos::createStagingRing(myPhysicalDevice, myDevice, STAGING_RING_SIZE, myStagingRing);
+	assert(boolResult);
+
 	VkCommandBuffer myCmdBufferInitialization;
 	boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCmdBufferInitialization);
 	assert(boolResult);
@@ -170,7 +189,7 @@ int main(int argc, char* argv[])
 	boolResult = vkdemos::createAndAllocateImage(
 		myDevice,
 		myMemoryProperties,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
 		0,
 		myDepthBufferFormat,
 		windowWidth,
@@ -178,13 +197,14 @@ int main(int argc, char* argv[])
 		myDepthImage,
 		myDepthMemory,
 		&myDepthImageView,
-		VK_IMAGE_ASPECT_DEPTH_BIT
+		VK_IMAGE_ASPECT_DEPTH_BIT,
+		VKDEMOS_ALLOCATION_SITE("depth buffer")
 	);
 	assert(boolResult);
 
-	// Create the renderpass.
+	// Create the renderpass; the frame graph transitions the swapchain image for presentation after it.
 	VkRenderPass myRenderPass;
-	boolResult = demo02CreateRenderPass(myDevice, mySurfaceFormat, myDepthBufferFormat, myRenderPass);
+	boolResult = demo02CreateRenderPass(myDevice, mySurfaceFormat, myDepthBufferFormat, myRenderPass, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	assert(boolResult);
 
 	// Create the Framebuffers, based on the number of swapchain images.
@@ -198,33 +218,29 @@ int main(int argc, char* argv[])
 		myFramebuffersVector.push_back(fb);
 	}
 
-	// Create a buffer to use as the vertex buffer.
+	/*
+	 * Create the vertex buffer.
+	 * The vertices never change: a static geometry buffer lives in device-local memory,
+	 * and the data is copied there through a staging buffer.
+	 */
 	const size_t vertexBufferSize = sizeof(Demo06Vertex)*NUM_DEMO_VERTICES;
 	VkBuffer myVertexBuffer;
 	VkDeviceMemory myVertexBufferMemory;
-
-	boolResult = vkdemos::createAndAllocateBuffer(
+	boolResult = vkdemos::createGeometryBuffer(
 		myDevice,
 		myMemoryProperties,
+		myQueue,
+		myCommandPool,
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		vkdemos::GEOMETRY_USAGE_STATIC,
+		vertices,
 		vertexBufferSize,
 		myVertexBuffer,
-		myVertexBufferMemory
+		myVertexBufferMemory,
+		VKDEMOS_ALLOCATION_SITE("vertex buffer")
 	);
 	assert(boolResult);
 
-	// Map vertex buffer and insert data
-	{
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myVertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
-
-		memcpy(mappedBuffer, vertices, vertexBufferSize);
-
-		vkUnmapMemory(myDevice, myVertexBufferMemory);
-	}
-
 
 
 	/*
@@ -232,9 +248,9 @@ int main(int argc, char* argv[])
 	 *
 	 * We need an area of memory for the compute shader to
 	 * compute the next state in the simulation; we do this by
-	 * creating various Storage Images (spec. 13.1.1), so that
-	 * we have at least one to use as the current state and
-	 * one as the next state.
+	 * creating two Storage Images (spec. 13.1.1), one to use
+	 * as the current state and one as the next state, swapping
+	 * them at every step.
 	 *
 	 * To optimize memory allocation, we allocate a single
 	 * memory area from the GPU, and then we create the various
@@ -243,8 +259,6 @@ int main(int argc, char* argv[])
 	VkImage myArenaStorageImages[NUM_COMPUTE_STORAGE_IMAGES];
 	VkImageView myArenaStorageImagesViews[NUM_COMPUTE_STORAGE_IMAGES];
 	VkDeviceMemory myArenaStorageImagesMemory;
-	VkBuffer myArenaStagingBuffer;
-	VkDeviceMemory myArenaStagingBufferMemory;
 
 	{
 		std::random_device rd;
@@ -257,7 +271,17 @@ int main(int argc, char* argv[])
 		/*
 		 * Create the VkImages
 		 */
-		uint32_t queueFamilyIndices[2] = {myQueueFamilyIndex, myComputeQueueFamilyIndex};
+		/*
+		 * The images are used by the graphics and the compute queues, and written by the
+		 * transfer queue: they're shared by all the distinct families among them.
+		 * If there's only one, the images are exclusive to it.
+		 */
+		std::vector<uint32_t> queueFamilyIndices = {myQueueFamilyIndex};
+		for(const uint32_t family : {myComputeQueueFamilyIndex, myTransferQueueFamilyIndex})
+			if(std::find(queueFamilyIndices.begin(), queueFamilyIndices.end(), family) == queueFamilyIndices.end())
+				queueFamilyIndices.push_back(family);
+
+		const VkSharingMode arenaSharingMode = (queueFamilyIndices.size() > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
 
 		const VkImageCreateInfo imageCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -271,9 +295,9 @@ int main(int argc, char* argv[])
 			.samples = VK_SAMPLE_COUNT_1_BIT,
 			.tiling = VK_IMAGE_TILING_OPTIMAL,
 			.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-			.sharingMode = VK_SHARING_MODE_CONCURRENT,
-			.queueFamilyIndexCount = 2,
-			.pQueueFamilyIndices = queueFamilyIndices,
+			.sharingMode = arenaSharingMode,
+			.queueFamilyIndexCount = (arenaSharingMode == VK_SHARING_MODE_CONCURRENT) ? (uint32_t)queueFamilyIndices.size() : 0u,
+			.pQueueFamilyIndices = queueFamilyIndices.data(),
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		};
 
@@ -318,7 +342,7 @@ int main(int argc, char* argv[])
 			.memoryTypeIndex = (uint32_t)memoryTypeIndex,
 		};
 
-		result = vkAllocateMemory(myDevice, &memoryAllocateInfo, nullptr, &myArenaStorageImagesMemory);
+		result = vkdemos::trackedAllocateMemory(myDevice, myMemoryProperties, memoryAllocateInfo, VKDEMOS_ALLOCATION_SITE("arena storage images"), myArenaStorageImagesMemory);
 		assert(result == VK_SUCCESS);
 
 
@@ -360,168 +384,29 @@ int main(int argc, char* argv[])
 
 
 		/*
-		 * As for Demo 05, we use a staging buffer to copy the initialization
-		 * data for the first iteration of the simulation.
+		 * As for Demo 05, we use the staging ring to upload the initialization
+		 * data for the first iteration of the simulation to the first image,
+		 * on the transfer queue; the compute queue then waits for the upload, and finds
+		 * the image in the GENERAL layout. The other image is transitioned from UNDEFINED
+		 * by the frame graph, before the first step writes it.
 		 */
-		boolResult = vkdemos::createAndAllocateBuffer(
-			myDevice,
-			myMemoryProperties,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		boolResult = vkdemos::stageImageData(
+			myStagingRing,
+			myUploadEngine,
+			arenaInitialization,
 			ARENA_WIDTH*ARENA_HEIGHT*sizeof(uint8_t),
-			myArenaStagingBuffer,
-			myArenaStagingBufferMemory
-		);
-		assert(boolResult);
-
-		// Map the buffer and fill it with data.
-		void *mappedBuffer;
-		result = vkMapMemory(myDevice, myArenaStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedBuffer);
-		assert(result == VK_SUCCESS);
-
-		memcpy(mappedBuffer, reinterpret_cast<const unsigned char *>(arenaInitialization), ARENA_WIDTH*ARENA_HEIGHT*sizeof(uint8_t));
-
-		VkMappedMemoryRange mappedMemoryRange = {
-			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-			.pNext = nullptr,
-			.memory = myArenaStagingBufferMemory,
-			.offset = 0,
-			.size = VK_WHOLE_SIZE,
-		};
-
-		vkFlushMappedMemoryRanges(myDevice, 1, &mappedMemoryRange);
-		vkUnmapMemory(myDevice, myArenaStagingBufferMemory);
-
-
-		/*
-		 * Submit a buffer->image copy command to the GPU.
-		 */
-		VkCommandBuffer textureCopyCmdBuffer;
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, textureCopyCmdBuffer);
-		assert(boolResult);
-
-		// Begin command buffer recording.
-		VkCommandBufferBeginInfo commandBufferBeginInfo = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.pNext = nullptr,
-			.flags = (VkCommandBufferUsageFlags)0,
-			.pInheritanceInfo = nullptr,
-		};
-
-		result = vkBeginCommandBuffer(textureCopyCmdBuffer, &commandBufferBeginInfo);
-		assert(result == VK_SUCCESS);
-
-
-		/*
-		 * Transition image to an optimal layout for transfer
-		 */
-		{
-			std::vector<VkImageMemoryBarrier> imageMemoryBarrierVector;
-
-			VkImageMemoryBarrier imageMemoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-				.pNext = nullptr,
-				.srcAccessMask = 0,
-				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.subresourceRange =  {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
-				.image = myArenaStorageImages[0],  // Initialize only the first image
-			};
-
-			imageMemoryBarrierVector.push_back(imageMemoryBarrier);
-
-			// While I'm at it, transition all the other storage images from
-			// VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_GENERAL.
-
-			for(int i = 1; i < NUM_COMPUTE_STORAGE_IMAGES; i++) {
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-				imageMemoryBarrier.image = myArenaStorageImages[i];
-				imageMemoryBarrierVector.push_back(imageMemoryBarrier);
-			}
-
-			// Barrier for the buffer, to synchronize with the host upload
-			VkBufferMemoryBarrier bufferMemoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				.pNext = nullptr,
-				.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT,
-				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-				.buffer = myArenaStagingBuffer,
-				.offset = 0,
-				.size = VK_WHOLE_SIZE,
-			};
-
-			vkCmdPipelineBarrier(textureCopyCmdBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // dstStageMask
-				0,                                 // dependencyFlags
-				0,                                 // memoryBarrierCount
-				nullptr,                           // pMemoryBarriers
-				1,                                 // bufferMemoryBarrierCount
-				&bufferMemoryBarrier,              // pBufferMemoryBarriers
-				imageMemoryBarrierVector.size(),   // imageMemoryBarrierCount
-				imageMemoryBarrierVector.data()    // pImageMemoryBarriers
-			);
-		}
-
-
-		// Copy mip levels from staging buffer
-		VkBufferImageCopy bufferImageCopy = {
-			.bufferOffset = 0,
-			.bufferRowLength = 0,
-			.bufferImageHeight = 0,
-			.imageSubresource = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
-		    },
-		    .imageOffset = {0, 0, 0},
-		    .imageExtent = {.width = ARENA_WIDTH, .height = ARENA_HEIGHT, .depth = 1},
-		};
-
-		vkCmdCopyBufferToImage(
-			textureCopyCmdBuffer,
-			myArenaStagingBuffer,
-			myArenaStorageImages[0],
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferImageCopy
-		);
-
-		// Transition the Image to an optimal layout for use as a shader's read-only sampling source.
-		vkdemos::submitImageBarrier(
-			textureCopyCmdBuffer,
 			myArenaStorageImages[0],
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			ARENA_WIDTH,
+			ARENA_HEIGHT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_GENERAL,
-		    {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			arenaSharingMode
 		);
+		assert(boolResult);
 
-		// End command buffer recording.
-		result = vkEndCommandBuffer(textureCopyCmdBuffer);
-
-		// Submit the command buffer to the queue
-		VkSubmitInfo submitInfo = {
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.pNext = nullptr,
-			.waitSemaphoreCount = 0,
-			.pWaitSemaphores = nullptr,
-			.pWaitDstStageMask = nullptr,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &textureCopyCmdBuffer,
-			.signalSemaphoreCount = 0,
-			.pSignalSemaphores = nullptr
-		};
-
-		result = vkQueueSubmit(myQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		assert(result == VK_SUCCESS);
+		vkdemos::flushStagingRing(myStagingRing, myUploadEngine);
 	}
 
 
@@ -542,14 +427,14 @@ int main(int argc, char* argv[])
 	 */
 	VkDescriptorPoolSize descriptorPoolSize = {
 	    .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-	    .descriptorCount = NUM_COMPUTE_STORAGE_IMAGES * 2 + FRAME_LAG,
+	    .descriptorCount = NUM_COMPUTE_STORAGE_IMAGES * 2 + NUM_COMPUTE_STORAGE_IMAGES,
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
 	    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 	    .pNext = nullptr,
 	    .flags = 0,
-	    .maxSets = NUM_COMPUTE_STORAGE_IMAGES + FRAME_LAG,
+	    .maxSets = NUM_COMPUTE_STORAGE_IMAGES * 2,
 	    .poolSizeCount = 1,
 	    .pPoolSizes = &descriptorPoolSize,
 	};
@@ -665,11 +550,15 @@ int main(int argc, char* argv[])
 
 
 	/*
-	 * Allocate Descriptor Sets for Graphics.
+	 * Allocate and write the Descriptor Sets, one of each kind per arena image:
+	 * the graphics set i draws the image i, and the compute set i reads the
+	 * image i as the previous state and writes the other one as the next state.
+	 * The images never change, so the sets are written once here.
 	 */
-	VkDescriptorSet myGraphicsDescriptorSets[FRAME_LAG];
+	VkDescriptorSet myGraphicsDescriptorSets[NUM_COMPUTE_STORAGE_IMAGES];
+	VkDescriptorSet myComputeDescriptorSets[NUM_COMPUTE_STORAGE_IMAGES];
 
-	for(int i = 0; i < FRAME_LAG; i++)
+	for(int i = 0; i < NUM_COMPUTE_STORAGE_IMAGES; i++)
 	{
 		VkDescriptorSetAllocateInfo graphicsDescriptorSetAllocateInfo = {
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -681,16 +570,7 @@ int main(int argc, char* argv[])
 
 		result = vkAllocateDescriptorSets(myDevice, &graphicsDescriptorSetAllocateInfo, &myGraphicsDescriptorSets[i]);
 		assert(result == VK_SUCCESS);
-	}
-
 
-	/*
-	 * Allocate Descriptor Sets for Compute.
-	 */
-	VkDescriptorSet myComputeDescriptorSets[NUM_COMPUTE_STORAGE_IMAGES];
-
-	for(int i = 0; i < NUM_COMPUTE_STORAGE_IMAGES; i++)
-	{
 		VkDescriptorSetAllocateInfo computeDescriptorSetAllocateInfo = {
 			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 			.pNext = nullptr,
@@ -701,6 +581,64 @@ int main(int argc, char* argv[])
 
 		result = vkAllocateDescriptorSets(myDevice, &computeDescriptorSetAllocateInfo, &myComputeDescriptorSets[i]);
 		assert(result == VK_SUCCESS);
+
+		VkDescriptorImageInfo descriptorImageInfos[2] =
+		{
+		    [0] = {
+				.sampler = VK_NULL_HANDLE,		// ignored for VK_DESCRIPTOR_TYPE_STORAGE_IMAGE (Spec. 13.2.4)
+				.imageView = myArenaStorageImagesViews[i],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		    },
+		    [1] = {
+				.sampler = VK_NULL_HANDLE,
+				.imageView = myArenaStorageImagesViews[(i + 1) % NUM_COMPUTE_STORAGE_IMAGES],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		    },
+		};
+
+		VkWriteDescriptorSet writeDescriptorSets[3] = {
+		    // Graphics: "arenaState"
+		    [0] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = myGraphicsDescriptorSets[i],
+				.dstBinding = 0,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &descriptorImageInfos[0],
+				.pBufferInfo = nullptr,
+				.pTexelBufferView = nullptr,
+		    },
+		    // Compute: "previousState"
+		    [1] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = myComputeDescriptorSets[i],
+				.dstBinding = 0,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &descriptorImageInfos[0],
+				.pBufferInfo = nullptr,
+				.pTexelBufferView = nullptr,
+		    },
+		    // Compute: "nextState"
+		    [2] = {
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.pNext = nullptr,
+				.dstSet = myComputeDescriptorSets[i],
+				.dstBinding = 1,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &descriptorImageInfos[1],
+				.pBufferInfo = nullptr,
+				.pTexelBufferView = nullptr,
+		    },
+		};
+
+		vkUpdateDescriptorSets(myDevice, 3, writeDescriptorSets, 0, nullptr);
 	}
 
 
@@ -729,15 +667,11 @@ int main(int argc, char* argv[])
 	result = vkQueueSubmit(myQueue, 1, &submitInfo, VK_NULL_HANDLE);
 	assert(result == VK_SUCCESS);
 
-	// Per-Frame and per-compute data.
+	// Per-Frame data.
 	PerFrameData perFrameDataVector[FRAME_LAG];
-	PerComputeData perComputeDataVector[NUM_COMPUTE_STORAGE_IMAGES];
 
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, perFrameDataVector[i].presentCmdBuffer);
-		assert(boolResult);
-
 		result = vkdemos::utils::createFence(myDevice, perFrameDataVector[i].presentFence);
 		assert(result == VK_SUCCESS);
 
@@ -750,19 +684,82 @@ int main(int argc, char* argv[])
 		perFrameDataVector[i].fenceInitialized = false;
 	}
 
-	for(int i = 0; i < NUM_COMPUTE_STORAGE_IMAGES; i++)
-	{
-		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, perComputeDataVector[i].computeCmdBuffer);
-		assert(boolResult);
 
-		result = vkdemos::utils::createFence(myDevice, perComputeDataVector[i].computeFence);
-		assert(result == VK_SUCCESS);
+	/*
+	 * Declare the frame graph: a compute pass reads the previous state of the arena and writes
+	 * the next one, and a graphics pass draws the next state to the swapchain image.
+	 * The arena images are imported: they live across frames, and at every step they're bound
+	 * the other way round. The graph generates the barriers between the passes, and the
+	 * semaphores between the queues: the graphics pass waits for the compute pass, and the
+	 * compute pass of the next frame waits for the graphics pass, which read the image the
+	 * compute pass is going to write.
+	 * The passes can't change between frames: on the frames without a simulation step, the
+	 * compute pass records nothing, and the images aren't swapped. That empty pass still costs
+	 * a submission to the compute queue and two semaphores every frame; for a demo stepping once
+	 * every FRAMES_PER_COMPUTE frames that's negligible, but a graph with costlier optional work
+	 * would rather be compiled twice, with and without the pass.
+	 * There are no transient images, so the graph needs no memory allocator.
+	 */
+	vkdemos::FrameGraph myFrameGraph;
+	boolResult = vkdemos::createFrameGraph(myDevice, myQueue, myQueueFamilyIndex, myComputeQueue, myComputeQueueFamilyIndex, FRAME_LAG, myFrameGraph);
+	assert(boolResult);
 
-		result = vkdemos::utils::createSemaphore(myDevice, perComputeDataVector[i].computeCompletedSemaphore);
-		assert(result == VK_SUCCESS);
+	const vkdemos::FrameGraphResource previousArenaResource = vkdemos::addFrameGraphImportedImage(myFrameGraph, "arena previous state");
+	const vkdemos::FrameGraphResource nextArenaResource = vkdemos::addFrameGraphImportedImage(myFrameGraph, "arena next state");
+	const vkdemos::FrameGraphResource swapchainResource = vkdemos::addFrameGraphImportedImage(myFrameGraph, "swapchain image");
+	vkdemos::setFrameGraphOutput(myFrameGraph, swapchainResource, vkdemos::RESOURCE_USAGE_PRESENT);
 
-		perComputeDataVector[i].fenceInitialized = false;
-	}
+	PushConstData pushConstData;
+	pushConstData.windowSize = {windowWidth, windowHeight};
+	pushConstData.arenaSize = {ARENA_WIDTH, ARENA_HEIGHT};
+
+	// State of the current frame, read by the passes when the graph is executed.
+	int mostRecentlyUpdatedArenaImageIndex = 0;
+	bool computeStepThisFrame = false;
+	uint32_t swapchainImageIndex = 0;
+
+	vkdemos::addFrameGraphPass(myFrameGraph, "simulation step", vkdemos::FRAME_GRAPH_QUEUE_COMPUTE,
+		{
+			{previousArenaResource, vkdemos::RESOURCE_USAGE_STORAGE_READ_COMPUTE},
+			{nextArenaResource, vkdemos::RESOURCE_USAGE_STORAGE_WRITE_COMPUTE},
+		},
+		[&](VkCommandBuffer theCommandBuffer) {
+			// The compute set of the previous state's image writes the other one.
+			const int previousArenaImageIndex = (mostRecentlyUpdatedArenaImageIndex + 1) % NUM_COMPUTE_STORAGE_IMAGES;
+
+			if(computeStepThisFrame)
+				demo06RecordComputeSingleStep(theCommandBuffer, myComputePipeline, myComputePipelineLayout, myComputeDescriptorSets[previousArenaImageIndex], ARENA_WIDTH, ARENA_HEIGHT, pushConstData);
+		}
+	);
+
+	vkdemos::addFrameGraphPass(myFrameGraph, "rendering", vkdemos::FRAME_GRAPH_QUEUE_GRAPHICS,
+		{
+			{nextArenaResource, vkdemos::RESOURCE_USAGE_STORAGE_READ_FRAGMENT},
+			{swapchainResource, vkdemos::RESOURCE_USAGE_COLOR_ATTACHMENT},
+		},
+		[&](VkCommandBuffer theCommandBuffer) {
+			demo06FillRenderingCommandBuffer(
+				theCommandBuffer,
+				myFramebuffersVector[swapchainImageIndex],
+				myRenderPass,
+				myGraphicsPipeline,
+				myGraphicsPipelineLayout,
+				myVertexBuffer,
+				VERTEX_INPUT_BINDING,
+				NUM_DEMO_VERTICES,
+				myGraphicsDescriptorSets[mostRecentlyUpdatedArenaImageIndex],
+				windowWidth,
+				windowHeight,
+				pushConstData
+			);
+		}
+	);
+
+	boolResult = vkdemos::compileFrameGraph(myFrameGraph);
+	assert(boolResult);
+
+	// Layouts of the arena images for the first binding: the upload left the first one in GENERAL.
+	VkImageLayout arenaImageLayouts[NUM_COMPUTE_STORAGE_IMAGES] = {VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_UNDEFINED};
 
 	// Wait for the queue to complete its work.
 	result = vkQueueWaitIdle(myQueue);
@@ -778,14 +775,6 @@ int main(int argc, char* argv[])
 	SDL_Event sdlEvent;
 	bool quit = false, quit2 = false;
 
-	PushConstData pushConstData;
-	pushConstData.windowSize = {windowWidth, windowHeight};
-	pushConstData.arenaSize = {ARENA_WIDTH, ARENA_HEIGHT};
-
-	int mostRecentlyUpdatedArenaImageIndex = 0;
-	VkImageView mostRecentlyUpdatedArenaImageView = myArenaStorageImagesViews[0];
-	VkSemaphore computeSemaphoreToWait = VK_NULL_HANDLE;
-
 	// Just some variables for frame statistics
 	long frameNumber = 0;
 	long frameMaxTime = LONG_MIN;
@@ -814,135 +803,55 @@ int main(int argc, char* argv[])
 		if(!quit)
 		{
 			PerFrameData & perFrameData = perFrameDataVector[frameNumber % FRAME_LAG];
-			const VkDescriptorSet & activeGraphicsDescriptorSet = myGraphicsDescriptorSets[frameNumber % FRAME_LAG];
 
 			// Render a single frame
 			auto renderStartTime = std::chrono::high_resolution_clock::now();
 
+			// Wait for the frame's fence: the graph reuses its command buffers.
+			if(perFrameData.fenceInitialized) {
+				vkWaitForFences(myDevice, 1, &perFrameData.presentFence, VK_TRUE, UINT64_MAX);
+				vkResetFences(myDevice, 1, &perFrameData.presentFence);
+			}
+
 
 			/*
-			 * Start dispatching the compute job: we run it only every Nth frame,
-			 * so that our simulation is slow enough for us to see.
+			 * We compute a simulation step only every Nth frame, so that our simulation
+			 * is slow enough for us to see: the images are swapped, and the next state is
+			 * computed from the previous one.
 			 */
-			computeSemaphoreToWait = VK_NULL_HANDLE;
-			if(frameNumber % FRAMES_PER_COMPUTE == 0)
-			{
-				VkImageView currentlyUpdatedArenaImageView = mostRecentlyUpdatedArenaImageView;
-
+			computeStepThisFrame = (frameNumber % FRAMES_PER_COMPUTE == 0);
+			if(computeStepThisFrame)
 				mostRecentlyUpdatedArenaImageIndex = (mostRecentlyUpdatedArenaImageIndex + 1) % NUM_COMPUTE_STORAGE_IMAGES;
-				mostRecentlyUpdatedArenaImageView = myArenaStorageImagesViews[mostRecentlyUpdatedArenaImageIndex];
-
-				PerComputeData & perComputeData = perComputeDataVector[mostRecentlyUpdatedArenaImageIndex];
-				const VkDescriptorSet & activeComputeDescriptorSet = myComputeDescriptorSets[mostRecentlyUpdatedArenaImageIndex];
-
-
-				// Update compute descriptor set
-				{
-					VkDescriptorImageInfo descriptorImageInfos[2] =
-					{
-					    [0] = {
-							.sampler = VK_NULL_HANDLE,
-							.imageView = currentlyUpdatedArenaImageView,
-							.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-					    },
-					    [1] = {
-							.sampler = VK_NULL_HANDLE,
-							.imageView = mostRecentlyUpdatedArenaImageView,
-							.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-					    },
-					};
-
-					VkWriteDescriptorSet writeDescriptorSets[2] = {
-					    [0] = {
-							.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-							.pNext = nullptr,
-							.dstSet = activeComputeDescriptorSet,
-							.dstBinding = 0,
-							.dstArrayElement = 0,
-							.descriptorCount = 1,
-							.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-							.pImageInfo = &descriptorImageInfos[0],
-							.pBufferInfo = nullptr,
-							.pTexelBufferView = nullptr,
-					    },
-					    [1] = {
-					        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-							.pNext = nullptr,
-							.dstSet = activeComputeDescriptorSet,
-							.dstBinding = 1,
-							.dstArrayElement = 0,
-							.descriptorCount = 1,
-							.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-							.pImageInfo = &descriptorImageInfos[1],
-							.pBufferInfo = nullptr,
-							.pTexelBufferView = nullptr,
-					    }
-					};
-
-					vkUpdateDescriptorSets(myDevice, 2, writeDescriptorSets, 0, nullptr);
-				}
-
-				quit = !demo06ComputeSingleStep(myDevice, myComputeQueue, myComputePipeline, myComputePipelineLayout, activeComputeDescriptorSet, perComputeData, ARENA_WIDTH, ARENA_HEIGHT, pushConstData);
-				if(quit) break;
-
-				computeSemaphoreToWait = perComputeData.computeCompletedSemaphore;
-			}
 
+			const int previousArenaImageIndex = (mostRecentlyUpdatedArenaImageIndex + 1) % NUM_COMPUTE_STORAGE_IMAGES;
 
-			/*
-			 * Now submit the rendering commands; we pass the compute semaphore's handle
-			 * so that the graphics queue can correctly wait for the results before rendering.
-			 */
-			// Wait for the frame's fence
-			if(perFrameData.fenceInitialized) {
-				vkWaitForFences(myDevice, 1, &perFrameData.presentFence, VK_TRUE, UINT64_MAX);
-				vkResetFences(myDevice, 1, &perFrameData.presentFence);
-			}
+			vkdemos::bindFrameGraphImage(myFrameGraph, previousArenaResource, myArenaStorageImages[previousArenaImageIndex], arenaImageLayouts[previousArenaImageIndex]);
+			vkdemos::bindFrameGraphImage(myFrameGraph, nextArenaResource, myArenaStorageImages[mostRecentlyUpdatedArenaImageIndex], arenaImageLayouts[mostRecentlyUpdatedArenaImageIndex]);
 
-			// Update the graphics descriptor set: tell the fragment shader which storage image to use
-			// to draw the arena grid.
-			{
-				VkDescriptorImageInfo descriptorImageInfo = {
-					.sampler = VK_NULL_HANDLE,		// ignored for VK_DESCRIPTOR_TYPE_STORAGE_IMAGE (Spec. 13.2.4)
-					.imageView = mostRecentlyUpdatedArenaImageView,
-					.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
-				};
-
-				VkWriteDescriptorSet writeDescriptorSet = {
-					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.pNext = nullptr,
-					.dstSet = activeGraphicsDescriptorSet,
-					.dstBinding = 0,
-					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-					.pImageInfo = &descriptorImageInfo,
-					.pBufferInfo = nullptr,
-					.pTexelBufferView = nullptr,
-				};
-
-				vkUpdateDescriptorSets(myDevice, 1, &writeDescriptorSet, 0, nullptr);
-			}
+			// Make the compute queue wait for the arena upload, the first time.
+			vkdemos::submitPendingUploadAcquires(myUploadEngine);
 
+			/*
+			 * Now acquire the swapchain image, and execute the graph: the compute pass
+			 * is submitted to the compute queue, and the rendering pass to the graphics
+			 * queue, waiting for it.
+			 */
 			quit = !demo06RenderSingleFrame(
 				myDevice,
 				myQueue,
 				mySwapchain,
-				myFramebuffersVector,
-				myRenderPass,
-				myGraphicsPipeline,
-				myGraphicsPipelineLayout,
-				myVertexBuffer,
-				VERTEX_INPUT_BINDING,
-				NUM_DEMO_VERTICES,
-				activeGraphicsDescriptorSet,
-				computeSemaphoreToWait,
+				mySwapchainImagesVector,
+				myFrameGraph,
+				swapchainResource,
+				frameNumber % FRAME_LAG,
 				perFrameData,
-				windowWidth,
-				windowHeight,
-				pushConstData
+				swapchainImageIndex
 			);
 
+			// The storage images are always used in the GENERAL layout.
+			for(VkImageLayout & layout : arenaImageLayouts)
+				layout = VK_IMAGE_LAYOUT_GENERAL;
+
 
 			auto renderStopTime = std::chrono::high_resolution_clock::now();
 
@@ -985,6 +894,11 @@ int main(int argc, char* argv[])
 	result = vkQueueWaitIdle(myQueue);
 	assert(result == VK_SUCCESS);
 
+	vkdemos::destroyStagingRing(myStagingRing, myUploadEngine);
+	vkdemos::destroyUploadEngine(myUploadEngine);
+
+	vkdemos::destroyFrameGraph(myFrameGraph);
+
 	for(int i = 0; i < FRAME_LAG; i++)
 	{
 		vkDestroyFence(myDevice, perFrameDataVector[i].presentFence, nullptr);
@@ -992,26 +906,17 @@ int main(int argc, char* argv[])
 		vkDestroySemaphore(myDevice, perFrameDataVector[i].renderingCompletedSemaphore, nullptr);
 	}
 
-	for(int i = 0; i < NUM_COMPUTE_STORAGE_IMAGES; i++)
-	{
-		vkDestroyFence(myDevice, perComputeDataVector[i].computeFence, nullptr);
-		vkDestroySemaphore(myDevice, perComputeDataVector[i].computeCompletedSemaphore, nullptr);
-	}
-
 	// Destroy descriptor pool/set layout
 	vkDestroyDescriptorPool(myDevice, myDescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(myDevice, myGraphicsDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(myDevice, myComputeDescriptorSetLayout, nullptr);
 
-	// Free the arena storage images and staging buffer
+	// Free the arena storage images
 	for(int i = 0; i < NUM_COMPUTE_STORAGE_IMAGES; i++) {
 		vkDestroyImageView(myDevice, myArenaStorageImagesViews[i], nullptr);
 		vkDestroyImage(myDevice, myArenaStorageImages[i], nullptr);
 	}
-	vkFreeMemory(myDevice, myArenaStorageImagesMemory, nullptr);
-
-	vkDestroyBuffer(myDevice, myArenaStagingBuffer, nullptr);
-	vkFreeMemory(myDevice, myArenaStagingBufferMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myArenaStorageImagesMemory);
 
 	// For more informations on the following commands, refer to Demo 02.
 	vkDestroyPipeline(myDevice, myComputePipeline, nullptr);
@@ -1019,7 +924,7 @@ int main(int argc, char* argv[])
 	vkDestroyPipeline(myDevice, myGraphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(myDevice, myGraphicsPipelineLayout, nullptr);
 	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
-	vkFreeMemory(myDevice, myVertexBufferMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
 
 	for(auto framebuffer : myFramebuffersVector)
 		vkDestroyFramebuffer(myDevice, framebuffer, nullptr);
@@ -1027,7 +932,7 @@ int main(int argc, char* argv[])
 	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
 	vkDestroyImageView(myDevice, myDepthImageView, nullptr);
 	vkDestroyImage(myDevice, myDepthImage, nullptr);
-	vkFreeMemory(myDevice, myDepthMemory, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myDepthMemory);
 
 	// For more informations on the following commands, refer to Demo 01.
 	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
@@ -1036,6 +941,10 @@ int main(int argc, char* argv[])
 		vkDestroyImageView(myDevice, imgView, nullptr);
 
 	vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+
+	// All the device memory should have been freed by now.
+	vkdemos::printMemoryLeakReport();
+
 	vkDestroyDevice(myDevice, nullptr);
 	vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
 	vkdemos::destroyDebugReportCallback(myInstance, myDebugReportCallback);
@@ -0,0 +1,304 @@
+#ifndef BENCHMARKCOMMON_H
+#define BENCHMARKCOMMON_H
+
+/*
+ * Setup shared by the benchmarks that need a Vulkan device: a headless instance and device,
+ * and a render pass, framebuffer and pipeline that discard the primitives before rasterization,
+ * so that nothing needs a window or attachments.
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+
+static constexpr char DISCARD_VERTEX_SHADER_FILE_NAME[] = "vertexthroughput.spirv";
+
+
+// The vertex read by vertexthroughput.vert: 32 bytes, all of them used.
+struct BenchmarkVertex
+{
+	float x, y, z;
+	float nx, ny, nz;
+	float u, v;
+};
+
+
+struct HeadlessDevice
+{
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	uint32_t queueFamilyIndex = UINT32_MAX;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+};
+
+
+
+/*
+ * Creates an instance without extensions, and a device on the first physical device found,
+ * with a queue from its first graphics queue family (which must support timestamps if requireTimestamps).
+ */
+static bool createHeadlessDevice(const char * theApplicationName, const bool requireTimestamps, HeadlessDevice & outDevice)
+{
+	VkResult result;
+	HeadlessDevice myDevice;
+
+	const VkApplicationInfo applicationInfo = {
+		.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+		.pNext = nullptr,
+		.pApplicationName = theApplicationName,
+		.applicationVersion = 1,
+		.pEngineName = theApplicationName,
+		.engineVersion = 1,
+		.apiVersion = VK_MAKE_VERSION(1, 0, 0),
+	};
+
+	const VkInstanceCreateInfo instanceCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.pApplicationInfo = &applicationInfo,
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = 0,
+		.ppEnabledExtensionNames = nullptr,
+	};
+
+	result = vkCreateInstance(&instanceCreateInfo, nullptr, &myDevice.instance);
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: Cannot create Vulkan instance, " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	uint32_t physicalDeviceCount = 1;
+	result = vkEnumeratePhysicalDevices(myDevice.instance, &physicalDeviceCount, &myDevice.physicalDevice);
+	if((result != VK_SUCCESS && result != VK_INCOMPLETE) || physicalDeviceCount == 0) {
+		std::cout << "!!! ERROR: No Vulkan device found." << std::endl;
+		return false;
+	}
+
+	vkGetPhysicalDeviceProperties(myDevice.physicalDevice, &myDevice.properties);
+	vkGetPhysicalDeviceMemoryProperties(myDevice.physicalDevice, &myDevice.memoryProperties);
+
+	uint32_t queueFamilyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(myDevice.physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(myDevice.physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	for(uint32_t i = 0; i < queueFamilyCount && myDevice.queueFamilyIndex == UINT32_MAX; i++)
+		if(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			myDevice.queueFamilyIndex = i;
+
+	if(myDevice.queueFamilyIndex == UINT32_MAX) {
+		std::cout << "!!! ERROR: The device has no graphics queue." << std::endl;
+		return false;
+	}
+
+	if(requireTimestamps && queueFamilies[myDevice.queueFamilyIndex].timestampValidBits == 0) {
+		std::cout << "!!! ERROR: The device's graphics queue doesn't support timestamps." << std::endl;
+		return false;
+	}
+
+	const float queuePriority = 1.0f;
+	const VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queueFamilyIndex = myDevice.queueFamilyIndex,
+		.queueCount = 1,
+		.pQueuePriorities = &queuePriority,
+	};
+
+	const VkDeviceCreateInfo deviceCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queueCreateInfoCount = 1,
+		.pQueueCreateInfos = &deviceQueueCreateInfo,
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = 0,
+		.ppEnabledExtensionNames = nullptr,
+		.pEnabledFeatures = nullptr,
+	};
+
+	result = vkCreateDevice(myDevice.physicalDevice, &deviceCreateInfo, nullptr, &myDevice.device);
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: Cannot create the device, " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	vkGetDeviceQueue(myDevice.device, myDevice.queueFamilyIndex, 0, &myDevice.queue);
+
+	outDevice = myDevice;
+	return true;
+}
+
+
+
+static void destroyHeadlessDevice(HeadlessDevice & theDevice)
+{
+	vkDestroyDevice(theDevice.device, nullptr);
+	vkDestroyInstance(theDevice.instance, nullptr);
+	theDevice = HeadlessDevice();
+}
+
+
+
+/*
+ * A render pass and a 1x1 framebuffer without attachments.
+ */
+static bool createDiscardRenderPass(const VkDevice theDevice, VkRenderPass & outRenderPass, VkFramebuffer & outFramebuffer)
+{
+	VkResult result;
+
+	const VkSubpassDescription subpassDescription = {
+		.flags = 0,
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.inputAttachmentCount = 0,
+		.pInputAttachments = nullptr,
+		.colorAttachmentCount = 0,
+		.pColorAttachments = nullptr,
+		.pResolveAttachments = nullptr,
+		.pDepthStencilAttachment = nullptr,
+		.preserveAttachmentCount = 0,
+		.pPreserveAttachments = nullptr,
+	};
+
+	const VkRenderPassCreateInfo renderPassCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.attachmentCount = 0,
+		.pAttachments = nullptr,
+		.subpassCount = 1,
+		.pSubpasses = &subpassDescription,
+		.dependencyCount = 0,
+		.pDependencies = nullptr,
+	};
+
+	result = vkCreateRenderPass(theDevice, &renderPassCreateInfo, nullptr, &outRenderPass);
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: couldn't create the render pass: " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	return vkdemos::utils::createFramebuffer(theDevice, outRenderPass, {}, 1, 1, outFramebuffer);
+}
+
+
+
+/*
+ * A pipeline reading BenchmarkVertex vertices with vertexthroughput.vert, with rasterizer discard:
+ * no viewport, no fragment shader, no attachments needed.
+ */
+static bool createDiscardPipeline(const VkDevice theDevice,
+                                  const VkRenderPass theRenderPass,
+                                  const VkPipelineLayout thePipelineLayout,
+                                  VkPipeline & outPipeline)
+{
+	VkResult result;
+
+	VkShaderModule vertexShaderModule;
+	if(!vkdemos::utils::loadAndCreateShaderModule(theDevice, DISCARD_VERTEX_SHADER_FILE_NAME, vertexShaderModule))
+		return false;
+
+	const VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {
+		.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.pNext  = nullptr,
+		.flags  = 0,
+		.stage  = VK_SHADER_STAGE_VERTEX_BIT,
+		.module = vertexShaderModule,
+		.pName  = "main",
+		.pSpecializationInfo = nullptr,
+	};
+
+	const VkVertexInputBindingDescription vertexInputBindingDescription = {
+		.binding = 0,
+		.stride = sizeof(BenchmarkVertex),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+	};
+
+	const VkVertexInputAttributeDescription vertexInputAttributeDescription[3] = {
+		{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(BenchmarkVertex, x)},
+		{1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(BenchmarkVertex, nx)},
+		{2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(BenchmarkVertex, u)},
+	};
+
+	const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.vertexBindingDescriptionCount = 1,
+		.pVertexBindingDescriptions = &vertexInputBindingDescription,
+		.vertexAttributeDescriptionCount = 3,
+		.pVertexAttributeDescriptions = vertexInputAttributeDescription,
+	};
+
+	const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.primitiveRestartEnable = VK_FALSE,
+	};
+
+	const VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_TRUE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+		.depthBiasConstantFactor = 0.0f,
+		.depthBiasClamp = 0.0f,
+		.depthBiasSlopeFactor = 0.0f,
+		.lineWidth = 1.0f,
+	};
+
+	const VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.stageCount = 1,
+		.pStages = &shaderStageCreateInfo,
+		.pVertexInputState = &vertexInputStateCreateInfo,
+		.pInputAssemblyState = &inputAssemblyStateCreateInfo,
+		.pTessellationState = nullptr,
+		.pViewportState = nullptr,
+		.pRasterizationState = &rasterizationStateCreateInfo,
+		.pMultisampleState = nullptr,
+		.pDepthStencilState = nullptr,
+		.pColorBlendState = nullptr,
+		.pDynamicState = nullptr,
+		.layout = thePipelineLayout,
+		.renderPass = theRenderPass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1,
+	};
+
+	result = vkCreateGraphicsPipelines(theDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &outPipeline);
+	vkDestroyShaderModule(theDevice, vertexShaderModule, nullptr);
+
+	if(result != VK_SUCCESS) {
+		std::cout << "!!! ERROR: couldn't create the pipeline: " << vkdemos::utils::VkResultToString(result) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ * Benchmark of three ways of managing the command buffers recorded every frame
+ * (00_commons/31_frameCommandPool.h):
+ *
+ * - per-buffer reset: one pool with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, and
+ *   command buffers reset one by one with vkResetCommandBuffer before recording them again;
+ * - allocate and free: a transient pool per frame in flight, from which the command buffers are
+ *   allocated every frame, and freed when the frame's fence has signaled;
+ * - pool reset: a transient pool per frame in flight (FrameCommandPool), reset with a single
+ *   vkResetCommandPool when the frame's fence has signaled, and its command buffers handed out again.
+ *
+ * Every frame records a few command buffers of many small draws, with two frames in flight;
+ * the primitives are discarded before rasterization. Reports the CPU time per frame spent
+ * resetting, allocating and recording the command buffers.
+ *
+ * Needs a Vulkan device (the first one found), but no window; uses vertexthroughput.spirv.
+ * Usage: ./commandpools [command buffers per frame] [draws per command buffer] [frames]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+#include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/31_frameCommandPool.h"
+
+#include "benchmarkcommon.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+
+
+static constexpr int FRAME_LAG = 2;
+static constexpr uint32_t TRIANGLE_COUNT = 64;      // distinct triangles in the vertex buffer.
+
+enum CommandBufferStrategy
+{
+	STRATEGY_RESET_BUFFERS,
+	STRATEGY_ALLOCATE_AND_FREE,
+	STRATEGY_RESET_POOL,
+};
+
+static const char * STRATEGY_NAMES[] = {"per-buffer reset", "allocate and free", "pool reset"};
+
+
+struct BenchmarkScene
+{
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+	VkPipeline pipeline;
+	VkBuffer vertexBuffer;
+};
+
+
+
+// Records drawCount draws of one of the triangles, inside the render pass.
+static void recordBenchmarkCommandBuffer(const VkCommandBuffer theCommandBuffer, const BenchmarkScene & theScene, const int drawCount)
+{
+	VkResult result;
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	result = vkBeginCommandBuffer(theCommandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	const VkRenderPassBeginInfo renderPassBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = nullptr,
+		.renderPass = theScene.renderPass,
+		.framebuffer = theScene.framebuffer,
+		.renderArea = {{0, 0}, {1, 1}},
+		.clearValueCount = 0,
+		.pClearValues = nullptr,
+	};
+
+	vkCmdBeginRenderPass(theCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBindPipeline(theCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, theScene.pipeline);
+
+	for(int i = 0; i < drawCount; i++) {
+		const VkDeviceSize offset = sizeof(BenchmarkVertex) * 3 * (i % TRIANGLE_COUNT);
+		vkCmdBindVertexBuffers(theCommandBuffer, 0, 1, &theScene.vertexBuffer, &offset);
+		vkCmdDraw(theCommandBuffer, 3, 1, 0, 0);
+	}
+
+	vkCmdEndRenderPass(theCommandBuffer);
+
+	result = vkEndCommandBuffer(theCommandBuffer);
+	assert(result == VK_SUCCESS);
+}
+
+
+
+/*
+ * Renders frameCount frames of bufferCount command buffers with the given strategy,
+ * and returns the average CPU seconds per frame spent getting and recording the command buffers.
+ */
+static double runBenchmark(const HeadlessDevice & theDevice,
+                           const BenchmarkScene & theScene,
+                           const CommandBufferStrategy theStrategy,
+                           const int bufferCount,
+                           const int drawCount,
+                           const int frameCount)
+{
+	VkResult result;
+	bool boolResult;
+
+	const VkDevice device = theDevice.device;
+
+	// Per-buffer reset: the buffers of all the frames come from the same pool.
+	VkCommandPool mySharedPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> mySharedPoolBuffers[FRAME_LAG];
+
+	// Allocate and free, and pool reset: a transient pool per frame.
+	vkdemos::FrameCommandPool myFramePools[FRAME_LAG];
+	std::vector<VkCommandBuffer> myAllocatedBuffers[FRAME_LAG];
+
+	VkFence myFences[FRAME_LAG];
+	bool myFencePending[FRAME_LAG] = {};
+
+	for(int i = 0; i < FRAME_LAG; i++) {
+		result = vkdemos::utils::createFence(device, myFences[i]);
+		assert(result == VK_SUCCESS);
+
+		boolResult = vkdemos::createFrameCommandPool(device, theDevice.queueFamilyIndex, myFramePools[i]);
+		assert(boolResult);
+	}
+
+	if(theStrategy == STRATEGY_RESET_BUFFERS)
+	{
+		boolResult = vkdemos::createCommandPool(device, theDevice.queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, mySharedPool);
+		assert(boolResult);
+
+		for(int i = 0; i < FRAME_LAG; i++) {
+			mySharedPoolBuffers[i].resize(bufferCount);
+			for(int j = 0; j < bufferCount; j++) {
+				boolResult = vkdemos::allocateCommandBuffer(device, mySharedPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, mySharedPoolBuffers[i][j]);
+				assert(boolResult);
+			}
+		}
+	}
+
+	std::vector<VkCommandBuffer> myFrameBuffers(bufferCount);
+	double totalSeconds = 0.0;
+
+	// One more round of frames than measured, to warm up.
+	for(int frame = -FRAME_LAG; frame < frameCount; frame++)
+	{
+		const int frameIndex = (frame + FRAME_LAG) % FRAME_LAG;
+
+		if(myFencePending[frameIndex]) {
+			result = vkWaitForFences(device, 1, &myFences[frameIndex], VK_TRUE, UINT64_MAX);
+			assert(result == VK_SUCCESS);
+			result = vkResetFences(device, 1, &myFences[frameIndex]);
+			assert(result == VK_SUCCESS);
+			myFencePending[frameIndex] = false;
+		}
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		switch(theStrategy)
+		{
+			case STRATEGY_RESET_BUFFERS:
+				for(int j = 0; j < bufferCount; j++) {
+					myFrameBuffers[j] = mySharedPoolBuffers[frameIndex][j];
+					result = vkResetCommandBuffer(myFrameBuffers[j], 0);
+					assert(result == VK_SUCCESS);
+				}
+				break;
+
+			case STRATEGY_ALLOCATE_AND_FREE:
+			{
+				std::vector<VkCommandBuffer> & allocated = myAllocatedBuffers[frameIndex];
+				if(!allocated.empty()) {
+					vkFreeCommandBuffers(device, myFramePools[frameIndex].commandPool, (uint32_t)allocated.size(), allocated.data());
+					allocated.clear();
+				}
+
+				const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+					.pNext = nullptr,
+					.commandPool = myFramePools[frameIndex].commandPool,
+					.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					.commandBufferCount = (uint32_t)bufferCount
+				};
+
+				result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, myFrameBuffers.data());
+				assert(result == VK_SUCCESS);
+				allocated = myFrameBuffers;
+				break;
+			}
+
+			case STRATEGY_RESET_POOL:
+				vkdemos::resetFrameCommandPool(myFramePools[frameIndex]);
+				for(int j = 0; j < bufferCount; j++)
+					myFrameBuffers[j] = vkdemos::getFrameCommandBuffer(myFramePools[frameIndex], VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+				break;
+		}
+
+		for(int j = 0; j < bufferCount; j++)
+			recordBenchmarkCommandBuffer(myFrameBuffers[j], theScene, drawCount);
+
+		const auto stopTime = std::chrono::high_resolution_clock::now();
+		if(frame >= 0)
+			totalSeconds += std::chrono::duration<double>(stopTime - startTime).count();
+
+		const VkSubmitInfo submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = nullptr,
+			.pWaitDstStageMask = nullptr,
+			.commandBufferCount = (uint32_t)bufferCount,
+			.pCommandBuffers = myFrameBuffers.data(),
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = nullptr,
+		};
+
+		result = vkQueueSubmit(theDevice.queue, 1, &submitInfo, myFences[frameIndex]);
+		assert(result == VK_SUCCESS);
+		myFencePending[frameIndex] = true;
+	}
+
+	result = vkQueueWaitIdle(theDevice.queue);
+	assert(result == VK_SUCCESS);
+
+	for(int i = 0; i < FRAME_LAG; i++) {
+		vkDestroyFence(device, myFences[i], nullptr);
+		vkdemos::destroyFrameCommandPool(myFramePools[i]);
+	}
+
+	if(mySharedPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(device, mySharedPool, nullptr);
+
+	return totalSeconds / frameCount;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	VkResult result;
+	bool boolResult;
+
+	const int bufferCount = (argc > 1) ? std::atoi(argv[1]) : 8;
+	const int drawCount = (argc > 2) ? std::atoi(argv[2]) : 500;
+	const int frameCount = (argc > 3) ? std::atoi(argv[3]) : 500;
+
+	HeadlessDevice myHeadlessDevice;
+	if(!createHeadlessDevice("commandpools", false, myHeadlessDevice))
+		return 1;
+
+	const VkDevice myDevice = myHeadlessDevice.device;
+
+	VkCommandPool myCommandPool;
+	boolResult = vkdemos::createCommandPool(myDevice, myHeadlessDevice.queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
+	assert(boolResult);
+
+	BenchmarkScene myScene;
+	if(!createDiscardRenderPass(myDevice, myScene.renderPass, myScene.framebuffer))
+		return 1;
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 0,
+		.pSetLayouts = nullptr,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr,
+	};
+
+	VkPipelineLayout myPipelineLayout;
+	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, nullptr, &myPipelineLayout);
+	assert(result == VK_SUCCESS);
+
+	if(!createDiscardPipeline(myDevice, myScene.renderPass, myPipelineLayout, myScene.pipeline))
+		return 1;
+
+	std::vector<BenchmarkVertex> vertices(TRIANGLE_COUNT * 3);
+	for(size_t i = 0; i < vertices.size(); i++)
+		vertices[i] = {(float)(i % 3) * 0.1f, (float)(i / 3) * 0.01f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+
+	VkDeviceMemory myVertexBufferMemory;
+	boolResult = vkdemos::createGeometryBuffer(myDevice, myHeadlessDevice.memoryProperties, myHeadlessDevice.queue, myCommandPool, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vkdemos::GEOMETRY_USAGE_STATIC,
+	                                           vertices.data(), sizeof(BenchmarkVertex) * vertices.size(), myScene.vertexBuffer, myVertexBufferMemory, VKDEMOS_ALLOCATION_SITE("benchmark vertex buffer"));
+	if(!boolResult)
+		return 1;
+
+	std::cout << "--- Command buffer management on " << myHeadlessDevice.properties.deviceName << ", "
+	          << bufferCount << " command buffers of " << drawCount << " draws per frame, " << frameCount << " frames" << std::endl;
+
+	double baselineTime = 0.0;
+
+	for(int strategy = STRATEGY_RESET_BUFFERS; strategy <= STRATEGY_RESET_POOL; strategy++)
+	{
+		const double frameTime = runBenchmark(myHeadlessDevice, myScene, (CommandBufferStrategy)strategy, bufferCount, drawCount, frameCount);
+		if(strategy == STRATEGY_RESET_BUFFERS)
+			baselineTime = frameTime;
+
+		std::cout << "    " << std::setw(18) << STRATEGY_NAMES[strategy] << ": " << std::fixed << std::setprecision(1)
+		          << std::setw(8) << frameTime * 1e6 << " us per frame"
+		          << "  (x" << std::setprecision(2) << baselineTime / frameTime << " vs per-buffer reset)" << std::endl;
+	}
+
+	vkDestroyBuffer(myDevice, myScene.vertexBuffer, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
+	vkDestroyPipeline(myDevice, myScene.pipeline, nullptr);
+	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+	vkDestroyFramebuffer(myDevice, myScene.framebuffer, nullptr);
+	vkDestroyRenderPass(myDevice, myScene.renderPass, nullptr);
+	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+	destroyHeadlessDevice(myHeadlessDevice);
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Benchmark of the CPU mip chain generation (00_commons/21_cpuMipmaps.h).
+ *
+ * Generates the full mip chain of a synthetic RGBA8 image with each filter,
+ * with the scalar, SSE2 and AVX row kernels on a single thread, and with the best
+ * kernels on a thread pool; reports the throughput in megapixels of the source image
+ * per second, the speedup of the thread pool over the same kernels on a single thread,
+ * and the maximum difference of each result from the scalar one.
+ *
+ * Usage: ./cpumipmaps [size] [iterations]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/20_threadPool.h"
+#include "../00_commons/21_cpuMipmaps.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+
+
+struct BenchmarkResult
+{
+	double megapixelsPerSecond;
+	int maxDifference;
+};
+
+
+// A pattern with both smooth gradients and high frequencies, so the filters have something to do.
+static void fillTestImage(std::vector<uint8_t> & image, const uint32_t size)
+{
+	image.resize((size_t)size * size * 4);
+
+	for(uint32_t y = 0; y < size; y++) {
+		for(uint32_t x = 0; x < size; x++) {
+			uint8_t * pixel = &image[((size_t)y * size + x) * 4];
+			pixel[0] = (uint8_t)(x * 255 / size);
+			pixel[1] = (uint8_t)(y * 255 / size);
+			pixel[2] = ((x / 4 + y / 4) % 2) ? 255 : 0;
+			pixel[3] = (uint8_t)((x ^ y) & 0xFF);
+		}
+	}
+}
+
+
+static BenchmarkResult runBenchmark(vkdemos::ThreadPool * thePool,
+                                    const std::vector<uint8_t> & image,
+                                    const uint32_t size,
+                                    const int iterations,
+                                    const vkdemos::CpuImageProcessingOptions & theOptions,
+                                    const std::vector<uint8_t> & reference,
+                                    std::vector<uint8_t> & output)
+{
+	vkdemos::CpuMipChainLayout layout;
+	vkdemos::computeCpuMipChainLayout(size, size, 0, 16, layout);
+	output.assign(layout.totalSize, 0);
+
+	// Warm-up (builds the sRGB tables, faults in the memory).
+	vkdemos::generateCpuMipChain(thePool, image.data(), layout, output.data(), theOptions);
+
+	const auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; i++)
+		vkdemos::generateCpuMipChain(thePool, image.data(), layout, output.data(), theOptions);
+	const auto end = std::chrono::steady_clock::now();
+
+	const double seconds = std::chrono::duration<double>(end - start).count();
+
+	BenchmarkResult result;
+	result.megapixelsPerSecond = (double)size * size * iterations / seconds / 1e6;
+	result.maxDifference = 0;
+
+	for(size_t i = 0; i < reference.size() && i < output.size(); i++)
+		result.maxDifference = std::max(result.maxDifference, std::abs((int)reference[i] - (int)output[i]));
+
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const uint32_t size = (argc > 1) ? (uint32_t)std::atoi(argv[1]) : 2048;
+	const int iterations = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+	std::vector<uint8_t> image;
+	fillTestImage(image, size);
+
+	vkdemos::ThreadPool myThreadPool;
+	vkdemos::initThreadPool(myThreadPool);
+
+	const vkdemos::CpuSimdLevel bestSimd = vkdemos::resolveCpuSimdLevel(vkdemos::CPU_SIMD_AUTO);
+
+	std::cout << "--- CPU mip chain generation, " << size << "x" << size << " RGBA8, "
+	          << iterations << " iterations, " << vkdemos::getThreadPoolConcurrency(&myThreadPool) << " threads" << std::endl;
+
+	const char * filterNames[] = {"box", "kaiser"};
+	const char * simdNames[] = {"auto", "scalar", "sse2", "avx"};
+
+	for(int filter = vkdemos::CPU_IMAGE_FILTER_BOX; filter <= vkdemos::CPU_IMAGE_FILTER_KAISER; filter++)
+	{
+		for(int srgb = 0; srgb <= 1; srgb++)
+		{
+			vkdemos::CpuImageProcessingOptions options;
+			options.filter = (vkdemos::CpuImageFilter)filter;
+			options.srgb = (srgb != 0);
+
+			std::cout << "+++ filter " << filterNames[filter] << (srgb ? ", sRGB" : ", linear") << std::endl;
+
+			std::vector<uint8_t> reference, output;
+			double scalarSpeed = 0.0;
+			double bestSingleThreadSpeed = 0.0;
+
+			for(int simd = vkdemos::CPU_SIMD_SCALAR; simd <= vkdemos::CPU_SIMD_AVX + 1; simd++)
+			{
+				// The last run uses the best kernels on all the threads.
+				const bool threaded = (simd > vkdemos::CPU_SIMD_AVX);
+				options.simdLevel = threaded ? bestSimd : (vkdemos::CpuSimdLevel)simd;
+
+				if(!threaded && vkdemos::resolveCpuSimdLevel(options.simdLevel) != options.simdLevel)
+					continue;   // Not supported by this CPU.
+
+				const BenchmarkResult result = runBenchmark(threaded ? &myThreadPool : nullptr, image, size, iterations, options, reference, output);
+
+				if(simd == vkdemos::CPU_SIMD_SCALAR) {
+					reference = output;
+					scalarSpeed = result.megapixelsPerSecond;
+				}
+
+				if(options.simdLevel == bestSimd && !threaded)
+					bestSingleThreadSpeed = result.megapixelsPerSecond;
+
+				std::cout << "    " << std::setw(6) << simdNames[options.simdLevel] << (threaded ? ", threaded" : ",   1 thread")
+				          << ": " << std::fixed << std::setprecision(1) << std::setw(8) << result.megapixelsPerSecond << " MP/s"
+				          << "  (x" << std::setprecision(2) << result.megapixelsPerSecond / scalarSpeed << " vs scalar";
+
+				if(threaded)
+					std::cout << ", x" << result.megapixelsPerSecond / bestSingleThreadSpeed << " vs 1 thread";
+
+				std::cout << ", max difference " << result.maxDifference << ")" << std::endl;
+			}
+		}
+	}
+
+	vkdemos::destroyThreadPool(myThreadPool);
+	return 0;
+}
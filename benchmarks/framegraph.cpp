@@ -0,0 +1,195 @@
+/*
+ * Benchmark of the frame graph of 00_commons/34_frameGraph.h.
+ *
+ * Builds a graph shaped like a post-processing chain, made of transfer commands so that it
+ * needs no shaders or render passes: a "scene" pass clears a transient image, every "post" pass
+ * copies the previous image to a new transient one, and a "resolve" pass copies the last one to
+ * an imported output image. A "debug" pass writes an image nobody reads, and gets culled.
+ * Every image of the chain only lives for two passes, so the graph places them all in the memory
+ * of a few of them; the barriers between the passes are generated by the graph.
+ * Reports the transient memory with and without aliasing, the barriers recorded, and the CPU time
+ * spent recording and submitting a frame, with two frames in flight.
+ *
+ * Needs a Vulkan device (the first one found), but no window.
+ * Usage: ./framegraph [post passes] [frames] [size]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+#include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/08_createAndAllocateImage.h"
+#include "../00_commons/12_memoryAllocator.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/34_frameGraph.h"
+
+#include "benchmarkcommon.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+
+
+static constexpr int FRAME_LAG = 2;
+static constexpr VkFormat IMAGE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+
+int main(int argc, char* argv[])
+{
+	VkResult result;
+	bool boolResult;
+
+	const int postPassCount = (argc > 1) ? std::atoi(argv[1]) : 8;
+	const int frameCount = (argc > 2) ? std::atoi(argv[2]) : 200;
+	const uint32_t imageSize = (argc > 3) ? (uint32_t)std::atoi(argv[3]) : 1024;
+
+	HeadlessDevice myHeadlessDevice;
+	if(!createHeadlessDevice("framegraph", false, myHeadlessDevice))
+		return 1;
+
+	const VkDevice myDevice = myHeadlessDevice.device;
+
+	vkdemos::MemoryAllocator myAllocator;
+	boolResult = vkdemos::createMemoryAllocator(myHeadlessDevice.physicalDevice, myDevice, myAllocator);
+	assert(boolResult);
+
+	// The output image is owned by the application, like a swapchain image.
+	VkImage myOutputImage;
+	vkdemos::MemoryAllocation myOutputImageAllocation;
+	boolResult = vkdemos::createAndAllocateImage(myDevice, myAllocator, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                                             IMAGE_FORMAT, imageSize, imageSize, myOutputImage, myOutputImageAllocation,
+	                                             nullptr, 0, VKDEMOS_ALLOCATION_SITE("output image"));
+	if(!boolResult)
+		return 1;
+
+
+	/*
+	 * Declare the graph.
+	 */
+	vkdemos::FrameGraph myGraph;
+	boolResult = vkdemos::createFrameGraph(myDevice, myHeadlessDevice.queue, myHeadlessDevice.queueFamilyIndex, VK_NULL_HANDLE, 0, FRAME_LAG, myGraph);
+	if(!boolResult)
+		return 1;
+
+	const vkdemos::FrameGraphImageDesc imageDesc = {
+		.format = IMAGE_FORMAT,
+		.extent = {imageSize, imageSize},
+		.mipLevels = 1,
+		.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+	};
+
+	const vkdemos::FrameGraphResource outputResource = vkdemos::addFrameGraphImportedImage(myGraph, "output");
+	vkdemos::setFrameGraphOutput(myGraph, outputResource, vkdemos::RESOURCE_USAGE_TRANSFER_READ);
+
+	std::vector<vkdemos::FrameGraphResource> chainResources;
+	for(int i = 0; i <= postPassCount; i++)
+		chainResources.push_back(vkdemos::addFrameGraphTransientImage(myGraph, "chain" + std::to_string(i), imageDesc));
+
+	const vkdemos::FrameGraphResource debugResource = vkdemos::addFrameGraphTransientImage(myGraph, "debug", imageDesc);
+
+	const VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	const VkImageCopy imageCopy = {
+		.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.srcOffset = {0, 0, 0},
+		.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.dstOffset = {0, 0, 0},
+		.extent = {imageSize, imageSize, 1},
+	};
+
+	// The images are looked up when the passes are recorded: the transient ones exist only after compileFrameGraph.
+	auto clearPass = [&](vkdemos::FrameGraphResource theResource) {
+		return [&, theResource](VkCommandBuffer theCommandBuffer) {
+			const VkClearColorValue clearColor = {{0.2f, 0.4f, 0.6f, 1.0f}};
+			vkCmdClearColorImage(theCommandBuffer, vkdemos::getFrameGraphImage(myGraph, theResource), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+		};
+	};
+
+	auto copyPass = [&](vkdemos::FrameGraphResource theSource, vkdemos::FrameGraphResource theDestination) {
+		return [&, theSource, theDestination](VkCommandBuffer theCommandBuffer) {
+			vkCmdCopyImage(theCommandBuffer, vkdemos::getFrameGraphImage(myGraph, theSource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			               vkdemos::getFrameGraphImage(myGraph, theDestination), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
+		};
+	};
+
+	vkdemos::addFrameGraphPass(myGraph, "scene", vkdemos::FRAME_GRAPH_QUEUE_GRAPHICS,
+	                           {{chainResources[0], vkdemos::RESOURCE_USAGE_TRANSFER_WRITE}}, clearPass(chainResources[0]));
+
+	vkdemos::addFrameGraphPass(myGraph, "debug", vkdemos::FRAME_GRAPH_QUEUE_GRAPHICS,
+	                           {{chainResources[0], vkdemos::RESOURCE_USAGE_TRANSFER_READ}, {debugResource, vkdemos::RESOURCE_USAGE_TRANSFER_WRITE}},
+	                           copyPass(chainResources[0], debugResource));
+
+	for(int i = 1; i <= postPassCount; i++)
+		vkdemos::addFrameGraphPass(myGraph, "post" + std::to_string(i), vkdemos::FRAME_GRAPH_QUEUE_GRAPHICS,
+		                           {{chainResources[i - 1], vkdemos::RESOURCE_USAGE_TRANSFER_READ}, {chainResources[i], vkdemos::RESOURCE_USAGE_TRANSFER_WRITE}},
+		                           copyPass(chainResources[i - 1], chainResources[i]));
+
+	vkdemos::addFrameGraphPass(myGraph, "resolve", vkdemos::FRAME_GRAPH_QUEUE_GRAPHICS,
+	                           {{chainResources[postPassCount], vkdemos::RESOURCE_USAGE_TRANSFER_READ}, {outputResource, vkdemos::RESOURCE_USAGE_TRANSFER_WRITE}},
+	                           copyPass(chainResources[postPassCount], outputResource));
+
+	if(!vkdemos::compileFrameGraph(myGraph, &myAllocator))
+		return 1;
+
+
+	/*
+	 * Execute it.
+	 */
+	VkFence myFences[FRAME_LAG];
+	bool myFencePending[FRAME_LAG] = {};
+	for(int i = 0; i < FRAME_LAG; i++) {
+		result = vkdemos::utils::createFence(myDevice, myFences[i]);
+		assert(result == VK_SUCCESS);
+	}
+
+	std::cout << "--- Frame graph on " << myHeadlessDevice.properties.deviceName << ", "
+	          << postPassCount << " post passes, " << imageSize << "x" << imageSize << " images, " << frameCount << " frames" << std::endl;
+
+	double recordingSeconds = 0.0;
+	VkImageLayout outputLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	for(int frame = 0; frame < frameCount; frame++)
+	{
+		const uint32_t frameIndex = frame % FRAME_LAG;
+
+		if(myFencePending[frameIndex]) {
+			result = vkWaitForFences(myDevice, 1, &myFences[frameIndex], VK_TRUE, UINT64_MAX);
+			assert(result == VK_SUCCESS);
+			result = vkResetFences(myDevice, 1, &myFences[frameIndex]);
+			assert(result == VK_SUCCESS);
+		}
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		vkdemos::bindFrameGraphImage(myGraph, outputResource, myOutputImage, outputLayout);
+		boolResult = vkdemos::executeFrameGraph(myGraph, frameIndex, myFences[frameIndex]);
+		assert(boolResult);
+		myFencePending[frameIndex] = true;
+
+		const auto stopTime = std::chrono::high_resolution_clock::now();
+		recordingSeconds += std::chrono::duration<double>(stopTime - startTime).count();
+
+		outputLayout = vkdemos::getResourceUsageInfo(vkdemos::RESOURCE_USAGE_TRANSFER_READ).imageLayout;
+	}
+
+	result = vkQueueWaitIdle(myHeadlessDevice.queue);
+	assert(result == VK_SUCCESS);
+
+	vkdemos::printFrameGraphStatistics(myGraph);
+	std::cout << "    " << std::fixed << std::setprecision(1) << recordingSeconds / frameCount * 1e6 << " us per frame to record and submit the graph." << std::endl;
+
+	for(int i = 0; i < FRAME_LAG; i++)
+		vkDestroyFence(myDevice, myFences[i], nullptr);
+
+	vkdemos::destroyFrameGraph(myGraph, &myAllocator);
+	vkDestroyImage(myDevice, myOutputImage, nullptr);
+	vkdemos::freeMemoryToAllocator(myAllocator, myOutputImageAllocation);
+	vkdemos::destroyMemoryAllocator(myAllocator);
+	destroyHeadlessDevice(myHeadlessDevice);
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Benchmark of multithreaded command recording (00_commons/30_parallelCommandRecording.h).
+ *
+ * Records a render pass of many small draws (each one binds the vertex buffer at a different
+ * offset and draws a triangle) in secondary command buffers, with 1, 2, 4... slices recorded
+ * in parallel on a thread pool, and executes them with vkCmdExecuteCommands from a primary
+ * command buffer. Two frames are in flight, as in the demos, so that the recording of a frame
+ * overlaps the execution of the previous one. The primitives are discarded before rasterization.
+ * Reports the CPU time spent recording each frame, and the speedup over a single slice.
+ *
+ * Needs a Vulkan device (the first one found), but no window.
+ * Usage: ./parallelrecording [draws] [frames]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+#include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/20_threadPool.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/30_parallelCommandRecording.h"
+
+#include "benchmarkcommon.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+
+
+static constexpr int FRAME_LAG = 2;
+static constexpr uint32_t TRIANGLE_COUNT = 64;      // distinct triangles in the vertex buffer.
+static constexpr size_t MIN_DRAWS_PER_SLICE = 256;
+
+
+int main(int argc, char* argv[])
+{
+	VkResult result;
+	bool boolResult;
+
+	const size_t drawCount = (argc > 1) ? (size_t)std::atol(argv[1]) : 20000;
+	const int frameCount = (argc > 2) ? std::atoi(argv[2]) : 50;
+
+	HeadlessDevice myHeadlessDevice;
+	if(!createHeadlessDevice("parallelrecording", false, myHeadlessDevice))
+		return 1;
+
+	const VkDevice myDevice = myHeadlessDevice.device;
+	const VkQueue myQueue = myHeadlessDevice.queue;
+
+	VkCommandPool myCommandPool;
+	boolResult = vkdemos::createCommandPool(myDevice, myHeadlessDevice.queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
+	assert(boolResult);
+
+	VkRenderPass myRenderPass;
+	VkFramebuffer myFramebuffer;
+	if(!createDiscardRenderPass(myDevice, myRenderPass, myFramebuffer))
+		return 1;
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 0,
+		.pSetLayouts = nullptr,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr,
+	};
+
+	VkPipelineLayout myPipelineLayout;
+	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, nullptr, &myPipelineLayout);
+	assert(result == VK_SUCCESS);
+
+	VkPipeline myPipeline;
+	if(!createDiscardPipeline(myDevice, myRenderPass, myPipelineLayout, myPipeline))
+		return 1;
+
+	std::vector<BenchmarkVertex> vertices(TRIANGLE_COUNT * 3);
+	for(size_t i = 0; i < vertices.size(); i++)
+		vertices[i] = {(float)(i % 3) * 0.1f, (float)(i / 3) * 0.01f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+
+	VkBuffer myVertexBuffer;
+	VkDeviceMemory myVertexBufferMemory;
+	boolResult = vkdemos::createGeometryBuffer(myDevice, myHeadlessDevice.memoryProperties, myQueue, myCommandPool, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vkdemos::GEOMETRY_USAGE_STATIC,
+	                                           vertices.data(), sizeof(BenchmarkVertex) * vertices.size(), myVertexBuffer, myVertexBufferMemory, VKDEMOS_ALLOCATION_SITE("benchmark vertex buffer"));
+	if(!boolResult)
+		return 1;
+
+	// Per-frame primary command buffers and fences.
+	VkCommandBuffer myPrimaryCommandBuffers[FRAME_LAG];
+	VkFence myFences[FRAME_LAG];
+	bool myFencePending[FRAME_LAG] = {};
+
+	for(int i = 0; i < FRAME_LAG; i++) {
+		boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myPrimaryCommandBuffers[i]);
+		assert(boolResult);
+
+		result = vkdemos::utils::createFence(myDevice, myFences[i]);
+		assert(result == VK_SUCCESS);
+	}
+
+	// Every draw binds the vertex buffer at the offset of one of the triangles, and draws it.
+	const vkdemos::RecordDrawRangeFunction recordDraws = [&](VkCommandBuffer theCommandBuffer, size_t firstDraw, size_t endDraw) {
+		vkCmdBindPipeline(theCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, myPipeline);
+
+		for(size_t i = firstDraw; i < endDraw; i++) {
+			const VkDeviceSize offset = sizeof(BenchmarkVertex) * 3 * (i % TRIANGLE_COUNT);
+			vkCmdBindVertexBuffers(theCommandBuffer, 0, 1, &myVertexBuffer, &offset);
+			vkCmdDraw(theCommandBuffer, 3, 1, 0, 0);
+		}
+	};
+
+	const VkRenderPassBeginInfo renderPassBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = nullptr,
+		.renderPass = myRenderPass,
+		.framebuffer = myFramebuffer,
+		.renderArea = {{0, 0}, {1, 1}},
+		.clearValueCount = 0,
+		.pClearValues = nullptr,
+	};
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	vkdemos::ThreadPool myThreadPool;
+	vkdemos::initThreadPool(myThreadPool);
+	const uint32_t maxThreads = (uint32_t)vkdemos::getThreadPoolConcurrency(&myThreadPool);
+
+	std::cout << "--- Command recording on " << myHeadlessDevice.properties.deviceName << ", "
+	          << drawCount << " draws per frame, " << frameCount << " frames, up to " << maxThreads << " threads" << std::endl;
+
+	double singleSliceTime = 0.0;
+
+	for(uint32_t sliceCount = 1; ; sliceCount = std::min(sliceCount * 2, maxThreads))
+	{
+		vkdemos::ParallelCommandRecorder myRecorder;
+		boolResult = vkdemos::createParallelCommandRecorder(myDevice, myHeadlessDevice.queueFamilyIndex, (sliceCount > 1) ? &myThreadPool : nullptr,
+		                                                    FRAME_LAG, sliceCount, myRecorder);
+		if(!boolResult)
+			return 1;
+
+		double recordingSeconds = 0.0;
+
+		// One more frame than measured: the first one allocates the command buffers' memory.
+		for(int frame = -1; frame < frameCount; frame++)
+		{
+			const int frameIndex = (frame + FRAME_LAG) % FRAME_LAG;
+
+			if(myFencePending[frameIndex]) {
+				result = vkWaitForFences(myDevice, 1, &myFences[frameIndex], VK_TRUE, UINT64_MAX);
+				assert(result == VK_SUCCESS);
+				result = vkResetFences(myDevice, 1, &myFences[frameIndex]);
+				assert(result == VK_SUCCESS);
+				myFencePending[frameIndex] = false;
+			}
+
+			const auto startTime = std::chrono::high_resolution_clock::now();
+
+			result = vkBeginCommandBuffer(myPrimaryCommandBuffers[frameIndex], &commandBufferBeginInfo);
+			assert(result == VK_SUCCESS);
+
+			boolResult = vkdemos::recordParallelRenderPass(myRecorder, frameIndex, myPrimaryCommandBuffers[frameIndex], renderPassBeginInfo,
+			                                               drawCount, MIN_DRAWS_PER_SLICE, recordDraws);
+			assert(boolResult);
+
+			result = vkEndCommandBuffer(myPrimaryCommandBuffers[frameIndex]);
+			assert(result == VK_SUCCESS);
+
+			const auto stopTime = std::chrono::high_resolution_clock::now();
+			if(frame >= 0)
+				recordingSeconds += std::chrono::duration<double>(stopTime - startTime).count();
+
+			const VkSubmitInfo submitInfo = {
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.pNext = nullptr,
+				.waitSemaphoreCount = 0,
+				.pWaitSemaphores = nullptr,
+				.pWaitDstStageMask = nullptr,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &myPrimaryCommandBuffers[frameIndex],
+				.signalSemaphoreCount = 0,
+				.pSignalSemaphores = nullptr,
+			};
+
+			result = vkQueueSubmit(myQueue, 1, &submitInfo, myFences[frameIndex]);
+			assert(result == VK_SUCCESS);
+			myFencePending[frameIndex] = true;
+		}
+
+		result = vkQueueWaitIdle(myQueue);
+		assert(result == VK_SUCCESS);
+
+		const double frameTime = recordingSeconds / frameCount;
+		if(sliceCount == 1)
+			singleSliceTime = frameTime;
+
+		std::cout << "    " << std::setw(3) << sliceCount << " slices: " << std::fixed << std::setprecision(3)
+		          << std::setw(8) << frameTime * 1e3 << " ms per frame, "
+		          << std::setprecision(1) << std::setw(7) << drawCount / frameTime / 1e6 << " Mdraws/s"
+		          << "  (x" << std::setprecision(2) << singleSliceTime / frameTime << ")" << std::endl;
+
+		vkdemos::destroyParallelCommandRecorder(myRecorder);
+
+		if(sliceCount == maxThreads)
+			break;
+	}
+
+	vkdemos::destroyThreadPool(myThreadPool);
+
+	for(int i = 0; i < FRAME_LAG; i++)
+		vkDestroyFence(myDevice, myFences[i], nullptr);
+
+	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
+	vkDestroyPipeline(myDevice, myPipeline, nullptr);
+	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+	vkDestroyFramebuffer(myDevice, myFramebuffer, nullptr);
+	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
+	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+	destroyHeadlessDevice(myHeadlessDevice);
+	return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Benchmark of the redundant state filtering of 00_commons/32_stateFilteringRecorder.h.
+ *
+ * Records a draw list the way a simple renderer does: every draw sets all the state it needs
+ * (pipeline, viewport, scissor, vertex buffer, push constants) before drawing, even though the
+ * draws are sorted by material and mesh, so that most of these calls change nothing. The list
+ * is recorded once with the vkCmd* functions directly, and once through a StateFilteringRecorder;
+ * the primitives are discarded before rasterization.
+ * Reports the CPU time per command buffer of both versions, and the calls the recorder elided.
+ *
+ * Needs a Vulkan device (the first one found), but no window; uses vertexthroughput.spirv.
+ * Usage: ./statefiltering [draws] [materials] [meshes] [iterations]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+#include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/26_geometryBuffers.h"
+#include "../00_commons/32_stateFilteringRecorder.h"
+
+#include "benchmarkcommon.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+
+
+struct BenchmarkDraw
+{
+	uint32_t material;     // pipeline and push constants.
+	uint32_t mesh;         // triangle of the vertex buffer.
+};
+
+struct MaterialPushConstants
+{
+	float color[4];
+};
+
+
+
+/*
+ * Records the draw list in theCommandBuffer, with or without a recorder, and returns the seconds it took.
+ */
+static double recordDrawList(const VkCommandBuffer theCommandBuffer,
+                             vkdemos::StateFilteringRecorder * theRecorder,
+                             const VkRenderPass theRenderPass,
+                             const VkFramebuffer theFramebuffer,
+                             const VkPipelineLayout thePipelineLayout,
+                             const std::vector<VkPipeline> & thePipelines,
+                             const VkBuffer theVertexBuffer,
+                             const std::vector<BenchmarkDraw> & theDraws)
+{
+	VkResult result;
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	const VkRenderPassBeginInfo renderPassBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = nullptr,
+		.renderPass = theRenderPass,
+		.framebuffer = theFramebuffer,
+		.renderArea = {{0, 0}, {1, 1}},
+		.clearValueCount = 0,
+		.pClearValues = nullptr,
+	};
+
+	const VkViewport viewport = {0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+	const VkRect2D scissor = {{0, 0}, {1, 1}};
+	const VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	result = vkBeginCommandBuffer(theCommandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	vkCmdBeginRenderPass(theCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	if(theRecorder != nullptr)
+		vkdemos::beginStateFilteringRecorder(*theRecorder, theCommandBuffer);
+
+	for(const BenchmarkDraw & draw : theDraws)
+	{
+		const MaterialPushConstants pushConstants = {{(float)draw.material, 0.5f, 0.5f, 1.0f}};
+		const VkDeviceSize offset = sizeof(BenchmarkVertex) * 3 * draw.mesh;
+
+		if(theRecorder != nullptr) {
+			vkdemos::recordBindPipeline(*theRecorder, VK_PIPELINE_BIND_POINT_GRAPHICS, thePipelines[draw.material]);
+			vkdemos::recordSetViewport(*theRecorder, 0, 1, &viewport);
+			vkdemos::recordSetScissor(*theRecorder, 0, 1, &scissor);
+			vkdemos::recordBindVertexBuffers(*theRecorder, 0, 1, &theVertexBuffer, &offset);
+			vkdemos::recordPushConstants(*theRecorder, thePipelineLayout, pushConstantStages, 0, sizeof(pushConstants), &pushConstants);
+		}
+		else {
+			vkCmdBindPipeline(theCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, thePipelines[draw.material]);
+			vkCmdSetViewport(theCommandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(theCommandBuffer, 0, 1, &scissor);
+			vkCmdBindVertexBuffers(theCommandBuffer, 0, 1, &theVertexBuffer, &offset);
+			vkCmdPushConstants(theCommandBuffer, thePipelineLayout, pushConstantStages, 0, sizeof(pushConstants), &pushConstants);
+		}
+
+		vkCmdDraw(theCommandBuffer, 3, 1, 0, 0);
+	}
+
+	vkCmdEndRenderPass(theCommandBuffer);
+
+	result = vkEndCommandBuffer(theCommandBuffer);
+	assert(result == VK_SUCCESS);
+
+	const auto stopTime = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double>(stopTime - startTime).count();
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	VkResult result;
+	bool boolResult;
+
+	const uint32_t drawCount = (argc > 1) ? (uint32_t)std::atoi(argv[1]) : 20000;
+	const uint32_t materialCount = (argc > 2) ? (uint32_t)std::max(std::atoi(argv[2]), 1) : 8;
+	const uint32_t meshCount = (argc > 3) ? (uint32_t)std::max(std::atoi(argv[3]), 1) : 64;
+	const int iterationCount = (argc > 4) ? std::atoi(argv[4]) : 50;
+
+	HeadlessDevice myHeadlessDevice;
+	if(!createHeadlessDevice("statefiltering", false, myHeadlessDevice))
+		return 1;
+
+	const VkDevice myDevice = myHeadlessDevice.device;
+
+	VkCommandPool myCommandPool;
+	boolResult = vkdemos::createCommandPool(myDevice, myHeadlessDevice.queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
+	assert(boolResult);
+
+	VkCommandBuffer myCommandBuffer;
+	boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCommandBuffer);
+	assert(boolResult);
+
+	VkRenderPass myRenderPass;
+	VkFramebuffer myFramebuffer;
+	if(!createDiscardRenderPass(myDevice, myRenderPass, myFramebuffer))
+		return 1;
+
+	// The shader doesn't read the push constants, but the layout declares them.
+	const VkPushConstantRange pushConstantRange = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(MaterialPushConstants),
+	};
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 0,
+		.pSetLayouts = nullptr,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange,
+	};
+
+	VkPipelineLayout myPipelineLayout;
+	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, nullptr, &myPipelineLayout);
+	assert(result == VK_SUCCESS);
+
+	// One pipeline per material (all the same, but the driver can't know).
+	std::vector<VkPipeline> myPipelines(materialCount);
+	for(VkPipeline & pipeline : myPipelines)
+		if(!createDiscardPipeline(myDevice, myRenderPass, myPipelineLayout, pipeline))
+			return 1;
+
+	std::vector<BenchmarkVertex> vertices(meshCount * 3);
+	for(size_t i = 0; i < vertices.size(); i++)
+		vertices[i] = {(float)(i % 3) * 0.1f, (float)(i / 3) * 0.01f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+
+	VkBuffer myVertexBuffer;
+	VkDeviceMemory myVertexBufferMemory;
+	boolResult = vkdemos::createGeometryBuffer(myDevice, myHeadlessDevice.memoryProperties, myHeadlessDevice.queue, myCommandPool, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vkdemos::GEOMETRY_USAGE_STATIC,
+	                                           vertices.data(), sizeof(BenchmarkVertex) * vertices.size(), myVertexBuffer, myVertexBufferMemory, VKDEMOS_ALLOCATION_SITE("benchmark vertex buffer"));
+	if(!boolResult)
+		return 1;
+
+	// The draw list, sorted by material and then by mesh, as a renderer would.
+	const uint32_t drawsPerMaterial = std::max<uint32_t>((drawCount + materialCount - 1) / materialCount, 1);
+	const uint32_t drawsPerMesh = std::max<uint32_t>(drawsPerMaterial / meshCount, 1);
+
+	std::vector<BenchmarkDraw> myDraws(drawCount);
+	for(uint32_t i = 0; i < drawCount; i++)
+		myDraws[i] = {i / drawsPerMaterial, (i % drawsPerMaterial) / drawsPerMesh % meshCount};
+
+	std::cout << "--- State filtering on " << myHeadlessDevice.properties.deviceName << ", "
+	          << drawCount << " draws, " << materialCount << " materials, " << meshCount << " meshes, " << iterationCount << " iterations" << std::endl;
+
+	vkdemos::StateFilteringRecorder myRecorder;
+	double seconds[2] = {};
+
+	for(int iteration = -1; iteration < iterationCount; iteration++)
+	{
+		for(int filtered = 0; filtered < 2; filtered++)
+		{
+			// The statistics of a single command buffer are enough.
+			if(iteration == 0 && filtered == 1)
+				myRecorder.statistics = vkdemos::StateFilteringStatistics();
+
+			const double time = recordDrawList(myCommandBuffer, filtered ? &myRecorder : nullptr, myRenderPass, myFramebuffer,
+			                                   myPipelineLayout, myPipelines, myVertexBuffer, myDraws);
+
+			// The first iteration warms up the command buffer's memory.
+			if(iteration >= 0)
+				seconds[filtered] += time;
+
+			result = vkResetCommandBuffer(myCommandBuffer, 0);
+			assert(result == VK_SUCCESS);
+		}
+
+		if(iteration == 0)
+			vkdemos::printStateFilteringStatistics(myRecorder.statistics, "Recorder, one command buffer");
+	}
+
+	const char * versionNames[2] = {"vkCmd* directly", "state filtering"};
+	for(int filtered = 0; filtered < 2; filtered++)
+	{
+		const double commandBufferTime = seconds[filtered] / iterationCount;
+		std::cout << "    " << std::setw(16) << versionNames[filtered] << ": " << std::fixed << std::setprecision(1)
+		          << std::setw(8) << commandBufferTime * 1e6 << " us per command buffer"
+		          << "  (x" << std::setprecision(2) << seconds[0] / seconds[filtered] << ")" << std::endl;
+	}
+
+	vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
+	vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
+	for(VkPipeline pipeline : myPipelines)
+		vkDestroyPipeline(myDevice, pipeline, nullptr);
+	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+	vkDestroyFramebuffer(myDevice, myFramebuffer, nullptr);
+	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
+	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+	destroyHeadlessDevice(myHeadlessDevice);
+	return 0;
+}
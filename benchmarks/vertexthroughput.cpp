@@ -0,0 +1,263 @@
+/*
+ * Benchmark of the vertex throughput from host-visible and device-local vertex buffers
+ * (the two placements of 00_commons/26_geometryBuffers.h).
+ *
+ * Creates the same vertex buffer twice, as GEOMETRY_USAGE_DYNAMIC (host-visible memory)
+ * and as GEOMETRY_USAGE_STATIC (device-local memory), then draws it many times with a
+ * pipeline that discards the primitives before rasterization, so that the time is spent
+ * fetching and transforming vertices; the draws are timed with timestamp queries.
+ * Reports millions of vertices per second, and the vertex data read per second.
+ *
+ * Needs a Vulkan device (the first one found), but no window.
+ * Usage: ./vertexthroughput [millions of vertices] [draws]
+ */
+
+#include <vulkan/vulkan.h>
+
+#include "../00_commons/00_utils.h"
+#include "../00_commons/07_commandPoolAndBuffer.h"
+#include "../00_commons/15_memoryTracker.h"
+#include "../00_commons/26_geometryBuffers.h"
+
+#include "benchmarkcommon.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+
+// Pseudo-random positions; the triangles are discarded anyway, but the shader can't know.
+static void fillTestVertices(std::vector<BenchmarkVertex> & vertices, const uint32_t vertexCount)
+{
+	vertices.resize(vertexCount);
+
+	uint32_t seed = 12345;
+	for(uint32_t i = 0; i < vertexCount; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		const float r = (float)(seed >> 8) / (float)(1u << 24);
+
+		vertices[i] = {r * 2.0f - 1.0f, 1.0f - r * 2.0f, 0.5f, 0.0f, 0.0f, 1.0f, (float)(i % 3) * 0.001f, 0.0f};
+	}
+}
+
+
+
+/*
+ * Draws theVertexBuffer drawCount times in a single command buffer, and returns the seconds the device took.
+ */
+static double runBenchmark(const VkDevice theDevice,
+                           const VkQueue theQueue,
+                           const VkCommandBuffer theCommandBuffer,
+                           const VkFence theFence,
+                           const VkQueryPool theQueryPool,
+                           const double timestampPeriod,
+                           const VkRenderPass theRenderPass,
+                           const VkFramebuffer theFramebuffer,
+                           const VkPipeline thePipeline,
+                           const VkBuffer theVertexBuffer,
+                           const uint32_t vertexCount,
+                           const int drawCount)
+{
+	VkResult result;
+
+	const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr,
+	};
+
+	result = vkBeginCommandBuffer(theCommandBuffer, &commandBufferBeginInfo);
+	assert(result == VK_SUCCESS);
+
+	vkCmdResetQueryPool(theCommandBuffer, theQueryPool, 0, 2);
+
+	const VkRenderPassBeginInfo renderPassBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = nullptr,
+		.renderPass = theRenderPass,
+		.framebuffer = theFramebuffer,
+		.renderArea = {{0, 0}, {1, 1}},
+		.clearValueCount = 0,
+		.pClearValues = nullptr,
+	};
+
+	vkCmdBeginRenderPass(theCommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBindPipeline(theCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, thePipeline);
+
+	const VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(theCommandBuffer, 0, 1, &theVertexBuffer, &offset);
+
+	vkCmdWriteTimestamp(theCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, theQueryPool, 0);
+
+	for(int i = 0; i < drawCount; i++)
+		vkCmdDraw(theCommandBuffer, vertexCount, 1, 0, 0);
+
+	vkCmdWriteTimestamp(theCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, theQueryPool, 1);
+
+	vkCmdEndRenderPass(theCommandBuffer);
+
+	result = vkEndCommandBuffer(theCommandBuffer);
+	assert(result == VK_SUCCESS);
+
+	const VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = nullptr,
+		.pWaitDstStageMask = nullptr,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &theCommandBuffer,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = nullptr,
+	};
+
+	result = vkQueueSubmit(theQueue, 1, &submitInfo, theFence);
+	assert(result == VK_SUCCESS);
+
+	result = vkWaitForFences(theDevice, 1, &theFence, VK_TRUE, UINT64_MAX);
+	assert(result == VK_SUCCESS);
+
+	result = vkResetFences(theDevice, 1, &theFence);
+	assert(result == VK_SUCCESS);
+
+	uint64_t timestamps[2];
+	result = vkGetQueryPoolResults(theDevice, theQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	assert(result == VK_SUCCESS);
+
+	return (double)(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-9;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	VkResult result;
+	bool boolResult;
+
+	const uint32_t vertexCount = (argc > 1) ? (uint32_t)(std::atof(argv[1]) * 1e6) / 3 * 3 : 3000000;
+	const int drawCount = (argc > 2) ? std::atoi(argv[2]) : 20;
+
+	/*
+	 * Headless setup: see benchmarkcommon.h.
+	 */
+	HeadlessDevice myHeadlessDevice;
+	if(!createHeadlessDevice("vertexthroughput", true, myHeadlessDevice))
+		return 1;
+
+	const VkDevice myDevice = myHeadlessDevice.device;
+	const VkQueue myQueue = myHeadlessDevice.queue;
+	const VkPhysicalDeviceProperties & myPhysicalDeviceProperties = myHeadlessDevice.properties;
+	const VkPhysicalDeviceMemoryProperties & myMemoryProperties = myHeadlessDevice.memoryProperties;
+	const uint32_t myQueueFamilyIndex = myHeadlessDevice.queueFamilyIndex;
+
+	VkCommandPool myCommandPool;
+	boolResult = vkdemos::createCommandPool(myDevice, myQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, myCommandPool);
+	assert(boolResult);
+
+	VkCommandBuffer myCommandBuffer;
+	boolResult = vkdemos::allocateCommandBuffer(myDevice, myCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, myCommandBuffer);
+	assert(boolResult);
+
+	VkFence myFence;
+	result = vkdemos::utils::createFence(myDevice, myFence);
+	assert(result == VK_SUCCESS);
+
+	const VkQueryPoolCreateInfo queryPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2,
+		.pipelineStatistics = 0,
+	};
+
+	VkQueryPool myQueryPool;
+	result = vkCreateQueryPool(myDevice, &queryPoolCreateInfo, nullptr, &myQueryPool);
+	assert(result == VK_SUCCESS);
+
+	/*
+	 * A render pass and a framebuffer without attachments, and a pipeline without fragment shader:
+	 * the primitives are discarded before rasterization.
+	 */
+	VkRenderPass myRenderPass;
+	VkFramebuffer myFramebuffer;
+	if(!createDiscardRenderPass(myDevice, myRenderPass, myFramebuffer))
+		return 1;
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 0,
+		.pSetLayouts = nullptr,
+		.pushConstantRangeCount = 0,
+		.pPushConstantRanges = nullptr,
+	};
+
+	VkPipelineLayout myPipelineLayout;
+	result = vkCreatePipelineLayout(myDevice, &pipelineLayoutCreateInfo, nullptr, &myPipelineLayout);
+	assert(result == VK_SUCCESS);
+
+	VkPipeline myPipeline;
+	if(!createDiscardPipeline(myDevice, myRenderPass, myPipelineLayout, myPipeline))
+		return 1;
+
+	/*
+	 * The same vertices, in a dynamic (host-visible) and in a static (device-local) geometry buffer.
+	 */
+	std::vector<BenchmarkVertex> vertices;
+	fillTestVertices(vertices, vertexCount);
+	const VkDeviceSize vertexBufferSize = sizeof(BenchmarkVertex) * (VkDeviceSize)vertexCount;
+
+	const char * usageNames[] = {"device-local (static)", "host-visible (dynamic)"};
+	const vkdemos::GeometryUsageHint usageHints[] = {vkdemos::GEOMETRY_USAGE_STATIC, vkdemos::GEOMETRY_USAGE_DYNAMIC};
+
+	std::cout << "--- Vertex throughput on " << myPhysicalDeviceProperties.deviceName << ", "
+	          << vertexCount << " vertices of " << sizeof(BenchmarkVertex) << " bytes, " << drawCount << " draws" << std::endl;
+
+	double staticSpeed = 0.0;
+
+	for(int i = 0; i < 2; i++)
+	{
+		VkBuffer myVertexBuffer;
+		VkDeviceMemory myVertexBufferMemory;
+		boolResult = vkdemos::createGeometryBuffer(myDevice, myMemoryProperties, myQueue, myCommandPool, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, usageHints[i],
+		                                           vertices.data(), vertexBufferSize, myVertexBuffer, myVertexBufferMemory, VKDEMOS_ALLOCATION_SITE("benchmark vertex buffer"));
+		if(!boolResult)
+			return 1;
+
+		// Warm-up (the first submit may include lazy driver work).
+		runBenchmark(myDevice, myQueue, myCommandBuffer, myFence, myQueryPool, myPhysicalDeviceProperties.limits.timestampPeriod,
+		             myRenderPass, myFramebuffer, myPipeline, myVertexBuffer, vertexCount, 1);
+
+		const double seconds = runBenchmark(myDevice, myQueue, myCommandBuffer, myFence, myQueryPool, myPhysicalDeviceProperties.limits.timestampPeriod,
+		                                    myRenderPass, myFramebuffer, myPipeline, myVertexBuffer, vertexCount, drawCount);
+
+		const double verticesPerSecond = (double)vertexCount * drawCount / seconds;
+		if(i == 0)
+			staticSpeed = verticesPerSecond;
+
+		std::cout << "    " << std::setw(22) << usageNames[i] << ": " << std::fixed << std::setprecision(1)
+		          << std::setw(8) << verticesPerSecond / 1e6 << " Mvertices/s, "
+		          << std::setw(7) << verticesPerSecond * sizeof(BenchmarkVertex) / 1e9 << " GB/s"
+		          << "  (x" << std::setprecision(2) << verticesPerSecond / staticSpeed << " vs device-local)" << std::endl;
+
+		vkDestroyBuffer(myDevice, myVertexBuffer, nullptr);
+		vkdemos::trackedFreeMemory(myDevice, myVertexBufferMemory);
+	}
+
+	vkDestroyPipeline(myDevice, myPipeline, nullptr);
+	vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+	vkDestroyFramebuffer(myDevice, myFramebuffer, nullptr);
+	vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
+	vkDestroyQueryPool(myDevice, myQueryPool, nullptr);
+	vkDestroyFence(myDevice, myFence, nullptr);
+	vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+	destroyHeadlessDevice(myHeadlessDevice);
+	return 0;
+}
@@ -0,0 +1,13 @@
+#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// A typical mesh vertex: 32 bytes, all of them used, so that none of the fetches can be skipped.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+void main()
+{
+	gl_Position = vec4(position + normal * uv.x, 1.0 + uv.y);
+}